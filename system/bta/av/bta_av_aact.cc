@@ -2227,7 +2227,11 @@ void bta_av_data_path(tBTA_AV_SCB* p_scb, UNUSED_ATTR tBTA_AV_DATA* p_data) {
         p_buf2->len += fragment_len;
         extra_fragments.push_back(p_buf2);
         p_buf->len -= fragment_len;
+        p_scb->media_stats.buffer_allocs++;
+        p_scb->media_stats.copied_bytes += fragment_len;
       }
+      p_scb->media_stats.packets++;
+      p_scb->media_stats.fragments += extra_fragments.size();
 
       if (!extra_fragments.empty()) {
         // Reset the RTP Marker bit for all fragments except the last one
@@ -564,6 +564,13 @@ struct tBTA_AV_SCB final {
   uint8_t q_tag; /* identify the associated q_info union member */
   bool no_rtp_header; /* true if add no RTP header */
   uint16_t uuid_int; /*intended UUID of Initiator to connect to */
+  /* Media path counters, cleared when a peer connects */
+  struct {
+    uint64_t packets;       /* media packets handed to AVDTP */
+    uint64_t fragments;     /* extra packets for payloads above the MTU */
+    uint64_t buffer_allocs; /* buffers allocated by BTA AV */
+    uint64_t copied_bytes;  /* bytes copied by BTA AV */
+  } media_stats;
 
   /**
    * Called to setup the state when connected to a peer.
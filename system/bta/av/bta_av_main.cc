@@ -26,6 +26,7 @@
 
 #include <base/logging.h>
 
+#include <cinttypes>
 #include <cstdint>
 
 #include "bta/av/bta_av_int.h"
@@ -355,6 +356,7 @@ void bta_av_free_scb(tBTA_AV_SCB* p_scb) {
 
 void tBTA_AV_SCB::OnConnected(const RawAddress& peer_address) {
   peer_address_ = peer_address;
+  media_stats = {};
 
   if (peer_address.IsEmpty()) {
     LOG_ERROR("%s: Invalid peer address: %s", __func__,
@@ -1192,9 +1194,12 @@ void bta_av_dup_audio_buf(tBTA_AV_SCB* p_scb, BT_HDR* p_buf) {
     if (!(bta_av_cb.conn_audio & BTA_AV_HNDL_TO_MSK(i)))
       continue; /* Audio is not connected */
 
-    /* Enqueue the data */
+    /* Enqueue the data. Every channel prepends its own headers in place, so
+     * each needs a copy of its own. */
     BT_HDR* p_new = (BT_HDR*)osi_malloc(copy_size);
     memcpy(p_new, p_buf, copy_size);
+    p_scbi->media_stats.buffer_allocs++;
+    p_scbi->media_stats.copied_bytes += copy_size;
     list_append(p_scbi->a2dp_list, p_new);
 
     if (list_length(p_scbi->a2dp_list) > p_bta_av_cfg->audio_mqs) {
@@ -1631,5 +1636,12 @@ void bta_debug_av_dump(int fd) {
             p_scb->no_rtp_header ? "true" : "false");
     dprintf(fd, "    Intended UUID of Initiator to connect to: 0x%x\n",
             p_scb->uuid_int);
+    dprintf(fd, "    Media packets: %" PRIu64 "\n", p_scb->media_stats.packets);
+    dprintf(fd, "      MTU fragments: %" PRIu64 "\n",
+            p_scb->media_stats.fragments);
+    dprintf(fd, "      Buffers allocated: %" PRIu64 "\n",
+            p_scb->media_stats.buffer_allocs);
+    dprintf(fd, "      Bytes copied by BTA AV: %" PRIu64 "\n",
+            p_scb->media_stats.copied_bytes);
   }
 }
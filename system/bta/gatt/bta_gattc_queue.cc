@@ -18,9 +18,11 @@
 
 #include "bta_gatt_queue.h"
 
+#include <iterator>
 #include <list>
 #include <unordered_map>
-#include <unordered_set>
+#include <utility>
+#include <vector>
 
 #include "osi/include/allocator.h"
 #include "osi/include/log.h"
@@ -36,6 +38,11 @@ constexpr uint8_t GATT_WRITE_DESC = 4;
 constexpr uint8_t GATT_CONFIG_MTU = 5;
 constexpr uint8_t GATT_READ_MULTI = 6;
 
+/* Maximum number of writes without response handed to the stack at once */
+constexpr int GATT_MAX_STREAMED_WRITES = 8;
+
+bool gatt_profile_get_eatt_support(const RawAddress& remote_bda);
+
 struct gatt_read_op_data {
   GATT_READ_OP_CB cb;
   void* cb_data;
@@ -43,10 +50,12 @@ struct gatt_read_op_data {
 
 std::unordered_map<uint16_t, std::list<gatt_operation>>
     BtaGattQueue::gatt_op_queue;
-std::unordered_set<uint16_t> BtaGattQueue::gatt_op_queue_executing;
+std::unordered_map<uint16_t, int> BtaGattQueue::gatt_op_queue_executing;
 
 void BtaGattQueue::mark_as_not_executing(uint16_t conn_id) {
-  gatt_op_queue_executing.erase(conn_id);
+  auto it = gatt_op_queue_executing.find(conn_id);
+  if (it == gatt_op_queue_executing.end()) return;
+  if (--it->second <= 0) gatt_op_queue_executing.erase(it);
 }
 
 void BtaGattQueue::gatt_read_op_finished(uint16_t conn_id, tGATT_STATUS status,
@@ -138,6 +147,123 @@ void BtaGattQueue::gatt_read_multi_op_finished(uint16_t conn_id,
   }
 }
 
+struct gatt_merged_reads_data {
+  std::list<gatt_operation> reads;
+};
+
+static bool is_mergeable_read(const gatt_operation& op) {
+  return (op.type == GATT_READ_CHAR || op.type == GATT_READ_DESC) &&
+         !op.read_alone;
+}
+
+static bool is_write_no_rsp(const gatt_operation& op) {
+  return op.type == GATT_WRITE_CHAR && op.write_type == GATT_WRITE_NO_RSP;
+}
+
+static bool is_read_multi_var_len_supported(uint16_t conn_id) {
+  tGATT_IF gatt_if;
+  RawAddress remote_bda;
+  tBT_TRANSPORT transport;
+  if (!GATT_GetConnectionInfor(conn_id, &gatt_if, remote_bda, &transport)) {
+    return false;
+  }
+
+  /* Read Multiple Variable Length is mandatory for the servers supporting
+   * EATT */
+  return gatt_profile_get_eatt_support(remote_bda);
+}
+
+void BtaGattQueue::gatt_merged_reads_finished(uint16_t conn_id,
+                                              tGATT_STATUS status,
+                                              tBTA_GATTC_MULTI& handles,
+                                              uint16_t len, uint8_t* value,
+                                              void* data) {
+  gatt_merged_reads_data* tmp = (gatt_merged_reads_data*)data;
+  std::list<gatt_operation> reads = std::move(tmp->reads);
+  delete tmp;
+
+  /* The values come as length value tuples, the last ones being cut if they
+   * do not fit in the MTU. */
+  std::vector<std::pair<uint16_t, uint8_t*>> values;
+  if (status == GATT_SUCCESS) {
+    uint8_t* p = value;
+    uint16_t remaining = len;
+    while (values.size() < reads.size() && remaining >= 2) {
+      uint16_t value_len = p[0] | (p[1] << 8);
+      if (value_len > remaining - 2) break;
+      values.emplace_back(value_len, p + 2);
+      p += 2 + value_len;
+      remaining -= 2 + value_len;
+    }
+  }
+
+  /* Read one by one what the merged read did not return, before any other
+   * queued operation. Nothing is read if the queue was cleaned meanwhile. */
+  auto not_read = std::next(reads.begin(), values.size());
+  if (not_read != reads.end()) {
+    LOG_DEBUG("conn_id=0x%x, %zu of %zu reads to retry, status=%d", conn_id,
+              reads.size() - values.size(), reads.size(), status);
+    if (gatt_op_queue_executing.count(conn_id)) {
+      for (auto it = not_read; it != reads.end(); it++) it->read_alone = true;
+      std::list<gatt_operation>& gatt_ops = gatt_op_queue[conn_id];
+      gatt_ops.splice(gatt_ops.begin(), reads, not_read, reads.end());
+    }
+  }
+
+  mark_as_not_executing(conn_id);
+  gatt_execute_next_op(conn_id);
+
+  auto read = reads.begin();
+  for (const auto& [value_len, value_ptr] : values) {
+    if (read->read_cb) {
+      read->read_cb(conn_id, GATT_SUCCESS, read->handle, value_len, value_ptr,
+                    read->read_cb_data);
+    }
+    read++;
+  }
+}
+
+bool BtaGattQueue::gatt_execute_merged_reads(
+    uint16_t conn_id, std::list<gatt_operation>& gatt_ops) {
+  auto last = gatt_ops.begin();
+  tBTA_GATTC_MULTI handles = {.num_attr = 0};
+  while (last != gatt_ops.end() &&
+         handles.num_attr < GATT_MAX_READ_MULTI_HANDLES &&
+         is_mergeable_read(*last)) {
+    handles.handles[handles.num_attr++] = last->handle;
+    last++;
+  }
+
+  if (handles.num_attr < 2 || !is_read_multi_var_len_supported(conn_id)) {
+    return false;
+  }
+
+  LOG_VERBOSE("%s: conn_id=0x%x, merging %d reads", __func__, conn_id,
+              handles.num_attr);
+  gatt_merged_reads_data* data = new gatt_merged_reads_data();
+  data->reads.splice(data->reads.end(), gatt_ops, gatt_ops.begin(), last);
+  gatt_op_queue_executing[conn_id]++;
+  BTA_GATTC_ReadMultiple(conn_id, handles, true, GATT_AUTH_REQ_NONE,
+                         gatt_merged_reads_finished, data);
+  return true;
+}
+
+void BtaGattQueue::gatt_execute_write_op(uint16_t conn_id,
+                                         gatt_operation& op) {
+  gatt_write_op_data* data =
+      (gatt_write_op_data*)osi_malloc(sizeof(gatt_write_op_data));
+  data->cb = op.write_cb;
+  data->cb_data = op.write_cb_data;
+  if (op.type == GATT_WRITE_CHAR) {
+    BTA_GATTC_WriteCharValue(conn_id, op.handle, op.write_type,
+                             std::move(op.value), GATT_AUTH_REQ_NONE,
+                             gatt_write_op_finished, data);
+  } else {
+    BTA_GATTC_WriteCharDescr(conn_id, op.handle, std::move(op.value),
+                             GATT_AUTH_REQ_NONE, gatt_write_op_finished, data);
+  }
+}
+
 void BtaGattQueue::gatt_execute_next_op(uint16_t conn_id) {
   LOG_VERBOSE("%s: conn_id=0x%x", __func__, conn_id);
   if (gatt_op_queue.empty()) {
@@ -157,10 +283,24 @@ void BtaGattQueue::gatt_execute_next_op(uint16_t conn_id) {
     return;
   }
 
-  gatt_op_queue_executing.insert(conn_id);
-
   std::list<gatt_operation>& gatt_ops = map_ptr->second;
 
+  if (is_write_no_rsp(gatt_ops.front())) {
+    /* Writes without response are only paced by the stack, consecutive ones
+     * are handed over without waiting for each other. */
+    while (!gatt_ops.empty() && is_write_no_rsp(gatt_ops.front()) &&
+           gatt_op_queue_executing[conn_id] < GATT_MAX_STREAMED_WRITES) {
+      gatt_op_queue_executing[conn_id]++;
+      gatt_execute_write_op(conn_id, gatt_ops.front());
+      gatt_ops.pop_front();
+    }
+    return;
+  }
+
+  if (gatt_execute_merged_reads(conn_id, gatt_ops)) return;
+
+  gatt_op_queue_executing[conn_id]++;
+
   gatt_operation& op = gatt_ops.front();
 
   if (op.type == GATT_READ_CHAR) {
@@ -179,22 +319,8 @@ void BtaGattQueue::gatt_execute_next_op(uint16_t conn_id) {
     BTA_GATTC_ReadCharDescr(conn_id, op.handle, GATT_AUTH_REQ_NONE,
                             gatt_read_op_finished, data);
 
-  } else if (op.type == GATT_WRITE_CHAR) {
-    gatt_write_op_data* data =
-        (gatt_write_op_data*)osi_malloc(sizeof(gatt_write_op_data));
-    data->cb = op.write_cb;
-    data->cb_data = op.write_cb_data;
-    BTA_GATTC_WriteCharValue(conn_id, op.handle, op.write_type,
-                             std::move(op.value), GATT_AUTH_REQ_NONE,
-                             gatt_write_op_finished, data);
-
-  } else if (op.type == GATT_WRITE_DESC) {
-    gatt_write_op_data* data =
-        (gatt_write_op_data*)osi_malloc(sizeof(gatt_write_op_data));
-    data->cb = op.write_cb;
-    data->cb_data = op.write_cb_data;
-    BTA_GATTC_WriteCharDescr(conn_id, op.handle, std::move(op.value),
-                             GATT_AUTH_REQ_NONE, gatt_write_op_finished, data);
+  } else if (op.type == GATT_WRITE_CHAR || op.type == GATT_WRITE_DESC) {
+    gatt_execute_write_op(conn_id, op);
   } else if (op.type == GATT_CONFIG_MTU) {
     gatt_configure_mtu_op_data* data =
       (gatt_configure_mtu_op_data*)osi_malloc(sizeof(gatt_configure_mtu_op_data));
@@ -32,6 +32,11 @@
  *
  * If you decide to use those methods in your app, make sure to not mix it with
  * existing BTA_GATTC_* API.
+ *
+ * When the peer supports EATT, and hence Read Multiple Variable Length,
+ * consecutive queued reads are merged in a single request, and their
+ * callbacks are called one by one as if they were read separately. Writes
+ * without response are streamed without waiting for each other.
  */
 class BtaGattQueue {
  public:
@@ -71,6 +76,10 @@ class BtaGattQueue {
     /* write-specific fields */
     tGATT_WRITE_TYPE write_type;
     std::vector<uint8_t> value;
+
+    /* whether the read must not be merged with others, e.g. when it could not
+     * be served by the read multiple it was part of */
+    bool read_alone;
   };
 
  private:
@@ -88,8 +97,16 @@ class BtaGattQueue {
                                           tBTA_GATTC_MULTI& handle,
                                           uint16_t len, uint8_t* value,
                                           void* data);
+  static bool gatt_execute_merged_reads(uint16_t conn_id,
+                                        std::list<gatt_operation>& gatt_ops);
+  static void gatt_merged_reads_finished(uint16_t conn_id, tGATT_STATUS status,
+                                         tBTA_GATTC_MULTI& handles,
+                                         uint16_t len, uint8_t* value,
+                                         void* data);
+  static void gatt_execute_write_op(uint16_t conn_id, gatt_operation& op);
   // maps connection id to operations waiting for execution
   static std::unordered_map<uint16_t, std::list<gatt_operation>> gatt_op_queue;
-  // contain connection ids that currently execute operations
-  static std::unordered_set<uint16_t> gatt_op_queue_executing;
+  // maps connection ids that currently execute operations to the number of
+  // operations they execute
+  static std::unordered_map<uint16_t, int> gatt_op_queue_executing;
 };
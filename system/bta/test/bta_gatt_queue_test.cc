@@ -0,0 +1,327 @@
+/*
+ * Copyright 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "bta/include/bta_gatt_queue.h"
+
+#include <gtest/gtest.h>
+
+#include <deque>
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace {
+
+constexpr uint16_t kConnId = 1;
+
+// A request handed to BTA GATTC, completed when the test answers it as the
+// peer would.
+struct Request {
+  std::string type;
+  std::vector<uint16_t> handles;
+  tGATT_WRITE_TYPE write_type;
+  std::function<void(tGATT_STATUS)> complete;
+};
+
+std::deque<Request> requests;
+bool eatt_supported;
+uint16_t mtu;
+std::map<uint16_t, std::vector<uint8_t>> attributes;
+
+// A read callback result
+struct Read {
+  tGATT_STATUS status;
+  uint16_t handle;
+  std::vector<uint8_t> value;
+};
+std::vector<Read> reads;
+std::vector<uint16_t> writes;
+
+void on_read(uint16_t conn_id, tGATT_STATUS status, uint16_t handle,
+             uint16_t len, uint8_t* value, void* data) {
+  reads.push_back({status, handle, std::vector<uint8_t>(value, value + len)});
+}
+
+void on_write(uint16_t conn_id, tGATT_STATUS status, uint16_t handle,
+              uint16_t len, const uint8_t* value, void* data) {
+  writes.push_back(handle);
+}
+
+void push_read(uint16_t conn_id, uint16_t handle, GATT_READ_OP_CB callback,
+               void* cb_data) {
+  requests.push_back(
+      {"read", {handle}, GATT_WRITE, [=](tGATT_STATUS status) {
+         std::vector<uint8_t> value = attributes[handle];
+         callback(conn_id, status, handle, value.size(), value.data(),
+                  cb_data);
+       }});
+}
+
+void push_write(uint16_t conn_id, uint16_t handle, tGATT_WRITE_TYPE write_type,
+                GATT_WRITE_OP_CB callback, void* cb_data) {
+  requests.push_back(
+      {"write", {handle}, write_type, [=](tGATT_STATUS status) {
+         callback(conn_id, status, handle, 0, nullptr, cb_data);
+       }});
+}
+
+}  // namespace
+
+void BTA_GATTC_ReadCharacteristic(uint16_t conn_id, uint16_t handle,
+                                  tGATT_AUTH_REQ auth_req,
+                                  GATT_READ_OP_CB callback, void* cb_data) {
+  push_read(conn_id, handle, callback, cb_data);
+}
+
+void BTA_GATTC_ReadCharDescr(uint16_t conn_id, uint16_t handle,
+                             tGATT_AUTH_REQ auth_req, GATT_READ_OP_CB callback,
+                             void* cb_data) {
+  push_read(conn_id, handle, callback, cb_data);
+}
+
+void BTA_GATTC_ReadMultiple(uint16_t conn_id, tBTA_GATTC_MULTI& handles,
+                            bool variable_len, tGATT_AUTH_REQ auth_req,
+                            GATT_READ_MULTI_OP_CB callback, void* cb_data) {
+  ASSERT_TRUE(variable_len);
+  std::vector<uint16_t> handle_list(handles.handles,
+                                    handles.handles + handles.num_attr);
+  requests.push_back(
+      {"read_multi", handle_list, GATT_WRITE, [=](tGATT_STATUS status) {
+         // Length value tuples, cut to fit in the MTU
+         std::vector<uint8_t> rsp;
+         for (uint16_t handle : handle_list) {
+           const std::vector<uint8_t>& value = attributes[handle];
+           rsp.push_back(value.size() & 0xff);
+           rsp.push_back(value.size() >> 8);
+           rsp.insert(rsp.end(), value.begin(), value.end());
+         }
+         if (rsp.size() > mtu - 1u) rsp.resize(mtu - 1);
+         tBTA_GATTC_MULTI multi = {.num_attr = 0};
+         for (uint16_t handle : handle_list) {
+           multi.handles[multi.num_attr++] = handle;
+         }
+         callback(conn_id, status, multi, rsp.size(), rsp.data(), cb_data);
+       }});
+}
+
+void BTA_GATTC_WriteCharValue(uint16_t conn_id, uint16_t handle,
+                              tGATT_WRITE_TYPE write_type,
+                              std::vector<uint8_t> value,
+                              tGATT_AUTH_REQ auth_req,
+                              GATT_WRITE_OP_CB callback, void* cb_data) {
+  push_write(conn_id, handle, write_type, callback, cb_data);
+}
+
+void BTA_GATTC_WriteCharDescr(uint16_t conn_id, uint16_t handle,
+                              std::vector<uint8_t> value,
+                              tGATT_AUTH_REQ auth_req,
+                              GATT_WRITE_OP_CB callback, void* cb_data) {
+  push_write(conn_id, handle, GATT_WRITE, callback, cb_data);
+}
+
+void BTA_GATTC_ConfigureMTU(uint16_t conn_id, uint16_t mtu,
+                            GATT_CONFIGURE_MTU_OP_CB callback, void* cb_data) {
+  requests.push_back({"mtu", {}, GATT_WRITE, [=](tGATT_STATUS status) {
+                        callback(conn_id, status, cb_data);
+                      }});
+}
+
+bool GATT_GetConnectionInfor(uint16_t conn_id, tGATT_IF* p_gatt_if,
+                             RawAddress& bd_addr, tBT_TRANSPORT* p_transport) {
+  return true;
+}
+
+bool gatt_profile_get_eatt_support(const RawAddress& remote_bda) {
+  return eatt_supported;
+}
+
+class BtaGattQueueTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    requests.clear();
+    reads.clear();
+    writes.clear();
+    attributes.clear();
+    eatt_supported = true;
+    mtu = 64;
+  }
+
+  void TearDown() override { BtaGattQueue::Clean(kConnId); }
+
+  // Answers the oldest pending request.
+  void Answer(tGATT_STATUS status = GATT_SUCCESS) {
+    ASSERT_FALSE(requests.empty());
+    Request request = requests.front();
+    requests.pop_front();
+    request.complete(status);
+  }
+};
+
+TEST_F(BtaGattQueueTest, reads_are_merged_when_eatt_is_supported) {
+  attributes = {{0x10, {1}}, {0x12, {2, 2}}, {0x14, {}}};
+  BtaGattQueue::ReadCharacteristic(kConnId, 0x10, on_read, nullptr);
+  BtaGattQueue::ReadCharacteristic(kConnId, 0x12, on_read, nullptr);
+  BtaGattQueue::ReadDescriptor(kConnId, 0x14, on_read, nullptr);
+
+  // The first read went out alone, the following ones wait for it.
+  ASSERT_EQ(requests.size(), 1u);
+  ASSERT_EQ(requests.front().type, "read");
+  Answer();
+  ASSERT_EQ(requests.size(), 1u);
+  ASSERT_EQ(requests.front().type, "read_multi");
+  ASSERT_EQ(requests.front().handles, std::vector<uint16_t>({0x12, 0x14}));
+  Answer();
+
+  ASSERT_TRUE(requests.empty());
+  ASSERT_EQ(reads.size(), 3u);
+  ASSERT_EQ(reads[0].handle, 0x10);
+  ASSERT_EQ(reads[1].handle, 0x12);
+  ASSERT_EQ(reads[1].value, std::vector<uint8_t>({2, 2}));
+  ASSERT_EQ(reads[2].handle, 0x14);
+  ASSERT_TRUE(reads[2].value.empty());
+}
+
+TEST_F(BtaGattQueueTest, reads_are_not_merged_without_eatt) {
+  eatt_supported = false;
+  BtaGattQueue::ConfigureMtu(kConnId, 64);
+  BtaGattQueue::ReadCharacteristic(kConnId, 0x10, on_read, nullptr);
+  BtaGattQueue::ReadCharacteristic(kConnId, 0x12, on_read, nullptr);
+
+  ASSERT_EQ(requests.front().type, "mtu");
+  Answer();
+  ASSERT_EQ(requests.front().type, "read");
+  Answer();
+  ASSERT_EQ(requests.front().type, "read");
+  Answer();
+  ASSERT_EQ(reads.size(), 2u);
+}
+
+TEST_F(BtaGattQueueTest, cut_values_are_read_again_in_order) {
+  mtu = 23;
+  attributes = {{0x10, std::vector<uint8_t>(8, 1)},
+                {0x12, std::vector<uint8_t>(8, 2)},
+                {0x14, std::vector<uint8_t>(8, 3)},
+                {0x16, std::vector<uint8_t>(1, 4)}};
+  BtaGattQueue::ConfigureMtu(kConnId, mtu);
+  for (uint16_t handle : {0x10, 0x12, 0x14, 0x16}) {
+    BtaGattQueue::ReadCharacteristic(kConnId, handle, on_read, nullptr);
+  }
+  Answer();
+
+  // Only the first two tuples fit in the response.
+  ASSERT_EQ(requests.front().type, "read_multi");
+  Answer();
+  ASSERT_EQ(reads.size(), 2u);
+  ASSERT_EQ(requests.front().type, "read");
+  ASSERT_EQ(requests.front().handles, std::vector<uint16_t>({0x14}));
+  Answer();
+  ASSERT_EQ(requests.front().type, "read");
+  ASSERT_EQ(requests.front().handles, std::vector<uint16_t>({0x16}));
+  Answer();
+
+  ASSERT_EQ(reads.size(), 4u);
+  for (size_t i = 0; i < reads.size(); i++) {
+    ASSERT_EQ(reads[i].handle, 0x10 + 2 * i);
+    ASSERT_EQ(reads[i].value, attributes[reads[i].handle]);
+  }
+}
+
+TEST_F(BtaGattQueueTest, failed_merged_read_is_retried_one_by_one) {
+  BtaGattQueue::ConfigureMtu(kConnId, mtu);
+  BtaGattQueue::ReadCharacteristic(kConnId, 0x10, on_read, nullptr);
+  BtaGattQueue::ReadCharacteristic(kConnId, 0x12, on_read, nullptr);
+  Answer();
+
+  ASSERT_EQ(requests.front().type, "read_multi");
+  Answer(GATT_INSUF_AUTHENTICATION);
+  ASSERT_TRUE(reads.empty());
+
+  // Each read gets its own status.
+  ASSERT_EQ(requests.front().type, "read");
+  Answer(GATT_INSUF_AUTHENTICATION);
+  ASSERT_EQ(requests.front().type, "read");
+  Answer();
+  ASSERT_EQ(reads.size(), 2u);
+  ASSERT_EQ(reads[0].status, GATT_INSUF_AUTHENTICATION);
+  ASSERT_EQ(reads[1].status, GATT_SUCCESS);
+}
+
+TEST_F(BtaGattQueueTest, writes_without_response_are_streamed) {
+  BtaGattQueue::ConfigureMtu(kConnId, mtu);
+  for (uint16_t handle : {0x20, 0x22, 0x24}) {
+    BtaGattQueue::WriteCharacteristic(kConnId, handle, {1}, GATT_WRITE_NO_RSP,
+                                      on_write, nullptr);
+  }
+  BtaGattQueue::WriteCharacteristic(kConnId, 0x26, {1}, GATT_WRITE, on_write,
+                                    nullptr);
+  Answer();
+
+  // The writes without response went out together, the write request waits
+  // for them.
+  ASSERT_EQ(requests.size(), 3u);
+  for (const Request& request : requests) {
+    ASSERT_EQ(request.write_type, GATT_WRITE_NO_RSP);
+  }
+  Answer();
+  Answer();
+  ASSERT_EQ(requests.size(), 1u);
+  Answer();
+  ASSERT_EQ(requests.size(), 1u);
+  ASSERT_EQ(requests.front().write_type, GATT_WRITE);
+  Answer();
+  ASSERT_EQ(writes, std::vector<uint16_t>({0x20, 0x22, 0x24, 0x26}));
+}
+
+// The requests waiting for a response from an LE Audio earbud, at
+// connection time: PACS, ASCS, CSIS and VCS reads, then the CCC writes.
+static int configure_earbud_round_trips() {
+  constexpr uint16_t kReads = 14;
+  constexpr uint16_t kCccWrites = 8;
+  BtaGattQueue::ConfigureMtu(kConnId, mtu);
+  for (uint16_t i = 0; i < kReads; i++) {
+    attributes[0x100 + i] = std::vector<uint8_t>(2, i);
+    BtaGattQueue::ReadCharacteristic(kConnId, 0x100 + i, on_read, nullptr);
+  }
+  for (uint16_t i = 0; i < kCccWrites; i++) {
+    BtaGattQueue::WriteDescriptor(kConnId, 0x200 + i, {0x01, 0x00}, GATT_WRITE,
+                                  on_write, nullptr);
+  }
+
+  int round_trips = 0;
+  while (!requests.empty()) {
+    round_trips++;
+    Request request = requests.front();
+    requests.pop_front();
+    request.complete(GATT_SUCCESS);
+  }
+  EXPECT_EQ(reads.size(), kReads);
+  EXPECT_EQ(writes.size(), kCccWrites);
+  return round_trips;
+}
+
+TEST_F(BtaGattQueueTest, earbud_configuration_round_trips) {
+  eatt_supported = false;
+  int sequential_round_trips = configure_earbud_round_trips();
+  ASSERT_EQ(sequential_round_trips, 1 + 14 + 8);
+
+  reads.clear();
+  writes.clear();
+  eatt_supported = true;
+  int merged_round_trips = configure_earbud_round_trips();
+  // The reads queued behind the MTU exchange go out in two read multiple.
+  ASSERT_EQ(merged_round_trips, 1 + 2 + 8);
+}
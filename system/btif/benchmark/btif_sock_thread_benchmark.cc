@@ -0,0 +1,102 @@
+/*
+ * Copyright 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <base/logging.h>
+#include <benchmark/benchmark.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <future>
+#include <memory>
+#include <vector>
+
+#include "btif/include/btif_sock_thread.h"
+
+using ::benchmark::State;
+
+// Each connection is a socket pair standing for an RFCOMM socket: the app
+// writes on one end, and the socket thread signals the stack end, which is
+// drained and monitored again the way btif_sock_rfc does it.
+
+#define MESSAGE_SIZE 64
+
+static int g_handle = -1;
+static std::atomic<int> g_pending_messages;
+static std::unique_ptr<std::promise<void>> g_done_promise;
+
+static void on_signaled(int fd, int type, int flags, uint32_t user_id) {
+  if (!(flags & SOCK_THREAD_FD_RD)) return;
+  char buffer[MESSAGE_SIZE];
+  if (recv(fd, buffer, sizeof(buffer), MSG_DONTWAIT) <= 0) return;
+  btsock_thread_add_fd(g_handle, fd, BTSOCK_RFCOMM, SOCK_THREAD_FD_RD,
+                       user_id);
+  if (--g_pending_messages == 0) g_done_promise->set_value();
+}
+
+// Every iteration sends one message on every connection, and waits for the
+// socket thread to deliver all of them.
+static void BM_SocketThreadConnections(State& state) {
+  int connections = static_cast<int>(state.range(0));
+  btsock_thread_init();
+  g_handle = btsock_thread_create(on_signaled, NULL);
+  CHECK(g_handle >= 0);
+
+  std::vector<int> app_fds;
+  std::vector<int> stack_fds;
+  for (int i = 0; i < connections; i++) {
+    int fds[2];
+    CHECK(socketpair(AF_UNIX, SOCK_SEQPACKET, 0, fds) == 0);
+    stack_fds.push_back(fds[0]);
+    app_fds.push_back(fds[1]);
+    btsock_thread_add_fd(g_handle, fds[0], BTSOCK_RFCOMM, SOCK_THREAD_FD_RD,
+                         i);
+  }
+
+  char message[MESSAGE_SIZE] = {};
+  for (auto _ : state) {
+    g_pending_messages = connections;
+    g_done_promise = std::make_unique<std::promise<void>>();
+    std::future<void> done = g_done_promise->get_future();
+    for (int fd : app_fds) {
+      CHECK(send(fd, message, sizeof(message), 0) == sizeof(message));
+    }
+    done.wait();
+  }
+  state.SetItemsProcessed(static_cast<int64_t>(state.iterations()) *
+                          connections);
+
+  btsock_thread_exit(g_handle);
+  for (int fd : app_fds) close(fd);
+  for (int fd : stack_fds) close(fd);
+}
+BENCHMARK(BM_SocketThreadConnections)
+    ->Arg(16)
+    ->Arg(64)
+    ->Arg(256)
+    ->Arg(1024);
+
+int main(int argc, char** argv) {
+  // Disable LOG() output from libchrome
+  logging::LoggingSettings log_settings;
+  log_settings.logging_dest = logging::LoggingDestination::LOG_NONE;
+  CHECK(logging::InitLogging(log_settings)) << "Failed to set up logging";
+  ::benchmark::Initialize(&argc, argv);
+  if (::benchmark::ReportUnrecognizedArguments(argc, argv)) {
+    return 1;
+  }
+  ::benchmark::RunSpecifiedBenchmarks();
+}
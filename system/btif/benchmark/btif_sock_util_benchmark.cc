@@ -0,0 +1,96 @@
+/*
+ * Copyright 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <base/logging.h>
+#include <benchmark/benchmark.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <thread>
+#include <vector>
+
+#include "btif/include/btif_sock_util.h"
+
+using ::benchmark::State;
+
+// Loopback throughput of the SDUs between an app and the stack, over the
+// SOCK_SEQPACKET socket pair an L2CAP CoC socket uses. The "app" sends SDUs
+// from a thread, the stack end receives them one recv() at a time or in
+// batches of SOCK_MAX_BATCH.
+
+#define SDUS_PER_ITERATION 4096
+
+static void app_sender(int fd, size_t sdu_size, int sdus) {
+  std::vector<uint8_t> sdu(sdu_size);
+  for (int i = 0; i < sdus; i++) {
+    CHECK(send(fd, sdu.data(), sdu.size(), 0) == (ssize_t)sdu.size());
+  }
+}
+
+static void wait_readable(int fd) {
+  uint8_t byte;
+  recv(fd, &byte, sizeof(byte), MSG_PEEK);
+}
+
+static void run_loopback(State& state, bool batched) {
+  size_t sdu_size = state.range(0);
+  int fds[2];
+  CHECK(socketpair(AF_UNIX, SOCK_SEQPACKET, 0, fds) == 0);
+
+  std::vector<std::vector<uint8_t>> buffers(SOCK_MAX_BATCH,
+                                            std::vector<uint8_t>(sdu_size));
+  struct iovec msgs[SOCK_MAX_BATCH];
+  for (int i = 0; i < SOCK_MAX_BATCH; i++) {
+    msgs[i] = {buffers[i].data(), sdu_size};
+  }
+  uint32_t lens[SOCK_MAX_BATCH];
+
+  for (auto _ : state) {
+    std::thread app(app_sender, fds[1], sdu_size, SDUS_PER_ITERATION);
+    int received = 0;
+    while (received < SDUS_PER_ITERATION) {
+      wait_readable(fds[0]);
+      int count = batched ? sock_recv_msgs(fds[0], msgs, SOCK_MAX_BATCH, lens)
+                          : sock_recv_msgs(fds[0], msgs, 1, lens);
+      if (count > 0) received += count;
+    }
+    app.join();
+  }
+  state.SetItemsProcessed(static_cast<int64_t>(state.iterations()) *
+                          SDUS_PER_ITERATION);
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) *
+                          SDUS_PER_ITERATION * sdu_size);
+  close(fds[0]);
+  close(fds[1]);
+}
+
+static void BM_ReceiveSduPerCall(State& state) { run_loopback(state, false); }
+BENCHMARK(BM_ReceiveSduPerCall)->Arg(64)->Arg(672)->Arg(4096);
+
+static void BM_ReceiveSduBatch(State& state) { run_loopback(state, true); }
+BENCHMARK(BM_ReceiveSduBatch)->Arg(64)->Arg(672)->Arg(4096);
+
+int main(int argc, char** argv) {
+  // Disable LOG() output from libchrome
+  logging::LoggingSettings log_settings;
+  log_settings.logging_dest = logging::LoggingDestination::LOG_NONE;
+  CHECK(logging::InitLogging(log_settings)) << "Failed to set up logging";
+  ::benchmark::Initialize(&argc, argv);
+  if (::benchmark::ReportUnrecognizedArguments(argc, argv)) {
+    return 1;
+  }
+  ::benchmark::RunSpecifiedBenchmarks();
+}
@@ -0,0 +1,136 @@
+/*
+ * Copyright 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+
+#include "common/spsc_queue.h"
+#include "stack/include/bt_hdr.h"
+
+// Playout buffer between the AVDTP receive path and the A2DP Sink decoder.
+//
+// Packets are handed over from the receiving thread through a lock-free
+// single producer / single consumer queue, stamped with their arrival time.
+// The decoding thread pulls the packets that are due for playout: the buffer
+// estimates the packet interval and the arrival jitter of the link, holds back
+// a target depth that covers the jitter, and paces playout at the estimated
+// packet rate. The target depth grows after an underrun and slowly shrinks
+// back once the link is stable again.
+//
+// Enqueue() and Length() may be called from the receiving thread, everything
+// else must be called from the decoding thread (or while it is not running).
+// Enqueue() only takes a lock when the buffer is full and the oldest packet
+// has to make room for the new one.
+class BtifA2dpSinkJitterBuffer {
+ public:
+  struct Stats {
+    uint64_t packets_received;
+    uint64_t packets_played;
+    uint64_t packets_overflowed;  // Dropped because the buffer was full
+    uint64_t late_packets;        // Arrived after a newer packet was played
+    uint64_t underruns;
+    size_t depth;
+    size_t target_depth;
+    uint64_t packet_interval_us;
+    uint64_t jitter_us;
+    uint64_t average_latency_us;  // From arrival to playout
+    uint64_t max_latency_us;
+  };
+
+  // |capacity| is the maximum number of buffered packets. |min_depth| is the
+  // number of packets held back before playout starts on a jitter-free link.
+  BtifA2dpSinkJitterBuffer(size_t capacity, size_t min_depth);
+  ~BtifA2dpSinkJitterBuffer();
+
+  BtifA2dpSinkJitterBuffer(const BtifA2dpSinkJitterBuffer&) = delete;
+  BtifA2dpSinkJitterBuffer& operator=(const BtifA2dpSinkJitterBuffer&) =
+      delete;
+
+  // Takes ownership of |p_msg|, which must have been allocated with
+  // osi_malloc(). Its layer_specific field carries the RTP sequence number.
+  // Returns false if the buffer was full and its oldest packet was dropped.
+  bool Enqueue(BT_HDR* p_msg, uint64_t arrival_us);
+
+  // Hands the packets that are due for playout at |now_us| to |play|, in
+  // sequence order, and returns how many were played. |play| does not take
+  // ownership of the packet.
+  size_t Pull(uint64_t now_us, const std::function<void(BT_HDR*)>& play);
+
+  // Drops all buffered packets and restarts buffering. Link estimates and
+  // statistics are kept.
+  void Flush();
+
+  // Drops all buffered packets and forgets the link estimates and statistics.
+  void Reset();
+
+  // Number of buffered packets. Only a snapshot outside the decoding thread.
+  size_t Length() const;
+
+  Stats GetStats() const;
+
+ private:
+  struct Entry {
+    BT_HDR* p_msg;
+    uint64_t arrival_us;
+  };
+
+  void Drain();
+  void Insert(const Entry& entry);
+  void UpdateArrivalEstimates(uint64_t arrival_us);
+  size_t TargetDepth() const;
+  uint64_t PacketIntervalUs() const { return packet_interval_x16_ >> 4; }
+  void Play(const Entry& entry, uint64_t now_us,
+            const std::function<void(BT_HDR*)>& play);
+
+  const size_t capacity_;
+  const size_t min_depth_;
+  bluetooth::common::SpscQueue<Entry> rx_queue_;
+  // Held while dequeuing from |rx_queue_|, so that the receiving thread can
+  // also take the oldest packet out of it when it is full.
+  std::mutex rx_dequeue_mutex_;
+
+  // Written by the receiving thread.
+  std::atomic<uint64_t> packets_received_{0};
+  std::atomic<uint64_t> packets_overflowed_{0};
+
+  // Owned by the decoding thread.
+  std::deque<Entry> playout_queue_;
+  std::atomic<size_t> playout_length_{0};
+  bool playing_ = false;
+  uint64_t last_pull_us_ = 0;
+  uint64_t playout_credit_us_ = 0;
+  uint64_t last_arrival_us_ = 0;
+  uint64_t rate_window_start_us_ = 0;
+  size_t rate_window_intervals_ = 0;
+  size_t rate_estimate_intervals_ = 0;
+  uint64_t packet_interval_x16_ = 0;  // In 1/16 us
+  uint64_t jitter_x16_ = 0;           // In 1/16 us
+  size_t underrun_margin_ = 0;
+  uint64_t last_underrun_us_ = 0;
+  bool has_played_ = false;
+  uint16_t last_played_seq_ = 0;
+  uint64_t packets_played_ = 0;
+  uint64_t late_packets_ = 0;
+  uint64_t underruns_ = 0;
+  uint64_t average_latency_us_ = 0;
+  uint64_t max_latency_us_ = 0;
+};
@@ -32,7 +32,7 @@
 #define SOCK_THREAD_FD_WR (1 << 1)        /* BT socket write signal */
 #define SOCK_THREAD_FD_EXCEPTION (1 << 2) /* BT socket exception singal */
 
-/* Add BT socket fd in current socket poll thread context immediately */
+/* Add BT socket fd immediately. Every add is immediate now, from any thread */
 #define SOCK_THREAD_ADD_FD_SYNC (1 << 3)
 
 /*******************************************************************************
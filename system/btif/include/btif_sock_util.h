@@ -28,9 +28,32 @@
 #define BTIF_SOCK_UTIL_H
 
 #include <stdint.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+
+// Maximum number of messages or buffers moved by one vectored call
+#define SOCK_MAX_BATCH 16
 
 int sock_send_fd(int sock_fd, const uint8_t* buffer, int len, int send_fd);
 int sock_send_all(int sock_fd, const uint8_t* buf, int len);
 int sock_recv_all(int sock_fd, uint8_t* buf, int len);
 
+// Sends each of the |count| buffers of |msgs| as one message of a
+// SOCK_SEQPACKET socket, without blocking and in a single system call.
+// Returns the number of messages sent, or -1 with errno set if none could be.
+int sock_send_msgs(int sock_fd, const struct iovec* msgs, int count);
+
+// Receives up to |count| messages of a SOCK_SEQPACKET socket into the buffers
+// of |msgs|, without blocking and in a single system call. The length of
+// each message is written to |lens|; messages longer than their buffer are
+// truncated, and report their untruncated length. Returns the number of
+// messages received, or -1 with errno set if none could be.
+int sock_recv_msgs(int sock_fd, const struct iovec* msgs, int count,
+                   uint32_t* lens);
+
+// Gathers the |count| buffers of |iov| into a single send on a stream
+// socket, without blocking. Returns the number of bytes sent, which may end
+// in the middle of a buffer, or -1 with errno set.
+ssize_t sock_send_iov(int sock_fd, const struct iovec* iov, int count);
+
 #endif
@@ -88,16 +88,21 @@
 #include "device/include/interop.h"
 #include "device/include/interop_config.h"
 #include "gd/common/init_flags.h"
+#include "gd/common/task_tracer.h"
 #include "gd/os/parameter_provider.h"
 #include "internal_include/bt_target.h"
 #include "main/shim/dumpsys.h"
 #include "os/log.h"
 #include "osi/include/alarm.h"
 #include "osi/include/allocator.h"
+#include "osi/include/properties.h"
 #include "osi/include/stack_power_telemetry.h"
 #include "osi/include/wakelock.h"
 #include "stack/btm/btm_sco_hfp_hal.h"
+#include "stack/eatt/eatt.h"
 #include "stack/gatt/connection_manager.h"
+#include "stack/gatt/gatt_notif_batch.h"
+#include "stack/gatt/gatt_sr_pipeline.h"
 #include "stack/include/a2dp_api.h"
 #include "stack/include/avdt_api.h"
 #include "stack/include/btm_api.h"
@@ -404,6 +409,8 @@ static int init(bt_callbacks_t* callbacks, bool start_restricted,
       config_compare_result);
 
   bluetooth::common::InitFlags::Load(init_flags);
+  bluetooth::common::TaskTracer::SetEnabled(
+      osi_property_get_bool("persist.bluetooth.task_tracing.enabled", false));
 
   if (interface_ready()) return BT_STATUS_DONE;
 
@@ -795,6 +802,7 @@ static void dump(int fd, const char** arguments) {
   BTA_HfClientDumpStatistics(fd);
   wakelock_debug_dump(fd);
   alarm_debug_dump(fd);
+  bluetooth::common::DumpTaskTraces(fd);
   bluetooth::csis::CsisClient::DebugDump(fd);
   le_audio::has::HasClient::DebugDump(fd);
   HearingAid::DebugDump(fd);
@@ -802,6 +810,9 @@ static void dump(int fd, const char** arguments) {
   LeAudioBroadcaster::DebugDump(fd);
   VolumeControl::DebugDump(fd);
   connection_manager::dump(fd);
+  gatt_notif_batch_dump(fd);
+  gatt_sr_pipeline_dump(fd);
+  bluetooth::eatt::EattExtension::Dump(fd);
   bluetooth::bqr::DebugDump(fd);
   PAN_Dumpsys(fd);
   DumpsysHid(fd);
@@ -29,14 +29,15 @@
 #include <string>
 
 #include "bt_target.h"  // Must be first to define build configuration
+#include "btif/include/btif_a2dp_sink_jitter_buffer.h"
 #include "btif/include/btif_av.h"
 #include "btif/include/btif_av_co.h"
 #include "btif/include/btif_avrcp_audio_track.h"
 #include "btif/include/btif_util.h"  // CASE_RETURN_STR
 #include "common/message_loop_thread.h"
+#include "common/time_util.h"
 #include "osi/include/alarm.h"
 #include "osi/include/allocator.h"
-#include "osi/include/fixed_queue.h"
 #include "osi/include/log.h"
 #include "osi/include/osi.h"  // UNUSED_ATTR
 #include "stack/include/bt_hdr.h"
@@ -87,9 +88,11 @@ class BtifA2dpSinkControlBlock {
  public:
   explicit BtifA2dpSinkControlBlock(const std::string& thread_name)
       : worker_thread(thread_name),
-        rx_audio_queue(nullptr),
+        jitter_buffer(MAX_INPUT_A2DP_FRAME_QUEUE_SZ,
+                      MAX_A2DP_DELAYED_START_FRAME_COUNT),
         rx_flush(false),
         decode_alarm(nullptr),
+        decoding(false),
         sample_rate(0),
         channel_count(0),
         rx_focus_state(BTIF_A2DP_SINK_FOCUS_NOT_GRANTED),
@@ -102,10 +105,10 @@ class BtifA2dpSinkControlBlock {
       BtifAvrcpAudioTrackDelete(audio_track);
     }
     audio_track = nullptr;
-    fixed_queue_free(rx_audio_queue, nullptr);
-    rx_audio_queue = nullptr;
+    jitter_buffer.Reset();
     alarm_free(decode_alarm);
     decode_alarm = nullptr;
+    decoding = false;
     rx_flush = false;
     rx_focus_state = BTIF_A2DP_SINK_FOCUS_NOT_GRANTED;
     sample_rate = 0;
@@ -114,9 +117,12 @@ class BtifA2dpSinkControlBlock {
   }
 
   MessageLoopThread worker_thread;
-  fixed_queue_t* rx_audio_queue;
-  bool rx_flush; /* discards any incoming data when true */
+  // Filled by the AVDTP receive thread without taking g_mutex, played out by
+  // the worker thread.
+  BtifA2dpSinkJitterBuffer jitter_buffer;
+  std::atomic<bool> rx_flush; /* discards any incoming data when true */
   alarm_t* decode_alarm;
+  std::atomic<bool> decoding; /* decode_alarm is running */
   tA2DP_SAMPLE_RATE sample_rate;
   tA2DP_BITS_PER_SAMPLE bits_per_sample;
   tA2DP_CHANNEL_COUNT channel_count;
@@ -191,8 +197,6 @@ bool btif_a2dp_sink_init() {
     return false;
   }
 
-  btif_a2dp_sink_cb.rx_audio_queue = fixed_queue_new(SIZE_MAX);
-
   /* Schedule the rest of the operations */
   if (!btif_a2dp_sink_cb.worker_thread.EnableRealTimeScheduling()) {
 #if defined(__ANDROID__)
@@ -322,6 +326,7 @@ void btif_a2dp_sink_cleanup() {
 
     decode_alarm = btif_a2dp_sink_cb.decode_alarm;
     btif_a2dp_sink_cb.decode_alarm = nullptr;
+    btif_a2dp_sink_cb.decoding = false;
   }
 
   // Stop the timer
@@ -337,8 +342,7 @@ static void btif_a2dp_sink_cleanup_delayed() {
   LOG_INFO("%s", __func__);
   LockGuard lock(g_mutex);
 
-  fixed_queue_free(btif_a2dp_sink_cb.rx_audio_queue, nullptr);
-  btif_a2dp_sink_cb.rx_audio_queue = nullptr;
+  btif_a2dp_sink_cb.jitter_buffer.Flush();
   btif_a2dp_sink_state = BTIF_A2DP_SINK_STATE_OFF;
 }
 
@@ -469,6 +473,7 @@ static void btif_a2dp_sink_audio_handle_stop_decoding() {
     btif_a2dp_sink_audio_rx_flush_req();
     old_alarm = btif_a2dp_sink_cb.decode_alarm;
     btif_a2dp_sink_cb.decode_alarm = nullptr;
+    btif_a2dp_sink_cb.decoding = false;
   }
 
   // Drop the lock here, btif_decode_alarm_cb may in the process of being called
@@ -517,6 +522,7 @@ static void btif_a2dp_sink_audio_handle_start_decoding() {
     LOG_ERROR("%s: unable to allocate decode alarm", __func__);
     return;
   }
+  btif_a2dp_sink_cb.decoding = true;
   alarm_set(btif_a2dp_sink_cb.decode_alarm, BTIF_SINK_MEDIA_TIME_TICK_MS,
             btif_decode_alarm_cb, nullptr);
 }
@@ -545,8 +551,7 @@ static void btif_a2dp_sink_handle_inc_media(BT_HDR* p_msg) {
 static void btif_a2dp_sink_avk_handle_timer() {
   LockGuard lock(g_mutex);
 
-  BT_HDR* p_msg;
-  if (fixed_queue_is_empty(btif_a2dp_sink_cb.rx_audio_queue)) {
+  if (btif_a2dp_sink_cb.jitter_buffer.Length() == 0) {
     LOG_VERBOSE("%s: empty queue", __func__);
     return;
   }
@@ -558,24 +563,16 @@ static void btif_a2dp_sink_avk_handle_timer() {
   }
   /* Play only in BTIF_A2DP_SINK_FOCUS_GRANTED case */
   if (btif_a2dp_sink_cb.rx_flush) {
-    fixed_queue_flush(btif_a2dp_sink_cb.rx_audio_queue, osi_free);
+    btif_a2dp_sink_cb.jitter_buffer.Flush();
     return;
   }
 
   LOG_VERBOSE("%s: process frames begin", __func__);
-  while (true) {
-    p_msg = (BT_HDR*)fixed_queue_try_dequeue(btif_a2dp_sink_cb.rx_audio_queue);
-    if (p_msg == NULL) {
-      break;
-    }
-    LOG_VERBOSE("%s: number of packets in queue %zu", __func__,
-                fixed_queue_length(btif_a2dp_sink_cb.rx_audio_queue));
-
-    /* Queue packet has less frames */
-    btif_a2dp_sink_handle_inc_media(p_msg);
-    osi_free(p_msg);
-  }
-  LOG_VERBOSE("%s: process frames end", __func__);
+  size_t played = btif_a2dp_sink_cb.jitter_buffer.Pull(
+      bluetooth::common::time_get_os_boottime_us(),
+      btif_a2dp_sink_handle_inc_media);
+  LOG_VERBOSE("%s: process frames end, played %zu, %zu left in queue",
+              __func__, played, btif_a2dp_sink_cb.jitter_buffer.Length());
 }
 
 /* when true media task discards any rx frames */
@@ -590,7 +587,7 @@ static void btif_a2dp_sink_audio_rx_flush_event() {
   LOG_INFO("%s", __func__);
   LockGuard lock(g_mutex);
   // Flush all received encoded audio buffers
-  fixed_queue_flush(btif_a2dp_sink_cb.rx_audio_queue, osi_free);
+  btif_a2dp_sink_cb.jitter_buffer.Flush();
 }
 
 static void btif_a2dp_sink_decoder_update_event(
@@ -662,9 +659,8 @@ static void btif_a2dp_sink_decoder_update_event(
 }
 
 uint8_t btif_a2dp_sink_enqueue_buf(BT_HDR* p_pkt) {
-  LockGuard lock(g_mutex);
   if (btif_a2dp_sink_cb.rx_flush) /* Flush enabled, do not enqueue */
-    return fixed_queue_length(btif_a2dp_sink_cb.rx_audio_queue);
+    return btif_a2dp_sink_cb.jitter_buffer.Length();
 
   LOG_VERBOSE("%s +", __func__);
   /* Allocate and queue this buffer */
@@ -673,19 +669,17 @@ uint8_t btif_a2dp_sink_enqueue_buf(BT_HDR* p_pkt) {
   memcpy(p_msg, p_pkt, sizeof(*p_msg));
   p_msg->offset = 0;
   memcpy(p_msg->data, p_pkt->data + p_pkt->offset, p_pkt->len);
-  fixed_queue_enqueue(btif_a2dp_sink_cb.rx_audio_queue, p_msg);
-
-  if (fixed_queue_length(btif_a2dp_sink_cb.rx_audio_queue) ==
-      MAX_INPUT_A2DP_FRAME_QUEUE_SZ) {
-    osi_free(fixed_queue_try_dequeue(btif_a2dp_sink_cb.rx_audio_queue));
-    uint8_t ret = fixed_queue_length(btif_a2dp_sink_cb.rx_audio_queue);
-    return ret;
+  if (!btif_a2dp_sink_cb.jitter_buffer.Enqueue(
+          p_msg, bluetooth::common::time_get_os_boottime_us())) {
+    LOG_VERBOSE("%s: queue full, dropped oldest packet", __func__);
+    return btif_a2dp_sink_cb.jitter_buffer.Length();
   }
 
-  // Avoid other checks if alarm has already been initialized.
-  if (btif_a2dp_sink_cb.decode_alarm == nullptr &&
-      fixed_queue_length(btif_a2dp_sink_cb.rx_audio_queue) >=
-          MAX_A2DP_DELAYED_START_FRAME_COUNT) {
+  // Only take the lock until decoding has been started.
+  size_t length = btif_a2dp_sink_cb.jitter_buffer.Length();
+  if (!btif_a2dp_sink_cb.decoding &&
+      length >= MAX_A2DP_DELAYED_START_FRAME_COUNT) {
+    LockGuard lock(g_mutex);
     LOG_VERBOSE("%s: Initiate decoding. Current focus state:%d", __func__,
                 btif_a2dp_sink_cb.rx_focus_state);
     if (btif_a2dp_sink_cb.rx_focus_state == BTIF_A2DP_SINK_FOCUS_GRANTED) {
@@ -693,12 +687,12 @@ uint8_t btif_a2dp_sink_enqueue_buf(BT_HDR* p_pkt) {
     }
   }
 
-  return fixed_queue_length(btif_a2dp_sink_cb.rx_audio_queue);
+  return length;
 }
 
 void btif_a2dp_sink_audio_rx_flush_req() {
   LOG_INFO("%s", __func__);
-  if (fixed_queue_is_empty(btif_a2dp_sink_cb.rx_audio_queue)) {
+  if (btif_a2dp_sink_cb.jitter_buffer.Length() == 0) {
     /* Queue is already empty */
     return;
   }
@@ -710,8 +704,39 @@ void btif_a2dp_sink_audio_rx_flush_req() {
       FROM_HERE, base::BindOnce(btif_a2dp_sink_command_ready, p_buf));
 }
 
-void btif_a2dp_sink_debug_dump(UNUSED_ATTR int fd) {
-  // Nothing to do
+void btif_a2dp_sink_debug_dump(int fd) {
+  BtifA2dpSinkJitterBuffer::Stats stats;
+  {
+    LockGuard lock(g_mutex);
+    stats = btif_a2dp_sink_cb.jitter_buffer.GetStats();
+  }
+
+  dprintf(fd, "\nA2DP Sink State:\n");
+  dprintf(fd, "  RxQueue:\n");
+  dprintf(fd,
+          "  Packets (received/played/overflowed/late)               : %llu / "
+          "%llu / %llu / %llu\n",
+          (unsigned long long)stats.packets_received,
+          (unsigned long long)stats.packets_played,
+          (unsigned long long)stats.packets_overflowed,
+          (unsigned long long)stats.late_packets);
+  dprintf(fd,
+          "  Underruns                                               : %llu\n",
+          (unsigned long long)stats.underruns);
+  dprintf(fd,
+          "  Depth in packets (current/target)                       : %zu / "
+          "%zu\n",
+          stats.depth, stats.target_depth);
+  dprintf(fd,
+          "  Packet interval / jitter in ms                          : %llu / "
+          "%llu\n",
+          (unsigned long long)stats.packet_interval_us / 1000,
+          (unsigned long long)stats.jitter_us / 1000);
+  dprintf(fd,
+          "  Latency in ms (ave/max)                                 : %llu / "
+          "%llu\n",
+          (unsigned long long)stats.average_latency_us / 1000,
+          (unsigned long long)stats.max_latency_us / 1000);
 }
 
 void btif_a2dp_sink_set_focus_state_req(btif_a2dp_sink_focus_state_t state) {
@@ -734,7 +759,7 @@ static void btif_a2dp_sink_set_focus_state_event(
   LOG_VERBOSE("%s: setting focus state to %d", __func__, state);
   btif_a2dp_sink_cb.rx_focus_state = state;
   if (btif_a2dp_sink_cb.rx_focus_state == BTIF_A2DP_SINK_FOCUS_NOT_GRANTED) {
-    fixed_queue_flush(btif_a2dp_sink_cb.rx_audio_queue, osi_free);
+    btif_a2dp_sink_cb.jitter_buffer.Flush();
     btif_a2dp_sink_cb.rx_flush = true;
   } else if (btif_a2dp_sink_cb.rx_focus_state == BTIF_A2DP_SINK_FOCUS_GRANTED) {
     btif_a2dp_sink_cb.rx_flush = false;
@@ -0,0 +1,303 @@
+/*
+ * Copyright 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "bt_btif_a2dp_sink"
+
+#include "btif/include/btif_a2dp_sink_jitter_buffer.h"
+
+#include <algorithm>
+#include <iterator>
+
+#include "osi/include/allocator.h"
+#include "osi/include/log.h"
+
+// Number of jitter deviations covered by the target depth.
+static constexpr uint64_t kJitterCoverage = 4;
+
+// Inter-arrival gaps above this are stream pauses, not link jitter.
+static constexpr uint64_t kMaxPacketIntervalUs = 500 * 1000;
+
+// Number of packet intervals the packet rate is measured over, and the number
+// needed for a first estimate.
+static constexpr size_t kRateWindow = 256;
+static constexpr size_t kMinRateWindow = 4;
+
+// After this long without an underrun the extra margin shrinks by a packet.
+static constexpr uint64_t kUnderrunMarginDecayUs = 10 * 1000 * 1000;
+
+// A packet older than the last played one by at most this many sequence
+// numbers is late. Larger distances are treated as a sequence number jump.
+static constexpr int kMaxLateDistance = 64;
+
+static int16_t sequence_distance(uint16_t from, uint16_t to) {
+  return static_cast<int16_t>(static_cast<uint16_t>(to - from));
+}
+
+BtifA2dpSinkJitterBuffer::BtifA2dpSinkJitterBuffer(size_t capacity,
+                                                   size_t min_depth)
+    : capacity_(capacity),
+      min_depth_(std::max<size_t>(1, std::min(min_depth, capacity / 2))),
+      rx_queue_(capacity) {}
+
+BtifA2dpSinkJitterBuffer::~BtifA2dpSinkJitterBuffer() { Flush(); }
+
+bool BtifA2dpSinkJitterBuffer::Enqueue(BT_HDR* p_msg, uint64_t arrival_us) {
+  packets_received_++;
+  bool dropped = false;
+  if (rx_queue_.Length() >= capacity_) {
+    // The decoding thread is not keeping up: the oldest packet is the least
+    // useful one for playout, drop it to make room.
+    std::lock_guard<std::mutex> lock(rx_dequeue_mutex_);
+    Entry oldest;
+    if (rx_queue_.Length() >= capacity_ && rx_queue_.TryDequeue(&oldest)) {
+      osi_free(oldest.p_msg);
+      packets_overflowed_++;
+      dropped = true;
+    }
+  }
+  // There is room: the queue holds at least |capacity_| entries, and only
+  // this thread adds to it.
+  rx_queue_.TryEnqueue(Entry{p_msg, arrival_us});
+  return !dropped;
+}
+
+size_t BtifA2dpSinkJitterBuffer::Pull(
+    uint64_t now_us, const std::function<void(BT_HDR*)>& play) {
+  Drain();
+
+  if (!playing_) {
+    if (playout_queue_.empty() || playout_queue_.size() < TargetDepth()) {
+      return 0;
+    }
+    // Play the first packet right away and pace the rest from here.
+    playing_ = true;
+    last_pull_us_ = now_us;
+    playout_credit_us_ = PacketIntervalUs();
+  } else {
+    playout_credit_us_ += now_us - last_pull_us_;
+    last_pull_us_ = now_us;
+  }
+
+  if (underrun_margin_ > 0 &&
+      now_us - last_underrun_us_ > kUnderrunMarginDecayUs) {
+    underrun_margin_--;
+    last_underrun_us_ = now_us;
+  }
+
+  size_t due;
+  uint64_t interval_us = PacketIntervalUs();
+  if (interval_us == 0) {
+    due = playout_queue_.size();
+    playout_credit_us_ = 0;
+  } else {
+    due = playout_credit_us_ / interval_us;
+    playout_credit_us_ -= due * interval_us;
+  }
+
+  // Catch up when the link delivers faster than the estimated rate, so that
+  // latency does not build up.
+  size_t max_depth = 2 * TargetDepth();
+  if (playout_queue_.size() > max_depth + due) {
+    due = playout_queue_.size() - max_depth;
+  }
+
+  bool underrun = due > playout_queue_.size();
+  size_t played = 0;
+  while (played < due && !playout_queue_.empty()) {
+    Play(playout_queue_.front(), now_us, play);
+    playout_queue_.pop_front();
+    played++;
+  }
+
+  if (underrun) {
+    LOG_VERBOSE("%s: underrun, %zu of %zu packets available", __func__,
+                played, due);
+    underruns_++;
+    if (underrun_margin_ < capacity_) underrun_margin_++;
+    last_underrun_us_ = now_us;
+    playing_ = false;
+    playout_credit_us_ = 0;
+  }
+
+  playout_length_ = playout_queue_.size();
+  return played;
+}
+
+void BtifA2dpSinkJitterBuffer::Flush() {
+  {
+    std::lock_guard<std::mutex> lock(rx_dequeue_mutex_);
+    Entry entry;
+    while (rx_queue_.TryDequeue(&entry)) {
+      osi_free(entry.p_msg);
+    }
+  }
+  for (const Entry& queued : playout_queue_) {
+    osi_free(queued.p_msg);
+  }
+  playout_queue_.clear();
+  playout_length_ = 0;
+  playing_ = false;
+  playout_credit_us_ = 0;
+  last_arrival_us_ = 0;
+  has_played_ = false;
+}
+
+void BtifA2dpSinkJitterBuffer::Reset() {
+  Flush();
+  packets_received_ = 0;
+  packets_overflowed_ = 0;
+  packet_interval_x16_ = 0;
+  rate_estimate_intervals_ = 0;
+  jitter_x16_ = 0;
+  underrun_margin_ = 0;
+  last_underrun_us_ = 0;
+  packets_played_ = 0;
+  late_packets_ = 0;
+  underruns_ = 0;
+  average_latency_us_ = 0;
+  max_latency_us_ = 0;
+}
+
+size_t BtifA2dpSinkJitterBuffer::Length() const {
+  return rx_queue_.Length() + playout_length_;
+}
+
+BtifA2dpSinkJitterBuffer::Stats BtifA2dpSinkJitterBuffer::GetStats() const {
+  return Stats{
+      .packets_received = packets_received_,
+      .packets_played = packets_played_,
+      .packets_overflowed = packets_overflowed_,
+      .late_packets = late_packets_,
+      .underruns = underruns_,
+      .depth = Length(),
+      .target_depth = TargetDepth(),
+      .packet_interval_us = PacketIntervalUs(),
+      .jitter_us = jitter_x16_ >> 4,
+      .average_latency_us = average_latency_us_,
+      .max_latency_us = max_latency_us_,
+  };
+}
+
+void BtifA2dpSinkJitterBuffer::Drain() {
+  {
+    std::lock_guard<std::mutex> lock(rx_dequeue_mutex_);
+    Entry entry;
+    while (rx_queue_.TryDequeue(&entry)) {
+      UpdateArrivalEstimates(entry.arrival_us);
+      Insert(entry);
+    }
+  }
+
+  while (playout_queue_.size() > capacity_) {
+    osi_free(playout_queue_.front().p_msg);
+    playout_queue_.pop_front();
+    packets_overflowed_++;
+  }
+  playout_length_ = playout_queue_.size();
+}
+
+void BtifA2dpSinkJitterBuffer::Insert(const Entry& entry) {
+  uint16_t seq = entry.p_msg->layer_specific;
+  if (has_played_) {
+    int distance = sequence_distance(last_played_seq_, seq);
+    if (distance < 0 && distance >= -kMaxLateDistance) {
+      LOG_VERBOSE("%s: dropping late packet seq=%u last_played=%u", __func__,
+                  seq, last_played_seq_);
+      late_packets_++;
+      osi_free(entry.p_msg);
+      return;
+    }
+  }
+
+  // Packets normally arrive in order, so search from the back.
+  auto it = playout_queue_.end();
+  while (it != playout_queue_.begin()) {
+    auto prev = std::prev(it);
+    int distance =
+        sequence_distance(static_cast<uint16_t>(prev->p_msg->layer_specific),
+                          seq);
+    if (distance >= 0 || distance < -kMaxLateDistance) break;
+    it = prev;
+  }
+  playout_queue_.insert(it, entry);
+}
+
+void BtifA2dpSinkJitterBuffer::UpdateArrivalEstimates(uint64_t arrival_us) {
+  uint64_t last_arrival_us = last_arrival_us_;
+  last_arrival_us_ = arrival_us;
+  if (last_arrival_us == 0 || arrival_us < last_arrival_us ||
+      arrival_us - last_arrival_us > kMaxPacketIntervalUs) {
+    // The stream (re)started, measure its rate from here.
+    rate_window_start_us_ = arrival_us;
+    rate_window_intervals_ = 0;
+    return;
+  }
+
+  // The packet interval is the mean over a window of arrivals rather than a
+  // smoothed per-packet interval: bursts of back-to-back packets would bias
+  // the latter, and playout would drift away from the link rate.
+  rate_window_intervals_++;
+  if (rate_window_intervals_ >= kMinRateWindow &&
+      (rate_window_intervals_ > rate_estimate_intervals_ ||
+       rate_window_intervals_ >= kRateWindow / 4)) {
+    packet_interval_x16_ =
+        std::max<uint64_t>(16, ((arrival_us - rate_window_start_us_) << 4) /
+                                   rate_window_intervals_);
+    rate_estimate_intervals_ = rate_window_intervals_;
+  }
+  if (rate_window_intervals_ >= kRateWindow) {
+    rate_window_start_us_ = arrival_us;
+    rate_window_intervals_ = 0;
+  }
+  if (packet_interval_x16_ == 0) return;
+
+  // RFC 3550 style smoothed absolute deviation, kept scaled by 16 so that
+  // the smoothing does not truncate towards zero.
+  uint64_t interval_x16 = (arrival_us - last_arrival_us) << 4;
+  int64_t deviation = static_cast<int64_t>(interval_x16) -
+                      static_cast<int64_t>(packet_interval_x16_);
+  int64_t abs_deviation = deviation < 0 ? -deviation : deviation;
+  jitter_x16_ = static_cast<int64_t>(jitter_x16_) +
+                (abs_deviation - static_cast<int64_t>(jitter_x16_)) / 16;
+}
+
+size_t BtifA2dpSinkJitterBuffer::TargetDepth() const {
+  size_t depth = min_depth_ + underrun_margin_;
+  if (packet_interval_x16_ != 0) {
+    depth += (kJitterCoverage * jitter_x16_ + packet_interval_x16_ - 1) /
+             packet_interval_x16_;
+  }
+  return std::min(depth, std::max<size_t>(min_depth_, capacity_ / 2));
+}
+
+void BtifA2dpSinkJitterBuffer::Play(const Entry& entry, uint64_t now_us,
+                                    const std::function<void(BT_HDR*)>& play) {
+  uint64_t latency_us = now_us > entry.arrival_us ? now_us - entry.arrival_us
+                                                  : 0;
+  average_latency_us_ =
+      static_cast<int64_t>(average_latency_us_) +
+      (static_cast<int64_t>(latency_us) -
+       static_cast<int64_t>(average_latency_us_)) /
+          16;
+  max_latency_us_ = std::max(max_latency_us_, latency_us);
+
+  has_played_ = true;
+  last_played_seq_ = entry.p_msg->layer_specific;
+  packets_played_++;
+
+  play(entry.p_msg);
+  osi_free(entry.p_msg);
+}
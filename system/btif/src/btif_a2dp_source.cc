@@ -30,7 +30,9 @@
 #include <string.h>
 
 #include <algorithm>
+#include <deque>
 #include <future>
+#include <mutex>
 
 #include "audio_a2dp_hw/include/audio_a2dp_hw.h"
 #include "audio_hal_interface/a2dp_encoding.h"
@@ -47,9 +49,9 @@
 #include "common/repeating_timer.h"
 #include "common/time_util.h"
 #include "osi/include/allocator.h"
-#include "osi/include/fixed_queue.h"
 #include "osi/include/log.h"
 #include "osi/include/osi.h"
+#include "osi/include/properties.h"
 #include "osi/include/wakelock.h"
 #include "stack/include/acl_api.h"
 #include "stack/include/acl_api_types.h"
@@ -70,6 +72,71 @@ extern std::unique_ptr<tUIPC_STATE> a2dp_uipc;
  */
 #define MAX_OUTPUT_A2DP_FRAME_QUEUE_SZ (MAX_PCM_FRAME_NUM_PER_TICK * 2)
 
+/**
+ * With link pacing enabled, the media task holds the encoder back for a tick
+ * while at least this many packets are still waiting for the link, instead of
+ * queueing more of them. The audio stays in the audio HAL meanwhile, and the
+ * encoder catches up from the elapsed time on the next tick.
+ */
+#define A2DP_SOURCE_LINK_PACING_QUEUE_LENGTH 3
+/* Ticks in a row the encoder may be held back, so the audio HAL never stalls */
+#define A2DP_SOURCE_LINK_PACING_MAX_HELD_TICKS 1
+#define A2DP_SOURCE_LINK_PACING_PROPERTY \
+  "persist.bluetooth.a2dp_source.link_pacing"
+
+/* Upper bounds (in ms) of the TX queue queueing time histogram buckets. The
+ * last bucket counts everything above the last bound. */
+static const uint64_t kQueueingTimeBucketsMs[] = {10, 20, 40, 80, 160, 320};
+#define QUEUEING_TIME_BUCKETS \
+  (sizeof(kQueueingTimeBucketsMs) / sizeof(kQueueingTimeBucketsMs[0]) + 1)
+
+/**
+ * The queue of encoded media packets waiting for the link. Packets are stamped
+ * when they are queued so that their queueing time can be measured. It is
+ * filled by the media task and drained by the BTA AV data path.
+ */
+class TxAudioQueue {
+ public:
+  void Enqueue(BT_HDR* p_buf, uint64_t now_us) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    packets_.push_back({p_buf, now_us});
+  }
+
+  // Returns nullptr if the queue is empty. Otherwise |p_enqueue_us| is set
+  // to the time the packet was queued.
+  BT_HDR* Dequeue(uint64_t* p_enqueue_us) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (packets_.empty()) return nullptr;
+    BT_HDR* p_buf = packets_.front().p_buf;
+    *p_enqueue_us = packets_.front().enqueue_us;
+    packets_.pop_front();
+    return p_buf;
+  }
+
+  size_t Length() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return packets_.size();
+  }
+
+  // Frees all queued packets, and returns how many there were.
+  size_t Flush() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    size_t flushed = packets_.size();
+    for (const TxPacket& packet : packets_) osi_free(packet.p_buf);
+    packets_.clear();
+    return flushed;
+  }
+
+ private:
+  struct TxPacket {
+    BT_HDR* p_buf;
+    uint64_t enqueue_us;
+  };
+
+  mutable std::mutex mutex_;
+  std::deque<TxPacket> packets_;
+};
+
 class SchedulingStats {
  public:
   SchedulingStats() { Reset(); }
@@ -129,6 +196,9 @@ class BtifMediaStats {
     tx_queue_max_frames_per_packet = 0;
     tx_queue_total_queueing_time_us = 0;
     tx_queue_max_queueing_time_us = 0;
+    std::fill(std::begin(tx_queue_queueing_time_histogram),
+              std::end(tx_queue_queueing_time_histogram), 0);
+    tx_queue_held_ticks = 0;
     tx_queue_total_readbuf_calls = 0;
     tx_queue_last_readbuf_us = 0;
     tx_queue_total_flushed_messages = 0;
@@ -154,6 +224,8 @@ class BtifMediaStats {
 
   uint64_t tx_queue_total_queueing_time_us;
   uint64_t tx_queue_max_queueing_time_us;
+  size_t tx_queue_queueing_time_histogram[QUEUEING_TIME_BUCKETS];
+  size_t tx_queue_held_ticks;
 
   size_t tx_queue_total_readbuf_calls;
   uint64_t tx_queue_last_readbuf_us;
@@ -183,17 +255,19 @@ class BtifA2dpSource {
   };
 
   BtifA2dpSource()
-      : tx_audio_queue(nullptr),
-        tx_flush(false),
+      : tx_flush(false),
         sw_audio_is_encoding(false),
+        link_pacing(false),
+        held_ticks(0),
         encoder_interface(nullptr),
         encoder_interval_ms(0),
         state_(kStateOff) {}
 
   void Reset() {
-    fixed_queue_free(tx_audio_queue, nullptr);
-    tx_audio_queue = nullptr;
+    tx_audio_queue.Flush();
     tx_flush = false;
+    link_pacing = false;
+    held_ticks = 0;
     media_alarm.CancelAndWait();
     wakelock_release();
     encoder_interface = nullptr;
@@ -219,9 +293,11 @@ class BtifA2dpSource {
 
   void SetState(BtifA2dpSource::RunState state) { state_ = state; }
 
-  fixed_queue_t* tx_audio_queue;
+  TxAudioQueue tx_audio_queue;
   bool tx_flush; /* Discards any outgoing data when true */
   bool sw_audio_is_encoding;
+  bool link_pacing;   /* Holds the encoder back while the link is behind */
+  size_t held_ticks;  /* Ticks in a row the encoder was held back */
   RepeatingTimer media_alarm;
   const tA2DP_ENCODER_INTERFACE* encoder_interface;
   uint64_t encoder_interval_ms; /* Local copy of the encoder interval */
@@ -272,6 +348,8 @@ static bool btif_a2dp_source_enqueue_callback(BT_HDR* p_buf, size_t frames_n,
 static void log_tstamps_us(const char* comment, uint64_t timestamp_us);
 static void update_scheduling_stats(SchedulingStats* stats, uint64_t now_us,
                                     uint64_t expected_delta);
+static void update_queueing_time_stats(BtifMediaStats* stats,
+                                       uint64_t queueing_time_us);
 // Update the A2DP Source related metrics.
 // This function should be called before collecting the metrics.
 static void btif_a2dp_source_update_metrics(void);
@@ -307,6 +385,11 @@ void btif_a2dp_source_accumulate_stats(BtifMediaStats* src,
   dst->tx_queue_total_queueing_time_us += src->tx_queue_total_queueing_time_us;
   dst->tx_queue_max_queueing_time_us = std::max(
       dst->tx_queue_max_queueing_time_us, src->tx_queue_max_queueing_time_us);
+  for (size_t i = 0; i < QUEUEING_TIME_BUCKETS; i++) {
+    dst->tx_queue_queueing_time_histogram[i] +=
+        src->tx_queue_queueing_time_histogram[i];
+  }
+  dst->tx_queue_held_ticks += src->tx_queue_held_ticks;
   dst->tx_queue_total_readbuf_calls += src->tx_queue_total_readbuf_calls;
   dst->tx_queue_last_readbuf_us = src->tx_queue_last_readbuf_us;
   dst->tx_queue_total_flushed_messages += src->tx_queue_total_flushed_messages;
@@ -354,7 +437,6 @@ bool btif_a2dp_source_startup(void) {
 
   btif_a2dp_source_cb.Reset();
   btif_a2dp_source_cb.SetState(BtifA2dpSource::kStateStartingUp);
-  btif_a2dp_source_cb.tx_audio_queue = fixed_queue_new(SIZE_MAX);
 
   // Schedule the rest of the operations
   btif_a2dp_source_thread.DoInThread(
@@ -515,8 +597,7 @@ static void btif_a2dp_source_shutdown_delayed(
   } else {
     btif_a2dp_control_cleanup();
   }
-  fixed_queue_free(btif_a2dp_source_cb.tx_audio_queue, nullptr);
-  btif_a2dp_source_cb.tx_audio_queue = nullptr;
+  btif_a2dp_source_cb.tx_audio_queue.Flush();
 
   btif_a2dp_source_cb.SetState(BtifA2dpSource::kStateOff);
 
@@ -841,6 +922,16 @@ static void btif_a2dp_source_audio_tx_start_event(void) {
   if (codec_config != nullptr) {
     btif_a2dp_source_cb.stats.codec_index = codec_config->codecIndex();
   }
+
+  // aptX and aptX HD encode a fixed amount of audio per tick instead of
+  // catching up on the elapsed time, so they cannot be held back.
+  btif_a2dp_source_cb.link_pacing =
+      osi_property_get_bool(A2DP_SOURCE_LINK_PACING_PROPERTY, false) &&
+      btif_a2dp_source_cb.stats.codec_index !=
+          BTAV_A2DP_CODEC_INDEX_SOURCE_APTX &&
+      btif_a2dp_source_cb.stats.codec_index !=
+          BTAV_A2DP_CODEC_INDEX_SOURCE_APTX_HD;
+  btif_a2dp_source_cb.held_ticks = 0;
 }
 
 static void btif_a2dp_source_audio_tx_stop_event(void) {
@@ -919,8 +1010,7 @@ static void btif_a2dp_source_audio_handle_timer(void) {
     return;
   }
   CHECK(btif_a2dp_source_cb.encoder_interface != nullptr);
-  size_t transmit_queue_length =
-      fixed_queue_length(btif_a2dp_source_cb.tx_audio_queue);
+  size_t transmit_queue_length = btif_a2dp_source_cb.tx_audio_queue.Length();
 #ifdef __ANDROID__
   ATRACE_INT("btif TX queue", transmit_queue_length);
 #endif
@@ -929,7 +1019,15 @@ static void btif_a2dp_source_audio_handle_timer(void) {
     btif_a2dp_source_cb.encoder_interface->set_transmit_queue_length(
         transmit_queue_length);
   }
-  btif_a2dp_source_cb.encoder_interface->send_frames(timestamp_us);
+  if (btif_a2dp_source_cb.link_pacing &&
+      transmit_queue_length >= A2DP_SOURCE_LINK_PACING_QUEUE_LENGTH &&
+      btif_a2dp_source_cb.held_ticks < A2DP_SOURCE_LINK_PACING_MAX_HELD_TICKS) {
+    btif_a2dp_source_cb.held_ticks++;
+    btif_a2dp_source_cb.stats.tx_queue_held_ticks++;
+  } else {
+    btif_a2dp_source_cb.held_ticks = 0;
+    btif_a2dp_source_cb.encoder_interface->send_frames(timestamp_us);
+  }
   bta_av_ci_src_data_ready(BTA_AV_CHNL_AUDIO);
   update_scheduling_stats(&btif_a2dp_source_cb.stats.tx_queue_enqueue_stats,
                           stats_timestamp_us,
@@ -977,9 +1075,8 @@ static bool btif_a2dp_source_enqueue_callback(BT_HDR* p_buf, size_t frames_n,
     LOG_VERBOSE("%s: tx suspended, discarded frame", __func__);
 
     btif_a2dp_source_cb.stats.tx_queue_total_flushed_messages +=
-        fixed_queue_length(btif_a2dp_source_cb.tx_audio_queue);
+        btif_a2dp_source_cb.tx_audio_queue.Flush();
     btif_a2dp_source_cb.stats.tx_queue_last_flushed_us = now_us;
-    fixed_queue_flush(btif_a2dp_source_cb.tx_audio_queue, osi_free);
 
     osi_free(p_buf);
     return false;
@@ -987,31 +1084,29 @@ static bool btif_a2dp_source_enqueue_callback(BT_HDR* p_buf, size_t frames_n,
 
   // Check for TX queue overflow
   // TODO: Using frames_n here is probably wrong: should be "+ 1" instead.
-  if (fixed_queue_length(btif_a2dp_source_cb.tx_audio_queue) + frames_n >
+  if (btif_a2dp_source_cb.tx_audio_queue.Length() + frames_n >
       btif_a2dp_source_dynamic_audio_buffer_size) {
     LOG_WARN("%s: TX queue buffer size now=%u adding=%u max=%d", __func__,
-             (uint32_t)fixed_queue_length(btif_a2dp_source_cb.tx_audio_queue),
+             (uint32_t)btif_a2dp_source_cb.tx_audio_queue.Length(),
              (uint32_t)frames_n, btif_a2dp_source_dynamic_audio_buffer_size);
     // Keep track of drop-outs
     btif_a2dp_source_cb.stats.tx_queue_dropouts++;
     btif_a2dp_source_cb.stats.tx_queue_last_dropouts_us = now_us;
 
     // Flush all queued buffers
-    size_t drop_n = fixed_queue_length(btif_a2dp_source_cb.tx_audio_queue);
+    size_t drop_n = btif_a2dp_source_cb.tx_audio_queue.Length();
     btif_a2dp_source_cb.stats.tx_queue_max_dropped_messages = std::max(
         drop_n, btif_a2dp_source_cb.stats.tx_queue_max_dropped_messages);
     int num_dropped_encoded_bytes = 0;
     int num_dropped_encoded_frames = 0;
-    while (fixed_queue_length(btif_a2dp_source_cb.tx_audio_queue)) {
+    uint64_t enqueue_us;
+    BT_HDR* p_dropped_buf;
+    while ((p_dropped_buf = btif_a2dp_source_cb.tx_audio_queue.Dequeue(
+                &enqueue_us)) != nullptr) {
       btif_a2dp_source_cb.stats.tx_queue_total_dropped_messages++;
-      void* p_data =
-          fixed_queue_try_dequeue(btif_a2dp_source_cb.tx_audio_queue);
-      if (p_data != nullptr) {
-        auto p_dropped_buf = static_cast<BT_HDR*>(p_data);
-        num_dropped_encoded_bytes += p_dropped_buf->len;
-        num_dropped_encoded_frames += p_dropped_buf->layer_specific;
-        osi_free(p_data);
-      }
+      num_dropped_encoded_bytes += p_dropped_buf->len;
+      num_dropped_encoded_frames += p_dropped_buf->layer_specific;
+      osi_free(p_dropped_buf);
     }
     log_a2dp_audio_overrun_event(
         btif_av_source_active_peer(), btif_a2dp_source_cb.encoder_interval_ms,
@@ -1052,7 +1147,7 @@ static bool btif_a2dp_source_enqueue_callback(BT_HDR* p_buf, size_t frames_n,
       frames_n, btif_a2dp_source_cb.stats.tx_queue_max_frames_per_packet);
   CHECK(btif_a2dp_source_cb.encoder_interface != nullptr);
 
-  fixed_queue_enqueue(btif_a2dp_source_cb.tx_audio_queue, p_buf);
+  btif_a2dp_source_cb.tx_audio_queue.Enqueue(p_buf, now_us);
 
   return true;
 }
@@ -1066,10 +1161,9 @@ static void btif_a2dp_source_audio_tx_flush_event(void) {
     btif_a2dp_source_cb.encoder_interface->feeding_flush();
 
   btif_a2dp_source_cb.stats.tx_queue_total_flushed_messages +=
-      fixed_queue_length(btif_a2dp_source_cb.tx_audio_queue);
+      btif_a2dp_source_cb.tx_audio_queue.Flush();
   btif_a2dp_source_cb.stats.tx_queue_last_flushed_us =
       bluetooth::common::time_get_os_boottime_us();
-  fixed_queue_flush(btif_a2dp_source_cb.tx_audio_queue, osi_free);
 
   if (!bluetooth::audio::a2dp::is_hal_enabled() && a2dp_uipc != nullptr) {
     UIPC_Ioctl(*a2dp_uipc, UIPC_CH_ID_AV_AUDIO, UIPC_REQ_RX_FLUSH, nullptr);
@@ -1086,8 +1180,8 @@ static bool btif_a2dp_source_audio_tx_flush_req(void) {
 
 BT_HDR* btif_a2dp_source_audio_readbuf(void) {
   uint64_t now_us = bluetooth::common::time_get_os_boottime_us();
-  BT_HDR* p_buf =
-      (BT_HDR*)fixed_queue_try_dequeue(btif_a2dp_source_cb.tx_audio_queue);
+  uint64_t enqueue_us = 0;
+  BT_HDR* p_buf = btif_a2dp_source_cb.tx_audio_queue.Dequeue(&enqueue_us);
 
   btif_a2dp_source_cb.stats.tx_queue_total_readbuf_calls++;
   btif_a2dp_source_cb.stats.tx_queue_last_readbuf_us = now_us;
@@ -1096,6 +1190,8 @@ BT_HDR* btif_a2dp_source_audio_readbuf(void) {
     update_scheduling_stats(&btif_a2dp_source_cb.stats.tx_queue_dequeue_stats,
                             now_us,
                             btif_a2dp_source_cb.encoder_interval_ms * 1000);
+    update_queueing_time_stats(&btif_a2dp_source_cb.stats,
+                               now_us > enqueue_us ? now_us - enqueue_us : 0);
   }
 
   return p_buf;
@@ -1105,7 +1201,7 @@ static void log_tstamps_us(const char* comment, uint64_t timestamp_us) {
   static uint64_t prev_us = 0;
   LOG_VERBOSE("%s: [%s] ts %08" PRIu64 ", diff : %08" PRIu64 ", queue sz %zu",
               __func__, comment, timestamp_us, timestamp_us - prev_us,
-              fixed_queue_length(btif_a2dp_source_cb.tx_audio_queue));
+              btif_a2dp_source_cb.tx_audio_queue.Length());
   prev_us = timestamp_us;
 }
 
@@ -1148,6 +1244,20 @@ static void update_scheduling_stats(SchedulingStats* stats, uint64_t now_us,
   }
 }
 
+static void update_queueing_time_stats(BtifMediaStats* stats,
+                                       uint64_t queueing_time_us) {
+  stats->tx_queue_total_queueing_time_us += queueing_time_us;
+  stats->tx_queue_max_queueing_time_us =
+      std::max(queueing_time_us, stats->tx_queue_max_queueing_time_us);
+
+  size_t bucket = 0;
+  while (bucket < QUEUEING_TIME_BUCKETS - 1 &&
+         queueing_time_us / 1000 >= kQueueingTimeBucketsMs[bucket]) {
+    bucket++;
+  }
+  stats->tx_queue_queueing_time_histogram[bucket]++;
+}
+
 void btif_a2dp_source_debug_dump(int fd) {
   btif_a2dp_source_accumulate_stats(&btif_a2dp_source_cb.stats,
                                     &btif_a2dp_source_cb.accumulated_stats);
@@ -1193,6 +1303,37 @@ void btif_a2dp_source_debug_dump(int fd) {
           accumulated_stats->tx_queue_total_frames,
           accumulated_stats->tx_queue_max_frames_per_packet, ave_size);
 
+  ave_time_us = 0;
+  if (dequeue_stats->total_updates != 0)
+    ave_time_us = accumulated_stats->tx_queue_total_queueing_time_us /
+                  dequeue_stats->total_updates;
+  dprintf(fd,
+          "  Queueing time in ms (total/max/ave)                     : %llu / "
+          "%llu / %llu\n",
+          (unsigned long long)
+                  accumulated_stats->tx_queue_total_queueing_time_us /
+              1000,
+          (unsigned long long)accumulated_stats->tx_queue_max_queueing_time_us /
+              1000,
+          (unsigned long long)ave_time_us / 1000);
+
+  dprintf(fd,
+          "  Queueing time histogram in ms                           :");
+  for (size_t i = 0; i < QUEUEING_TIME_BUCKETS; i++) {
+    if (i < QUEUEING_TIME_BUCKETS - 1) {
+      dprintf(fd, " <%llu: %zu", (unsigned long long)kQueueingTimeBucketsMs[i],
+              accumulated_stats->tx_queue_queueing_time_histogram[i]);
+    } else {
+      dprintf(fd, " >=%llu: %zu\n",
+              (unsigned long long)kQueueingTimeBucketsMs[i - 1],
+              accumulated_stats->tx_queue_queueing_time_histogram[i]);
+    }
+  }
+
+  dprintf(fd,
+          "  Counts (encoder ticks held back by link pacing)         : %zu\n",
+          accumulated_stats->tx_queue_held_ticks);
+
   dprintf(fd,
           "  Counts (flushed/dropped/dropouts)                       : %zu / "
           "%zu / %zu\n",
@@ -21,6 +21,7 @@
 #include <sys/types.h>
 #include <unistd.h>
 
+#include <algorithm>
 #include <cstdint>
 #include <cstring>
 
@@ -122,53 +123,27 @@ static char packet_get_head_l(l2cap_socket* sock, uint8_t** data,
   return true;
 }
 
-static struct packet* packet_alloc(const uint8_t* data, uint32_t len) {
+static struct packet* packet_alloc(uint32_t len) {
   struct packet* p = (struct packet*)osi_calloc(sizeof(*p));
-  uint8_t* buf = (uint8_t*)osi_malloc(len);
-
-  p->data = buf;
+  p->data = (uint8_t*)osi_malloc(len);
   p->len = len;
-  memcpy(p->data, data, len);
   return p;
 }
 
-/* makes a copy of the data, returns true on success */
-static char packet_put_head_l(l2cap_socket* sock, const void* data,
-                              uint32_t len) {
-  struct packet* p = packet_alloc((const uint8_t*)data, len);
-
-  /*
-   * We do not check size limits here since this is used to undo "getting" a
-   * packet that the user read incompletely. That is to say the packet was
-   * already in the queue. We do check thos elimits in packet_put_tail_l() since
-   * that function is used to put new data into the queue.
-   */
-
-  if (!p) return false;
-
-  p->prev = NULL;
-  p->next = sock->first_packet;
-  sock->first_packet = p;
-  if (p->next)
-    p->next->prev = p;
-  else
-    sock->last_packet = p;
-
-  sock->bytes_buffered += len;
-
-  return true;
+static void packet_free(struct packet* p) {
+  osi_free(p->data);
+  osi_free(p);
 }
 
-/* makes a copy of the data, returns true on success */
-static char packet_put_tail_l(l2cap_socket* sock, const void* data,
-                              uint32_t len) {
+/* takes ownership of the packet, returns true on success */
+static char packet_put_tail_l(l2cap_socket* sock, struct packet* p) {
   if (sock->bytes_buffered >= L2CAP_MAX_RX_BUFFER) {
     LOG_ERROR("Unable to add to buffer due to buffer overflow socket_id:%u",
               sock->id);
+    packet_free(p);
     return false;
   }
 
-  struct packet* p = packet_alloc((const uint8_t*)data, len);
   p->next = NULL;
   p->prev = sock->last_packet;
   sock->last_packet = p;
@@ -177,11 +152,29 @@ static char packet_put_tail_l(l2cap_socket* sock, const void* data,
   else
     sock->first_packet = p;
 
-  sock->bytes_buffered += len;
+  sock->bytes_buffered += p->len;
 
   return true;
 }
 
+/* MTU sized buffers the apps' SDUs are received in. An SDU that fills the
+ * MTU is handed to the stack in its buffer, a shorter one is copied into a
+ * buffer of its size so that the stack queues do not hold MTU sized buffers
+ * for it. The buffers left are kept for the next read, as long as the MTU
+ * does not change. Only used with state_lock held. */
+static BT_HDR* sdu_pool[SOCK_MAX_BATCH];
+static uint16_t sdu_pool_mtu = 0;
+
+/* Upper bound of the memory held by the buffers of one read */
+#define L2CAP_SDU_BATCH_BYTES (64 * 1024)
+
+static void sdu_pool_free_l(void) {
+  for (int i = 0; i < SOCK_MAX_BATCH; i++) {
+    osi_free_and_reset((void**)&sdu_pool[i]);
+  }
+  sdu_pool_mtu = 0;
+}
+
 static char is_inited(void) {
   std::unique_lock<std::mutex> lock(state_lock);
   return pth != -1;
@@ -348,6 +341,7 @@ bt_status_t btsock_l2cap_cleanup() {
   std::unique_lock<std::mutex> lock(state_lock);
   pth = -1;
   while (socks) btsock_l2cap_free_l(socks);
+  sdu_pool_free_l();
   return BT_STATUS_SUCCESS;
 }
 
@@ -663,10 +657,11 @@ static void on_l2cap_data_ind(tBTA_JV* evt, uint32_t id) {
   uint32_t count;
 
   if (BTA_JvL2capReady(sock->handle, &count) == BTA_JV_SUCCESS) {
-    std::vector<uint8_t> buffer(count);
-    if (BTA_JvL2capRead(sock->handle, sock->id, buffer.data(), count) ==
+    // Read straight into the queued packet, it is sent to the app from there.
+    struct packet* p = packet_alloc(count);
+    if (BTA_JvL2capRead(sock->handle, sock->id, p->data, count) ==
         BTA_JV_SUCCESS) {
-      if (packet_put_tail_l(sock, buffer.data(), count)) {
+      if (packet_put_tail_l(sock, p)) {
         bytes_read = count;
         btsock_thread_add_fd(pth, sock->our_fd, BTSOCK_L2CAP, SOCK_THREAD_FD_WR,
                              sock->id);
@@ -677,6 +672,8 @@ static void on_l2cap_data_ind(tBTA_JV* evt, uint32_t id) {
         btsock_l2cap_free_l(sock);
         return;
       }
+    } else {
+      packet_free(p);
     }
   }
 
@@ -855,26 +852,29 @@ bt_status_t btsock_l2cap_connect(const RawAddress* bd_addr, int channel,
  * (for example: unrecoverable error or no data)
  */
 static bool flush_incoming_que_on_wr_signal_l(l2cap_socket* sock) {
-  uint8_t* buf;
-  uint32_t len;
+  while (sock->first_packet) {
+    // The socket is created with SOCK_SEQPACKET, each packet is sent as one
+    // message, several at a time.
+    struct iovec msgs[SOCK_MAX_BATCH];
+    int count = 0;
+    for (struct packet* p = sock->first_packet; p && count < SOCK_MAX_BATCH;
+         p = p->next) {
+      msgs[count].iov_base = p->data;
+      msgs[count].iov_len = p->len;
+      count++;
+    }
 
-  while (packet_get_head_l(sock, &buf, &len)) {
-    ssize_t sent;
-    OSI_NO_INTR(sent = send(sock->our_fd, buf, len, MSG_DONTWAIT));
-    int saved_errno = errno;
+    int sent = sock_send_msgs(sock->our_fd, msgs, count);
+    if (sent < 0) return errno == EWOULDBLOCK || errno == EAGAIN;
 
-    if (sent == (signed)len)
-      osi_free(buf);
-    else if (sent >= 0) {
-      packet_put_head_l(sock, buf + sent, len - sent);
-      osi_free(buf);
-      if (!sent) /* special case if other end not keeping up */
-        return true;
-    } else {
-      packet_put_head_l(sock, buf, len);
+    for (int i = 0; i < sent; i++) {
+      uint8_t* buf;
+      uint32_t len;
+      packet_get_head_l(sock, &buf, &len);
       osi_free(buf);
-      return saved_errno == EWOULDBLOCK || saved_errno == EAGAIN;
     }
+    if (sent < count) /* special case if other end not keeping up */
+      return true;
   }
 
   return false;
@@ -893,6 +893,68 @@ inline uint8_t* get_l2cap_sdu_start_ptr(BT_HDR* msg) {
   return (uint8_t*)(msg) + BT_HDR_SIZE + msg->offset;
 }
 
+/* Hands to the stack the SDUs awaiting on |fd|, as many per system call as
+ * the MTU allows. */
+static void read_sdus_from_app_l(l2cap_socket* sock, int fd) {
+  if (sock->outgoing_congest) {
+    /* The SDUs stay in the socket, the end of the congestion monitors fd
+     * again. The flag is only changed with state_lock held, hence it can't
+     * change while this batch is handed to the stack. */
+    LOG_VERBOSE("Socket congestion on socket_id:%u, not reading", sock->id);
+    return;
+  }
+
+  if (sock->tx_mtu != sdu_pool_mtu) {
+    sdu_pool_free_l();
+    sdu_pool_mtu = sock->tx_mtu;
+  }
+
+  int max_sdus = L2CAP_SDU_BATCH_BYTES / std::max<int>(sock->tx_mtu, 1);
+  max_sdus = std::min(std::max(max_sdus, 1), SOCK_MAX_BATCH);
+
+  struct iovec msgs[SOCK_MAX_BATCH];
+  for (int i = 0; i < max_sdus; i++) {
+    if (!sdu_pool[i]) sdu_pool[i] = malloc_l2cap_buf(sdu_pool_mtu);
+    msgs[i].iov_base = get_l2cap_sdu_start_ptr(sdu_pool[i]);
+    msgs[i].iov_len = sock->tx_mtu;
+  }
+
+  /* The socket is created with SOCK_SEQPACKET, hence we read whole messages.
+     BluetoothSocket.write(...) guarantees that any packet send to this socket
+     is broken into pieces no bigger than MTU bytes (as requested by BT
+     spec). */
+  uint32_t lens[SOCK_MAX_BATCH];
+  int count = sock_recv_msgs(fd, msgs, max_sdus, lens);
+  if (count < 0 && (errno == EWOULDBLOCK || errno == EAGAIN)) {
+    // Nothing was handed to the stack, no write done will monitor fd again.
+    btsock_thread_add_fd(pth, sock->our_fd, BTSOCK_L2CAP, SOCK_THREAD_FD_RD,
+                         sock->id);
+    return;
+  }
+
+  for (int i = 0; i < count; i++) {
+    if (lens[i] > sock->tx_mtu) {
+      /* This can't happen thanks to check in BluetoothSocket.java but leave
+       * this in case this socket is ever used anywhere else*/
+      LOG(ERROR) << "recv more than MTU. Data will be lost: " << lens[i];
+      lens[i] = sock->tx_mtu;
+    }
+
+    BT_HDR* buffer;
+    if (lens[i] == sdu_pool_mtu) {
+      buffer = sdu_pool[i];
+      sdu_pool[i] = NULL;
+    } else {
+      buffer = malloc_l2cap_buf(lens[i]);
+      memcpy(get_l2cap_sdu_start_ptr(buffer),
+             get_l2cap_sdu_start_ptr(sdu_pool[i]), lens[i]);
+    }
+
+    // will take care of freeing buffer
+    BTA_JvL2capWrite(sock->handle, PTR_TO_UINT(buffer), buffer, sock->id);
+  }
+}
+
 void btsock_l2cap_signaled(int fd, int flags, uint32_t user_id) {
   char drop_it = false;
 
@@ -908,35 +970,7 @@ void btsock_l2cap_signaled(int fd, int flags, uint32_t user_id) {
       int size = 0;
       bool ioctl_success = ioctl(sock->our_fd, FIONREAD, &size) == 0;
       if (!(flags & SOCK_THREAD_FD_EXCEPTION) || (ioctl_success && size)) {
-        /* FIONREAD return number of bytes that are immediately available for
-           reading, might be bigger than awaiting packet.
-
-           BluetoothSocket.write(...) guarantees that any packet send to this
-           socket is broken into pieces no bigger than MTU bytes (as requested
-           by BT spec). */
-        size = std::min(size, (int)sock->tx_mtu);
-
-        BT_HDR* buffer = malloc_l2cap_buf(size);
-        /* The socket is created with SOCK_SEQPACKET, hence we read one message
-         * at the time. */
-        ssize_t count;
-        OSI_NO_INTR(count = recv(fd, get_l2cap_sdu_start_ptr(buffer), size,
-                                 MSG_NOSIGNAL | MSG_DONTWAIT | MSG_TRUNC));
-        if (count > sock->tx_mtu) {
-          /* This can't happen thanks to check in BluetoothSocket.java but leave
-           * this in case this socket is ever used anywhere else*/
-          LOG(ERROR) << "recv more than MTU. Data will be lost: " << count;
-          count = sock->tx_mtu;
-        }
-
-        /* When multiple packets smaller than MTU are flushed to the socket, the
-           size of the single packet read could be smaller than the ioctl
-           reported total size of awaiting packets. Hence, we adjust the buffer
-           length. */
-        buffer->len = count;
-
-        // will take care of freeing buffer
-        BTA_JvL2capWrite(sock->handle, PTR_TO_UINT(buffer), buffer, user_id);
+        read_sdus_from_app_l(sock, fd);
       }
     } else
       drop_it = true;
@@ -879,22 +879,39 @@ static sent_status_t send_data_to_app(int fd, BT_HDR* p_buf) {
 
 static bool flush_incoming_que_on_wr_signal(rfc_slot_t* slot) {
   while (!list_is_empty(slot->incoming_queue)) {
-    BT_HDR* p_buf = (BT_HDR*)list_front(slot->incoming_queue);
-    switch (send_data_to_app(slot->fd, p_buf)) {
-      case SENT_NONE:
-      case SENT_PARTIAL:
+    // Gather the queued buffers into one send.
+    struct iovec iov[SOCK_MAX_BATCH];
+    BT_HDR* bufs[SOCK_MAX_BATCH];
+    int count = 0;
+    for (const list_node_t* node = list_begin(slot->incoming_queue);
+         node != list_end(slot->incoming_queue) && count < SOCK_MAX_BATCH;
+         node = list_next(node)) {
+      bufs[count] = (BT_HDR*)list_node(node);
+      iov[count].iov_base = bufs[count]->data + bufs[count]->offset;
+      iov[count].iov_len = bufs[count]->len;
+      count++;
+    }
+
+    ssize_t sent = sock_send_iov(slot->fd, iov, count);
+    if (sent == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) sent = 0;
+    if (sent == -1) {
+      LOG_ERROR("%s error writing RFCOMM data back to app: %s", __func__,
+                strerror(errno));
+      list_remove(slot->incoming_queue, bufs[0]);
+      return false;
+    }
+
+    for (int i = 0; i < count; i++) {
+      if (bufs[i]->len > sent) {
+        bufs[i]->offset += sent;
+        bufs[i]->len -= sent;
         // monitor the fd to get callback when app is ready to receive data
         btsock_thread_add_fd(pth, slot->fd, BTSOCK_RFCOMM, SOCK_THREAD_FD_WR,
                              slot->id);
         return true;
-
-      case SENT_ALL:
-        list_remove(slot->incoming_queue, p_buf);
-        break;
-
-      case SENT_FAILED:
-        list_remove(slot->incoming_queue, p_buf);
-        return false;
+      }
+      sent -= bufs[i]->len;
+      list_remove(slot->incoming_queue, bufs[i]);
     }
   }
 
@@ -20,7 +20,12 @@
  *
  *  Filename:      btif_sock_thread.cc
  *
- *  Description:   socket select thread
+ *  Description:   socket epoll thread
+ *
+ *  Each thread waits on an epoll set. Monitored fds are one-shot: once an fd
+ *  signals, the signaled events stop being monitored until the fd is added
+ *  again, which re-arms it without waking the thread up. There is no limit on
+ *  the number of monitored fds, and a wakeup only costs the signaled fds.
  *
  ******************************************************************************/
 
@@ -31,21 +36,20 @@
 #include <alloca.h>
 #include <fcntl.h>
 #include <features.h>
-#include <poll.h>
 #include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <sys/select.h>
+#include <sys/epoll.h>
 #include <sys/socket.h>
 #include <sys/types.h>
 #include <sys/un.h>
 #include <time.h>
 #include <unistd.h>
 
-#include <array>
 #include <mutex>
 #include <optional>
+#include <unordered_map>
 
 #include "os/log.h"
 #include "osi/include/osi.h"  // OSI_NO_INTR
@@ -58,29 +62,35 @@
   } while (0)
 
 #define MAX_THREAD 8
-#define MAX_POLL 64
-#define POLL_EXCEPTION_EVENTS (POLLHUP | POLLRDHUP | POLLERR | POLLNVAL)
-#define IS_EXCEPTION(e) ((e)&POLL_EXCEPTION_EVENTS)
-#define IS_READ(e) ((e)&POLLIN)
-#define IS_WRITE(e) ((e)&POLLOUT)
+/* Maximum number of events handled per epoll_wait() */
+#define MAX_EVENTS 64
+#define EPOLL_EXCEPTION_EVENTS (EPOLLHUP | EPOLLRDHUP | EPOLLERR)
+#define IS_EXCEPTION(e) ((e)&EPOLL_EXCEPTION_EVENTS)
+#define IS_READ(e) ((e)&EPOLLIN)
+#define IS_WRITE(e) ((e)&EPOLLOUT)
+/* epoll user data of the cmd fd. Data fds have a non zero generation. */
+#define CMD_FD_EVENT_DATA 0
 /*cmd executes in socket poll thread */
 #define CMD_WAKEUP 1
 #define CMD_EXIT 2
-#define CMD_ADD_FD 3
 #define CMD_REMOVE_FD 4
 #define CMD_USER_PRIVATE 5
 
 struct poll_slot_t {
-  struct pollfd pfd;
   uint32_t user_id;
   int type;
   int flags;
+  /* Tells events of this fd from stale events of a previous fd with the same
+   * number */
+  uint32_t generation;
 };
 struct thread_slot_t {
   int cmd_fdr, cmd_fdw;
-  int poll_count;
-  poll_slot_t ps[MAX_POLL];
-  int psi[MAX_POLL];  // index of poll slot
+  int epoll_fd;
+  /* Guards ps and next_generation: fds are added from any thread */
+  std::mutex poll_lock;
+  std::unordered_map<int, poll_slot_t> ps;  // monitored fds, by fd
+  uint32_t next_generation;
   std::optional<pthread_t> thread_id;
   btsock_signaled_cb callback;
   btsock_cmd_cb cmd_callback;
@@ -121,7 +131,7 @@ static inline int create_thread(void* (*start_routine)(void*), void* arg,
   pthread_setschedparam(*thread_id, policy, &param);
   return ret;
 }
-static void init_poll(int cmd_fd);
+static bool init_poll(int h);
 static int alloc_thread_slot() {
   std::unique_lock<std::recursive_mutex> lock(thread_slot_lock);
   int i;
@@ -138,6 +148,14 @@ static int alloc_thread_slot() {
 static void free_thread_slot(int h) {
   if (0 <= h && h < MAX_THREAD) {
     close_cmd_fd(h);
+    if (ts[h].epoll_fd != -1) {
+      close(ts[h].epoll_fd);
+      ts[h].epoll_fd = -1;
+    }
+    {
+      std::lock_guard<std::mutex> lock(ts[h].poll_lock);
+      ts[h].ps.clear();
+    }
     ts[h].used = 0;
   } else
     LOG_ERROR("invalid thread handle:%d", h);
@@ -149,9 +167,10 @@ void btsock_thread_init() {
     int h;
     for (h = 0; h < MAX_THREAD; h++) {
       ts[h].cmd_fdr = ts[h].cmd_fdw = -1;
+      ts[h].epoll_fd = -1;
       ts[h].used = 0;
       ts[h].thread_id = std::nullopt;
-      ts[h].poll_count = 0;
+      ts[h].next_generation = 0;
       ts[h].callback = NULL;
       ts[h].cmd_callback = NULL;
     }
@@ -162,7 +181,12 @@ int btsock_thread_create(btsock_signaled_cb callback,
   asrt(callback || cmd_callback);
   int h = alloc_thread_slot();
   if (h >= 0) {
-    init_poll(h);
+    if (!init_poll(h)) {
+      free_thread_slot(h);
+      return -1;
+    }
+    ts[h].callback = callback;
+    ts[h].cmd_callback = cmd_callback;
     pthread_t thread;
     int status = create_thread(sock_poll_thread, (void*)(uintptr_t)h, &thread);
     if (status) {
@@ -172,21 +196,26 @@ int btsock_thread_create(btsock_signaled_cb callback,
     }
 
     ts[h].thread_id = thread;
-    ts[h].callback = callback;
-    ts[h].cmd_callback = cmd_callback;
   }
   return h;
 }
 
-/* create dummy socket pair used to wake up select loop */
-static inline void init_cmd_fd(int h) {
+/* create dummy socket pair used to wake up the epoll loop */
+static inline bool init_cmd_fd(int h) {
   asrt(ts[h].cmd_fdr == -1 && ts[h].cmd_fdw == -1);
   if (socketpair(AF_UNIX, SOCK_STREAM, 0, &ts[h].cmd_fdr) < 0) {
     LOG_ERROR("socketpair failed: %s", strerror(errno));
-    return;
+    return false;
+  }
+  // the cmd fd stays monitored for read, it is not one-shot
+  struct epoll_event event = {};
+  event.events = EPOLLIN;
+  event.data.u64 = CMD_FD_EVENT_DATA;
+  if (epoll_ctl(ts[h].epoll_fd, EPOLL_CTL_ADD, ts[h].cmd_fdr, &event) == -1) {
+    LOG_ERROR("epoll_ctl failed for cmd fd: %s", strerror(errno));
+    return false;
   }
-  // add the cmd fd for read & write
-  add_poll(h, ts[h].cmd_fdr, 0, SOCK_THREAD_FD_RD, 0);
+  return true;
 }
 static inline void close_cmd_fd(int h) {
   if (ts[h].cmd_fdr != -1) {
@@ -210,27 +239,14 @@ int btsock_thread_add_fd(int h, int fd, int type, int flags, uint32_t user_id) {
     LOG_ERROR("invalid bt thread handle:%d", h);
     return false;
   }
-  if (ts[h].cmd_fdw == -1) {
-    LOG_ERROR("cmd socket is not created. socket thread may not initialized");
+  if (ts[h].epoll_fd == -1) {
+    LOG_ERROR("epoll fd is not created. socket thread may not initialized");
     return false;
   }
-  if (flags & SOCK_THREAD_ADD_FD_SYNC) {
-    // must executed in socket poll thread
-    if (ts[h].thread_id.value() == pthread_self()) {
-      // cleanup one-time flags
-      flags &= ~SOCK_THREAD_ADD_FD_SYNC;
-      add_poll(h, fd, type, flags, user_id);
-      return true;
-    }
-    LOG_WARN(
-        "THREAD_ADD_FD_SYNC is not called in poll thread, fallback to async");
-  }
-  sock_cmd_t cmd = {CMD_ADD_FD, fd, type, flags, user_id};
-
-  ssize_t ret;
-  OSI_NO_INTR(ret = send(ts[h].cmd_fdw, &cmd, sizeof(cmd), 0));
-
-  return ret == sizeof(cmd);
+  // The epoll set can be updated from any thread, so every add is immediate.
+  flags &= ~SOCK_THREAD_ADD_FD_SYNC;
+  add_poll(h, fd, type, flags, user_id);
+  return true;
 }
 
 bool btsock_thread_remove_fd_and_close(int thread_handle, int fd) {
@@ -243,6 +259,8 @@ bool btsock_thread_remove_fd_and_close(int thread_handle, int fd) {
     return false;
   }
 
+  // The fd is closed in the socket thread, so that it is never closed while
+  // a callback is using it.
   sock_cmd_t cmd = {CMD_REMOVE_FD, fd, 0, 0, 0};
 
   ssize_t ret;
@@ -322,74 +340,78 @@ int btsock_thread_exit(int h) {
   }
   return false;
 }
-static void init_poll(int h) {
-  int i;
-  ts[h].poll_count = 0;
+static bool init_poll(int h) {
   ts[h].thread_id = std::nullopt;
   ts[h].callback = NULL;
   ts[h].cmd_callback = NULL;
-  for (i = 0; i < MAX_POLL; i++) {
-    ts[h].ps[i].pfd.fd = -1;
-    ts[h].psi[i] = -1;
+  {
+    std::lock_guard<std::mutex> lock(ts[h].poll_lock);
+    ts[h].ps.clear();
+  }
+  ts[h].epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+  if (ts[h].epoll_fd == -1) {
+    LOG_ERROR("epoll_create1 failed: %s", strerror(errno));
+    return false;
   }
-  init_cmd_fd(h);
+  return init_cmd_fd(h);
 }
-static inline unsigned int flags2pevents(int flags) {
-  unsigned int pevents = 0;
-  if (flags & SOCK_THREAD_FD_WR) pevents |= POLLOUT;
-  if (flags & SOCK_THREAD_FD_RD) pevents |= POLLIN;
-  pevents |= POLL_EXCEPTION_EVENTS;
-  return pevents;
+static inline uint32_t flags2events(int flags) {
+  uint32_t events = EPOLLONESHOT;
+  if (flags & SOCK_THREAD_FD_WR) events |= EPOLLOUT;
+  if (flags & SOCK_THREAD_FD_RD) events |= EPOLLIN;
+  events |= EPOLL_EXCEPTION_EVENTS;
+  return events;
 }
 
-static inline void set_poll(poll_slot_t* ps, int fd, int type, int flags,
-                            uint32_t user_id) {
-  ps->pfd.fd = fd;
-  ps->user_id = user_id;
-  if (ps->type != 0 && ps->type != type)
-    LOG_ERROR("poll socket type should not changed! type was:%d, type now:%d",
-              ps->type, type);
-  ps->type = type;
-  ps->flags = flags;
-  ps->pfd.events = flags2pevents(flags);
-  ps->pfd.revents = 0;
+static inline bool arm_poll(int h, int op, int fd, const poll_slot_t& slot) {
+  struct epoll_event event = {};
+  event.events = flags2events(slot.flags);
+  event.data.u64 = (static_cast<uint64_t>(slot.generation) << 32) |
+                   static_cast<uint32_t>(fd);
+  return epoll_ctl(ts[h].epoll_fd, op, fd, &event) == 0;
 }
-static inline void add_poll(int h, int fd, int type, int flags,
-                            uint32_t user_id) {
-  asrt(fd != -1);
-  int i;
-  int empty = -1;
-  poll_slot_t* ps = ts[h].ps;
 
-  for (i = 0; i < MAX_POLL; i++) {
-    if (ps[i].pfd.fd == fd) {
-      asrt(ts[h].poll_count < MAX_POLL);
-
-      set_poll(&ps[i], fd, type, flags | ps[i].flags, user_id);
-      return;
-    } else if (empty < 0 && ps[i].pfd.fd == -1)
-      empty = i;
+/* Must be called with poll_lock held */
+static inline void remove_poll_locked(int h, int fd) {
+  if (epoll_ctl(ts[h].epoll_fd, EPOLL_CTL_DEL, fd, NULL) == -1 &&
+      errno != ENOENT && errno != EBADF) {
+    LOG_WARN("epoll_ctl del failed for fd:%d: %s", fd, strerror(errno));
   }
-  if (empty >= 0) {
-    asrt(ts[h].poll_count < MAX_POLL);
-    set_poll(&ps[empty], fd, type, flags, user_id);
-    ++ts[h].poll_count;
-    return;
-  }
-  LOG_ERROR("exceeded max poll slot:%d!", MAX_POLL);
+  ts[h].ps.erase(fd);
 }
-static inline void remove_poll(int h, poll_slot_t* ps, int flags) {
-  if (flags == ps->flags) {
-    // all monitored events signaled. To remove it, just clear the slot
-    --ts[h].poll_count;
-    memset(ps, 0, sizeof(*ps));
-    ps->pfd.fd = -1;
+
+static inline void add_poll(int h, int fd, int type, int flags,
+                            uint32_t user_id) {
+  asrt(fd != -1);
+  std::lock_guard<std::mutex> lock(ts[h].poll_lock);
+  auto it = ts[h].ps.find(fd);
+  bool monitored = it != ts[h].ps.end();
+  poll_slot_t& slot = ts[h].ps[fd];
+  int requested_flags = flags;
+  if (monitored) {
+    if (slot.type != 0 && slot.type != type)
+      LOG_ERROR(
+          "poll socket type should not changed! type was:%d, type now:%d",
+          slot.type, type);
+    flags |= slot.flags;
   } else {
-    // one read or one write monitor event signaled, removed the accordding bit
-    ps->flags &= ~flags;
-    // update the poll events mask
-    ps->pfd.events = flags2pevents(ps->flags);
+    if (++ts[h].next_generation == 0) ++ts[h].next_generation;
+    slot.generation = ts[h].next_generation;
   }
+  slot.user_id = user_id;
+  slot.type = type;
+  slot.flags = flags;
+
+  if (arm_poll(h, monitored ? EPOLL_CTL_MOD : EPOLL_CTL_ADD, fd, slot)) return;
+  if (monitored && errno == ENOENT) {
+    // The fd was closed without being removed, and its number reused
+    if (++ts[h].next_generation == 0) ++ts[h].next_generation;
+    slot.generation = ts[h].next_generation;
+    slot.flags = requested_flags;
+    if (arm_poll(h, EPOLL_CTL_ADD, fd, slot)) return;
+  }
+  LOG_ERROR("epoll_ctl failed for fd:%d: %s", fd, strerror(errno));
+  ts[h].ps.erase(fd);
 }
 static int process_cmd_sock(int h) {
   sock_cmd_t cmd = {-1, 0, 0, 0, 0};
@@ -403,19 +425,12 @@ static int process_cmd_sock(int h) {
     return false;
   }
   switch (cmd.id) {
-    case CMD_ADD_FD:
-      add_poll(h, cmd.fd, cmd.type, cmd.flags, cmd.user_id);
-      break;
-    case CMD_REMOVE_FD:
-      for (int i = 1; i < MAX_POLL; ++i) {
-        poll_slot_t* poll_slot = &ts[h].ps[i];
-        if (poll_slot->pfd.fd == cmd.fd) {
-          remove_poll(h, poll_slot, poll_slot->flags);
-          break;
-        }
-      }
+    case CMD_REMOVE_FD: {
+      std::lock_guard<std::mutex> lock(ts[h].poll_lock);
+      if (ts[h].ps.count(cmd.fd) != 0) remove_poll_locked(h, cmd.fd);
       close(cmd.fd);
       break;
+    }
     case CMD_WAKEUP:
       break;
     case CMD_USER_PRIVATE:
@@ -432,95 +447,69 @@ static int process_cmd_sock(int h) {
   return true;
 }
 
-static void process_data_sock(int h, struct pollfd* pfds, int pfds_count,
-                              int event_count) {
-  asrt(event_count <= pfds_count);
-  int i;
-  for (i = 1; i < pfds_count; i++) {
-    if (pfds[i].revents) {
-      int ps_i = ts[h].psi[i];
-      if (ts[h].ps[ps_i].pfd.fd == -1) {
-        LOG_INFO("Socket has been removed from poll set");
-        continue;
-      }
-      asrt(pfds[i].fd == ts[h].ps[ps_i].pfd.fd);
-      uint32_t user_id = ts[h].ps[ps_i].user_id;
-      int type = ts[h].ps[ps_i].type;
-      int flags = 0;
-      if (IS_READ(pfds[i].revents)) {
-        flags |= SOCK_THREAD_FD_RD;
-      }
-      if (IS_WRITE(pfds[i].revents)) {
-        flags |= SOCK_THREAD_FD_WR;
-      }
-      if (IS_EXCEPTION(pfds[i].revents)) {
-        flags |= SOCK_THREAD_FD_EXCEPTION;
-        // remove the whole slot not flags
-        remove_poll(h, &ts[h].ps[ps_i], ts[h].ps[ps_i].flags);
-      } else if (flags)
-        remove_poll(h, &ts[h].ps[ps_i],
-                    flags);  // remove the monitor flags that already processed
-      if (flags) ts[h].callback(pfds[i].fd, type, flags, user_id);
-    }
-  }
-}
-
-static void prepare_poll_fds(int h, struct pollfd* pfds) {
-  int count = 0;
-  int ps_i = 0;
-  int pfd_i = 0;
-  asrt(ts[h].poll_count <= MAX_POLL);
-  while (count < ts[h].poll_count) {
-    if (ps_i >= MAX_POLL) {
-      LOG_ERROR(
-          "exceed max poll range, ps_i:%d, MAX_POLL:%d, count:%d, "
-          "ts[h].poll_count:%d",
-          ps_i, MAX_POLL, count, ts[h].poll_count);
+static void process_data_sock(int h, const struct epoll_event& event) {
+  int fd = static_cast<int>(static_cast<uint32_t>(event.data.u64));
+  uint32_t generation = static_cast<uint32_t>(event.data.u64 >> 32);
+  uint32_t user_id;
+  int type;
+  int flags = 0;
+  {
+    std::lock_guard<std::mutex> lock(ts[h].poll_lock);
+    auto it = ts[h].ps.find(fd);
+    if (it == ts[h].ps.end() || it->second.generation != generation) {
+      LOG_INFO("Socket has been removed from poll set");
       return;
     }
-    if (ts[h].ps[ps_i].pfd.fd >= 0) {
-      pfds[pfd_i] = ts[h].ps[ps_i].pfd;
-      ts[h].psi[pfd_i] = ps_i;
-      count++;
-      pfd_i++;
+    poll_slot_t& slot = it->second;
+    user_id = slot.user_id;
+    type = slot.type;
+    if (IS_READ(event.events) && (slot.flags & SOCK_THREAD_FD_RD)) {
+      flags |= SOCK_THREAD_FD_RD;
+    }
+    if (IS_WRITE(event.events) && (slot.flags & SOCK_THREAD_FD_WR)) {
+      flags |= SOCK_THREAD_FD_WR;
+    }
+    if (IS_EXCEPTION(event.events)) {
+      flags |= SOCK_THREAD_FD_EXCEPTION;
+      // remove the whole slot not flags
+      remove_poll_locked(h, fd);
+    } else {
+      // stop monitoring the events already signaled, re-arm the others
+      slot.flags &= ~flags;
+      if (slot.flags == 0) {
+        remove_poll_locked(h, fd);
+      } else if (!arm_poll(h, EPOLL_CTL_MOD, fd, slot)) {
+        LOG_ERROR("epoll_ctl failed for fd:%d: %s", fd, strerror(errno));
+        remove_poll_locked(h, fd);
+      }
     }
-    ps_i++;
   }
+  if (flags) ts[h].callback(fd, type, flags, user_id);
 }
+
 static void* sock_poll_thread(void* arg) {
-  std::array<struct pollfd, MAX_POLL> pfds;
+  struct epoll_event events[MAX_EVENTS];
 
   int h = (intptr_t)arg;
   for (;;) {
-    pfds = {};
-    prepare_poll_fds(h, pfds.data());
     int ret;
-    OSI_NO_INTR(ret = poll(pfds.data(), ts[h].poll_count, -1));
+    OSI_NO_INTR(ret = epoll_wait(ts[h].epoll_fd, events, MAX_EVENTS, -1));
     if (ret == -1) {
-      LOG_ERROR("poll ret -1, exit the thread, errno:%d, err:%s", errno,
+      LOG_ERROR("epoll_wait ret -1, exit the thread, errno:%d, err:%s", errno,
                 strerror(errno));
       break;
     }
-    if (ret != 0) {
-      int need_process_data_fd = true;
-      int pfds_count = ts[h].poll_count;
-      if (pfds[0].revents)  // cmd fd always is the first one
-      {
-        asrt(pfds[0].fd == ts[h].cmd_fdr);
+    for (int i = 0; i < ret; i++) {
+      if (events[i].data.u64 == CMD_FD_EVENT_DATA) {
         if (!process_cmd_sock(h)) {
           LOG_INFO("h:%d, process_cmd_sock return false, exit...", h);
-          break;
+          LOG_INFO("socket poll thread exiting, h:%d", h);
+          return 0;
         }
-        if (ret == 1)
-          need_process_data_fd = false;
-        else
-          ret--;  // exclude the cmd fd
+      } else {
+        process_data_sock(h, events[i]);
       }
-      if (need_process_data_fd)
-        process_data_sock(h, pfds.data(), pfds_count, ret);
-    } else {
-      LOG_INFO("no data, select ret: %d", ret);
-    };
+    }
   }
   LOG_INFO("socket poll thread exiting, h:%d", h);
   return 0;
@@ -75,6 +75,50 @@ int sock_recv_all(int sock_fd, uint8_t* buf, int len) {
   return len;
 }
 
+int sock_send_msgs(int sock_fd, const struct iovec* msgs, int count) {
+  struct mmsghdr hdrs[SOCK_MAX_BATCH];
+  if (count > SOCK_MAX_BATCH) count = SOCK_MAX_BATCH;
+  memset(hdrs, 0, sizeof(hdrs[0]) * count);
+  for (int i = 0; i < count; i++) {
+    hdrs[i].msg_hdr.msg_iov = (struct iovec*)&msgs[i];
+    hdrs[i].msg_hdr.msg_iovlen = 1;
+  }
+
+  int sent;
+  OSI_NO_INTR(sent = sendmmsg(sock_fd, hdrs, count,
+                              MSG_DONTWAIT | MSG_NOSIGNAL));
+  return sent;
+}
+
+int sock_recv_msgs(int sock_fd, const struct iovec* msgs, int count,
+                   uint32_t* lens) {
+  struct mmsghdr hdrs[SOCK_MAX_BATCH];
+  if (count > SOCK_MAX_BATCH) count = SOCK_MAX_BATCH;
+  memset(hdrs, 0, sizeof(hdrs[0]) * count);
+  for (int i = 0; i < count; i++) {
+    hdrs[i].msg_hdr.msg_iov = (struct iovec*)&msgs[i];
+    hdrs[i].msg_hdr.msg_iovlen = 1;
+  }
+
+  int received;
+  OSI_NO_INTR(received = recvmmsg(sock_fd, hdrs, count,
+                                  MSG_DONTWAIT | MSG_NOSIGNAL | MSG_TRUNC,
+                                  NULL));
+  for (int i = 0; i < received; i++) lens[i] = hdrs[i].msg_len;
+  return received;
+}
+
+ssize_t sock_send_iov(int sock_fd, const struct iovec* iov, int count) {
+  struct msghdr msg;
+  memset(&msg, 0, sizeof(msg));
+  msg.msg_iov = (struct iovec*)iov;
+  msg.msg_iovlen = count > SOCK_MAX_BATCH ? SOCK_MAX_BATCH : count;
+
+  ssize_t sent;
+  OSI_NO_INTR(sent = sendmsg(sock_fd, &msg, MSG_DONTWAIT | MSG_NOSIGNAL));
+  return sent;
+}
+
 int sock_send_fd(int sock_fd, const uint8_t* buf, int len, int send_fd) {
   struct msghdr msg;
   unsigned char* buffer = (unsigned char*)buf;
@@ -0,0 +1,245 @@
+/*
+ * Copyright 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "btif/include/btif_a2dp_sink_jitter_buffer.h"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include "osi/include/allocator.h"
+
+namespace {
+
+constexpr size_t kCapacity = 28;
+constexpr size_t kMinDepth = 5;
+constexpr uint64_t kTickMs = 20;
+
+// One received media packet of a recorded trace.
+struct TracePacket {
+  uint64_t arrival_ms;
+  uint16_t seq;
+};
+
+struct ReplayResult {
+  std::vector<uint16_t> played;
+  BtifA2dpSinkJitterBuffer::Stats stats;
+  size_t max_depth = 0;
+};
+
+// Builds a trace from the inter-arrival gaps, in ms, of consecutive packets.
+std::vector<TracePacket> TraceFromGaps(const std::vector<uint64_t>& gaps,
+                                       uint16_t first_seq = 0) {
+  std::vector<TracePacket> trace;
+  uint64_t arrival_ms = 0;
+  uint16_t seq = first_seq;
+  for (uint64_t gap : gaps) {
+    arrival_ms += gap;
+    trace.push_back({arrival_ms, seq++});
+  }
+  return trace;
+}
+
+std::vector<uint64_t> RepeatGaps(const std::vector<uint64_t>& pattern,
+                                 size_t times) {
+  std::vector<uint64_t> gaps;
+  for (size_t i = 0; i < times; i++) {
+    gaps.insert(gaps.end(), pattern.begin(), pattern.end());
+  }
+  return gaps;
+}
+
+BT_HDR* MakePacket(uint16_t seq) {
+  BT_HDR* p_msg = reinterpret_cast<BT_HDR*>(osi_calloc(sizeof(BT_HDR)));
+  p_msg->layer_specific = seq;
+  return p_msg;
+}
+
+// Feeds |trace| to a jitter buffer at its recorded arrival times, and pulls
+// from it every |tick_ms| like the A2DP Sink decode timer does.
+ReplayResult Replay(BtifA2dpSinkJitterBuffer& buffer,
+                    const std::vector<TracePacket>& trace,
+                    uint64_t tick_ms = kTickMs) {
+  ReplayResult result;
+  size_t next = 0;
+  // Play until the end of the trace has been played out.
+  for (uint64_t now_ms = 1; next < trace.size() || buffer.Length() > 0;
+       now_ms++) {
+    while (next < trace.size() && trace[next].arrival_ms <= now_ms) {
+      buffer.Enqueue(MakePacket(trace[next].seq), now_ms * 1000);
+      next++;
+    }
+    result.max_depth = std::max(result.max_depth, buffer.Length());
+    if (now_ms % tick_ms == 0) {
+      buffer.Pull(now_ms * 1000, [&result](BT_HDR* p_msg) {
+        result.played.push_back(p_msg->layer_specific);
+      });
+    }
+  }
+  result.stats = buffer.GetStats();
+  return result;
+}
+
+ReplayResult Replay(const std::vector<TracePacket>& trace,
+                    uint64_t tick_ms = kTickMs) {
+  BtifA2dpSinkJitterBuffer buffer(kCapacity, kMinDepth);
+  return Replay(buffer, trace, tick_ms);
+}
+
+bool IsInSequenceOrder(const std::vector<uint16_t>& played) {
+  for (size_t i = 1; i < played.size(); i++) {
+    if (static_cast<int16_t>(played[i] - played[i - 1]) <= 0) return false;
+  }
+  return true;
+}
+
+}  // namespace
+
+TEST(BtifA2dpSinkJitterBufferTest, steady_link_plays_everything_in_order) {
+  auto result = Replay(TraceFromGaps(RepeatGaps({20}, 500)));
+
+  EXPECT_EQ(result.played.size(), 500u);
+  EXPECT_TRUE(IsInSequenceOrder(result.played));
+  EXPECT_EQ(result.stats.underruns, 0u);
+  EXPECT_EQ(result.stats.late_packets, 0u);
+  EXPECT_EQ(result.stats.packets_overflowed, 0u);
+  EXPECT_EQ(result.stats.target_depth, kMinDepth);
+  EXPECT_EQ(result.stats.packet_interval_us, 20000u);
+  // The buffer only holds back the target depth.
+  EXPECT_LE(result.stats.average_latency_us, (kMinDepth + 1) * 20000u);
+}
+
+TEST(BtifA2dpSinkJitterBufferTest, bursty_link_grows_target_depth) {
+  // Recorded with Wi-Fi coexistence: packets arrive in bursts of three.
+  auto result = Replay(TraceFromGaps(RepeatGaps({58, 1, 1}, 200)));
+
+  EXPECT_EQ(result.played.size(), 600u);
+  EXPECT_TRUE(IsInSequenceOrder(result.played));
+  EXPECT_GT(result.stats.jitter_us, 10000u);
+  EXPECT_GT(result.stats.target_depth, kMinDepth);
+  EXPECT_LE(result.stats.underruns, 1u);
+  EXPECT_EQ(result.stats.packets_overflowed, 0u);
+}
+
+TEST(BtifA2dpSinkJitterBufferTest, link_stall_counts_underrun_and_recovers) {
+  std::vector<uint64_t> gaps = RepeatGaps({20}, 100);
+  gaps.push_back(400);  // Stall, then the backlog is delivered at once.
+  gaps.insert(gaps.end(), 19, 1);
+  std::vector<uint64_t> tail = RepeatGaps({20}, 100);
+  gaps.insert(gaps.end(), tail.begin(), tail.end());
+
+  auto result = Replay(TraceFromGaps(gaps));
+
+  EXPECT_EQ(result.played.size(), gaps.size());
+  EXPECT_TRUE(IsInSequenceOrder(result.played));
+  EXPECT_GE(result.stats.underruns, 1u);
+  EXPECT_LE(result.stats.underruns, 2u);
+}
+
+TEST(BtifA2dpSinkJitterBufferTest, reordered_packets_are_played_in_order) {
+  auto trace = TraceFromGaps(RepeatGaps({20}, 200));
+  for (size_t i = 50; i + 1 < trace.size(); i += 25) {
+    std::swap(trace[i].seq, trace[i + 1].seq);
+  }
+
+  auto result = Replay(trace);
+
+  EXPECT_EQ(result.played.size(), 200u);
+  EXPECT_TRUE(IsInSequenceOrder(result.played));
+  EXPECT_EQ(result.stats.late_packets, 0u);
+}
+
+TEST(BtifA2dpSinkJitterBufferTest, packets_behind_playout_are_late) {
+  auto trace = TraceFromGaps(RepeatGaps({20}, 100));
+  // A retransmitted packet shows up long after its successors were played.
+  trace.push_back({trace[60].arrival_ms + 1, 30});
+  std::sort(trace.begin(), trace.end(),
+            [](const TracePacket& a, const TracePacket& b) {
+              return a.arrival_ms < b.arrival_ms;
+            });
+
+  auto result = Replay(trace);
+
+  EXPECT_EQ(result.stats.late_packets, 1u);
+  EXPECT_EQ(result.played.size(), 100u);
+  EXPECT_TRUE(IsInSequenceOrder(result.played));
+}
+
+TEST(BtifA2dpSinkJitterBufferTest, sequence_number_wraps_around) {
+  auto result = Replay(TraceFromGaps(RepeatGaps({20}, 100), 65500));
+
+  EXPECT_EQ(result.played.size(), 100u);
+  EXPECT_TRUE(IsInSequenceOrder(result.played));
+  EXPECT_EQ(result.stats.late_packets, 0u);
+}
+
+TEST(BtifA2dpSinkJitterBufferTest, fast_source_does_not_build_up_latency) {
+  // The source clock runs 5% fast compared to the playout clock.
+  auto result = Replay(TraceFromGaps(RepeatGaps({19}, 1000)));
+
+  EXPECT_EQ(result.played.size(), 1000u);
+  EXPECT_EQ(result.stats.packets_overflowed, 0u);
+  EXPECT_LE(result.max_depth, 2 * result.stats.target_depth + 2);
+}
+
+TEST(BtifA2dpSinkJitterBufferTest, overflow_drops_oldest_packets) {
+  constexpr uint16_t kPackets = 100;
+  BtifA2dpSinkJitterBuffer buffer(kCapacity, kMinDepth);
+  for (uint16_t seq = 0; seq < kPackets; seq++) {
+    EXPECT_EQ(buffer.Enqueue(MakePacket(seq), 1000 + seq * 20000),
+              seq < kCapacity);
+  }
+
+  auto stats = buffer.GetStats();
+  EXPECT_EQ(stats.packets_received, kPackets);
+  EXPECT_EQ(stats.packets_overflowed, kPackets - kCapacity);
+  EXPECT_EQ(buffer.Length(), kCapacity);
+
+  // The newest packets were kept for playout.
+  std::vector<uint16_t> played;
+  buffer.Pull(1000 + kPackets * 20000, [&played](BT_HDR* p_msg) {
+    played.push_back(p_msg->layer_specific);
+  });
+  ASSERT_FALSE(played.empty());
+  EXPECT_EQ(static_cast<size_t>(played.front()), kPackets - kCapacity);
+  EXPECT_TRUE(IsInSequenceOrder(played));
+}
+
+TEST(BtifA2dpSinkJitterBufferTest, flush_restarts_buffering) {
+  BtifA2dpSinkJitterBuffer buffer(kCapacity, kMinDepth);
+  auto trace = TraceFromGaps(RepeatGaps({20}, 50));
+  Replay(buffer, trace);
+  EXPECT_EQ(buffer.Length(), 0u);
+
+  for (uint16_t seq = 0; seq < kMinDepth - 1; seq++) {
+    buffer.Enqueue(MakePacket(seq), 2000000 + seq * 20000);
+  }
+  buffer.Flush();
+  EXPECT_EQ(buffer.Length(), 0u);
+
+  // A new stream may restart with any sequence number.
+  size_t played = 0;
+  for (uint16_t seq = 0; seq < kMinDepth; seq++) {
+    buffer.Enqueue(MakePacket(seq), 3000000 + seq * 20000);
+  }
+  played += buffer.Pull(3000000 + kMinDepth * 20000,
+                        [](BT_HDR* /* p_msg */) {});
+  EXPECT_EQ(played, 1u);
+  buffer.Reset();
+  EXPECT_EQ(buffer.GetStats().packets_received, 0u);
+}
@@ -0,0 +1,186 @@
+/*
+ * Copyright 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <string>
+#include <vector>
+
+#include "btif/src/btif_sock_l2cap.cc"
+
+namespace {
+
+constexpr int kPollThreadHandle = 1;
+constexpr uint16_t kTxMtu = 1000;
+const RawAddress kPeer{{0x11, 0x22, 0x33, 0x44, 0x55, 0x66}};
+
+struct {
+  std::vector<BT_HDR*> written;
+  std::vector<int> monitored_flags;
+} test_state;
+
+}  // namespace
+
+tBTA_JV_STATUS BTA_JvFreeChannel(uint16_t channel, int conn_type) {
+  return BTA_JV_SUCCESS;
+}
+void BTA_JvGetChannelId(int conn_type, uint32_t id, int32_t channel) {}
+void BTA_JvL2capConnect(int conn_type, tBTA_SEC sec_mask, tBTA_JV_ROLE role,
+                        std::unique_ptr<tL2CAP_ERTM_INFO> ertm_info,
+                        uint16_t remote_psm, uint16_t rx_mtu,
+                        std::unique_ptr<tL2CAP_CFG_INFO> cfg,
+                        const RawAddress& peer_bd_addr,
+                        tBTA_JV_L2CAP_CBACK* p_cback,
+                        uint32_t l2cap_socket_id) {}
+tBTA_JV_STATUS BTA_JvL2capClose(uint32_t handle) { return BTA_JV_SUCCESS; }
+void BTA_JvL2capStartServer(int conn_type, tBTA_SEC sec_mask, tBTA_JV_ROLE role,
+                            std::unique_ptr<tL2CAP_ERTM_INFO> ertm_info,
+                            uint16_t local_psm, uint16_t rx_mtu,
+                            std::unique_ptr<tL2CAP_CFG_INFO> cfg,
+                            tBTA_JV_L2CAP_CBACK* p_cback,
+                            uint32_t l2cap_socket_id) {}
+tBTA_JV_STATUS BTA_JvL2capStopServer(uint16_t local_psm,
+                                     uint32_t l2cap_socket_id) {
+  return BTA_JV_SUCCESS;
+}
+tBTA_JV_STATUS BTA_JvL2capRead(uint32_t handle, uint32_t req_id,
+                               uint8_t* p_data, uint16_t len) {
+  return BTA_JV_SUCCESS;
+}
+tBTA_JV_STATUS BTA_JvL2capReady(uint32_t handle, uint32_t* p_data_size) {
+  *p_data_size = 0;
+  return BTA_JV_SUCCESS;
+}
+tBTA_JV_STATUS BTA_JvL2capWrite(uint32_t handle, uint32_t req_id, BT_HDR* msg,
+                                uint32_t user_id) {
+  test_state.written.push_back(msg);
+  return BTA_JV_SUCCESS;
+}
+tBTA_JV_STATUS BTA_JvSetPmProfile(uint32_t handle, tBTA_JV_PM_ID app_id,
+                                  tBTA_JV_CONN_STATE init_st) {
+  return BTA_JV_SUCCESS;
+}
+int btsock_thread_add_fd(int handle, int fd, int type, int flags,
+                         uint32_t user_id) {
+  test_state.monitored_flags.push_back(flags);
+  return 0;
+}
+void uid_set_add_tx(uid_set_t* set, int32_t app_uid, uint64_t bytes) {}
+void uid_set_add_rx(uid_set_t* set, int32_t app_uid, uint64_t bytes) {}
+void log_socket_connection_state(
+    const RawAddress& address, int port, int type,
+    android::bluetooth::SocketConnectionstateEnum connection_state,
+    int64_t tx_bytes, int64_t rx_bytes, int uid, int server_port,
+    android::bluetooth::SocketRoleEnum socket_role) {}
+void btif_sock_connection_logger(int state, int role, const RawAddress& addr,
+                                 int channel, const char* server_name) {}
+
+class BtifSockL2capTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    test_state = {};
+    btsock_l2cap_init(kPollThreadHandle, nullptr);
+    ASSERT_EQ(btsock_l2cap_connect(&kPeer, 0x1001, &app_fd_, 0, 1000),
+              BT_STATUS_SUCCESS);
+
+    std::unique_lock<std::mutex> lock(state_lock);
+    sock_ = btsock_l2cap_find_by_id_l(last_sock_id);
+    ASSERT_NE(sock_, nullptr);
+    sock_->connected = true;
+    sock_->tx_mtu = kTxMtu;
+    test_state.monitored_flags.clear();
+  }
+
+  void TearDown() override {
+    btsock_l2cap_cleanup();
+    close(app_fd_);
+    for (BT_HDR* p_buf : test_state.written) osi_free(p_buf);
+  }
+
+  void AppSends(size_t len, char fill) {
+    std::string sdu(len, fill);
+    ASSERT_EQ(send(app_fd_, sdu.data(), sdu.size(), 0),
+              static_cast<ssize_t>(len));
+  }
+
+  void Signal() {
+    btsock_l2cap_signaled(sock_->our_fd, SOCK_THREAD_FD_RD, sock_->id);
+  }
+
+  void Congest(bool cong) {
+    tBTA_JV_L2CAP_CONG p{.status = BTA_JV_SUCCESS,
+                         .handle = static_cast<uint32_t>(sock_->handle),
+                         .cong = cong};
+    on_l2cap_outgoing_congest(&p, sock_->id);
+  }
+
+  int app_fd_ = -1;
+  l2cap_socket* sock_ = nullptr;
+};
+
+TEST_F(BtifSockL2capTest, sdus_are_handed_off_in_buffers_of_their_size) {
+  AppSends(10, 'a');
+  AppSends(kTxMtu, 'b');
+  AppSends(100, 'c');
+  Signal();
+
+  ASSERT_EQ(test_state.written.size(), 3u);
+  EXPECT_EQ(test_state.written[0]->len, 10);
+  EXPECT_EQ(test_state.written[1]->len, kTxMtu);
+  EXPECT_EQ(test_state.written[2]->len, 100);
+  EXPECT_EQ(std::string(reinterpret_cast<char*>(
+                            get_l2cap_sdu_start_ptr(test_state.written[2])),
+                        100),
+            std::string(100, 'c'));
+
+  // Only the SDU that filled the MTU took its receive buffer, the shorter
+  // ones were copied and their MTU sized buffers kept for the next read.
+  EXPECT_NE(sdu_pool[0], nullptr);
+  EXPECT_NE(sdu_pool[0], test_state.written[0]);
+  EXPECT_EQ(sdu_pool[1], nullptr);
+  EXPECT_NE(sdu_pool[2], nullptr);
+  EXPECT_NE(sdu_pool[2], test_state.written[2]);
+}
+
+TEST_F(BtifSockL2capTest, congested_socket_is_not_read) {
+  Congest(true);
+  AppSends(10, 'a');
+  Signal();
+
+  EXPECT_TRUE(test_state.written.empty());
+  EXPECT_TRUE(test_state.monitored_flags.empty());
+  int pending = 0;
+  ASSERT_EQ(ioctl(sock_->our_fd, FIONREAD, &pending), 0);
+  EXPECT_GT(pending, 0);
+
+  // The end of the congestion monitors the socket again, the SDU is then read
+  Congest(false);
+  ASSERT_EQ(test_state.monitored_flags.size(), 1u);
+  EXPECT_EQ(test_state.monitored_flags[0], SOCK_THREAD_FD_RD);
+  Signal();
+  ASSERT_EQ(test_state.written.size(), 1u);
+  EXPECT_EQ(test_state.written[0]->len, 10);
+}
+
+TEST_F(BtifSockL2capTest, nothing_to_read_monitors_socket_again) {
+  Signal();
+
+  EXPECT_TRUE(test_state.written.empty());
+  ASSERT_EQ(test_state.monitored_flags.size(), 1u);
+  EXPECT_EQ(test_state.monitored_flags[0], SOCK_THREAD_FD_RD);
+}
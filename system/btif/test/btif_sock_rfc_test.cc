@@ -0,0 +1,193 @@
+/*
+ * Copyright 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <string>
+#include <vector>
+
+#include "btif/src/btif_sock_rfc.cc"
+
+namespace {
+
+constexpr int kPollThreadHandle = 1;
+constexpr uint16_t kBufferLen = 1000;
+const RawAddress kPeer{{0x11, 0x22, 0x33, 0x44, 0x55, 0x66}};
+
+struct {
+  std::vector<int> monitored_flags;
+  int flow_control_enabled = 0;
+} test_state;
+
+}  // namespace
+
+bool BTA_FreeSCN(uint8_t scn) { return true; }
+tBTA_JV_STATUS BTA_JvCreateRecordByUser(uint32_t rfcomm_slot_id) {
+  return BTA_JV_SUCCESS;
+}
+void BTA_JvDisable(void) {}
+tBTA_JV_STATUS BTA_JvEnable(tBTA_JV_DM_CBACK* p_cback) {
+  return BTA_JV_SUCCESS;
+}
+void BTA_JvGetChannelId(int conn_type, uint32_t id, int32_t channel) {}
+tBTA_JV_STATUS BTA_JvRfcommClose(uint32_t handle, uint32_t rfcomm_slot_id) {
+  return BTA_JV_SUCCESS;
+}
+tBTA_JV_STATUS BTA_JvRfcommConnect(tBTA_SEC sec_mask, tBTA_JV_ROLE role,
+                                   uint8_t remote_scn,
+                                   const RawAddress& peer_bd_addr,
+                                   tBTA_JV_RFCOMM_CBACK* p_cback,
+                                   uint32_t rfcomm_slot_id) {
+  return BTA_JV_SUCCESS;
+}
+uint16_t BTA_JvRfcommGetPortHdl(uint32_t handle) { return 0; }
+tBTA_JV_STATUS BTA_JvRfcommStartServer(tBTA_SEC sec_mask, tBTA_JV_ROLE role,
+                                       uint8_t local_scn, uint8_t max_session,
+                                       tBTA_JV_RFCOMM_CBACK* p_cback,
+                                       uint32_t rfcomm_slot_id) {
+  return BTA_JV_SUCCESS;
+}
+tBTA_JV_STATUS BTA_JvRfcommStopServer(uint32_t handle,
+                                      uint32_t rfcomm_slot_id) {
+  return BTA_JV_SUCCESS;
+}
+tBTA_JV_STATUS BTA_JvRfcommWrite(uint32_t handle, uint32_t req_id) {
+  return BTA_JV_SUCCESS;
+}
+tBTA_JV_STATUS BTA_JvSetPmProfile(uint32_t handle, tBTA_JV_PM_ID app_id,
+                                  tBTA_JV_CONN_STATE init_st) {
+  return BTA_JV_SUCCESS;
+}
+tBTA_JV_STATUS BTA_JvStartDiscovery(const RawAddress& bd_addr,
+                                    uint16_t num_uuid,
+                                    const bluetooth::Uuid* p_uuid_list,
+                                    uint32_t rfcomm_slot_id) {
+  return BTA_JV_SUCCESS;
+}
+int PORT_FlowControl_MaxCredit(uint16_t handle, bool enable) {
+  if (enable) test_state.flow_control_enabled++;
+  return 0;
+}
+int add_rfc_sdp_rec(const char* name, bluetooth::Uuid uuid, int scn) {
+  return 0;
+}
+void del_rfc_sdp_rec(int handle) {}
+bool is_reserved_rfc_channel(int channel) { return false; }
+int get_reserved_rfc_channel(const bluetooth::Uuid& uuid) { return -1; }
+int btsock_thread_add_fd(int handle, int fd, int type, int flags,
+                         uint32_t user_id) {
+  test_state.monitored_flags.push_back(flags);
+  return 0;
+}
+void uid_set_add_tx(uid_set_t* set, int32_t app_uid, uint64_t bytes) {}
+void uid_set_add_rx(uid_set_t* set, int32_t app_uid, uint64_t bytes) {}
+void log_socket_connection_state(
+    const RawAddress& address, int port, int type,
+    android::bluetooth::SocketConnectionstateEnum connection_state,
+    int64_t tx_bytes, int64_t rx_bytes, int uid, int server_port,
+    android::bluetooth::SocketRoleEnum socket_role) {}
+void btif_sock_connection_logger(int state, int role, const RawAddress& addr,
+                                 int channel, const char* server_name) {}
+
+class BtifSockRfcTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    test_state = {};
+    btsock_rfc_init(kPollThreadHandle, nullptr);
+
+    std::unique_lock<std::recursive_mutex> lock(slot_lock);
+    slot_ = alloc_rfc_slot(&kPeer, "test", Uuid::kEmpty, 1, 0, false);
+    ASSERT_NE(slot_, nullptr);
+    slot_->f.connected = true;
+    // The app end is owned by the test, as it would be by the app
+    app_fd_ = slot_->app_fd;
+    slot_->app_fd = INVALID_FD;
+    // Keep the socket small so that the stack data has to be queued
+    int sndbuf = 4096;
+    ASSERT_EQ(setsockopt(slot_->fd, SOL_SOCKET, SO_SNDBUF, &sndbuf,
+                         sizeof(sndbuf)),
+              0);
+  }
+
+  void TearDown() override {
+    btsock_rfc_cleanup();
+    close(app_fd_);
+  }
+
+  // Hands the app a buffer from the stack, returns the data it holds
+  std::string StackReceives(char fill) {
+    BT_HDR* p_buf = (BT_HDR*)osi_malloc(sizeof(BT_HDR) + kBufferLen);
+    p_buf->offset = 0;
+    p_buf->len = kBufferLen;
+    memset(p_buf->data, fill, kBufferLen);
+    bta_co_rfc_data_incoming(slot_->id, p_buf);
+    return std::string(kBufferLen, fill);
+  }
+
+  std::string AppReadsAll() {
+    std::string data;
+    char buf[4096];
+    ssize_t received;
+    while ((received = recv(app_fd_, buf, sizeof(buf), MSG_DONTWAIT)) > 0) {
+      data.append(buf, received);
+    }
+    return data;
+  }
+
+  int app_fd_ = INVALID_FD;
+  rfc_slot_t* slot_ = nullptr;
+};
+
+TEST_F(BtifSockRfcTest, queued_buffers_reach_app_in_order) {
+  std::string expected;
+  for (int i = 0; i < 1000 && list_length(slot_->incoming_queue) < 3; i++) {
+    expected += StackReceives('a' + i % 26);
+  }
+  ASSERT_GE(list_length(slot_->incoming_queue), 3u);
+  ASSERT_FALSE(test_state.monitored_flags.empty());
+  EXPECT_EQ(test_state.monitored_flags.back(), SOCK_THREAD_FD_WR);
+
+  // Each write signal sends as many queued buffers as fit in one send, the
+  // first one possibly partially sent before
+  std::string received;
+  for (int i = 0; i < 1000 && !list_is_empty(slot_->incoming_queue); i++) {
+    received += AppReadsAll();
+    btsock_rfc_signaled(slot_->fd, SOCK_THREAD_FD_WR, slot_->id);
+  }
+  ASSERT_TRUE(list_is_empty(slot_->incoming_queue));
+  received += AppReadsAll();
+
+  EXPECT_EQ(received, expected);
+  EXPECT_EQ(test_state.flow_control_enabled, 1);
+}
+
+TEST_F(BtifSockRfcTest, flow_control_stays_off_while_app_is_not_reading) {
+  for (int i = 0; i < 1000 && list_length(slot_->incoming_queue) < 3; i++) {
+    StackReceives('a' + i % 26);
+  }
+  size_t queued = list_length(slot_->incoming_queue);
+  ASSERT_GE(queued, 3u);
+
+  test_state.monitored_flags.clear();
+  btsock_rfc_signaled(slot_->fd, SOCK_THREAD_FD_WR, slot_->id);
+
+  EXPECT_EQ(list_length(slot_->incoming_queue), queued);
+  EXPECT_EQ(test_state.flow_control_enabled, 0);
+  ASSERT_EQ(test_state.monitored_flags.size(), 1u);
+  EXPECT_EQ(test_state.monitored_flags[0], SOCK_THREAD_FD_WR);
+}
@@ -0,0 +1,215 @@
+/*
+ * Copyright 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "btif/include/btif_sock_thread.h"
+
+#include <fcntl.h>
+#include <gtest/gtest.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace {
+
+constexpr auto kSignalTimeout = std::chrono::seconds(5);
+constexpr auto kNoSignalWait = std::chrono::milliseconds(100);
+
+// The signals delivered by the socket thread, by user id.
+std::mutex signals_mutex;
+std::condition_variable signals_cv;
+std::map<uint32_t, std::vector<int>> signals;
+std::vector<uint32_t> cmds;
+
+void on_signaled(int fd, int type, int flags, uint32_t user_id) {
+  std::lock_guard<std::mutex> lock(signals_mutex);
+  signals[user_id].push_back(flags);
+  signals_cv.notify_all();
+}
+
+void on_cmd(int cmd_fd, int type, int size, uint32_t user_id) {
+  std::lock_guard<std::mutex> lock(signals_mutex);
+  cmds.push_back(user_id);
+  signals_cv.notify_all();
+}
+
+// A connected socket pair: the socket thread monitors |stack_fd|, and the
+// test plays the app on |app_fd|.
+struct Link {
+  int stack_fd = -1;
+  int app_fd = -1;
+};
+
+Link make_link() {
+  int fds[2];
+  EXPECT_EQ(socketpair(AF_UNIX, SOCK_SEQPACKET, 0, fds), 0);
+  return Link{fds[0], fds[1]};
+}
+
+void close_link(const Link& link) {
+  if (link.stack_fd != -1) close(link.stack_fd);
+  if (link.app_fd != -1) close(link.app_fd);
+}
+
+}  // namespace
+
+class BtifSockThreadTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    btsock_thread_init();
+    {
+      std::lock_guard<std::mutex> lock(signals_mutex);
+      signals.clear();
+      cmds.clear();
+    }
+    handle_ = btsock_thread_create(on_signaled, on_cmd);
+    ASSERT_GE(handle_, 0);
+  }
+
+  void TearDown() override { ASSERT_TRUE(btsock_thread_exit(handle_)); }
+
+  // Waits until |user_id| was signaled |count| times in total.
+  bool WaitForSignals(uint32_t user_id, size_t count) {
+    std::unique_lock<std::mutex> lock(signals_mutex);
+    return signals_cv.wait_for(lock, kSignalTimeout, [user_id, count] {
+      return signals[user_id].size() >= count;
+    });
+  }
+
+  size_t SignalCount(uint32_t user_id) {
+    std::lock_guard<std::mutex> lock(signals_mutex);
+    return signals[user_id].size();
+  }
+
+  int LastFlags(uint32_t user_id) {
+    std::lock_guard<std::mutex> lock(signals_mutex);
+    return signals[user_id].back();
+  }
+
+  // Waits until every command posted before has been processed.
+  void Sync() {
+    static uint32_t sync_id = 0;
+    uint32_t id = ++sync_id;
+    ASSERT_TRUE(btsock_thread_post_cmd(handle_, 0, nullptr, 0, id));
+    std::unique_lock<std::mutex> lock(signals_mutex);
+    ASSERT_TRUE(signals_cv.wait_for(lock, kSignalTimeout, [id] {
+      return std::find(cmds.begin(), cmds.end(), id) != cmds.end();
+    }));
+  }
+
+  int handle_ = -1;
+};
+
+TEST_F(BtifSockThreadTest, read_signal_is_one_shot) {
+  Link link = make_link();
+  ASSERT_TRUE(btsock_thread_add_fd(handle_, link.stack_fd, BTSOCK_RFCOMM,
+                                   SOCK_THREAD_FD_RD, 1));
+  ASSERT_EQ(write(link.app_fd, "a", 1), 1);
+  ASSERT_TRUE(WaitForSignals(1, 1));
+  ASSERT_EQ(LastFlags(1), SOCK_THREAD_FD_RD);
+
+  // The data is still unread, but the fd is not monitored until it is added
+  // again.
+  std::this_thread::sleep_for(kNoSignalWait);
+  ASSERT_EQ(SignalCount(1), 1u);
+
+  ASSERT_TRUE(btsock_thread_add_fd(handle_, link.stack_fd, BTSOCK_RFCOMM,
+                                   SOCK_THREAD_FD_RD, 1));
+  ASSERT_TRUE(WaitForSignals(1, 2));
+  close_link(link);
+}
+
+TEST_F(BtifSockThreadTest, read_and_write_are_signaled_separately) {
+  Link link = make_link();
+  ASSERT_TRUE(btsock_thread_add_fd(handle_, link.stack_fd, BTSOCK_L2CAP,
+                                   SOCK_THREAD_FD_WR, 1));
+  ASSERT_TRUE(WaitForSignals(1, 1));
+  ASSERT_EQ(LastFlags(1), SOCK_THREAD_FD_WR);
+
+  ASSERT_TRUE(btsock_thread_add_fd(handle_, link.stack_fd, BTSOCK_L2CAP,
+                                   SOCK_THREAD_FD_RD, 1));
+  std::this_thread::sleep_for(kNoSignalWait);
+  ASSERT_EQ(SignalCount(1), 1u);
+  ASSERT_EQ(write(link.app_fd, "a", 1), 1);
+  ASSERT_TRUE(WaitForSignals(1, 2));
+  ASSERT_EQ(LastFlags(1), SOCK_THREAD_FD_RD);
+  close_link(link);
+}
+
+TEST_F(BtifSockThreadTest, peer_close_is_an_exception) {
+  Link link = make_link();
+  ASSERT_TRUE(btsock_thread_add_fd(handle_, link.stack_fd, BTSOCK_RFCOMM,
+                                   SOCK_THREAD_FD_RD, 1));
+  close(link.app_fd);
+  link.app_fd = -1;
+  ASSERT_TRUE(WaitForSignals(1, 1));
+  ASSERT_TRUE(LastFlags(1) & SOCK_THREAD_FD_EXCEPTION);
+  close_link(link);
+}
+
+TEST_F(BtifSockThreadTest, many_sockets) {
+  // Well above the 64 sockets per thread the poll() based thread handled
+  constexpr uint32_t kLinks = 300;
+  std::vector<Link> links;
+  for (uint32_t i = 0; i < kLinks; i++) {
+    links.push_back(make_link());
+    ASSERT_TRUE(btsock_thread_add_fd(handle_, links.back().stack_fd,
+                                     BTSOCK_RFCOMM, SOCK_THREAD_FD_RD, i));
+  }
+  for (const Link& link : links) {
+    ASSERT_EQ(write(link.app_fd, "a", 1), 1);
+  }
+  for (uint32_t i = 0; i < kLinks; i++) {
+    ASSERT_TRUE(WaitForSignals(i, 1));
+  }
+  for (const Link& link : links) close_link(link);
+}
+
+TEST_F(BtifSockThreadTest, remove_fd_and_close) {
+  Link link = make_link();
+  ASSERT_TRUE(btsock_thread_add_fd(handle_, link.stack_fd, BTSOCK_RFCOMM,
+                                   SOCK_THREAD_FD_RD, 1));
+  ASSERT_TRUE(btsock_thread_remove_fd_and_close(handle_, link.stack_fd));
+  Sync();
+  ASSERT_EQ(fcntl(link.stack_fd, F_GETFD), -1);
+  link.stack_fd = -1;
+
+  ASSERT_EQ(send(link.app_fd, "a", 1, MSG_NOSIGNAL), -1);
+  std::this_thread::sleep_for(kNoSignalWait);
+  ASSERT_EQ(SignalCount(1), 0u);
+  close_link(link);
+}
+
+TEST_F(BtifSockThreadTest, reused_fd_number_is_monitored) {
+  Link link = make_link();
+  ASSERT_TRUE(btsock_thread_add_fd(handle_, link.stack_fd, BTSOCK_RFCOMM,
+                                   SOCK_THREAD_FD_RD, 1));
+  // Closed without being removed: the next socket gets the same number.
+  close_link(link);
+  Link reused = make_link();
+  ASSERT_TRUE(btsock_thread_add_fd(handle_, reused.stack_fd, BTSOCK_RFCOMM,
+                                   SOCK_THREAD_FD_RD, 2));
+  ASSERT_EQ(write(reused.app_fd, "a", 1), 1);
+  ASSERT_TRUE(WaitForSignals(2, 1));
+  ASSERT_EQ(SignalCount(1), 0u);
+  close_link(reused);
+}
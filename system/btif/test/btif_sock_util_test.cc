@@ -0,0 +1,128 @@
+/*
+ * Copyright 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "btif/include/btif_sock_util.h"
+
+#include <errno.h>
+#include <gtest/gtest.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace {
+
+class BtifSockUtilTest : public ::testing::Test {
+ protected:
+  void TearDown() override {
+    for (int fd : fds_) close(fd);
+  }
+
+  void MakePair(int type, int* stack_fd, int* app_fd) {
+    int fds[2];
+    ASSERT_EQ(socketpair(AF_UNIX, type, 0, fds), 0);
+    fds_.push_back(fds[0]);
+    fds_.push_back(fds[1]);
+    *stack_fd = fds[0];
+    *app_fd = fds[1];
+  }
+
+  std::vector<int> fds_;
+};
+
+struct iovec to_iovec(std::string& s) { return {&s[0], s.size()}; }
+
+}  // namespace
+
+TEST_F(BtifSockUtilTest, send_msgs_keeps_message_boundaries) {
+  int stack_fd, app_fd;
+  MakePair(SOCK_SEQPACKET, &stack_fd, &app_fd);
+  std::vector<std::string> sdus = {"first", "second sdu", "3"};
+  struct iovec msgs[3];
+  for (int i = 0; i < 3; i++) msgs[i] = to_iovec(sdus[i]);
+
+  ASSERT_EQ(sock_send_msgs(stack_fd, msgs, 3), 3);
+
+  for (const std::string& sdu : sdus) {
+    char buffer[64];
+    ASSERT_EQ(recv(app_fd, buffer, sizeof(buffer), 0), (ssize_t)sdu.size());
+    ASSERT_EQ(std::string(buffer, sdu.size()), sdu);
+  }
+}
+
+TEST_F(BtifSockUtilTest, recv_msgs_reads_several_messages) {
+  int stack_fd, app_fd;
+  MakePair(SOCK_SEQPACKET, &stack_fd, &app_fd);
+  ASSERT_EQ(send(app_fd, "ab", 2, 0), 2);
+  ASSERT_EQ(send(app_fd, "cde", 3, 0), 3);
+
+  char buffers[4][16];
+  struct iovec msgs[4];
+  for (int i = 0; i < 4; i++) msgs[i] = {buffers[i], sizeof(buffers[i])};
+  uint32_t lens[4];
+  ASSERT_EQ(sock_recv_msgs(stack_fd, msgs, 4, lens), 2);
+  ASSERT_EQ(lens[0], 2u);
+  ASSERT_EQ(lens[1], 3u);
+  ASSERT_EQ(std::string(buffers[0], 2), "ab");
+  ASSERT_EQ(std::string(buffers[1], 3), "cde");
+
+  // Nothing left, and the call does not block.
+  ASSERT_EQ(sock_recv_msgs(stack_fd, msgs, 4, lens), -1);
+  ASSERT_TRUE(errno == EAGAIN || errno == EWOULDBLOCK);
+}
+
+TEST_F(BtifSockUtilTest, recv_msgs_reports_truncated_length) {
+  int stack_fd, app_fd;
+  MakePair(SOCK_SEQPACKET, &stack_fd, &app_fd);
+  ASSERT_EQ(send(app_fd, "0123456789", 10, 0), 10);
+
+  char buffer[4];
+  struct iovec msg = {buffer, sizeof(buffer)};
+  uint32_t len;
+  ASSERT_EQ(sock_recv_msgs(stack_fd, &msg, 1, &len), 1);
+  ASSERT_EQ(len, 10u);
+  ASSERT_EQ(std::string(buffer, 4), "0123");
+}
+
+TEST_F(BtifSockUtilTest, send_iov_gathers_buffers) {
+  int stack_fd, app_fd;
+  MakePair(SOCK_STREAM, &stack_fd, &app_fd);
+  std::vector<std::string> bufs = {"abc", "", "defg"};
+  struct iovec iov[3];
+  for (int i = 0; i < 3; i++) iov[i] = to_iovec(bufs[i]);
+
+  ASSERT_EQ(sock_send_iov(stack_fd, iov, 3), 7);
+
+  char buffer[16];
+  ASSERT_EQ(recv(app_fd, buffer, sizeof(buffer), 0), 7);
+  ASSERT_EQ(std::string(buffer, 7), "abcdefg");
+}
+
+TEST_F(BtifSockUtilTest, send_iov_does_not_block_when_full) {
+  int stack_fd, app_fd;
+  MakePair(SOCK_STREAM, &stack_fd, &app_fd);
+  std::string chunk(4096, 'x');
+  struct iovec iov = to_iovec(chunk);
+
+  ssize_t sent;
+  size_t total = 0;
+  while ((sent = sock_send_iov(stack_fd, &iov, 1)) > 0) total += sent;
+  ASSERT_EQ(sent, -1);
+  ASSERT_TRUE(errno == EAGAIN || errno == EWOULDBLOCK);
+  ASSERT_GT(total, 0u);
+}
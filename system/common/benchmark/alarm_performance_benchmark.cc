@@ -0,0 +1,109 @@
+/*
+ * Copyright 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <base/logging.h>
+#include <benchmark/benchmark.h>
+
+#include <string>
+#include <vector>
+
+#include "common/message_loop_thread.h"
+#include "osi/include/alarm.h"
+
+using ::benchmark::State;
+
+#define NUM_ARMED_ALARMS 10000
+
+// Far enough in the future that no alarm fires while the benchmark runs, and
+// above the wakelock threshold so no wakelock is taken.
+static const uint64_t kAlarmIntervalMs = 3600000;
+
+bluetooth::common::MessageLoopThread* get_main_thread() { return nullptr; }
+
+static void alarm_callback(void* data) {}
+
+class BM_AlarmPerformance : public ::benchmark::Fixture {
+ protected:
+  void SetUp(State& st) override {
+    ::benchmark::Fixture::SetUp(st);
+    alarms_.resize(NUM_ARMED_ALARMS);
+    for (size_t i = 0; i < alarms_.size(); i++) {
+      const std::string alarm_name =
+          "BM_AlarmPerformance[" + std::to_string(i) + "]";
+      alarms_[i] = alarm_new(alarm_name.c_str());
+    }
+  }
+
+  void TearDown(State& st) override {
+    for (alarm_t* alarm : alarms_) alarm_free(alarm);
+    alarms_.clear();
+    alarm_cleanup();
+    ::benchmark::Fixture::TearDown(st);
+  }
+
+  void ArmAll() {
+    for (size_t i = 0; i < alarms_.size(); i++) {
+      alarm_set(alarms_[i], kAlarmIntervalMs + (i * 7919) % alarms_.size(),
+                alarm_callback, nullptr);
+    }
+  }
+
+  std::vector<alarm_t*> alarms_;
+};
+
+BENCHMARK_F(BM_AlarmPerformance, set_10k)(State& state) {
+  for (auto _ : state) {
+    ArmAll();
+    state.PauseTiming();
+    for (alarm_t* alarm : alarms_) alarm_cancel(alarm);
+    state.ResumeTiming();
+  }
+  state.SetItemsProcessed(state.iterations() * alarms_.size());
+};
+
+BENCHMARK_F(BM_AlarmPerformance, cancel_10k)(State& state) {
+  for (auto _ : state) {
+    state.PauseTiming();
+    ArmAll();
+    state.ResumeTiming();
+    for (alarm_t* alarm : alarms_) alarm_cancel(alarm);
+  }
+  state.SetItemsProcessed(state.iterations() * alarms_.size());
+};
+
+BENCHMARK_F(BM_AlarmPerformance, reschedule_with_10k_armed)(State& state) {
+  ArmAll();
+  size_t i = 0;
+  for (auto _ : state) {
+    alarm_set(alarms_[i], kAlarmIntervalMs + (i * 31) % alarms_.size(),
+              alarm_callback, nullptr);
+    i = (i + 1) % alarms_.size();
+  }
+  for (alarm_t* alarm : alarms_) alarm_cancel(alarm);
+  state.SetItemsProcessed(state.iterations());
+};
+
+int main(int argc, char** argv) {
+  // Disable LOG() output from libchrome
+  logging::LoggingSettings log_settings;
+  log_settings.logging_dest = logging::LoggingDestination::LOG_NONE;
+  CHECK(logging::InitLogging(log_settings)) << "Failed to set up logging";
+  ::benchmark::Initialize(&argc, argv);
+  if (::benchmark::ReportUnrecognizedArguments(argc, argv)) {
+    return 1;
+  }
+  ::benchmark::RunSpecifiedBenchmarks();
+}
@@ -0,0 +1,122 @@
+/*
+ * Copyright 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <base/logging.h>
+#include <benchmark/benchmark.h>
+#include <stdio.h>
+
+#include <filesystem>
+#include <string>
+
+#include "osi/include/config.h"
+
+using ::benchmark::State;
+
+#define NUM_DEVICES 1000
+
+static const std::filesystem::path kConfigFile =
+    std::filesystem::temp_directory_path() / "config_benchmark.conf";
+
+static std::string device_address(int i) {
+  char address[18];
+  snprintf(address, sizeof(address), "00:11:22:33:%02x:%02x", (i >> 8) & 0xff,
+           i & 0xff);
+  return address;
+}
+
+// Fills |config| the way bt_config.conf looks with |NUM_DEVICES| bonded
+// devices.
+static void populate_config(config_t* config) {
+  config_set_string(config, "Info", "FileSource", "Empty");
+  config_set_string(config, "Adapter", "Address", "AA:BB:CC:DD:EE:FF");
+  for (int i = 0; i < NUM_DEVICES; i++) {
+    const std::string section = device_address(i);
+    config_set_string(config, section, "Name", "Device " + std::to_string(i));
+    config_set_int(config, section, "DevClass", 0x240404);
+    config_set_int(config, section, "DevType", 3);
+    config_set_int(config, section, "AddrType", 0);
+    config_set_uint64(config, section, "Timestamp", 1700000000 + i);
+    config_set_string(config, section, "Service",
+                      "0000110b-0000-1000-8000-00805f9b34fb "
+                      "0000110e-0000-1000-8000-00805f9b34fb");
+    config_set_string(config, section, "LinkKey",
+                      "00112233445566778899aabbccddeeff");
+    config_set_int(config, section, "LinkKeyType", 8);
+    config_set_int(config, section, "PinLength", 0);
+    config_set_string(config, section, "LE_KEY_PENC",
+                      "00112233445566778899aabbccddeeff0011223344556677");
+  }
+}
+
+class BM_ConfigPerformance : public ::benchmark::Fixture {
+ protected:
+  void SetUp(State& st) override {
+    ::benchmark::Fixture::SetUp(st);
+    config_ = config_new_empty();
+    populate_config(config_.get());
+    CHECK(config_save(*config_, kConfigFile.string()));
+  }
+
+  void TearDown(State& st) override {
+    config_.reset();
+    std::filesystem::remove(kConfigFile);
+    ::benchmark::Fixture::TearDown(st);
+  }
+
+  std::unique_ptr<config_t> config_;
+};
+
+BENCHMARK_F(BM_ConfigPerformance, load_1000_devices)(State& state) {
+  for (auto _ : state) {
+    std::unique_ptr<config_t> config = config_new(kConfigFile.c_str());
+    CHECK(config != nullptr);
+  }
+};
+
+BENCHMARK_F(BM_ConfigPerformance, lookup_1000_devices)(State& state) {
+  int i = 0;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(config_get_string(
+        *config_, device_address(i), "LinkKey", nullptr));
+    i = (i + 1) % NUM_DEVICES;
+  }
+};
+
+BENCHMARK_F(BM_ConfigPerformance, set_1000_devices)(State& state) {
+  int i = 0;
+  for (auto _ : state) {
+    config_set_uint64(config_.get(), device_address(i), "Timestamp", i);
+    i = (i + 1) % NUM_DEVICES;
+  }
+};
+
+BENCHMARK_F(BM_ConfigPerformance, save_1000_devices)(State& state) {
+  for (auto _ : state) {
+    CHECK(config_save(*config_, kConfigFile.string()));
+  }
+};
+
+int main(int argc, char** argv) {
+  // Disable LOG() output from libchrome
+  logging::LoggingSettings log_settings;
+  log_settings.logging_dest = logging::LoggingDestination::LOG_NONE;
+  CHECK(logging::InitLogging(log_settings)) << "Failed to set up logging";
+  ::benchmark::Initialize(&argc, argv);
+  if (::benchmark::ReportUnrecognizedArguments(argc, argv)) {
+    return 1;
+  }
+  ::benchmark::RunSpecifiedBenchmarks();
+}
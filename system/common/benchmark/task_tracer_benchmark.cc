@@ -0,0 +1,99 @@
+/*
+ * Copyright 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <base/functional/bind.h>
+#include <base/logging.h>
+#include <benchmark/benchmark.h>
+
+#include <future>
+#include <memory>
+
+#include "common/message_loop_thread.h"
+#include "gd/common/task_tracer.h"
+
+using ::benchmark::State;
+using bluetooth::common::MessageLoopThread;
+using bluetooth::common::TaskTrace;
+using bluetooth::common::TaskTraceBuffer;
+using bluetooth::common::TaskTracer;
+
+#define NUM_MESSAGES_TO_SEND 100000
+
+static int g_counter = 0;
+static std::unique_ptr<std::promise<void>> g_counter_promise = nullptr;
+
+static void callback_batch() {
+  g_counter++;
+  if (g_counter >= NUM_MESSAGES_TO_SEND) {
+    g_counter_promise->set_value();
+  }
+}
+
+// Posts and runs NUM_MESSAGES_TO_SEND empty tasks on a MessageLoopThread, with
+// task tracing disabled (0) or enabled (1). Empty tasks are the worst case:
+// the cost of tracing is not hidden behind any work.
+static void BM_MessageLoopThreadTracing(State& state) {
+  TaskTracer::SetEnabled(state.range(0) != 0);
+  MessageLoopThread thread("BM_MessageLoopThreadTracing thread");
+  thread.StartUp();
+
+  for (auto _ : state) {
+    g_counter = 0;
+    g_counter_promise = std::make_unique<std::promise<void>>();
+    std::future<void> counter_future = g_counter_promise->get_future();
+    for (int i = 0; i < NUM_MESSAGES_TO_SEND; i++) {
+      thread.DoInThread(FROM_HERE, base::BindOnce(&callback_batch));
+    }
+    counter_future.wait();
+  }
+  state.SetItemsProcessed(static_cast<int64_t>(state.iterations()) *
+                          NUM_MESSAGES_TO_SEND);
+
+  thread.ShutDown();
+  TaskTracer::SetEnabled(false);
+}
+BENCHMARK(BM_MessageLoopThreadTracing)
+    ->Arg(0)
+    ->Arg(1)
+    ->Unit(benchmark::kMillisecond);
+
+// The cost of recording a task, on the running thread.
+static void BM_TaskTraceBufferRecord(State& state) {
+  TaskTraceBuffer buffer("BM_TaskTraceBufferRecord");
+  TaskTrace trace;
+  trace.function_name = __func__;
+  trace.file_name = __FILE__;
+  trace.line_number = __LINE__;
+  for (auto _ : state) {
+    trace.ready_us = TaskTracer::NowUs();
+    trace.start_us = TaskTracer::NowUs();
+    trace.end_us = TaskTracer::NowUs();
+    buffer.Record(trace);
+  }
+}
+BENCHMARK(BM_TaskTraceBufferRecord);
+
+int main(int argc, char** argv) {
+  // Disable LOG() output from libchrome
+  logging::LoggingSettings log_settings;
+  log_settings.logging_dest = logging::LoggingDestination::LOG_NONE;
+  CHECK(logging::InitLogging(log_settings)) << "Failed to set up logging";
+  ::benchmark::Initialize(&argc, argv);
+  if (::benchmark::ReportUnrecognizedArguments(argc, argv)) {
+    return 1;
+  }
+  ::benchmark::RunSpecifiedBenchmarks();
+}
@@ -40,7 +40,8 @@ MessageLoopThread::MessageLoopThread(const std::string& thread_name)
       thread_id_(-1),
       linux_tid_(-1),
       weak_ptr_factory_(this),
-      shutting_down_(false) {}
+      shutting_down_(false),
+      trace_buffer_(thread_name) {}
 
 MessageLoopThread::~MessageLoopThread() { ShutDown(); }
 
@@ -75,6 +76,16 @@ bool MessageLoopThread::DoInThreadDelayed(const base::Location& from_here,
                << ", from " << from_here.ToString();
     return false;
   }
+  if (TaskTracer::IsEnabled()) {
+    TaskTrace trace;
+    trace.function_name = from_here.function_name();
+    trace.file_name = from_here.file_name();
+    trace.line_number = from_here.line_number();
+    trace.program_counter = from_here.program_counter();
+    trace.ready_us = TaskTracer::NowUs() + delay.InMicroseconds();
+    task = base::BindOnce(&MessageLoopThread::RunTracedTask, &trace_buffer_,
+                          trace, std::move(task));
+  }
   if (!message_loop_->task_runner()->PostDelayedTask(from_here, std::move(task),
                                                      delay)) {
     LOG(ERROR) << __func__
@@ -200,6 +211,15 @@ void MessageLoopThread::Run(std::promise<void> start_up_promise) {
   }
 }
 
+// Non API method, runs on the thread itself
+void MessageLoopThread::RunTracedTask(TaskTraceBuffer* trace_buffer,
+                                      TaskTrace trace, base::OnceClosure task) {
+  trace.start_us = TaskTracer::NowUs();
+  std::move(task).Run();
+  trace.end_us = TaskTracer::NowUs();
+  trace_buffer->Record(trace);
+}
+
 void MessageLoopThread::Post(base::OnceClosure closure) {
   DoInThread(FROM_HERE, std::move(closure));
 }
@@ -29,6 +29,7 @@
 #include "abstract_message_loop.h"
 #include "gd/common/contextual_callback.h"
 #include "gd/common/i_postable_context.h"
+#include "gd/common/task_tracer.h"
 
 namespace bluetooth {
 
@@ -234,6 +235,16 @@ class MessageLoopThread final : public IPostableContext {
    */
   void Run(std::promise<void> start_up_promise);
 
+  /**
+   * Run a task posted while task tracing was enabled, and record it
+   *
+   * @param trace_buffer the task trace buffer of this thread
+   * @param trace the post site and ready time of the task
+   * @param task the posted task
+   */
+  static void RunTracedTask(TaskTraceBuffer* trace_buffer, TaskTrace trace,
+                            base::OnceClosure task);
+
   mutable std::recursive_mutex api_mutex_;
   const std::string thread_name_;
   btbase::AbstractMessageLoop* message_loop_;
@@ -244,6 +255,7 @@ class MessageLoopThread final : public IPostableContext {
   pid_t linux_tid_;
   base::WeakPtrFactory<MessageLoopThread> weak_ptr_factory_;
   bool shutting_down_;
+  TaskTraceBuffer trace_buffer_;
 };
 
 inline std::ostream& operator<<(std::ostream& os,
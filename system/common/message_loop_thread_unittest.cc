@@ -22,6 +22,7 @@
 #include <gtest/gtest.h>
 
 #include <base/functional/bind.h>
+#include <base/functional/callback_helpers.h>
 #include <base/threading/platform_thread.h>
 #include <sys/capability.h>
 #include <syscall.h>
@@ -346,3 +347,27 @@ TEST_F(MessageLoopThreadTest, test_post_twice) {
   message_loop_thread.ShutDown();
   ASSERT_EQ(counter, 2);
 }
+
+// Verify that only tasks posted with task tracing enabled are recorded
+TEST_F(MessageLoopThreadTest, test_task_tracing) {
+  using bluetooth::common::TaskTrace;
+  using bluetooth::common::TaskTraceBuffer;
+  using bluetooth::common::TaskTracer;
+
+  std::string name = "test_task_tracing_thread";
+  MessageLoopThread message_loop_thread(name);
+  message_loop_thread.StartUp();
+
+  message_loop_thread.DoInThread(FROM_HERE, base::DoNothing());
+  TaskTracer::SetEnabled(true);
+  message_loop_thread.DoInThread(FROM_HERE, base::DoNothing());
+  TaskTracer::SetEnabled(false);
+  message_loop_thread.ShutDown();
+
+  std::vector<TaskTrace> tasks;
+  TaskTracer::ForEachBuffer([&name, &tasks](const TaskTraceBuffer& buffer) {
+    if (buffer.GetName() == name) tasks = buffer.GetRecentTasks();
+  });
+  ASSERT_EQ(tasks.size(), 1u);
+  ASSERT_GE(tasks[0].end_us, tasks[0].start_us);
+}
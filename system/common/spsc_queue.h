@@ -0,0 +1,122 @@
+/******************************************************************************
+ *
+ *  Copyright 2023 The Android Open Source Project
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at:
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ******************************************************************************/
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+namespace bluetooth {
+
+namespace common {
+
+/*
+ *   SpscQueue<T>
+ *
+ * - SpscQueue<T> is a bounded, lock-free ring buffer for handing items from
+ *   exactly one producer thread to exactly one consumer thread. Neither side
+ *   ever blocks: TryEnqueue() fails when the ring is full and TryDequeue()
+ *   fails when it is empty.
+ * - TryDequeue() may be called from more than one thread if the caller
+ *   serializes those calls, e.g. with a mutex.
+ * - The capacity is rounded up to the next power of two.
+ * - Length() may be called from any thread, but is only a snapshot while the
+ *   producer or consumer is running.
+ * - The queue does not own pointer items; drain it before destruction if
+ *   they need to be freed.
+ */
+template <class T>
+class SpscQueue {
+ public:
+  explicit SpscQueue(size_t capacity)
+      : slots_(RoundUpToPowerOfTwo(capacity)), mask_(slots_.size() - 1) {}
+
+  SpscQueue(const SpscQueue&) = delete;
+  SpscQueue& operator=(const SpscQueue&) = delete;
+
+  /*
+   * Producer side. Moves |item| into the queue and returns true, or returns
+   * false and leaves |item| untouched if the queue is full.
+   */
+  bool TryEnqueue(T&& item) {
+    size_t tail = tail_.load(std::memory_order_relaxed);
+    if (tail - head_.load(std::memory_order_acquire) == slots_.size()) {
+      return false;
+    }
+    slots_[tail & mask_] = std::move(item);
+    tail_.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  bool TryEnqueue(const T& item) {
+    T copy = item;
+    return TryEnqueue(std::move(copy));
+  }
+
+  /*
+   * Consumer side. Moves the oldest item into |item| and returns true, or
+   * returns false if the queue is empty.
+   */
+  bool TryDequeue(T* item) {
+    size_t head = head_.load(std::memory_order_relaxed);
+    if (head == tail_.load(std::memory_order_acquire)) {
+      return false;
+    }
+    *item = std::move(slots_[head & mask_]);
+    head_.store(head + 1, std::memory_order_release);
+    return true;
+  }
+
+  /*
+   * Returns the number of queued items
+   */
+  size_t Length() const {
+    size_t head = head_.load(std::memory_order_acquire);
+    size_t tail = tail_.load(std::memory_order_acquire);
+    return tail - head;
+  }
+
+  /*
+   * Returns the capacity of the queue, after rounding
+   */
+  size_t Capacity() const { return slots_.size(); }
+
+  /*
+   * Returns whether the queue is empty
+   */
+  bool Empty() const { return Length() == 0; }
+
+ private:
+  static size_t RoundUpToPowerOfTwo(size_t value) {
+    size_t result = 1;
+    while (result < value) result <<= 1;
+    return result;
+  }
+
+  std::vector<T> slots_;
+  const size_t mask_;
+  // Written by the consumer only.
+  alignas(64) std::atomic<size_t> head_{0};
+  // Written by the producer only.
+  alignas(64) std::atomic<size_t> tail_{0};
+};
+
+}  // namespace common
+
+}  // namespace bluetooth
@@ -0,0 +1,99 @@
+/******************************************************************************
+ *
+ *  Copyright 2023 The Android Open Source Project
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at:
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ******************************************************************************/
+#include "common/spsc_queue.h"
+
+#include <gtest/gtest.h>
+
+#include <memory>
+#include <thread>
+
+namespace testing {
+
+using bluetooth::common::SpscQueue;
+
+TEST(SpscQueueTest, TestCapacityIsRoundedUp) {
+  EXPECT_EQ(SpscQueue<int>(1).Capacity(), static_cast<size_t>(1));
+  EXPECT_EQ(SpscQueue<int>(3).Capacity(), static_cast<size_t>(4));
+  EXPECT_EQ(SpscQueue<int>(28).Capacity(), static_cast<size_t>(32));
+  EXPECT_EQ(SpscQueue<int>(64).Capacity(), static_cast<size_t>(64));
+}
+
+TEST(SpscQueueTest, TestEnqueueDequeue) {
+  SpscQueue<int> queue(4);
+  int item = 0;
+  EXPECT_TRUE(queue.Empty());
+  EXPECT_FALSE(queue.TryDequeue(&item));
+
+  for (int i = 0; i < 4; i++) {
+    EXPECT_TRUE(queue.TryEnqueue(i));
+  }
+  EXPECT_EQ(queue.Length(), static_cast<size_t>(4));
+  EXPECT_FALSE(queue.TryEnqueue(4));
+
+  EXPECT_TRUE(queue.TryDequeue(&item));
+  EXPECT_EQ(item, 0);
+  EXPECT_TRUE(queue.TryEnqueue(4));
+
+  for (int i = 1; i <= 4; i++) {
+    EXPECT_TRUE(queue.TryDequeue(&item));
+    EXPECT_EQ(item, i);
+  }
+  EXPECT_TRUE(queue.Empty());
+}
+
+TEST(SpscQueueTest, TestMoveOnlyItems) {
+  SpscQueue<std::unique_ptr<int>> queue(2);
+  EXPECT_TRUE(queue.TryEnqueue(std::make_unique<int>(1)));
+  EXPECT_TRUE(queue.TryEnqueue(std::make_unique<int>(2)));
+
+  auto rejected = std::make_unique<int>(3);
+  EXPECT_FALSE(queue.TryEnqueue(std::move(rejected)));
+  EXPECT_NE(rejected, nullptr);
+
+  std::unique_ptr<int> item;
+  EXPECT_TRUE(queue.TryDequeue(&item));
+  EXPECT_EQ(*item, 1);
+  EXPECT_TRUE(queue.TryDequeue(&item));
+  EXPECT_EQ(*item, 2);
+}
+
+TEST(SpscQueueTest, TestProducerConsumerThreads) {
+  constexpr int kNumItems = 100000;
+  SpscQueue<int> queue(16);
+
+  std::thread producer([&queue]() {
+    for (int i = 0; i < kNumItems; i++) {
+      while (!queue.TryEnqueue(i)) std::this_thread::yield();
+    }
+  });
+
+  int expected = 0;
+  while (expected < kNumItems) {
+    int item;
+    if (!queue.TryDequeue(&item)) {
+      std::this_thread::yield();
+      continue;
+    }
+    ASSERT_EQ(item, expected);
+    expected++;
+  }
+  producer.join();
+  EXPECT_TRUE(queue.Empty());
+}
+
+}  // namespace testing
@@ -0,0 +1,130 @@
+/*
+ * Copyright 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <base/logging.h>
+#include <benchmark/benchmark.h>
+
+#include <string>
+
+#include "btcore/include/module.h"
+#include "btif/include/btif_common.h"
+#include "common/init_flags.h"
+#include "device/include/device_iot_config.h"
+#include "types/raw_address.h"
+
+using ::benchmark::State;
+
+#define NUM_DEVICES 32
+
+extern module_t device_iot_config_module;
+
+static const char* kInitFlags[] = {
+    "INIT_device_iot_config_logging=true",
+    nullptr,
+};
+
+// Saves are driven explicitly through device_iot_config_flush() here.
+bt_status_t btif_transfer_context(tBTIF_CBACK* p_cback, uint16_t event,
+                                  char* p_params, int param_len,
+                                  tBTIF_COPY_CBACK* p_copy_cback) {
+  return BT_STATUS_SUCCESS;
+}
+
+static RawAddress make_address(int i) {
+  RawAddress addr = RawAddress::kEmpty;
+  addr.address[0] = 0x40;
+  addr.address[4] = (i >> 8) & 0xff;
+  addr.address[5] = i & 0xff;
+  return addr;
+}
+
+class BM_DeviceIotConfig : public ::benchmark::Fixture {
+ protected:
+  void SetUp(State& st) override {
+    ::benchmark::Fixture::SetUp(st);
+    if (st.thread_index() != 0) return;
+    bluetooth::common::InitFlags::Load(kInitFlags);
+    module_init(&device_iot_config_module);
+    for (int i = 0; i < NUM_DEVICES; i++) {
+      RawAddress addr = make_address(i);
+      DEVICE_IOT_CONFIG_ADDR_SET_STR(addr, "Name", "Benchmark Headset");
+      DEVICE_IOT_CONFIG_ADDR_SET_HEX(addr, "Manufacturer", 0x000a, 2);
+      DEVICE_IOT_CONFIG_ADDR_INT_ADD_ONE(addr, "ProfileA2dpConn");
+    }
+    device_iot_config_flush();
+  }
+
+  void TearDown(State& st) override {
+    if (st.thread_index() == 0) {
+      device_iot_config_clear();
+      module_clean_up(&device_iot_config_module);
+    }
+    ::benchmark::Fixture::TearDown(st);
+  }
+};
+
+BENCHMARK_DEFINE_F(BM_DeviceIotConfig, int_add_one)(State& state) {
+  int i = state.thread_index();
+  for (auto _ : state) {
+    RawAddress addr = make_address(i);
+    benchmark::DoNotOptimize(
+        DEVICE_IOT_CONFIG_ADDR_INT_ADD_ONE(addr, "ProfileA2dpConn"));
+    i = (i + 1) % NUM_DEVICES;
+  }
+}
+BENCHMARK_REGISTER_F(BM_DeviceIotConfig, int_add_one)->ThreadRange(1, 8);
+
+BENCHMARK_F(BM_DeviceIotConfig, set_int)(State& state) {
+  int i = 0;
+  for (auto _ : state) {
+    RawAddress addr = make_address(i % NUM_DEVICES);
+    benchmark::DoNotOptimize(
+        DEVICE_IOT_CONFIG_ADDR_SET_INT(addr, "ProfileA2dpConn", i));
+    i++;
+  }
+};
+
+BENCHMARK_F(BM_DeviceIotConfig, get_int_after_add_one)(State& state) {
+  RawAddress addr = make_address(0);
+  int value = 0;
+  for (auto _ : state) {
+    DEVICE_IOT_CONFIG_ADDR_INT_ADD_ONE(addr, "ProfileA2dpConn");
+    benchmark::DoNotOptimize(
+        DEVICE_IOT_CONFIG_ADDR_GET_INT(addr, "ProfileA2dpConn", value));
+  }
+};
+
+BENCHMARK_F(BM_DeviceIotConfig, flush_after_add_one)(State& state) {
+  int i = 0;
+  for (auto _ : state) {
+    RawAddress addr = make_address(i);
+    DEVICE_IOT_CONFIG_ADDR_INT_ADD_ONE(addr, "ProfileA2dpConn");
+    device_iot_config_flush();
+    i = (i + 1) % NUM_DEVICES;
+  }
+};
+
+int main(int argc, char** argv) {
+  // Disable LOG() output from libchrome
+  logging::LoggingSettings log_settings;
+  log_settings.logging_dest = logging::LoggingDestination::LOG_NONE;
+  CHECK(logging::InitLogging(log_settings)) << "Failed to set up logging";
+  ::benchmark::Initialize(&argc, argv);
+  if (::benchmark::ReportUnrecognizedArguments(argc, argv)) {
+    return 1;
+  }
+  ::benchmark::RunSpecifiedBenchmarks();
+}
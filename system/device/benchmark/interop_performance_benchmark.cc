@@ -0,0 +1,120 @@
+/*
+ * Copyright 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <base/logging.h>
+#include <benchmark/benchmark.h>
+
+#include <string>
+
+#include "btcore/include/module.h"
+#include "device/include/interop.h"
+#include "device/include/interop_config.h"
+#include "types/raw_address.h"
+
+using ::benchmark::State;
+
+#define NUM_ENTRIES_PER_FEATURE 256
+
+extern const module_t interop_module;
+
+static const interop_feature_t kFeatures[] = {
+    INTEROP_DISABLE_LE_SECURE_CONNECTIONS,
+    INTEROP_AUTO_RETRY_PAIRING,
+    INTEROP_DISABLE_ABSOLUTE_VOLUME,
+    INTEROP_DISABLE_AUTO_PAIRING,
+    INTEROP_DISABLE_SNIFF,
+    INTEROP_AVRCP_1_4_ONLY,
+};
+
+static RawAddress make_address(int i) {
+  RawAddress addr = RawAddress::kEmpty;
+  addr.address[0] = 0x40 | ((i >> 8) & 0x0f);
+  addr.address[1] = i & 0xff;
+  addr.address[2] = 0x5a;
+  addr.address[3] = 0x11;
+  addr.address[4] = 0x22;
+  addr.address[5] = 0x33;
+  return addr;
+}
+
+static std::string make_name(int i) {
+  return "Benchmark Headset " + std::to_string(i);
+}
+
+class BM_InteropPerformance : public ::benchmark::Fixture {
+ protected:
+  void SetUp(State& st) override {
+    ::benchmark::Fixture::SetUp(st);
+    module_init(&interop_module);
+    for (interop_feature_t feature : kFeatures) {
+      for (int i = 0; i < NUM_ENTRIES_PER_FEATURE; i++) {
+        RawAddress addr = make_address(i);
+        interop_database_add_addr(feature, &addr, 3);
+        interop_database_add_name(feature, make_name(i).c_str());
+      }
+    }
+  }
+
+  void TearDown(State& st) override {
+    interop_database_clear();
+    module_clean_up(&interop_module);
+    ::benchmark::Fixture::TearDown(st);
+  }
+};
+
+BENCHMARK_F(BM_InteropPerformance, match_addr_hit)(State& state) {
+  int i = 0;
+  for (auto _ : state) {
+    RawAddress addr = make_address(i);
+    benchmark::DoNotOptimize(interop_match_addr(INTEROP_DISABLE_SNIFF, &addr));
+    i = (i + 1) % NUM_ENTRIES_PER_FEATURE;
+  }
+};
+
+BENCHMARK_F(BM_InteropPerformance, match_addr_miss)(State& state) {
+  RawAddress addr;
+  RawAddress::FromString("00:11:22:33:44:55", addr);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(interop_match_addr(INTEROP_DISABLE_SNIFF, &addr));
+  }
+};
+
+BENCHMARK_F(BM_InteropPerformance, match_name_hit)(State& state) {
+  const std::string name = make_name(NUM_ENTRIES_PER_FEATURE - 1) + " Pro";
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(
+        interop_match_name(INTEROP_AVRCP_1_4_ONLY, name.c_str()));
+  }
+};
+
+BENCHMARK_F(BM_InteropPerformance, match_name_miss)(State& state) {
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(
+        interop_match_name(INTEROP_AVRCP_1_4_ONLY, "Unknown Speaker"));
+  }
+};
+
+int main(int argc, char** argv) {
+  // Disable LOG() output from libchrome
+  logging::LoggingSettings log_settings;
+  log_settings.logging_dest = logging::LoggingDestination::LOG_NONE;
+  CHECK(logging::InitLogging(log_settings)) << "Failed to set up logging";
+  ::benchmark::Initialize(&argc, argv);
+  if (::benchmark::ReportUnrecognizedArguments(argc, argv)) {
+    return 1;
+  }
+  ::benchmark::RunSpecifiedBenchmarks();
+}
@@ -60,6 +60,7 @@ bool device_iot_config_has_section(const std::string& section) {
   CHECK(config != NULL);
 
   std::unique_lock<std::mutex> lock(config_lock);
+  device_iot_config_fold_counters();
   return config_has_section(*config, section);
 }
 
@@ -70,6 +71,7 @@ bool device_iot_config_exist(const std::string& section,
   CHECK(config != NULL);
 
   std::unique_lock<std::mutex> lock(config_lock);
+  device_iot_config_fold_counters();
   return config_has_key(*config, section, key);
 }
 
@@ -80,6 +82,7 @@ bool device_iot_config_get_int(const std::string& section,
   CHECK(config != NULL);
 
   std::unique_lock<std::mutex> lock(config_lock);
+  device_iot_config_fold_counters();
   bool ret = config_has_key(*config, section, key);
   if (ret) value = config_get_int(*config, section, key, value);
 
@@ -93,6 +96,7 @@ bool device_iot_config_set_int(const std::string& section,
   CHECK(config != NULL);
 
   std::unique_lock<std::mutex> lock(config_lock);
+  device_iot_config_fold_counters();
   char value_str[32] = {0};
   snprintf(value_str, sizeof(value_str), "%d", value);
   if (device_iot_config_has_key_value(section, key, value_str)) return true;
@@ -109,16 +113,10 @@ bool device_iot_config_int_add_one(const std::string& section,
 
   CHECK(config != NULL);
 
-  int result = 0;
-  std::unique_lock<std::mutex> lock(config_lock);
-  result = config_get_int(*config, section, key, result);
-  if (result >= 0) {
-    result += 1;
-  } else {
-    result = 0;
+  if (device_iot_config_counter_increment(section, key)) {
+    std::unique_lock<std::mutex> lock(config_lock);
+    device_iot_config_save_async();
   }
-  config_set_int(config.get(), section, key, result);
-  device_iot_config_save_async();
 
   return true;
 }
@@ -130,6 +128,7 @@ bool device_iot_config_get_hex(const std::string& section,
   CHECK(config != NULL);
 
   std::unique_lock<std::mutex> lock(config_lock);
+  device_iot_config_fold_counters();
   const std::string* stored_value =
       config_get_string(*config, section, key, NULL);
   if (!stored_value) return false;
@@ -163,6 +162,7 @@ bool device_iot_config_set_hex(const std::string& section,
     snprintf(value_str, sizeof(value_str), "%08x", value);
 
   std::unique_lock<std::mutex> lock(config_lock);
+  device_iot_config_fold_counters();
   if (device_iot_config_has_key_value(section, key, value_str)) return true;
 
   config_set_string(config.get(), section, key, value_str);
@@ -193,6 +193,7 @@ bool device_iot_config_get_str(const std::string& section,
   CHECK(size_bytes != NULL);
 
   std::unique_lock<std::mutex> lock(config_lock);
+  device_iot_config_fold_counters();
   const std::string* stored_value =
       config_get_string(*config, section, key, NULL);
 
@@ -212,6 +213,7 @@ bool device_iot_config_set_str(const std::string& section,
   CHECK(config != NULL);
 
   std::unique_lock<std::mutex> lock(config_lock);
+  device_iot_config_fold_counters();
   if (device_iot_config_has_key_value(section, key, value)) return true;
 
   config_set_string(config.get(), section, key, value);
@@ -230,6 +232,7 @@ bool device_iot_config_get_bin(const std::string& section,
   CHECK(length != NULL);
 
   std::unique_lock<std::mutex> lock(config_lock);
+  device_iot_config_fold_counters();
   const std::string* value_string =
       config_get_string(*config, section, key, NULL);
 
@@ -262,6 +265,7 @@ size_t device_iot_config_get_bin_length(const std::string& section,
   CHECK(config != NULL);
 
   std::unique_lock<std::mutex> lock(config_lock);
+  device_iot_config_fold_counters();
   const std::string* value_str = config_get_string(*config, section, key, NULL);
 
   if (!value_str) return 0;
@@ -294,6 +298,7 @@ bool device_iot_config_set_bin(const std::string& section,
   }
 
   std::unique_lock<std::mutex> lock(config_lock);
+  device_iot_config_fold_counters();
   if (device_iot_config_has_key_value(section, key, str)) {
     osi_free(str);
     return true;
@@ -313,6 +318,7 @@ bool device_iot_config_remove(const std::string& section,
   CHECK(config != NULL);
 
   std::unique_lock<std::mutex> lock(config_lock);
+  device_iot_config_fold_counters();
   return config_remove_key(config.get(), section, key);
 }
 
@@ -339,6 +345,7 @@ bool device_iot_config_clear(void) {
   alarm_cancel(config_timer);
 
   std::unique_lock<std::mutex> lock(config_lock);
+  device_iot_config_discard_counters();
   config.reset();
 
   config = config_new_empty();
@@ -356,6 +363,12 @@ void device_debug_iot_config_dump(int fd) {
 
   dprintf(fd, "\nBluetooth Iot Config:\n");
 
+  // Counters incremented so far belong to the config being reported on
+  if (config != NULL) {
+    std::unique_lock<std::mutex> lock(config_lock);
+    device_iot_config_fold_counters();
+  }
+
   dprintf(fd, "  Config Source: ");
   switch (device_iot_config_source) {
     case NOT_LOADED:
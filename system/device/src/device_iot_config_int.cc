@@ -27,8 +27,13 @@
 #include <time.h>
 #include <unistd.h>
 
+#include <atomic>
+#include <climits>
+#include <memory>
 #include <mutex>
 #include <string>
+#include <unordered_map>
+#include <vector>
 
 #include "btcore/include/module.h"
 #include "btif/include/btif_api.h"
@@ -54,6 +59,49 @@ extern alarm_t* config_timer;
 
 using bluetooth::common::InitFlags;
 
+// Pending counter increments of one thread, keyed by section and then key.
+// This is not lock-free: |lock| is taken on every increment, but it is only
+// contended while a fold drains the buffer, so incrementing a counter never
+// waits on |config_lock| or on file I/O.
+struct iot_counter_buffer_t {
+  std::mutex lock;
+  std::unordered_map<std::string, std::unordered_map<std::string, int>>
+      increments;
+};
+
+// Buffers of every thread that ever incremented a counter. A buffer whose
+// thread has exited is dropped by the next fold once it has been drained.
+static std::mutex counter_buffers_lock;
+static std::vector<std::shared_ptr<iot_counter_buffer_t>> counter_buffers;
+static std::atomic<bool> counters_pending(false);
+
+static iot_counter_buffer_t& counter_buffer_for_thread() {
+  thread_local std::shared_ptr<iot_counter_buffer_t> buffer;
+  if (!buffer) {
+    buffer = std::make_shared<iot_counter_buffer_t>();
+    std::unique_lock<std::mutex> lock(counter_buffers_lock);
+    counter_buffers.push_back(buffer);
+  }
+  return *buffer;
+}
+
+// Same result as adding one |count| times: a negative value restarts at 0
+// and INT_MAX wraps around to INT_MIN.
+static int counter_apply_increments(int value, int count) {
+  while (count > 0) {
+    if (value < 0) {
+      value = 0;
+      count--;
+      continue;
+    }
+    int headroom = INT_MAX - value;
+    if (count <= headroom) return value + count;
+    count -= headroom + 1;
+    value = INT_MIN;
+  }
+  return value;
+}
+
 static void cleanup() {
   alarm_free(config_timer);
   config_timer = NULL;
@@ -179,6 +227,7 @@ future_t* device_iot_config_module_clean_up(void) {
   config_timer = NULL;
 
   std::unique_lock<std::mutex> lock(config_lock);
+  device_iot_config_discard_counters();
   config.reset();
   config = NULL;
   return future_new_immediate(FUTURE_SUCCESS);
@@ -199,6 +248,7 @@ void device_iot_config_write(uint16_t event, UNUSED_ATTR char* p_param) {
 
   LOG_INFO("evt=%d", event);
   std::unique_lock<std::mutex> lock(config_lock);
+  device_iot_config_fold_counters();
   if (event == IOT_CONFIG_SAVE_TIMER_FIRED_EVT) {
     device_iot_config_set_modified_time();
   }
@@ -237,10 +287,63 @@ void device_iot_config_save_async(void) {
   CHECK(config_timer != NULL);
 
   LOG_VERBOSE("");
+  // Changes made while a save is pending ride along with it, so a steady
+  // stream of updates neither postpones the save nor writes more than once
+  // per settle period.
+  if (alarm_is_scheduled(config_timer)) return;
   alarm_set(config_timer, CONFIG_SETTLE_PERIOD_MS,
             device_iot_config_timer_save_cb, NULL);
 }
 
+bool device_iot_config_counter_increment(const std::string& section,
+                                         const std::string& key) {
+  iot_counter_buffer_t& buffer = counter_buffer_for_thread();
+  {
+    std::unique_lock<std::mutex> lock(buffer.lock);
+    int& count = buffer.increments[section][key];
+    if (count < INT_MAX) count++;
+  }
+  return !counters_pending.exchange(true);
+}
+
+void device_iot_config_fold_counters(void) {
+  // Cleared before draining so that an increment racing with this fold
+  // schedules a save of its own.
+  counters_pending.store(false);
+
+  std::unique_lock<std::mutex> buffers_lock(counter_buffers_lock);
+  auto it = counter_buffers.begin();
+  while (it != counter_buffers.end()) {
+    {
+      std::unique_lock<std::mutex> lock((*it)->lock);
+      for (const auto& section : (*it)->increments) {
+        for (const auto& key : section.second) {
+          int value = config_get_int(*config, section.first, key.first, 0);
+          config_set_int(config.get(), section.first, key.first,
+                         counter_apply_increments(value, key.second));
+        }
+      }
+      (*it)->increments.clear();
+    }
+
+    if (it->use_count() == 1) {
+      it = counter_buffers.erase(it);
+    } else {
+      ++it;
+    }
+  }
+}
+
+void device_iot_config_discard_counters(void) {
+  counters_pending.store(false);
+
+  std::unique_lock<std::mutex> buffers_lock(counter_buffers_lock);
+  for (auto& buffer : counter_buffers) {
+    std::unique_lock<std::mutex> lock(buffer->lock);
+    buffer->increments.clear();
+  }
+}
+
 int device_iot_config_get_device_num(const config_t& conf) {
   if (!InitFlags::IsDeviceIotConfigLoggingEnabled()) return 0;
 
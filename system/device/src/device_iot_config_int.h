@@ -80,6 +80,13 @@ future_t* device_iot_config_module_shut_down(void);
 future_t* device_iot_config_module_clean_up(void);
 void device_iot_config_write(uint16_t event, char* p_param);
 
+// Counter increments are accumulated per thread and only folded into |config|
+// when it is read, written or saved. config_lock must not be held by the
+// caller. Returns true when this is the first increment since the last fold,
+// in which case the caller is responsible for scheduling a save.
+bool device_iot_config_counter_increment(const std::string& section,
+                                         const std::string& key);
+
 // config_lock is used by the caller of the following methods
 void device_iot_config_sections_sort_by_entry_key(config_t& config,
                                                   compare_func comp);
@@ -87,6 +94,8 @@ bool device_iot_config_has_key_value(const std::string& section,
                                      const std::string& key,
                                      const std::string& value_str);
 void device_iot_config_save_async(void);
+void device_iot_config_fold_counters(void);
+void device_iot_config_discard_counters(void);
 int device_iot_config_get_device_num(const config_t& config);
 void device_iot_config_restrict_device_num(config_t& config);
 bool device_iot_config_compare_key(const entry_t& first, const entry_t& second);
@@ -34,8 +34,12 @@
 
 #include <iostream>
 #include <map>
+#include <memory>
 #include <string>
+#include <unordered_map>
+#include <unordered_set>
 #include <utility>
+#include <vector>
 
 #include "btcore/include/module.h"
 #include "btif/include/btif_storage.h"
@@ -186,6 +190,35 @@ typedef struct {
 
 } interop_db_entry_t;
 
+typedef struct {
+  std::map<char, size_t> children;
+  bool is_terminal;
+} interop_name_trie_node_t;
+
+// Immutable, indexed view of |interop_list| serving the
+// interop_database_match_* lookups. A new snapshot is built whenever the list
+// changes and published with an atomic pointer swap, so lookups neither take
+// |interop_list_lock| nor scan the list. A reader holding an older snapshot
+// keeps it alive until it is done with it.
+typedef struct {
+  // Address prefixes keyed by feature, prefix length and prefix bytes, and
+  // the set of prefix lengths (as a bitmask) in use for each feature.
+  std::unordered_set<uint64_t> addrs;
+  std::unordered_map<int, uint8_t> addr_lengths;
+  // Only static address ranges are matched.
+  std::unordered_map<int, std::vector<interop_addr_range_entry_t>> addr_ranges;
+  // One trie of lower-cased name prefixes per feature, rooted at index 0.
+  std::unordered_map<int, std::vector<interop_name_trie_node_t>> names;
+  std::unordered_set<uint64_t> manufacturers;
+  std::unordered_set<uint64_t> vndr_prdts;
+  std::unordered_set<uint64_t> versions;
+  // Keyed by feature and OUI.
+  std::unordered_map<uint64_t, uint16_t> ssr_max_lats;
+  std::unordered_map<uint64_t, std::pair<uint8_t, uint16_t>> lmp_versions;
+} interop_index_t;
+
+static std::shared_ptr<const interop_index_t> interop_index;
+
 static const char* interop_feature_string_(const interop_feature_t feature);
 static void interop_free_entry_(void* data);
 static void interop_lazy_init_(void);
@@ -203,6 +236,7 @@ static bool interop_database_remove_(interop_db_entry_t* entry);
 static bool interop_database_match(interop_db_entry_t* entry,
                                    interop_db_entry_t** ret_entry,
                                    interop_entry_type entry_type);
+static void interop_index_rebuild(void);
 static void interop_config_flush(void);
 static bool interop_config_remove(const std::string& section,
                                   const std::string& key);
@@ -300,11 +334,14 @@ static future_t* interop_init(void) {
 
   interop_lazy_init_();
   interop_is_initialized = true;
+  interop_index_rebuild();
   return future_new_immediate(FUTURE_SUCCESS);
 }
 
 static future_t* interop_clean_up(void) {
   pthread_mutex_lock(&interop_list_lock);
+  std::atomic_store(&interop_index,
+                    std::shared_ptr<const interop_index_t>());
   list_free(interop_list);
   interop_list = NULL;
   list_free(media_player_list);
@@ -637,6 +674,9 @@ static void interop_database_add_(interop_db_entry_t* db_entry, bool persist) {
 
   pthread_mutex_unlock(&interop_list_lock);
 
+  // Entries loaded from the config files are indexed once loading completes.
+  if (interop_is_initialized) interop_index_rebuild();
+
   if (!persist) {
     // return if the persist option is not set
     return;
@@ -778,6 +818,162 @@ static bool interop_database_match(interop_db_entry_t* entry,
   return found;
 }
 
+static uint64_t interop_addr_key(int feature, const RawAddress& addr,
+                                 size_t length) {
+  uint64_t prefix = 0;
+  for (size_t i = 0; i < length; i++) prefix = (prefix << 8) | addr.address[i];
+  return ((uint64_t)feature << 51) | ((uint64_t)length << 48) | prefix;
+}
+
+static uint64_t interop_oui_key(int feature, const RawAddress& addr) {
+  return ((uint64_t)feature << 24) | (addr.address[0] << 16) |
+         (addr.address[1] << 8) | addr.address[2];
+}
+
+static void interop_name_trie_add(std::vector<interop_name_trie_node_t>& trie,
+                                  const char* name) {
+  if (trie.empty()) trie.emplace_back();
+
+  size_t node = 0;
+  for (const char* c = name; *c != '\0'; c++) {
+    char lower = tolower(*c);
+    auto it = trie[node].children.find(lower);
+    if (it != trie[node].children.end()) {
+      node = it->second;
+      continue;
+    }
+    size_t child = trie.size();
+    trie[node].children[lower] = child;
+    trie.emplace_back();
+    node = child;
+  }
+  trie[node].is_terminal = true;
+}
+
+// Returns true if any name in |trie| is a case insensitive prefix of |name|.
+static bool interop_name_trie_match(
+    const std::vector<interop_name_trie_node_t>& trie, const char* name) {
+  size_t node = 0;
+  for (const char* c = name; !trie[node].is_terminal; c++) {
+    if (*c == '\0') return false;
+    auto it = trie[node].children.find(tolower(*c));
+    if (it == trie[node].children.end()) return false;
+    node = it->second;
+  }
+  return true;
+}
+
+// Must be called with |interop_list_lock| held
+static std::shared_ptr<const interop_index_t> interop_index_build(void) {
+  auto index = std::make_shared<interop_index_t>();
+
+  for (const list_node_t* node = list_begin(interop_list);
+       node != list_end(interop_list); node = list_next(node)) {
+    const interop_db_entry_t* db_entry =
+        (const interop_db_entry_t*)list_node(node);
+
+    switch (db_entry->bl_type) {
+      case INTEROP_BL_TYPE_ADDR: {
+        const interop_addr_entry_t* cur = &db_entry->entry_type.addr_entry;
+        index->addrs.insert(
+            interop_addr_key(cur->feature, cur->addr, cur->length));
+        index->addr_lengths[cur->feature] |= 1 << cur->length;
+        break;
+      }
+      case INTEROP_BL_TYPE_NAME: {
+        const interop_name_entry_t* cur = &db_entry->entry_type.name_entry;
+        interop_name_trie_add(index->names[cur->feature], cur->name);
+        break;
+      }
+      case INTEROP_BL_TYPE_MANUFACTURE: {
+        const interop_manufacturer_t* cur = &db_entry->entry_type.mnfr_entry;
+        index->manufacturers.insert(((uint64_t)cur->feature << 16) |
+                                    cur->manufacturer);
+        break;
+      }
+      case INTEROP_BL_TYPE_VNDR_PRDT: {
+        const interop_hid_multitouch_t* cur =
+            &db_entry->entry_type.vnr_pdt_entry;
+        index->vndr_prdts.insert(((uint64_t)cur->feature << 32) |
+                                 ((uint64_t)cur->vendor_id << 16) |
+                                 cur->product_id);
+        break;
+      }
+      case INTEROP_BL_TYPE_SSR_MAX_LAT: {
+        const interop_hid_ssr_max_lat_t* cur =
+            &db_entry->entry_type.ssr_max_lat_entry;
+        // The first entry wins, as it did with the list scan.
+        index->ssr_max_lats.emplace(interop_oui_key(cur->feature, cur->addr),
+                                    cur->max_lat);
+        break;
+      }
+      case INTEROP_BL_TYPE_VERSION: {
+        const interop_version_t* cur = &db_entry->entry_type.version_entry;
+        index->versions.insert(((uint64_t)cur->feature << 16) | cur->version);
+        break;
+      }
+      case INTEROP_BL_TYPE_LMP_VERSION: {
+        const interop_lmp_version_t* cur =
+            &db_entry->entry_type.lmp_version_entry;
+        index->lmp_versions.emplace(
+            interop_oui_key(cur->feature, cur->addr),
+            std::make_pair(cur->lmp_ver, cur->lmp_sub_ver));
+        break;
+      }
+      case INTEROP_BL_TYPE_ADDR_RANGE: {
+        if (db_entry->bl_entry_type != INTEROP_ENTRY_TYPE_STATIC) break;
+        const interop_addr_range_entry_t* cur =
+            &db_entry->entry_type.addr_range_entry;
+        index->addr_ranges[cur->feature].push_back(*cur);
+        break;
+      }
+      default:
+        LOG_ERROR("bl_type: %d not handled", db_entry->bl_type);
+        break;
+    }
+  }
+
+  return index;
+}
+
+// Rebuilds the lookup snapshot from |interop_list| and publishes it. Only
+// called when the list changes, never on the lookup path.
+static void interop_index_rebuild(void) {
+  pthread_mutex_lock(&interop_list_lock);
+  std::shared_ptr<const interop_index_t> index;
+  if (interop_list) index = interop_index_build();
+  std::atomic_store(&interop_index, index);
+  pthread_mutex_unlock(&interop_list_lock);
+}
+
+static std::shared_ptr<const interop_index_t> interop_index_get(void) {
+  return std::atomic_load(&interop_index);
+}
+
+static bool interop_index_match_addr(const interop_index_t& index,
+                                     int feature, const RawAddress& addr) {
+  auto lengths = index.addr_lengths.find(feature);
+  if (lengths == index.addr_lengths.end()) return false;
+
+  for (size_t length = 1; length <= sizeof(RawAddress); length++) {
+    if (!(lengths->second & (1 << length))) continue;
+    if (index.addrs.count(interop_addr_key(feature, addr, length))) return true;
+  }
+  return false;
+}
+
+static bool interop_index_match_addr_range(const interop_index_t& index,
+                                           int feature,
+                                           const RawAddress& addr) {
+  auto ranges = index.addr_ranges.find(feature);
+  if (ranges == index.addr_ranges.end()) return false;
+
+  for (const interop_addr_range_entry_t& range : ranges->second) {
+    if (addr >= range.addr_start && addr <= range.addr_end) return true;
+  }
+  return false;
+}
+
 static bool interop_database_remove_(interop_db_entry_t* entry) {
   interop_db_entry_t* ret_entry = NULL;
 
@@ -792,6 +988,7 @@ static bool interop_database_remove_(interop_db_entry_t* entry) {
   pthread_mutex_lock(&interop_list_lock);
   list_remove(interop_list, (void*)ret_entry);
   pthread_mutex_unlock(&interop_list_lock);
+  interop_index_rebuild();
 
   return interop_config_add_or_remove(entry, false);
 }
@@ -1292,16 +1489,10 @@ void interop_database_add_addr_lmp_version(const interop_feature_t feature,
 
 bool interop_database_match_manufacturer(const interop_feature_t feature,
                                          uint16_t manufacturer) {
-  interop_db_entry_t entry;
+  std::shared_ptr<const interop_index_t> index = interop_index_get();
+  if (!index) return false;
 
-  entry.bl_type = INTEROP_BL_TYPE_MANUFACTURE;
-  entry.entry_type.mnfr_entry.feature = feature;
-  entry.entry_type.mnfr_entry.manufacturer = manufacturer;
-
-  if (interop_database_match(
-          &entry, NULL,
-          (interop_entry_type)(INTEROP_ENTRY_TYPE_STATIC |
-                               INTEROP_ENTRY_TYPE_DYNAMIC))) {
+  if (index->manufacturers.count(((uint64_t)feature << 16) | manufacturer)) {
     LOG_WARN(
         "Device with manufacturer id: %d is a match for interop workaround %s",
         manufacturer, interop_feature_string_(feature));
@@ -1316,18 +1507,14 @@ bool interop_database_match_name(const interop_feature_t feature,
   char trim_name[KEY_MAX_LENGTH] = {'\0'};
   CHECK(name);
 
-  strlcpy(trim_name, name, KEY_MAX_LENGTH);
-  interop_db_entry_t entry;
+  std::shared_ptr<const interop_index_t> index = interop_index_get();
+  if (!index) return false;
 
-  entry.bl_type = INTEROP_BL_TYPE_NAME;
-  strlcpy(entry.entry_type.name_entry.name, trim(trim_name), KEY_MAX_LENGTH);
-  entry.entry_type.name_entry.feature = (interop_feature_t)feature;
-  entry.entry_type.name_entry.length = strlen(entry.entry_type.name_entry.name);
+  auto trie = index->names.find(feature);
+  if (trie == index->names.end()) return false;
 
-  if (interop_database_match(
-          &entry, NULL,
-          (interop_entry_type)(INTEROP_ENTRY_TYPE_STATIC |
-                               INTEROP_ENTRY_TYPE_DYNAMIC))) {
+  strlcpy(trim_name, name, KEY_MAX_LENGTH);
+  if (interop_name_trie_match(trie->second, trim(trim_name))) {
     LOG_WARN("Device with name: %s is a match for interop workaround %s", name,
              interop_feature_string_(feature));
     return true;
@@ -1340,29 +1527,16 @@ bool interop_database_match_addr(const interop_feature_t feature,
                                  const RawAddress* addr) {
   CHECK(addr);
 
-  interop_db_entry_t entry;
+  std::shared_ptr<const interop_index_t> index = interop_index_get();
+  if (!index) return false;
 
-  entry.bl_type = INTEROP_BL_TYPE_ADDR;
-  entry.entry_type.addr_entry.addr = *addr;
-  entry.entry_type.addr_entry.feature = (interop_feature_t)feature;
-  entry.entry_type.addr_entry.length = sizeof(RawAddress);
-
-  if (interop_database_match(
-          &entry, NULL,
-          (interop_entry_type)(INTEROP_ENTRY_TYPE_STATIC |
-                               INTEROP_ENTRY_TYPE_DYNAMIC))) {
+  if (interop_index_match_addr(*index, feature, *addr)) {
     LOG_WARN("Device %s is a match for interop workaround %s.",
              ADDRESS_TO_LOGGABLE_CSTR(*addr), interop_feature_string_(feature));
     return true;
   }
 
-  entry.bl_type = INTEROP_BL_TYPE_ADDR_RANGE;
-  entry.bl_entry_type = INTEROP_ENTRY_TYPE_STATIC;
-  entry.entry_type.addr_range_entry.addr_start = *addr;
-  entry.entry_type.addr_range_entry.feature = (interop_feature_t)feature;
-
-  if (interop_database_match(&entry, NULL,
-                             (interop_entry_type)(INTEROP_ENTRY_TYPE_STATIC))) {
+  if (interop_index_match_addr_range(*index, feature, *addr)) {
     LOG_WARN("Device %s is a match for interop workaround %s.",
              ADDRESS_TO_LOGGABLE_CSTR(*addr), interop_feature_string_(feature));
     return true;
@@ -1373,17 +1547,11 @@ bool interop_database_match_addr(const interop_feature_t feature,
 
 bool interop_database_match_vndr_prdt(const interop_feature_t feature,
                                       uint16_t vendor_id, uint16_t product_id) {
-  interop_db_entry_t entry;
+  std::shared_ptr<const interop_index_t> index = interop_index_get();
+  if (!index) return false;
 
-  entry.bl_type = INTEROP_BL_TYPE_VNDR_PRDT;
-
-  entry.entry_type.vnr_pdt_entry.feature = (interop_feature_t)feature;
-  entry.entry_type.vnr_pdt_entry.vendor_id = vendor_id;
-  entry.entry_type.vnr_pdt_entry.product_id = product_id;
-  if (interop_database_match(
-          &entry, NULL,
-          (interop_entry_type)(INTEROP_ENTRY_TYPE_STATIC |
-                               INTEROP_ENTRY_TYPE_DYNAMIC))) {
+  if (index->vndr_prdts.count(((uint64_t)feature << 32) |
+                              ((uint64_t)vendor_id << 16) | product_id)) {
     LOG_WARN(
         "Device with vendor_id: %d product_id: %d is a match for interop "
         "workaround %s",
@@ -1397,21 +1565,14 @@ bool interop_database_match_vndr_prdt(const interop_feature_t feature,
 bool interop_database_match_addr_get_max_lat(const interop_feature_t feature,
                                              const RawAddress* addr,
                                              uint16_t* max_lat) {
-  interop_db_entry_t entry;
-  interop_db_entry_t* ret_entry = NULL;
+  std::shared_ptr<const interop_index_t> index = interop_index_get();
+  if (!index) return false;
 
-  entry.bl_type = INTEROP_BL_TYPE_SSR_MAX_LAT;
-
-  entry.entry_type.ssr_max_lat_entry.feature = feature;
-  entry.entry_type.ssr_max_lat_entry.addr = *addr;
-  entry.entry_type.ssr_max_lat_entry.feature = feature;
-  if (interop_database_match(
-          &entry, &ret_entry,
-          (interop_entry_type)(INTEROP_ENTRY_TYPE_STATIC |
-                               INTEROP_ENTRY_TYPE_DYNAMIC))) {
+  auto it = index->ssr_max_lats.find(interop_oui_key(feature, *addr));
+  if (it != index->ssr_max_lats.end()) {
     LOG_WARN("Device %s is a match for interop workaround %s.",
              ADDRESS_TO_LOGGABLE_CSTR(*addr), interop_feature_string_(feature));
-    *max_lat = ret_entry->entry_type.ssr_max_lat_entry.max_lat;
+    *max_lat = it->second;
     return true;
   }
 
@@ -1420,16 +1581,10 @@ bool interop_database_match_addr_get_max_lat(const interop_feature_t feature,
 
 bool interop_database_match_version(const interop_feature_t feature,
                                     uint16_t version) {
-  interop_db_entry_t entry;
-
-  entry.bl_type = INTEROP_BL_TYPE_VERSION;
+  std::shared_ptr<const interop_index_t> index = interop_index_get();
+  if (!index) return false;
 
-  entry.entry_type.version_entry.feature = (interop_feature_t)feature;
-  entry.entry_type.version_entry.version = version;
-  if (interop_database_match(
-          &entry, NULL,
-          (interop_entry_type)(INTEROP_ENTRY_TYPE_STATIC |
-                               INTEROP_ENTRY_TYPE_DYNAMIC))) {
+  if (index->versions.count(((uint64_t)feature << 16) | version)) {
     LOG_WARN("Device with version: 0x%04x is a match for interop workaround %s",
              version, interop_feature_string_(feature));
     return true;
@@ -1442,22 +1597,15 @@ bool interop_database_match_addr_get_lmp_ver(const interop_feature_t feature,
                                              const RawAddress* addr,
                                              uint8_t* lmp_ver,
                                              uint16_t* lmp_sub_ver) {
-  interop_db_entry_t entry;
-  interop_db_entry_t* ret_entry = NULL;
-
-  entry.bl_type = INTEROP_BL_TYPE_LMP_VERSION;
+  std::shared_ptr<const interop_index_t> index = interop_index_get();
+  if (!index) return false;
 
-  entry.entry_type.lmp_version_entry.feature = feature;
-  entry.entry_type.lmp_version_entry.addr = *addr;
-  entry.entry_type.lmp_version_entry.feature = feature;
-  if (interop_database_match(
-          &entry, &ret_entry,
-          (interop_entry_type)(INTEROP_ENTRY_TYPE_STATIC |
-                               INTEROP_ENTRY_TYPE_DYNAMIC))) {
+  auto it = index->lmp_versions.find(interop_oui_key(feature, *addr));
+  if (it != index->lmp_versions.end()) {
     LOG_WARN("Device %s is a match for interop workaround %s.",
              ADDRESS_TO_LOGGABLE_CSTR(*addr), interop_feature_string_(feature));
-    *lmp_ver = ret_entry->entry_type.lmp_version_entry.lmp_ver;
-    *lmp_sub_ver = ret_entry->entry_type.lmp_version_entry.lmp_sub_ver;
+    *lmp_ver = it->second.first;
+    *lmp_sub_ver = it->second.second;
     return true;
   }
 
@@ -1525,6 +1673,7 @@ bool interop_database_remove_addr(const interop_feature_t feature,
 bool interop_database_remove_feature(const interop_feature_t feature) {
   if (interop_list == NULL || list_length(interop_list) == 0) return false;
 
+  bool removed = false;
   list_node_t* node = list_begin(interop_list);
   while (node != list_end(interop_list)) {
     interop_db_entry_t* entry =
@@ -1580,9 +1729,12 @@ bool interop_database_remove_feature(const interop_feature_t feature) {
       pthread_mutex_lock(&interop_list_lock);
       list_remove(interop_list, (void*)entry);
       pthread_mutex_unlock(&interop_list_lock);
+      removed = true;
     }
   }
 
+  if (removed) interop_index_rebuild();
+
   for (const section_t& sec : config_dynamic.get()->sections) {
     if (feature == interop_feature_name_to_feature_id(sec.name.c_str())) {
       LOG_WARN("found feature - %s", interop_feature_string_(feature));
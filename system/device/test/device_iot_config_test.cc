@@ -22,6 +22,11 @@
 #include <gtest/gtest.h>
 #include <sys/mman.h>
 
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+
 #include "btcore/include/module.h"
 #include "btif/include/btif_common.h"
 #include "common/init_flags.h"
@@ -763,6 +768,76 @@ TEST_F(DeviceIotConfigModuleTest, test_device_iot_config_module_shutdown) {
   test::mock::osi_alarm::alarm_is_scheduled.body = {};
 }
 
+TEST_F(DeviceIotConfigModuleTest,
+       test_device_iot_config_module_shutdown_saves_pending_counters) {
+  std::map<std::string, int> stored;
+  std::map<std::string, int> saved;
+
+  test::mock::osi_config::config_get_int.body =
+      [&](const config_t& config, const std::string& section,
+          const std::string& key, int def_value) {
+        auto it = stored.find(section + "/" + key);
+        return it == stored.end() ? def_value : it->second;
+      };
+
+  test::mock::osi_config::config_set_int.body =
+      [&](config_t* config, const std::string& section,
+          const std::string& key, int value) {
+        stored[section + "/" + key] = value;
+      };
+
+  test::mock::osi_config::config_save.body =
+      [&](const config_t& config, const std::string& filename) -> bool {
+    saved = stored;
+    return true;
+  };
+
+  device_iot_config_module_init();
+  stored.clear();
+
+  // Increments of a thread that has already exited must not be lost.
+  std::thread worker([]() {
+    for (int i = 0; i < 100; i++) {
+      device_iot_config_int_add_one("00:00:00:00:00:01", "ProfileA2dpConn");
+    }
+  });
+  worker.join();
+
+  for (int i = 0; i < 10; i++) {
+    device_iot_config_int_add_one("00:00:00:00:00:01", "ProfileA2dpConn");
+    device_iot_config_int_add_one("00:00:00:00:00:02", "ProfileHfpConn");
+  }
+
+  {
+    reset_mock_function_count_map();
+
+    device_iot_config_module_shut_down();
+
+    EXPECT_EQ(get_func_call_count("config_save"), 1);
+    EXPECT_EQ(saved["00:00:00:00:00:01/ProfileA2dpConn"], 110);
+    EXPECT_EQ(saved["00:00:00:00:00:02/ProfileHfpConn"], 10);
+  }
+
+  {
+    reset_mock_function_count_map();
+
+    // Nothing is pending any more, so a second save writes the same values.
+    device_iot_config_module_shut_down();
+
+    EXPECT_EQ(get_func_call_count("config_set_int"), 0);
+    EXPECT_EQ(saved["00:00:00:00:00:01/ProfileA2dpConn"], 110);
+    EXPECT_EQ(saved["00:00:00:00:00:02/ProfileHfpConn"], 10);
+  }
+
+  device_iot_config_module_clean_up();
+
+  test::mock::osi_config::config_get_int.body = {};
+  test::mock::osi_config::config_set_int.body = {};
+  test::mock::osi_config::config_save.body = {};
+  test::mock::osi_config::config_new.body = {};
+  test::mock::osi_config::config_new_empty.body = {};
+}
+
 TEST_F(DeviceIotConfigModuleTest, test_device_iot_config_module_clean_up) {
   bool return_value;
   std::string enable_logging_property_get_value;
@@ -1348,6 +1423,12 @@ TEST_F(DeviceIotConfigTest, test_device_iot_config_int_add_one) {
     int_value = -1;
 
     EXPECT_TRUE(device_iot_config_int_add_one(expected_section, expected_key));
+
+    EXPECT_EQ(get_func_call_count("config_get_int"), 0);
+    EXPECT_EQ(get_func_call_count("config_set_int"), 0);
+    EXPECT_EQ(get_func_call_count("alarm_set"), 1);
+
+    device_iot_config_fold_counters();
     EXPECT_EQ(actual_section, expected_section);
     EXPECT_EQ(actual_key, expected_key);
     EXPECT_EQ(get_default_value, 0);
@@ -1364,6 +1445,12 @@ TEST_F(DeviceIotConfigTest, test_device_iot_config_int_add_one) {
     int_value = 0;
 
     EXPECT_TRUE(device_iot_config_int_add_one(expected_section, expected_key));
+
+    EXPECT_EQ(get_func_call_count("config_get_int"), 0);
+    EXPECT_EQ(get_func_call_count("config_set_int"), 0);
+    EXPECT_EQ(get_func_call_count("alarm_set"), 1);
+
+    device_iot_config_fold_counters();
     EXPECT_EQ(actual_section, expected_section);
     EXPECT_EQ(actual_key, expected_key);
     EXPECT_EQ(get_default_value, 0);
@@ -1380,6 +1467,12 @@ TEST_F(DeviceIotConfigTest, test_device_iot_config_int_add_one) {
     int_value = 1;
 
     EXPECT_TRUE(device_iot_config_int_add_one(expected_section, expected_key));
+
+    EXPECT_EQ(get_func_call_count("config_get_int"), 0);
+    EXPECT_EQ(get_func_call_count("config_set_int"), 0);
+    EXPECT_EQ(get_func_call_count("alarm_set"), 1);
+
+    device_iot_config_fold_counters();
     EXPECT_EQ(actual_section, expected_section);
     EXPECT_EQ(actual_key, expected_key);
     EXPECT_EQ(get_default_value, 0);
@@ -1396,6 +1489,12 @@ TEST_F(DeviceIotConfigTest, test_device_iot_config_int_add_one) {
     int_value = INT_MAX;
 
     EXPECT_TRUE(device_iot_config_int_add_one(expected_section, expected_key));
+
+    EXPECT_EQ(get_func_call_count("config_get_int"), 0);
+    EXPECT_EQ(get_func_call_count("config_set_int"), 0);
+    EXPECT_EQ(get_func_call_count("alarm_set"), 1);
+
+    device_iot_config_fold_counters();
     EXPECT_EQ(actual_section, expected_section);
     EXPECT_EQ(actual_key, expected_key);
     EXPECT_EQ(get_default_value, 0);
@@ -1413,6 +1512,12 @@ TEST_F(DeviceIotConfigTest, test_device_iot_config_int_add_one) {
     int_value = INT_MIN;
 
     EXPECT_TRUE(device_iot_config_int_add_one(expected_section, expected_key));
+
+    EXPECT_EQ(get_func_call_count("config_get_int"), 0);
+    EXPECT_EQ(get_func_call_count("config_set_int"), 0);
+    EXPECT_EQ(get_func_call_count("alarm_set"), 1);
+
+    device_iot_config_fold_counters();
     EXPECT_EQ(actual_section, expected_section);
     EXPECT_EQ(actual_key, expected_key);
     EXPECT_EQ(get_default_value, 0);
@@ -1423,6 +1528,42 @@ TEST_F(DeviceIotConfigTest, test_device_iot_config_int_add_one) {
     EXPECT_EQ(get_func_call_count("alarm_set"), 1);
   }
 
+  {
+    reset_mock_function_count_map();
+
+    int_value = 5;
+
+    EXPECT_TRUE(device_iot_config_int_add_one(expected_section, expected_key));
+    EXPECT_TRUE(device_iot_config_int_add_one(expected_section, expected_key));
+    EXPECT_TRUE(device_iot_config_int_add_one(expected_section, expected_key));
+
+    EXPECT_EQ(get_func_call_count("config_get_int"), 0);
+    EXPECT_EQ(get_func_call_count("config_set_int"), 0);
+    EXPECT_EQ(get_func_call_count("alarm_set"), 1);
+
+    device_iot_config_fold_counters();
+    EXPECT_EQ(set_value, int_value + 3);
+
+    EXPECT_EQ(get_func_call_count("config_get_int"), 1);
+    EXPECT_EQ(get_func_call_count("config_set_int"), 1);
+    EXPECT_EQ(get_func_call_count("alarm_set"), 1);
+  }
+
+  {
+    reset_mock_function_count_map();
+
+    int_value = -7;
+
+    EXPECT_TRUE(device_iot_config_int_add_one(expected_section, expected_key));
+    EXPECT_TRUE(device_iot_config_int_add_one(expected_section, expected_key));
+
+    device_iot_config_fold_counters();
+    EXPECT_EQ(set_value, 1);
+
+    EXPECT_EQ(get_func_call_count("config_get_int"), 1);
+    EXPECT_EQ(get_func_call_count("config_set_int"), 1);
+  }
+
   test::mock::osi_config::config_get_int.body = {};
   test::mock::osi_config::config_set_int.body = {};
   test::mock::osi_alarm::alarm_set.body = {};
@@ -1457,6 +1598,12 @@ TEST_F(DeviceIotConfigTest, test_device_iot_config_addr_int_add_one) {
     int_value = -1;
 
     EXPECT_TRUE(DEVICE_IOT_CONFIG_ADDR_INT_ADD_ONE(peer_addr, expected_key));
+
+    EXPECT_EQ(get_func_call_count("config_get_int"), 0);
+    EXPECT_EQ(get_func_call_count("config_set_int"), 0);
+    EXPECT_EQ(get_func_call_count("alarm_set"), 1);
+
+    device_iot_config_fold_counters();
     EXPECT_EQ(actual_section, expected_section);
     EXPECT_EQ(actual_key, expected_key);
     EXPECT_EQ(get_default_value, 0);
@@ -1473,6 +1620,12 @@ TEST_F(DeviceIotConfigTest, test_device_iot_config_addr_int_add_one) {
     int_value = 0;
 
     EXPECT_TRUE(DEVICE_IOT_CONFIG_ADDR_INT_ADD_ONE(peer_addr, expected_key));
+
+    EXPECT_EQ(get_func_call_count("config_get_int"), 0);
+    EXPECT_EQ(get_func_call_count("config_set_int"), 0);
+    EXPECT_EQ(get_func_call_count("alarm_set"), 1);
+
+    device_iot_config_fold_counters();
     EXPECT_EQ(actual_section, expected_section);
     EXPECT_EQ(actual_key, expected_key);
     EXPECT_EQ(get_default_value, 0);
@@ -1489,6 +1642,12 @@ TEST_F(DeviceIotConfigTest, test_device_iot_config_addr_int_add_one) {
     int_value = 1;
 
     EXPECT_TRUE(DEVICE_IOT_CONFIG_ADDR_INT_ADD_ONE(peer_addr, expected_key));
+
+    EXPECT_EQ(get_func_call_count("config_get_int"), 0);
+    EXPECT_EQ(get_func_call_count("config_set_int"), 0);
+    EXPECT_EQ(get_func_call_count("alarm_set"), 1);
+
+    device_iot_config_fold_counters();
     EXPECT_EQ(actual_section, expected_section);
     EXPECT_EQ(actual_key, expected_key);
     EXPECT_EQ(get_default_value, 0);
@@ -1505,6 +1664,12 @@ TEST_F(DeviceIotConfigTest, test_device_iot_config_addr_int_add_one) {
     int_value = INT_MAX;
 
     EXPECT_TRUE(DEVICE_IOT_CONFIG_ADDR_INT_ADD_ONE(peer_addr, expected_key));
+
+    EXPECT_EQ(get_func_call_count("config_get_int"), 0);
+    EXPECT_EQ(get_func_call_count("config_set_int"), 0);
+    EXPECT_EQ(get_func_call_count("alarm_set"), 1);
+
+    device_iot_config_fold_counters();
     EXPECT_EQ(actual_section, expected_section);
     EXPECT_EQ(actual_key, expected_key);
     EXPECT_EQ(get_default_value, 0);
@@ -1522,6 +1687,12 @@ TEST_F(DeviceIotConfigTest, test_device_iot_config_addr_int_add_one) {
     int_value = INT_MIN;
 
     EXPECT_TRUE(DEVICE_IOT_CONFIG_ADDR_INT_ADD_ONE(peer_addr, expected_key));
+
+    EXPECT_EQ(get_func_call_count("config_get_int"), 0);
+    EXPECT_EQ(get_func_call_count("config_set_int"), 0);
+    EXPECT_EQ(get_func_call_count("alarm_set"), 1);
+
+    device_iot_config_fold_counters();
     EXPECT_EQ(actual_section, expected_section);
     EXPECT_EQ(actual_key, expected_key);
     EXPECT_EQ(get_default_value, 0);
@@ -2395,6 +2566,37 @@ TEST_F(DeviceIotConfigTest, test_device_iot_config_set_str) {
   test::mock::osi_alarm::alarm_set.body = {};
 }
 
+TEST_F(DeviceIotConfigTest, test_device_iot_config_set_str_folds_counters) {
+  std::string section = "00:00:00:00:00:00", key = "def";
+  std::vector<std::string> calls;
+
+  test::mock::osi_config::config_set_int.body =
+      [&](config_t* config, const std::string& section, const std::string& key,
+          int val) { calls.push_back("config_set_int"); };
+
+  test::mock::osi_config::config_set_string.body =
+      [&](config_t* config, const std::string& section, const std::string& key,
+          const std::string& value) { calls.push_back("config_set_string"); };
+
+  test::mock::osi_alarm::alarm_set.body =
+      [&](alarm_t* alarm, uint64_t interval_ms, alarm_callback_t cb,
+          void* data) {};
+
+  // The pending increment lands before the new value, not over it
+  EXPECT_TRUE(device_iot_config_int_add_one(section, key));
+  EXPECT_TRUE(device_iot_config_set_str(section, key, "name"));
+  EXPECT_EQ(calls,
+            std::vector<std::string>({"config_set_int", "config_set_string"}));
+
+  // Nothing is left to fold over it later
+  device_iot_config_fold_counters();
+  EXPECT_EQ(calls.size(), 2u);
+
+  test::mock::osi_config::config_set_int.body = {};
+  test::mock::osi_config::config_set_string.body = {};
+  test::mock::osi_alarm::alarm_set.body = {};
+}
+
 TEST_F(DeviceIotConfigTest, test_device_iot_config_addr_set_str) {
   const RawAddress peer_addr{};
   std::string actual_key, expected_key = "def";
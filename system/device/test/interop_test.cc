@@ -834,3 +834,33 @@ TEST_F(InteropTest, test_dynamic_did_version) {
 
   module_clean_up(&interop_module);
 }
+
+TEST_F(InteropTest, test_dynamic_addr_prefix_lengths) {
+  module_init(&interop_module);
+
+  RawAddress short_prefix;
+  RawAddress long_prefix;
+  RawAddress other_address;
+  RawAddress::FromString("AA:BB:00:00:00:00", short_prefix);
+  RawAddress::FromString("CC:DD:EE:FF:00:00", long_prefix);
+  RawAddress::FromString("AA:BC:00:00:00:00", other_address);
+
+  interop_database_add_addr(INTEROP_AUTO_RETRY_PAIRING, &short_prefix, 2);
+  interop_database_add_addr(INTEROP_AUTO_RETRY_PAIRING, &long_prefix, 4);
+
+  RawAddress test_address;
+  RawAddress::FromString("AA:BB:11:22:33:44", test_address);
+  EXPECT_TRUE(interop_match_addr(INTEROP_AUTO_RETRY_PAIRING, &test_address));
+  RawAddress::FromString("CC:DD:EE:FF:12:34", test_address);
+  EXPECT_TRUE(interop_match_addr(INTEROP_AUTO_RETRY_PAIRING, &test_address));
+  RawAddress::FromString("CC:DD:EE:F0:12:34", test_address);
+  EXPECT_FALSE(interop_match_addr(INTEROP_AUTO_RETRY_PAIRING, &test_address));
+  EXPECT_FALSE(interop_match_addr(INTEROP_AUTO_RETRY_PAIRING, &other_address));
+  EXPECT_FALSE(interop_match_addr(INTEROP_DISABLE_SNIFF, &short_prefix));
+
+  interop_database_remove_feature(INTEROP_AUTO_RETRY_PAIRING);
+  EXPECT_FALSE(interop_match_addr(INTEROP_AUTO_RETRY_PAIRING, &short_prefix));
+  EXPECT_FALSE(interop_match_addr(INTEROP_AUTO_RETRY_PAIRING, &long_prefix));
+
+  module_clean_up(&interop_module);
+}
@@ -0,0 +1,111 @@
+/*
+ * Copyright 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "common/task_tracer.h"
+
+#include <dlfcn.h>
+#include <stdio.h>
+
+#include <algorithm>
+#include <cinttypes>
+
+namespace bluetooth {
+namespace common {
+
+namespace {
+
+// Number of slowest recent tasks dumped per thread
+constexpr size_t kDumpedSlowTasks = 5;
+
+std::string PostSiteToString(const TaskTrace& trace) {
+  if (trace.file_name != nullptr) {
+    return std::string(trace.function_name != nullptr ? trace.function_name : "?") + "@" + trace.file_name + ":" +
+           std::to_string(trace.line_number);
+  }
+  if (trace.program_counter != nullptr) {
+    // Report the caller as an offset in its library, for llvm-symbolizer.
+    Dl_info info;
+    if (dladdr(trace.program_counter, &info) != 0 && info.dli_fname != nullptr) {
+      char offset[32];
+      snprintf(
+          offset,
+          sizeof(offset),
+          "+0x%" PRIxPTR,
+          reinterpret_cast<uintptr_t>(trace.program_counter) - reinterpret_cast<uintptr_t>(info.dli_fbase));
+      return std::string(info.dli_fname) + offset;
+    }
+    char address[32];
+    snprintf(address, sizeof(address), "%p", trace.program_counter);
+    return address;
+  }
+  return "unknown";
+}
+
+void DumpHistogram(int fd, const char* title, const TaskTraceBuffer::Histogram& histogram, uint64_t tasks) {
+  dprintf(
+      fd,
+      "    %s (us) total/max/ave: %" PRIu64 " / %" PRIu64 " / %" PRIu64 "\n",
+      title,
+      histogram.total_us,
+      histogram.max_us,
+      tasks != 0 ? histogram.total_us / tasks : 0);
+  dprintf(fd, "    %s histogram (us):", title);
+  for (size_t i = 0; i < TaskTraceBuffer::kHistogramBuckets; i++) {
+    if (i < TaskTraceBuffer::kHistogramBoundsUs.size()) {
+      dprintf(fd, " <%" PRIu64 ": %" PRIu64, TaskTraceBuffer::kHistogramBoundsUs[i], histogram.counts[i]);
+    } else {
+      dprintf(fd, " >=%" PRIu64 ": %" PRIu64 "\n", TaskTraceBuffer::kHistogramBoundsUs[i - 1], histogram.counts[i]);
+    }
+  }
+}
+
+void DumpBuffer(int fd, const TaskTraceBuffer& buffer) {
+  uint64_t tasks = buffer.GetRecordedCount();
+  dprintf(fd, "  Thread %s: %" PRIu64 " tasks\n", buffer.GetName().c_str(), tasks);
+  if (tasks == 0) return;
+
+  DumpHistogram(fd, "Queue latency", buffer.GetQueueLatencyHistogram(), tasks);
+  DumpHistogram(fd, "Run duration", buffer.GetRunDurationHistogram(), tasks);
+
+  std::vector<TaskTrace> recent = buffer.GetRecentTasks();
+  size_t dumped = std::min(kDumpedSlowTasks, recent.size());
+  std::partial_sort(
+      recent.begin(), recent.begin() + dumped, recent.end(), [](const TaskTrace& a, const TaskTrace& b) {
+        return a.QueueLatencyUs() + a.RunDurationUs() > b.QueueLatencyUs() + b.RunDurationUs();
+      });
+  dprintf(fd, "    Slowest of the last %zu tasks:\n", recent.size());
+  uint64_t now_us = TaskTracer::NowUs();
+  for (size_t i = 0; i < dumped; i++) {
+    const TaskTrace& trace = recent[i];
+    dprintf(
+        fd,
+        "      queued %" PRIu64 " us, ran %" PRIu64 " us, started %" PRIu64 " us ago, posted from %s\n",
+        trace.QueueLatencyUs(),
+        trace.RunDurationUs(),
+        now_us > trace.start_us ? now_us - trace.start_us : 0,
+        PostSiteToString(trace).c_str());
+  }
+}
+
+}  // namespace
+
+void DumpTaskTraces(int fd) {
+  dprintf(fd, "\nTask tracing: %s\n", TaskTracer::IsEnabled() ? "enabled" : "disabled");
+  TaskTracer::ForEachBuffer([fd](const TaskTraceBuffer& buffer) { DumpBuffer(fd, buffer); });
+}
+
+}  // namespace common
+}  // namespace bluetooth
@@ -0,0 +1,254 @@
+/*
+ * Copyright 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace bluetooth {
+namespace common {
+
+// Opt-in tracing of the tasks run by the stack threads (common::MessageLoopThread and os::Thread).
+//
+// Each traced thread owns a TaskTraceBuffer. The thread itself is the only writer: it records every task it runs,
+// with its post site, the time it waited in the queue and the time it ran. Records go to a fixed size ring of recent
+// tasks and to cumulative histograms, without locks or allocations, so that dumpsys can read them at any time.
+//
+// Tracing is off by default. When it is off, posting a task costs one relaxed atomic load more.
+
+// A task run by a traced thread. Times are in microseconds of the monotonic clock.
+struct TaskTrace {
+  // Post site, when the caller passed a location
+  const char* function_name = nullptr;
+  const char* file_name = nullptr;
+  int line_number = 0;
+  // Post site, when only the caller address is known
+  const void* program_counter = nullptr;
+  // When the task became runnable: the post time plus the delay, if any
+  uint64_t ready_us = 0;
+  uint64_t start_us = 0;
+  uint64_t end_us = 0;
+
+  uint64_t QueueLatencyUs() const {
+    return start_us > ready_us ? start_us - ready_us : 0;
+  }
+  uint64_t RunDurationUs() const {
+    return end_us > start_us ? end_us - start_us : 0;
+  }
+};
+
+class TaskTraceBuffer;
+
+class TaskTracer {
+ public:
+  static bool IsEnabled() {
+    return Get().enabled_.load(std::memory_order_relaxed);
+  }
+
+  static void SetEnabled(bool enabled) {
+    Get().enabled_.store(enabled, std::memory_order_relaxed);
+  }
+
+  static uint64_t NowUs() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+  }
+
+  // Calls |function| on every live buffer. Buffers cannot be destroyed meanwhile.
+  static void ForEachBuffer(const std::function<void(const TaskTraceBuffer&)>& function) {
+    TaskTracer& tracer = Get();
+    std::lock_guard<std::mutex> lock(tracer.mutex_);
+    for (const TaskTraceBuffer* buffer : tracer.buffers_) {
+      function(*buffer);
+    }
+  }
+
+ private:
+  friend class TaskTraceBuffer;
+
+  static TaskTracer& Get() {
+    static TaskTracer tracer;
+    return tracer;
+  }
+
+  std::atomic<bool> enabled_{false};
+  std::mutex mutex_;
+  std::set<const TaskTraceBuffer*> buffers_;
+};
+
+class TaskTraceBuffer {
+ public:
+  // Number of recent tasks kept
+  static constexpr size_t kCapacity = 256;
+  // Upper bounds (in us) of the histogram buckets. The last bucket counts everything above the last bound.
+  static constexpr std::array<uint64_t, 7> kHistogramBoundsUs = {100, 1000, 5000, 10000, 50000, 100000, 500000};
+  static constexpr size_t kHistogramBuckets = kHistogramBoundsUs.size() + 1;
+
+  // Cumulative statistics of a latency, in microseconds
+  struct Histogram {
+    uint64_t total_us = 0;
+    uint64_t max_us = 0;
+    std::array<uint64_t, kHistogramBuckets> counts = {};
+  };
+
+  explicit TaskTraceBuffer(std::string name) : name_(std::move(name)) {
+    TaskTracer& tracer = TaskTracer::Get();
+    std::lock_guard<std::mutex> lock(tracer.mutex_);
+    tracer.buffers_.insert(this);
+  }
+
+  ~TaskTraceBuffer() {
+    TaskTracer& tracer = TaskTracer::Get();
+    std::lock_guard<std::mutex> lock(tracer.mutex_);
+    tracer.buffers_.erase(this);
+  }
+
+  TaskTraceBuffer(const TaskTraceBuffer&) = delete;
+  TaskTraceBuffer& operator=(const TaskTraceBuffer&) = delete;
+
+  const std::string& GetName() const {
+    return name_;
+  }
+
+  // Writer side: must only be called from the thread owning this buffer.
+  void Record(const TaskTrace& trace) {
+    uint64_t index = recorded_.load(std::memory_order_relaxed);
+    Slot& slot = slots_[index % kCapacity];
+
+    // Per slot sequence lock: the sequence is odd while the slot is written, and identifies the task once written.
+    slot.sequence.store(2 * index + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    slot.function_name.store(trace.function_name, std::memory_order_relaxed);
+    slot.file_name.store(trace.file_name, std::memory_order_relaxed);
+    slot.line_number.store(trace.line_number, std::memory_order_relaxed);
+    slot.program_counter.store(trace.program_counter, std::memory_order_relaxed);
+    slot.ready_us.store(trace.ready_us, std::memory_order_relaxed);
+    slot.start_us.store(trace.start_us, std::memory_order_relaxed);
+    slot.end_us.store(trace.end_us, std::memory_order_relaxed);
+    slot.sequence.store(2 * index + 2, std::memory_order_release);
+
+    queue_latency_.Add(trace.QueueLatencyUs());
+    run_duration_.Add(trace.RunDurationUs());
+    recorded_.store(index + 1, std::memory_order_release);
+  }
+
+  // Number of tasks recorded since the buffer was created
+  uint64_t GetRecordedCount() const {
+    return recorded_.load(std::memory_order_acquire);
+  }
+
+  // The recent tasks, oldest first. Tasks overwritten while they are read are left out.
+  std::vector<TaskTrace> GetRecentTasks() const {
+    uint64_t end = recorded_.load(std::memory_order_acquire);
+    uint64_t begin = end > kCapacity ? end - kCapacity : 0;
+    std::vector<TaskTrace> tasks;
+    tasks.reserve(end - begin);
+    for (uint64_t index = begin; index < end; index++) {
+      const Slot& slot = slots_[index % kCapacity];
+      uint64_t sequence = 2 * index + 2;
+      if (slot.sequence.load(std::memory_order_acquire) != sequence) continue;
+      TaskTrace trace;
+      trace.function_name = slot.function_name.load(std::memory_order_relaxed);
+      trace.file_name = slot.file_name.load(std::memory_order_relaxed);
+      trace.line_number = slot.line_number.load(std::memory_order_relaxed);
+      trace.program_counter = slot.program_counter.load(std::memory_order_relaxed);
+      trace.ready_us = slot.ready_us.load(std::memory_order_relaxed);
+      trace.start_us = slot.start_us.load(std::memory_order_relaxed);
+      trace.end_us = slot.end_us.load(std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (slot.sequence.load(std::memory_order_relaxed) != sequence) continue;
+      tasks.push_back(trace);
+    }
+    return tasks;
+  }
+
+  Histogram GetQueueLatencyHistogram() const {
+    return queue_latency_.Get();
+  }
+
+  Histogram GetRunDurationHistogram() const {
+    return run_duration_.Get();
+  }
+
+ private:
+  struct Slot {
+    std::atomic<uint64_t> sequence{0};
+    std::atomic<const char*> function_name{nullptr};
+    std::atomic<const char*> file_name{nullptr};
+    std::atomic<int> line_number{0};
+    std::atomic<const void*> program_counter{nullptr};
+    std::atomic<uint64_t> ready_us{0};
+    std::atomic<uint64_t> start_us{0};
+    std::atomic<uint64_t> end_us{0};
+  };
+
+  // Only written by the owning thread, so the counters are updated without read-modify-write operations.
+  class AtomicHistogram {
+   public:
+    void Add(uint64_t value_us) {
+      Increment(total_us_, value_us);
+      if (value_us > max_us_.load(std::memory_order_relaxed)) {
+        max_us_.store(value_us, std::memory_order_relaxed);
+      }
+      size_t bucket = 0;
+      while (bucket < kHistogramBoundsUs.size() && value_us >= kHistogramBoundsUs[bucket]) {
+        bucket++;
+      }
+      Increment(counts_[bucket], 1);
+    }
+
+    Histogram Get() const {
+      Histogram histogram;
+      histogram.total_us = total_us_.load(std::memory_order_relaxed);
+      histogram.max_us = max_us_.load(std::memory_order_relaxed);
+      for (size_t i = 0; i < kHistogramBuckets; i++) {
+        histogram.counts[i] = counts_[i].load(std::memory_order_relaxed);
+      }
+      return histogram;
+    }
+
+   private:
+    static void Increment(std::atomic<uint64_t>& counter, uint64_t value) {
+      counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+    }
+
+    std::atomic<uint64_t> total_us_{0};
+    std::atomic<uint64_t> max_us_{0};
+    std::array<std::atomic<uint64_t>, kHistogramBuckets> counts_ = {};
+  };
+
+  const std::string name_;
+  std::array<Slot, kCapacity> slots_;
+  std::atomic<uint64_t> recorded_{0};
+  AtomicHistogram queue_latency_;
+  AtomicHistogram run_duration_;
+};
+
+// Writes the per thread task histograms and the slowest recent tasks to |fd|.
+void DumpTaskTraces(int fd);
+
+}  // namespace common
+}  // namespace bluetooth
@@ -0,0 +1,127 @@
+/*
+ * Copyright 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "common/task_tracer.h"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace testing {
+
+using bluetooth::common::TaskTrace;
+using bluetooth::common::TaskTraceBuffer;
+using bluetooth::common::TaskTracer;
+
+TaskTrace MakeTrace(uint64_t ready_us, uint64_t queue_latency_us, uint64_t run_duration_us) {
+  TaskTrace trace;
+  trace.function_name = "function";
+  trace.file_name = "file.cc";
+  trace.line_number = 42;
+  trace.ready_us = ready_us;
+  trace.start_us = ready_us + queue_latency_us;
+  trace.end_us = trace.start_us + run_duration_us;
+  return trace;
+}
+
+TEST(TaskTracerTest, disabled_by_default) {
+  ASSERT_FALSE(TaskTracer::IsEnabled());
+  TaskTracer::SetEnabled(true);
+  ASSERT_TRUE(TaskTracer::IsEnabled());
+  TaskTracer::SetEnabled(false);
+}
+
+TEST(TaskTracerTest, buffers_are_registered_while_alive) {
+  std::vector<std::string> names;
+  auto collect = [&names](const TaskTraceBuffer& buffer) { names.push_back(buffer.GetName()); };
+  {
+    TaskTraceBuffer buffer("registered");
+    TaskTracer::ForEachBuffer(collect);
+    ASSERT_EQ(std::count(names.begin(), names.end(), "registered"), 1);
+  }
+  names.clear();
+  TaskTracer::ForEachBuffer(collect);
+  ASSERT_EQ(std::count(names.begin(), names.end(), "registered"), 0);
+}
+
+TEST(TaskTracerTest, record_keeps_post_site_and_times) {
+  TaskTraceBuffer buffer("test");
+  buffer.Record(MakeTrace(1000, 20, 300));
+
+  auto tasks = buffer.GetRecentTasks();
+  ASSERT_EQ(tasks.size(), 1u);
+  ASSERT_STREQ(tasks[0].function_name, "function");
+  ASSERT_STREQ(tasks[0].file_name, "file.cc");
+  ASSERT_EQ(tasks[0].line_number, 42);
+  ASSERT_EQ(tasks[0].QueueLatencyUs(), 20u);
+  ASSERT_EQ(tasks[0].RunDurationUs(), 300u);
+}
+
+TEST(TaskTracerTest, histograms_bucket_latencies) {
+  TaskTraceBuffer buffer("test");
+  buffer.Record(MakeTrace(0, 50, 2000));
+  buffer.Record(MakeTrace(0, 50, 2000));
+  buffer.Record(MakeTrace(0, 20000, 600000));
+
+  auto queue_latency = buffer.GetQueueLatencyHistogram();
+  ASSERT_EQ(queue_latency.total_us, 20100u);
+  ASSERT_EQ(queue_latency.max_us, 20000u);
+  ASSERT_EQ(queue_latency.counts[0], 2u);  // < 100 us
+  ASSERT_EQ(queue_latency.counts[4], 1u);  // < 50 ms
+
+  auto run_duration = buffer.GetRunDurationHistogram();
+  ASSERT_EQ(run_duration.max_us, 600000u);
+  ASSERT_EQ(run_duration.counts[2], 2u);                                    // < 5 ms
+  ASSERT_EQ(run_duration.counts[TaskTraceBuffer::kHistogramBuckets - 1], 1u);  // >= 500 ms
+}
+
+TEST(TaskTracerTest, ring_keeps_most_recent_tasks) {
+  TaskTraceBuffer buffer("test");
+  uint64_t recorded = TaskTraceBuffer::kCapacity + 10;
+  for (uint64_t i = 0; i < recorded; i++) {
+    buffer.Record(MakeTrace(i, 0, 0));
+  }
+
+  ASSERT_EQ(buffer.GetRecordedCount(), recorded);
+  auto tasks = buffer.GetRecentTasks();
+  ASSERT_EQ(tasks.size(), TaskTraceBuffer::kCapacity);
+  ASSERT_EQ(tasks.front().ready_us, 10u);
+  ASSERT_EQ(tasks.back().ready_us, recorded - 1);
+  ASSERT_EQ(buffer.GetQueueLatencyHistogram().counts[0], recorded);
+}
+
+TEST(TaskTracerTest, concurrent_reads_see_consistent_tasks) {
+  TaskTraceBuffer buffer("test");
+  constexpr uint64_t kTasks = 100000;
+  std::thread writer([&buffer]() {
+    for (uint64_t i = 1; i <= kTasks; i++) {
+      // Every field is derived from the same value, so that a torn read would show.
+      buffer.Record(MakeTrace(i, i, i));
+    }
+  });
+  while (buffer.GetRecordedCount() < kTasks) {
+    for (const TaskTrace& trace : buffer.GetRecentTasks()) {
+      EXPECT_EQ(trace.QueueLatencyUs(), trace.ready_us);
+      EXPECT_EQ(trace.RunDurationUs(), trace.ready_us);
+    }
+  }
+  writer.join();
+}
+
+}  // namespace testing
@@ -17,17 +17,25 @@
 #include "hci/controller.h"
 
 #include <android-base/strings.h>
+#include <chrono>
 #include <future>
+#include <limits>
 #include <memory>
+#include <optional>
 #include <string>
+#include <type_traits>
+#include <unordered_map>
 #include <utility>
 
 #include "common/init_flags.h"
+#include "common/strings.h"
 #include "dumpsys_data_generated.h"
 #include "hci/event_checkers.h"
 #include "hci/hci_layer.h"
 #include "hci_controller_generated.h"
+#include "os/files.h"
 #include "os/metrics.h"
+#include "os/parameter_provider.h"
 #include "os/system_properties.h"
 #include "sysprops/sysprops_module.h"
 
@@ -46,12 +54,16 @@ constexpr bool kDefaultErroneousDataReportingEnabled = true;
 static const std::string kPropertyErroneousDataReportingEnabled =
     "bluetooth.hci.erroneous_data_reporting.enabled";
 
+// Bump when the controller snapshot format changes, so that older snapshots are not used
+constexpr uint64_t kControllerSnapshotVersion = 1;
+
 using os::Handler;
 
 struct Controller::impl {
   impl(Controller& module) : module_(module) {}
 
   void Start(hci::HciLayer* hci) {
+    auto start_time = std::chrono::steady_clock::now();
     hci_ = hci;
     Handler* handler = module_.GetHandler();
     hci_->RegisterEventHandler(
@@ -61,8 +73,102 @@ struct Controller::impl {
     write_le_host_support(Enable::ENABLED, Enable::DISABLED);
     hci_->EnqueueCommand(ReadLocalNameBuilder::Create(),
                          handler->BindOnceOn(this, &Controller::impl::read_local_name_complete_handler));
-    hci_->EnqueueCommand(ReadLocalVersionInformationBuilder::Create(),
-                         handler->BindOnceOn(this, &Controller::impl::read_local_version_information_complete_handler));
+
+    // The version identifies the controller firmware, wait for it before trusting the snapshot
+    std::promise<void> version_promise;
+    auto version_future = version_promise.get_future();
+    hci_->EnqueueCommand(
+        ReadLocalVersionInformationBuilder::Create(),
+        handler->BindOnceOn(
+            this, &Controller::impl::read_local_version_information_complete_handler, std::move(version_promise)));
+    version_future.wait();
+
+    // Check the snapshot was taken with this controller before any host configuration is sent from it
+    std::optional<Address> snapshot_address = load_snapshot();
+    if (snapshot_address.has_value()) {
+      read_controller_mac_address();
+      if (*snapshot_address != mac_address_) {
+        LOG_WARN("Controller snapshot was taken with another controller, reading capabilities");
+        snapshot_address.reset();
+      }
+    }
+    configure(!snapshot_address.has_value());
+    if (!snapshot_address.has_value()) {
+      save_snapshot();
+    }
+
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start_time);
+    LOG_INFO(
+        "Controller started in %lld ms (%s)",
+        static_cast<long long>(elapsed.count()),
+        snapshot_address.has_value() ? "from snapshot" : "capabilities read");
+  }
+
+  // Reads the controller capabilities unless they were restored from the snapshot, then sends the
+  // host configuration that depends on them. Returns once the controller handled every command.
+  void configure(bool read_capabilities) {
+    Handler* handler = module_.GetHandler();
+    if (read_capabilities) {
+      read_controller_capabilities();
+    }
+
+    le_set_event_mask(MaskLeEventMask(local_version_information_.hci_version_, kDefaultLeEventMask));
+
+    if (common::init_flags::set_min_encryption_is_enabled() && is_supported(OpCode::SET_MIN_ENCRYPTION_KEY_SIZE)) {
+      hci_->EnqueueCommand(
+          SetMinEncryptionKeySizeBuilder::Create(kMinEncryptionKeySize),
+          handler->BindOnceOn(this, &Controller::impl::set_min_encryption_key_size_handler));
+    }
+
+    // SSP is managed by security layer once enabled
+    write_simple_pairing_mode(Enable::ENABLED);
+    if (module_.SupportsSecureConnections()) {
+      hci_->EnqueueCommand(
+          WriteSecureConnectionsHostSupportBuilder::Create(Enable::ENABLED),
+          handler->BindOnceOn(
+              this, &Controller::impl::write_secure_connections_host_support_complete_handler));
+    }
+
+    if (is_supported(OpCode::LE_SET_HOST_FEATURE) && module_.SupportsBleConnectedIsochronousStreamCentral()) {
+      hci_->EnqueueCommand(
+          LeSetHostFeatureBuilder::Create(LeHostFeatureBits::CONNECTED_ISO_STREAM_HOST_SUPPORT, Enable::ENABLED),
+          handler->BindOnceOn(this, &Controller::impl::le_set_host_feature_handler));
+    }
+
+    if (common::init_flags::subrating_is_enabled() && is_supported(OpCode::LE_SET_HOST_FEATURE) &&
+        module_.SupportsBleConnectionSubrating()) {
+      hci_->EnqueueCommand(
+          LeSetHostFeatureBuilder::Create(
+              LeHostFeatureBits::CONNECTION_SUBRATING_HOST_SUPPORT, Enable::ENABLED),
+          handler->BindOnceOn(this, &Controller::impl::le_set_host_feature_handler));
+    }
+
+    if (os::GetSystemPropertyBool(
+            kPropertyErroneousDataReportingEnabled, kDefaultErroneousDataReportingEnabled)) {
+        if (is_supported(OpCode::READ_DEFAULT_ERRONEOUS_DATA_REPORTING)) {
+          hci_->EnqueueCommand(
+              ReadDefaultErroneousDataReportingBuilder::Create(),
+              handler->BindOnceOn(
+                  this, &Controller::impl::read_default_erroneous_data_reporting_handler));
+        }
+    }
+
+    // We only need to synchronize the last read. Make BD_ADDR to be the last one.
+    read_controller_mac_address();
+  }
+
+  void read_controller_mac_address() {
+    Handler* handler = module_.GetHandler();
+    std::promise<void> promise;
+    auto future = promise.get_future();
+    hci_->EnqueueCommand(
+        ReadBdAddrBuilder::Create(),
+        handler->BindOnceOn(this, &Controller::impl::read_controller_mac_address_handler, std::move(promise)));
+    future.wait();
+  }
+
+  void read_controller_capabilities() {
+    Handler* handler = module_.GetHandler();
     hci_->EnqueueCommand(ReadLocalSupportedCommandsBuilder::Create(),
                          handler->BindOnceOn(this, &Controller::impl::read_local_supported_commands_complete_handler));
 
@@ -78,22 +184,21 @@ struct Controller::impl {
     std::promise<void> features_promise;
     auto features_future = features_promise.get_future();
 
+    // Drop anything left by a snapshot that could not be used
+    extended_lmp_features_array_.clear();
+    iso_buffer_size_ = {};
+    local_supported_codec_ids_.clear();
+    local_supported_vendor_codec_ids_.clear();
+    vendor_capabilities_ = {};
+
     hci_->EnqueueCommand(ReadLocalExtendedFeaturesBuilder::Create(0x00),
                          handler->BindOnceOn(this, &Controller::impl::read_local_extended_features_complete_handler,
                                              std::move(features_promise)));
     features_future.wait();
 
-    le_set_event_mask(MaskLeEventMask(local_version_information_.hci_version_, kDefaultLeEventMask));
-
     hci_->EnqueueCommand(ReadBufferSizeBuilder::Create(),
                          handler->BindOnceOn(this, &Controller::impl::read_buffer_size_complete_handler));
 
-    if (common::init_flags::set_min_encryption_is_enabled() && is_supported(OpCode::SET_MIN_ENCRYPTION_KEY_SIZE)) {
-      hci_->EnqueueCommand(
-          SetMinEncryptionKeySizeBuilder::Create(kMinEncryptionKeySize),
-          handler->BindOnceOn(this, &Controller::impl::set_min_encryption_key_size_handler));
-    }
-
     if (is_supported(OpCode::LE_READ_BUFFER_SIZE_V2)) {
       hci_->EnqueueCommand(
           LeReadBufferSizeV2Builder::Create(),
@@ -134,14 +239,6 @@ struct Controller::impl {
       le_maximum_data_length_.supported_max_tx_time_ = 0;
     }
 
-    // SSP is managed by security layer once enabled
-    write_simple_pairing_mode(Enable::ENABLED);
-    if (module_.SupportsSecureConnections()) {
-      hci_->EnqueueCommand(
-          WriteSecureConnectionsHostSupportBuilder::Create(Enable::ENABLED),
-          handler->BindOnceOn(
-              this, &Controller::impl::write_secure_connections_host_support_complete_handler));
-    }
     if (is_supported(OpCode::LE_READ_SUGGESTED_DEFAULT_DATA_LENGTH) && module_.SupportsBleDataPacketLengthExtension()) {
       hci_->EnqueueCommand(
           LeReadSuggestedDefaultDataLengthBuilder::Create(),
@@ -179,47 +276,240 @@ struct Controller::impl {
       LOG_INFO("LE_READ_PERIODIC_ADVERTISER_LIST_SIZE not supported, defaulting to 0");
       le_periodic_advertiser_list_size_ = 0;
     }
-    if (is_supported(OpCode::LE_SET_HOST_FEATURE) && module_.SupportsBleConnectedIsochronousStreamCentral()) {
+
+    // Skip vendor capabilities check if configured.
+    if (vendor_capabilities_enabled()) {
       hci_->EnqueueCommand(
-          LeSetHostFeatureBuilder::Create(LeHostFeatureBits::CONNECTED_ISO_STREAM_HOST_SUPPORT, Enable::ENABLED),
-          handler->BindOnceOn(this, &Controller::impl::le_set_host_feature_handler));
+          LeGetVendorCapabilitiesBuilder::Create(),
+          handler->BindOnceOn(this, &Controller::impl::le_get_vendor_capabilities_handler));
+    } else {
+      vendor_capabilities_.is_supported_ = 0x00;
     }
+  }
 
-    if (common::init_flags::subrating_is_enabled() && is_supported(OpCode::LE_SET_HOST_FEATURE) &&
-        module_.SupportsBleConnectionSubrating()) {
-      hci_->EnqueueCommand(
-          LeSetHostFeatureBuilder::Create(
-              LeHostFeatureBits::CONNECTION_SUBRATING_HOST_SUPPORT, Enable::ENABLED),
-          handler->BindOnceOn(this, &Controller::impl::le_set_host_feature_handler));
+  // The snapshot only holds what the controller reports about itself, along with the host settings
+  // that change what is read, so it stays valid across restarts with the same controller firmware.
+  void save_snapshot() const {
+    std::string path = os::ParameterProvider::ControllerSnapshotFilePath();
+    if (path.empty()) {
+      return;
     }
 
-    if (os::GetSystemPropertyBool(
-            kPropertyErroneousDataReportingEnabled, kDefaultErroneousDataReportingEnabled)) {
-        if (is_supported(OpCode::READ_DEFAULT_ERRONEOUS_DATA_REPORTING)) {
-          hci_->EnqueueCommand(
-              ReadDefaultErroneousDataReportingBuilder::Create(),
-              handler->BindOnceOn(
-                  this, &Controller::impl::read_default_erroneous_data_reporting_handler));
+    std::string snapshot;
+    auto add = [&snapshot](const std::string& key, const std::string& value) {
+      snapshot += key + "=" + value + "\n";
+    };
+    auto add_uint = [&add](const std::string& key, uint64_t value) { add(key, common::ToString(value)); };
+
+    add_uint("snapshot_version", kControllerSnapshotVersion);
+    add("disabled_commands", os::GetSystemProperty(kPropertyDisabledCommands).value_or(""));
+    add("vendor_capabilities_enabled", common::ToString(vendor_capabilities_enabled()));
+    add_uint("hci_version", static_cast<uint64_t>(local_version_information_.hci_version_));
+    add_uint("hci_revision", local_version_information_.hci_revision_);
+    add_uint("lmp_version", static_cast<uint64_t>(local_version_information_.lmp_version_));
+    add_uint("manufacturer_name", local_version_information_.manufacturer_name_);
+    add_uint("lmp_subversion", local_version_information_.lmp_subversion_);
+    add("bd_addr", mac_address_.ToString());
+
+    add("supported_commands", common::ToHexString(local_supported_commands_.begin(), local_supported_commands_.end()));
+    std::vector<std::string> features;
+    for (uint64_t page : extended_lmp_features_array_) {
+      features.push_back(common::ToString(page));
+    }
+    add("extended_lmp_features", common::StringJoin(features, ","));
+    add_uint("acl_buffer_length", acl_buffer_length_);
+    add_uint("acl_buffers", acl_buffers_);
+    add_uint("sco_buffer_length", sco_buffer_length_);
+    add_uint("sco_buffers", sco_buffers_);
+    add_uint("le_data_packet_length", le_buffer_size_.le_data_packet_length_);
+    add_uint("total_num_le_packets", le_buffer_size_.total_num_le_packets_);
+    add_uint("iso_data_packet_length", iso_buffer_size_.le_data_packet_length_);
+    add_uint("total_num_iso_packets", iso_buffer_size_.total_num_le_packets_);
+    add("supported_codec_ids", common::ToHexString(local_supported_codec_ids_));
+    std::vector<std::string> vendor_codecs;
+    for (uint32_t codec : local_supported_vendor_codec_ids_) {
+      vendor_codecs.push_back(common::ToString(static_cast<uint64_t>(codec)));
+    }
+    add("supported_vendor_codec_ids", common::StringJoin(vendor_codecs, ","));
+    add_uint("le_local_supported_features", le_local_supported_features_);
+    add_uint("le_supported_states", le_supported_states_);
+    add_uint("le_connect_list_size", le_connect_list_size_);
+    add_uint("le_resolving_list_size", le_resolving_list_size_);
+    add_uint("supported_max_tx_octets", le_maximum_data_length_.supported_max_tx_octets_);
+    add_uint("supported_max_tx_time", le_maximum_data_length_.supported_max_tx_time_);
+    add_uint("supported_max_rx_octets", le_maximum_data_length_.supported_max_rx_octets_);
+    add_uint("supported_max_rx_time", le_maximum_data_length_.supported_max_rx_time_);
+    add_uint("le_maximum_advertising_data_length", le_maximum_advertising_data_length_);
+    add_uint("le_suggested_default_data_length", le_suggested_default_data_length_);
+    add_uint("le_number_supported_advertising_sets", le_number_supported_advertising_sets_);
+    add_uint("le_periodic_advertiser_list_size", le_periodic_advertiser_list_size_);
+    add_uint("vendor_is_supported", vendor_capabilities_.is_supported_);
+    add_uint("vendor_max_advt_instances", vendor_capabilities_.max_advt_instances_);
+    add_uint(
+        "vendor_offloaded_resolution_of_private_address",
+        vendor_capabilities_.offloaded_resolution_of_private_address_);
+    add_uint("vendor_total_scan_results_storage", vendor_capabilities_.total_scan_results_storage_);
+    add_uint("vendor_max_irk_list_sz", vendor_capabilities_.max_irk_list_sz_);
+    add_uint("vendor_filtering_support", vendor_capabilities_.filtering_support_);
+    add_uint("vendor_max_filter", vendor_capabilities_.max_filter_);
+    add_uint("vendor_activity_energy_info_support", vendor_capabilities_.activity_energy_info_support_);
+    add_uint("vendor_version_supported", vendor_capabilities_.version_supported_);
+    add_uint("vendor_total_num_of_advt_tracked", vendor_capabilities_.total_num_of_advt_tracked_);
+    add_uint("vendor_extended_scan_support", vendor_capabilities_.extended_scan_support_);
+    add_uint("vendor_debug_logging_supported", vendor_capabilities_.debug_logging_supported_);
+    add_uint(
+        "vendor_le_address_generation_offloading_support",
+        vendor_capabilities_.le_address_generation_offloading_support_);
+    add_uint(
+        "vendor_a2dp_source_offload_capability_mask", vendor_capabilities_.a2dp_source_offload_capability_mask_);
+    add_uint("vendor_bluetooth_quality_report_support", vendor_capabilities_.bluetooth_quality_report_support_);
+
+    if (!os::WriteToFile(path, snapshot)) {
+      LOG_WARN("Unable to write controller snapshot to %s", path.c_str());
+    }
+  }
+
+  // Restores the controller capabilities from the snapshot if it was taken with the same host
+  // settings and controller firmware. Returns the address of the controller it was taken with.
+  std::optional<Address> load_snapshot() {
+    std::string path = os::ParameterProvider::ControllerSnapshotFilePath();
+    if (path.empty()) {
+      return std::nullopt;
+    }
+    std::optional<std::string> snapshot = os::ReadSmallFile(path);
+    if (!snapshot.has_value()) {
+      LOG_INFO("No controller snapshot in %s", path.c_str());
+      return std::nullopt;
+    }
+
+    std::unordered_map<std::string, std::string> values;
+    for (const auto& line : common::StringSplit(*snapshot, "\n")) {
+      auto pos = line.find('=');
+      if (pos != std::string::npos) {
+        values[line.substr(0, pos)] = line.substr(pos + 1);
+      }
+    }
+    auto get = [&values](const std::string& key) -> std::optional<std::string> {
+      auto it = values.find(key);
+      if (it == values.end()) {
+        return std::nullopt;
+      }
+      return it->second;
+    };
+    auto matches = [&get](const std::string& key, const std::string& value) { return get(key) == value; };
+    bool valid = true;
+    auto get_uint = [&get, &valid](const std::string& key, auto* value) {
+      using T = std::remove_pointer_t<decltype(value)>;
+      auto string_value = get(key);
+      std::optional<uint64_t> number =
+          string_value.has_value() ? common::Uint64FromString(*string_value) : std::nullopt;
+      if (!number.has_value() || *number > std::numeric_limits<T>::max()) {
+        valid = false;
+        return;
+      }
+      *value = static_cast<T>(*number);
+    };
+    auto get_uints = [&get, &valid](const std::string& key, auto* numbers) {
+      using T = typename std::remove_pointer_t<decltype(numbers)>::value_type;
+      auto string_value = get(key);
+      if (!string_value.has_value()) {
+        valid = false;
+        return;
+      }
+      numbers->clear();
+      if (string_value->empty()) {
+        return;
+      }
+      for (const auto& token : common::StringSplit(*string_value, ",")) {
+        std::optional<uint64_t> number = common::Uint64FromString(token);
+        if (!number.has_value() || *number > std::numeric_limits<T>::max()) {
+          valid = false;
+          return;
         }
+        numbers->push_back(static_cast<T>(*number));
+      }
+    };
+
+    if (!matches("snapshot_version", common::ToString(static_cast<uint64_t>(kControllerSnapshotVersion))) ||
+        !matches("disabled_commands", os::GetSystemProperty(kPropertyDisabledCommands).value_or("")) ||
+        !matches("vendor_capabilities_enabled", common::ToString(vendor_capabilities_enabled())) ||
+        !matches("hci_version", common::ToString(static_cast<uint64_t>(local_version_information_.hci_version_))) ||
+        !matches("hci_revision", common::ToString(static_cast<uint64_t>(local_version_information_.hci_revision_))) ||
+        !matches("lmp_version", common::ToString(static_cast<uint64_t>(local_version_information_.lmp_version_))) ||
+        !matches(
+            "manufacturer_name",
+            common::ToString(static_cast<uint64_t>(local_version_information_.manufacturer_name_))) ||
+        !matches(
+            "lmp_subversion", common::ToString(static_cast<uint64_t>(local_version_information_.lmp_subversion_)))) {
+      LOG_INFO("Controller snapshot does not match the controller or host settings");
+      return std::nullopt;
     }
 
-    // Skip vendor capabilities check if configured.
-    if (os::GetSystemPropertyBool(
-            kPropertyVendorCapabilitiesEnabled, kDefaultVendorCapabilitiesEnabled)) {
-      hci_->EnqueueCommand(
-          LeGetVendorCapabilitiesBuilder::Create(),
-          handler->BindOnceOn(this, &Controller::impl::le_get_vendor_capabilities_handler));
-    } else {
-      vendor_capabilities_.is_supported_ = 0x00;
+    std::optional<Address> address = Address::FromString(get("bd_addr").value_or(""));
+    std::optional<std::vector<uint8_t>> supported_commands =
+        common::FromHexString(get("supported_commands").value_or(""));
+    std::optional<std::vector<uint8_t>> codec_ids = common::FromHexString(get("supported_codec_ids").value_or(""));
+    if (!address.has_value() || !supported_commands.has_value() ||
+        supported_commands->size() != local_supported_commands_.size() || !codec_ids.has_value()) {
+      LOG_WARN("Controller snapshot is corrupted");
+      return std::nullopt;
+    }
+    std::copy(supported_commands->begin(), supported_commands->end(), local_supported_commands_.begin());
+    local_supported_codec_ids_ = std::move(*codec_ids);
+
+    get_uints("extended_lmp_features", &extended_lmp_features_array_);
+    get_uint("acl_buffer_length", &acl_buffer_length_);
+    get_uint("acl_buffers", &acl_buffers_);
+    get_uint("sco_buffer_length", &sco_buffer_length_);
+    get_uint("sco_buffers", &sco_buffers_);
+    get_uint("le_data_packet_length", &le_buffer_size_.le_data_packet_length_);
+    get_uint("total_num_le_packets", &le_buffer_size_.total_num_le_packets_);
+    get_uint("iso_data_packet_length", &iso_buffer_size_.le_data_packet_length_);
+    get_uint("total_num_iso_packets", &iso_buffer_size_.total_num_le_packets_);
+    get_uints("supported_vendor_codec_ids", &local_supported_vendor_codec_ids_);
+    get_uint("le_local_supported_features", &le_local_supported_features_);
+    get_uint("le_supported_states", &le_supported_states_);
+    get_uint("le_connect_list_size", &le_connect_list_size_);
+    get_uint("le_resolving_list_size", &le_resolving_list_size_);
+    get_uint("supported_max_tx_octets", &le_maximum_data_length_.supported_max_tx_octets_);
+    get_uint("supported_max_tx_time", &le_maximum_data_length_.supported_max_tx_time_);
+    get_uint("supported_max_rx_octets", &le_maximum_data_length_.supported_max_rx_octets_);
+    get_uint("supported_max_rx_time", &le_maximum_data_length_.supported_max_rx_time_);
+    get_uint("le_maximum_advertising_data_length", &le_maximum_advertising_data_length_);
+    get_uint("le_suggested_default_data_length", &le_suggested_default_data_length_);
+    get_uint("le_number_supported_advertising_sets", &le_number_supported_advertising_sets_);
+    get_uint("le_periodic_advertiser_list_size", &le_periodic_advertiser_list_size_);
+    get_uint("vendor_is_supported", &vendor_capabilities_.is_supported_);
+    get_uint("vendor_max_advt_instances", &vendor_capabilities_.max_advt_instances_);
+    get_uint(
+        "vendor_offloaded_resolution_of_private_address",
+        &vendor_capabilities_.offloaded_resolution_of_private_address_);
+    get_uint("vendor_total_scan_results_storage", &vendor_capabilities_.total_scan_results_storage_);
+    get_uint("vendor_max_irk_list_sz", &vendor_capabilities_.max_irk_list_sz_);
+    get_uint("vendor_filtering_support", &vendor_capabilities_.filtering_support_);
+    get_uint("vendor_max_filter", &vendor_capabilities_.max_filter_);
+    get_uint("vendor_activity_energy_info_support", &vendor_capabilities_.activity_energy_info_support_);
+    get_uint("vendor_version_supported", &vendor_capabilities_.version_supported_);
+    get_uint("vendor_total_num_of_advt_tracked", &vendor_capabilities_.total_num_of_advt_tracked_);
+    get_uint("vendor_extended_scan_support", &vendor_capabilities_.extended_scan_support_);
+    get_uint("vendor_debug_logging_supported", &vendor_capabilities_.debug_logging_supported_);
+    get_uint(
+        "vendor_le_address_generation_offloading_support",
+        &vendor_capabilities_.le_address_generation_offloading_support_);
+    get_uint(
+        "vendor_a2dp_source_offload_capability_mask", &vendor_capabilities_.a2dp_source_offload_capability_mask_);
+    get_uint("vendor_bluetooth_quality_report_support", &vendor_capabilities_.bluetooth_quality_report_support_);
+    if (!valid) {
+      LOG_WARN("Controller snapshot is corrupted");
+      return std::nullopt;
     }
 
-    // We only need to synchronize the last read. Make BD_ADDR to be the last one.
-    std::promise<void> promise;
-    auto future = promise.get_future();
-    hci_->EnqueueCommand(
-        ReadBdAddrBuilder::Create(),
-        handler->BindOnceOn(this, &Controller::impl::read_controller_mac_address_handler, std::move(promise)));
-    future.wait();
+    LOG_INFO("Restored controller capabilities from %s", path.c_str());
+    return address;
+  }
+
+  static bool vendor_capabilities_enabled() {
+    return os::GetSystemPropertyBool(kPropertyVendorCapabilitiesEnabled, kDefaultVendorCapabilitiesEnabled);
   }
 
   void Stop() {
@@ -292,7 +582,7 @@ struct Controller::impl {
     local_name_.erase(std::find(local_name_.begin(), local_name_.end(), '\0'), local_name_.end());
   }
 
-  void read_local_version_information_complete_handler(CommandCompleteView view) {
+  void read_local_version_information_complete_handler(std::promise<void> promise, CommandCompleteView view) {
     auto complete_view = ReadLocalVersionInformationCompleteView::Create(view);
     ASSERT(complete_view.IsValid());
     ErrorCode status = complete_view.GetStatus();
@@ -305,6 +595,7 @@ struct Controller::impl {
         local_version_information_.lmp_subversion_,
         static_cast<uint8_t>(local_version_information_.hci_version_),
         local_version_information_.hci_revision_);
+    promise.set_value();
   }
 
   void read_local_supported_commands_complete_handler(CommandCompleteView view) {
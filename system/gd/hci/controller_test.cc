@@ -20,6 +20,7 @@
 
 #include <chrono>
 #include <future>
+#include <map>
 #include <memory>
 
 #include "common/bind.h"
@@ -27,6 +28,8 @@
 #include "hci/address.h"
 #include "hci/hci_layer.h"
 #include "module_dumper.h"
+#include "os/files.h"
+#include "os/parameter_provider.h"
 #include "os/thread.h"
 #include "packet/raw_builder.h"
 
@@ -84,6 +87,11 @@ class TestHciLayer : public HciLayer {
     CommandView command = CommandView::Create(packet_view);
     ASSERT_TRUE(command.IsValid());
 
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      command_count_[command.GetOpCode()]++;
+    }
+
     uint8_t num_packets = 1;
     std::unique_ptr<packet::BasePacketBuilder> event_builder;
     switch (command.GetOpCode()) {
@@ -97,7 +105,7 @@ class TestHciLayer : public HciLayer {
         local_version_information.hci_revision_ = 0x1234;
         local_version_information.lmp_version_ = LmpVersion::V_4_2;
         local_version_information.manufacturer_name_ = 0xBAD;
-        local_version_information.lmp_subversion_ = 0x5678;
+        local_version_information.lmp_subversion_ = lmp_subversion;
         event_builder = ReadLocalVersionInformationCompleteBuilder::Create(
             num_packets, ErrorCode::SUCCESS, local_version_information);
       } break;
@@ -137,7 +145,7 @@ class TestHciLayer : public HciLayer {
             total_num_synchronous_data_packets);
       } break;
       case (OpCode::READ_BD_ADDR): {
-        event_builder = ReadBdAddrCompleteBuilder::Create(num_packets, ErrorCode::SUCCESS, Address::kAny);
+        event_builder = ReadBdAddrCompleteBuilder::Create(num_packets, ErrorCode::SUCCESS, bd_addr);
       } break;
       case (OpCode::LE_READ_BUFFER_SIZE_V1): {
         LeBufferSize le_buffer_size;
@@ -270,6 +278,11 @@ class TestHciLayer : public HciLayer {
     return command;
   }
 
+  size_t GetCommandCount(OpCode op_code) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    return command_count_[op_code];
+  }
+
   void ListDependencies(ModuleList* /* list */) const {}
   void Start() override {}
   void Stop() override {}
@@ -280,10 +293,13 @@ class TestHciLayer : public HciLayer {
   constexpr static uint16_t total_num_synchronous_data_packets = 12;
   uint64_t event_mask = 0;
   uint64_t le_event_mask = 0;
+  uint16_t lmp_subversion = 0x5678;
+  Address bd_addr = Address::kAny;
 
  private:
   common::ContextualCallback<void(EventView)> number_of_completed_packets_callback_;
   std::queue<CommandView> command_queue_;
+  std::map<OpCode, size_t> command_count_;
   mutable std::mutex mutex_;
   std::condition_variable not_empty_;
 };
@@ -337,6 +353,24 @@ class Controller096Test : public ControllerTest {
   }
 };
 
+class ControllerSnapshotTest : public ControllerTest {
+ protected:
+  void SetUp() override {
+    snapshot_path_ = ::testing::TempDir() + "/hci_controller_snapshot_test";
+    os::RemoveFile(snapshot_path_);
+    os::ParameterProvider::OverrideControllerSnapshotFilePath(snapshot_path_);
+    ControllerTest::SetUp();
+  }
+
+  void TearDown() override {
+    ControllerTest::TearDown();
+    os::ParameterProvider::OverrideControllerSnapshotFilePath("");
+    os::RemoveFile(snapshot_path_);
+  }
+
+  std::string snapshot_path_;
+};
+
 TEST_F(ControllerTest, startup_teardown) {}
 
 TEST_F(ControllerTest, read_controller_info) {
@@ -363,6 +397,82 @@ TEST_F(ControllerTest, read_controller_info) {
   ASSERT_TRUE(controller_->GetLocalSupportedBrEdrCodecIds().size() > 0);
 }
 
+TEST_F(ControllerSnapshotTest, restart_from_snapshot) {
+  ASSERT_TRUE(os::FileExists(snapshot_path_));
+  ASSERT_EQ(test_hci_layer_->GetCommandCount(OpCode::READ_BUFFER_SIZE), 1u);
+
+  TestModuleRegistry registry;
+  TestHciLayer* hci_layer = new TestHciLayer;
+  registry.InjectTestModule(&HciLayer::Factory, hci_layer);
+  registry.Start<Controller>(&registry.GetTestThread());
+  Controller* controller = registry.GetModuleUnderTest<Controller>();
+
+  // Only the version is read to validate the snapshot, the rest comes from the snapshot
+  EXPECT_EQ(hci_layer->GetCommandCount(OpCode::READ_LOCAL_VERSION_INFORMATION), 1u);
+  EXPECT_EQ(hci_layer->GetCommandCount(OpCode::READ_LOCAL_SUPPORTED_COMMANDS), 0u);
+  EXPECT_EQ(hci_layer->GetCommandCount(OpCode::READ_LOCAL_EXTENDED_FEATURES), 0u);
+  EXPECT_EQ(hci_layer->GetCommandCount(OpCode::READ_BUFFER_SIZE), 0u);
+  EXPECT_EQ(hci_layer->GetCommandCount(OpCode::LE_GET_VENDOR_CAPABILITIES), 0u);
+  EXPECT_EQ(hci_layer->GetCommandCount(OpCode::LE_SET_EVENT_MASK), 1u);
+  EXPECT_EQ(hci_layer->le_event_mask, test_hci_layer_->le_event_mask);
+
+  EXPECT_EQ(controller->GetAclPacketLength(), controller_->GetAclPacketLength());
+  EXPECT_EQ(controller->GetNumAclPacketBuffers(), controller_->GetNumAclPacketBuffers());
+  EXPECT_EQ(controller->GetScoPacketLength(), controller_->GetScoPacketLength());
+  EXPECT_EQ(controller->GetNumScoPacketBuffers(), controller_->GetNumScoPacketBuffers());
+  EXPECT_EQ(controller->SupportsSecureConnections(), controller_->SupportsSecureConnections());
+  EXPECT_EQ(controller->SupportsBle2mPhy(), controller_->SupportsBle2mPhy());
+  EXPECT_EQ(
+      controller->GetLeBufferSize().le_data_packet_length_, controller_->GetLeBufferSize().le_data_packet_length_);
+  EXPECT_EQ(controller->GetLeBufferSize().total_num_le_packets_, controller_->GetLeBufferSize().total_num_le_packets_);
+  EXPECT_EQ(controller->GetLeSupportedStates(), controller_->GetLeSupportedStates());
+  EXPECT_EQ(
+      controller->GetLeMaximumDataLength().supported_max_rx_octets_,
+      controller_->GetLeMaximumDataLength().supported_max_rx_octets_);
+  EXPECT_EQ(controller->GetLeMaximumAdvertisingDataLength(), controller_->GetLeMaximumAdvertisingDataLength());
+  EXPECT_EQ(controller->GetLocalSupportedBrEdrCodecIds(), controller_->GetLocalSupportedBrEdrCodecIds());
+  EXPECT_EQ(
+      controller->GetVendorCapabilities().version_supported_, controller_->GetVendorCapabilities().version_supported_);
+  EXPECT_EQ(controller->IsSupported(OpCode::LE_RAND), controller_->IsSupported(OpCode::LE_RAND));
+  EXPECT_EQ(controller->GetLocalName(), "DUT");
+
+  registry.StopAll();
+}
+
+TEST_F(ControllerSnapshotTest, new_firmware_reads_capabilities) {
+  TestModuleRegistry registry;
+  TestHciLayer* hci_layer = new TestHciLayer;
+  hci_layer->lmp_subversion = 0x5679;
+  registry.InjectTestModule(&HciLayer::Factory, hci_layer);
+  registry.Start<Controller>(&registry.GetTestThread());
+  Controller* controller = registry.GetModuleUnderTest<Controller>();
+
+  EXPECT_EQ(hci_layer->GetCommandCount(OpCode::READ_LOCAL_SUPPORTED_COMMANDS), 1u);
+  EXPECT_EQ(hci_layer->GetCommandCount(OpCode::READ_BUFFER_SIZE), 1u);
+  EXPECT_EQ(controller->GetAclPacketLength(), hci_layer->acl_data_packet_length);
+  EXPECT_EQ(controller->GetLocalVersionInformation().lmp_subversion_, 0x5679);
+
+  registry.StopAll();
+}
+
+TEST_F(ControllerSnapshotTest, other_controller_reads_capabilities) {
+  TestModuleRegistry registry;
+  TestHciLayer* hci_layer = new TestHciLayer;
+  hci_layer->bd_addr = Address{0x11, 0x22, 0x33, 0x44, 0x55, 0x66};
+  registry.InjectTestModule(&HciLayer::Factory, hci_layer);
+  registry.Start<Controller>(&registry.GetTestThread());
+  Controller* controller = registry.GetModuleUnderTest<Controller>();
+
+  // The address is checked before the host configuration is sent, so it is sent only once
+  EXPECT_EQ(hci_layer->GetCommandCount(OpCode::READ_LOCAL_SUPPORTED_COMMANDS), 1u);
+  EXPECT_EQ(hci_layer->GetCommandCount(OpCode::READ_BUFFER_SIZE), 1u);
+  EXPECT_EQ(hci_layer->GetCommandCount(OpCode::LE_SET_EVENT_MASK), 1u);
+  EXPECT_EQ(hci_layer->GetCommandCount(OpCode::WRITE_SIMPLE_PAIRING_MODE), 1u);
+  EXPECT_EQ(controller->GetMacAddress(), hci_layer->bd_addr);
+
+  registry.StopAll();
+}
+
 TEST_F(ControllerTest, read_write_local_name) {
   ASSERT_EQ(controller_->GetLocalName(), "DUT");
   controller_->WriteLocalName("New name");
@@ -16,6 +16,10 @@
 
 #include "hci/le_address_manager.h"
 
+#include <algorithm>
+#include <iterator>
+#include <vector>
+
 #include "common/init_flags.h"
 #include "hci/octets.h"
 #include "os/log.h"
@@ -242,6 +246,9 @@ void LeAddressManager::pause_registered_clients() {
         break;
       case WAITING_FOR_RESUME:
       case RESUMED:
+        if (!pause_start_.has_value()) {
+          pause_start_ = std::chrono::steady_clock::now();
+        }
         client.second = ClientState::WAITING_FOR_PAUSE;
         client.first->OnPause();
         break;
@@ -292,7 +299,14 @@ void LeAddressManager::resume_registered_clients() {
     return;
   }
 
-  LOG_INFO("Resuming registered clients");
+  if (pause_start_.has_value()) {
+    auto paused_ms =
+        std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - *pause_start_);
+    LOG_INFO("Resuming registered clients, paused for %lld ms", static_cast<long long>(paused_ms.count()));
+    pause_start_.reset();
+  } else {
+    LOG_INFO("Resuming registered clients");
+  }
   for (auto& client : registered_clients_) {
     client.second = ClientState::WAITING_FOR_RESUME;
     client.first->OnResume();
@@ -450,6 +464,7 @@ void LeAddressManager::handle_next_command() {
   ASSERT(!cached_commands_.empty());
   auto command = std::move(cached_commands_.front());
   cached_commands_.pop();
+  command_in_flight_ = true;
 
   std::visit(
       [this](auto&& command) {
@@ -469,9 +484,17 @@ void LeAddressManager::handle_next_command() {
 
 void LeAddressManager::AddDeviceToFilterAcceptList(
     FilterAcceptListAddressType connect_list_address_type, bluetooth::hci::Address address) {
+  handler_
+      ->BindOnceOn(this, &LeAddressManager::add_device_to_filter_accept_list, connect_list_address_type, address)
+      .Invoke();
+}
+
+void LeAddressManager::add_device_to_filter_accept_list(
+    FilterAcceptListAddressType connect_list_address_type, Address address) {
+  filter_accept_list_.emplace(connect_list_address_type, address);
   auto packet_builder = hci::LeAddDeviceToFilterAcceptListBuilder::Create(connect_list_address_type, address);
   Command command = {CommandType::ADD_DEVICE_TO_CONNECT_LIST, HCICommand{std::move(packet_builder)}};
-  handler_->BindOnceOn(this, &LeAddressManager::push_command, std::move(command)).Invoke();
+  push_command(std::move(command));
 }
 
 void LeAddressManager::AddDeviceToResolvingList(
@@ -479,9 +502,26 @@ void LeAddressManager::AddDeviceToResolvingList(
     Address peer_identity_address,
     const std::array<uint8_t, 16>& peer_irk,
     const std::array<uint8_t, 16>& local_irk) {
+  handler_
+      ->BindOnceOn(
+          this,
+          &LeAddressManager::add_device_to_resolving_list,
+          peer_identity_address_type,
+          peer_identity_address,
+          peer_irk,
+          local_irk)
+      .Invoke();
+}
+
+void LeAddressManager::add_device_to_resolving_list(
+    PeerAddressType peer_identity_address_type,
+    Address peer_identity_address,
+    const std::array<uint8_t, 16>& peer_irk,
+    const std::array<uint8_t, 16>& local_irk) {
   if (!supports_ble_privacy_) {
     return;
   }
+  resolving_list_[{peer_identity_address_type, peer_identity_address}] = {peer_irk, local_irk};
 
   // Disable Address resolution
   auto disable_builder = hci::LeSetAddressResolutionEnableBuilder::Create(hci::Enable::DISABLED);
@@ -505,25 +545,39 @@ void LeAddressManager::AddDeviceToResolvingList(
   Command enable = {CommandType::SET_ADDRESS_RESOLUTION_ENABLE, HCICommand{std::move(enable_builder)}};
   cached_commands_.push(std::move(enable));
 
-  if (registered_clients_.empty()) {
-    handler_->BindOnceOn(this, &LeAddressManager::handle_next_command).Invoke();
-  } else {
-    handler_->BindOnceOn(this, &LeAddressManager::pause_registered_clients).Invoke();
-  }
+  send_cached_commands();
 }
 
 void LeAddressManager::RemoveDeviceFromFilterAcceptList(
     FilterAcceptListAddressType connect_list_address_type, bluetooth::hci::Address address) {
+  handler_
+      ->BindOnceOn(
+          this, &LeAddressManager::remove_device_from_filter_accept_list, connect_list_address_type, address)
+      .Invoke();
+}
+
+void LeAddressManager::remove_device_from_filter_accept_list(
+    FilterAcceptListAddressType connect_list_address_type, Address address) {
+  filter_accept_list_.erase({connect_list_address_type, address});
   auto packet_builder = hci::LeRemoveDeviceFromFilterAcceptListBuilder::Create(connect_list_address_type, address);
   Command command = {CommandType::REMOVE_DEVICE_FROM_CONNECT_LIST, HCICommand{std::move(packet_builder)}};
-  handler_->BindOnceOn(this, &LeAddressManager::push_command, std::move(command)).Invoke();
+  push_command(std::move(command));
 }
 
 void LeAddressManager::RemoveDeviceFromResolvingList(
     PeerAddressType peer_identity_address_type, Address peer_identity_address) {
+  handler_
+      ->BindOnceOn(
+          this, &LeAddressManager::remove_device_from_resolving_list, peer_identity_address_type, peer_identity_address)
+      .Invoke();
+}
+
+void LeAddressManager::remove_device_from_resolving_list(
+    PeerAddressType peer_identity_address_type, Address peer_identity_address) {
   if (!supports_ble_privacy_) {
     return;
   }
+  resolving_list_.erase({peer_identity_address_type, peer_identity_address});
 
   // Disable Address resolution
   auto disable_builder = hci::LeSetAddressResolutionEnableBuilder::Create(hci::Enable::DISABLED);
@@ -540,23 +594,31 @@ void LeAddressManager::RemoveDeviceFromResolvingList(
   Command enable = {CommandType::SET_ADDRESS_RESOLUTION_ENABLE, HCICommand{std::move(enable_builder)}};
   cached_commands_.push(std::move(enable));
 
-  if (registered_clients_.empty()) {
-    handler_->BindOnceOn(this, &LeAddressManager::handle_next_command).Invoke();
-  } else {
-    handler_->BindOnceOn(this, &LeAddressManager::pause_registered_clients).Invoke();
-  }
+  send_cached_commands();
 }
 
 void LeAddressManager::ClearFilterAcceptList() {
+  handler_->BindOnceOn(this, &LeAddressManager::clear_filter_accept_list).Invoke();
+}
+
+void LeAddressManager::clear_filter_accept_list() {
+  filter_accept_list_.clear();
+  filter_accept_list_in_sync_ = true;
   auto packet_builder = hci::LeClearFilterAcceptListBuilder::Create();
   Command command = {CommandType::CLEAR_CONNECT_LIST, HCICommand{std::move(packet_builder)}};
-  handler_->BindOnceOn(this, &LeAddressManager::push_command, std::move(command)).Invoke();
+  push_command(std::move(command));
 }
 
 void LeAddressManager::ClearResolvingList() {
+  handler_->BindOnceOn(this, &LeAddressManager::clear_resolving_list).Invoke();
+}
+
+void LeAddressManager::clear_resolving_list() {
   if (!supports_ble_privacy_) {
     return;
   }
+  resolving_list_.clear();
+  resolving_list_in_sync_ = true;
 
   // Disable Address resolution
   auto disable_builder = hci::LeSetAddressResolutionEnableBuilder::Create(hci::Enable::DISABLED);
@@ -572,17 +634,203 @@ void LeAddressManager::ClearResolvingList() {
   Command enable = {CommandType::SET_ADDRESS_RESOLUTION_ENABLE, HCICommand{std::move(enable_builder)}};
   cached_commands_.push(std::move(enable));
 
-  handler_->BindOnceOn(this, &LeAddressManager::pause_registered_clients).Invoke();
+  send_cached_commands();
+}
+
+void LeAddressManager::ListTransaction::AddDeviceToFilterAcceptList(
+    FilterAcceptListAddressType connect_list_address_type, Address address) {
+  filter_accept_list_changes_[{connect_list_address_type, address}] = true;
+}
+
+void LeAddressManager::ListTransaction::RemoveDeviceFromFilterAcceptList(
+    FilterAcceptListAddressType connect_list_address_type, Address address) {
+  filter_accept_list_changes_[{connect_list_address_type, address}] = false;
+}
+
+void LeAddressManager::ListTransaction::ClearFilterAcceptList() {
+  clear_filter_accept_list_ = true;
+  filter_accept_list_changes_.clear();
+}
+
+void LeAddressManager::ListTransaction::AddDeviceToResolvingList(
+    PeerAddressType peer_identity_address_type,
+    Address peer_identity_address,
+    const std::array<uint8_t, 16>& peer_irk,
+    const std::array<uint8_t, 16>& local_irk) {
+  resolving_list_changes_[{peer_identity_address_type, peer_identity_address}] = ResolvingListKeys{peer_irk, local_irk};
+}
+
+void LeAddressManager::ListTransaction::RemoveDeviceFromResolvingList(
+    PeerAddressType peer_identity_address_type, Address peer_identity_address) {
+  resolving_list_changes_[{peer_identity_address_type, peer_identity_address}] = std::nullopt;
+}
+
+void LeAddressManager::ListTransaction::ClearResolvingList() {
+  clear_resolving_list_ = true;
+  resolving_list_changes_.clear();
+}
+
+void LeAddressManager::ApplyListTransaction(ListTransaction transaction) {
+  handler_->BindOnceOn(this, &LeAddressManager::apply_list_transaction, std::move(transaction)).Invoke();
+}
+
+void LeAddressManager::apply_list_transaction(ListTransaction transaction) {
+  size_t previous_commands = cached_commands_.size();
+  push_filter_accept_list_changes(transaction);
+  if (supports_ble_privacy_) {
+    push_resolving_list_changes(transaction);
+  }
+  if (cached_commands_.size() == previous_commands) {
+    LOG_DEBUG("No list change to apply");
+    return;
+  }
+
+  LOG_INFO("Applying list transaction with %zu commands", cached_commands_.size() - previous_commands);
+  send_cached_commands();
+}
+
+// Starts sending the cached commands once the registered clients are paused. Without clients, they are sent right
+// away, unless a command is in flight: its completion sends the next one.
+void LeAddressManager::send_cached_commands() {
+  if (!registered_clients_.empty()) {
+    pause_registered_clients();
+    return;
+  }
+  if (command_in_flight_ || cached_commands_.empty()) {
+    return;
+  }
+  handle_next_command();
+}
+
+void LeAddressManager::push_filter_accept_list_changes(const ListTransaction& transaction) {
+  if (!transaction.clear_filter_accept_list_ && transaction.filter_accept_list_changes_.empty()) {
+    return;
+  }
+
+  std::set<ListTransaction::FilterAcceptListEntry> target_list;
+  if (!transaction.clear_filter_accept_list_) {
+    target_list = filter_accept_list_;
+  }
+  for (const auto& [entry, add] : transaction.filter_accept_list_changes_) {
+    if (add) {
+      target_list.insert(entry);
+    } else {
+      target_list.erase(entry);
+    }
+  }
+
+  std::vector<ListTransaction::FilterAcceptListEntry> removed;
+  std::vector<ListTransaction::FilterAcceptListEntry> added;
+  std::set_difference(
+      filter_accept_list_.begin(),
+      filter_accept_list_.end(),
+      target_list.begin(),
+      target_list.end(),
+      std::back_inserter(removed));
+  std::set_difference(
+      target_list.begin(),
+      target_list.end(),
+      filter_accept_list_.begin(),
+      filter_accept_list_.end(),
+      std::back_inserter(added));
+
+  // Rewrite the whole list when its contents are unknown, or when that takes fewer commands
+  if (!filter_accept_list_in_sync_ || 1 + target_list.size() < removed.size() + added.size()) {
+    auto packet_builder = hci::LeClearFilterAcceptListBuilder::Create();
+    cached_commands_.push({CommandType::CLEAR_CONNECT_LIST, HCICommand{std::move(packet_builder)}});
+    removed.clear();
+    added.assign(target_list.begin(), target_list.end());
+  }
+  for (const auto& [address_type, address] : removed) {
+    auto packet_builder = hci::LeRemoveDeviceFromFilterAcceptListBuilder::Create(address_type, address);
+    cached_commands_.push({CommandType::REMOVE_DEVICE_FROM_CONNECT_LIST, HCICommand{std::move(packet_builder)}});
+  }
+  for (const auto& [address_type, address] : added) {
+    auto packet_builder = hci::LeAddDeviceToFilterAcceptListBuilder::Create(address_type, address);
+    cached_commands_.push({CommandType::ADD_DEVICE_TO_CONNECT_LIST, HCICommand{std::move(packet_builder)}});
+  }
+
+  filter_accept_list_ = std::move(target_list);
+  filter_accept_list_in_sync_ = true;
+}
+
+void LeAddressManager::push_resolving_list_changes(const ListTransaction& transaction) {
+  if (!transaction.clear_resolving_list_ && transaction.resolving_list_changes_.empty()) {
+    return;
+  }
+
+  std::map<ListTransaction::ResolvingListEntry, ListTransaction::ResolvingListKeys> target_list;
+  if (!transaction.clear_resolving_list_) {
+    target_list = resolving_list_;
+  }
+  for (const auto& [entry, keys] : transaction.resolving_list_changes_) {
+    if (keys.has_value()) {
+      target_list[entry] = *keys;
+    } else {
+      target_list.erase(entry);
+    }
+  }
+
+  // An entry with new keys is removed and added again
+  std::vector<ListTransaction::ResolvingListEntry> removed;
+  std::vector<ListTransaction::ResolvingListEntry> added;
+  for (const auto& [entry, keys] : resolving_list_) {
+    auto it = target_list.find(entry);
+    if (it == target_list.end() || it->second != keys) {
+      removed.push_back(entry);
+    }
+  }
+  for (const auto& [entry, keys] : target_list) {
+    auto it = resolving_list_.find(entry);
+    if (it == resolving_list_.end() || it->second != keys) {
+      added.push_back(entry);
+    }
+  }
+
+  bool clear = !resolving_list_in_sync_ || 1 + target_list.size() < removed.size() + added.size();
+  if (!clear && removed.empty() && added.empty()) {
+    return;
+  }
+
+  // Address resolution is disabled once around all the changes
+  auto disable_builder = hci::LeSetAddressResolutionEnableBuilder::Create(hci::Enable::DISABLED);
+  cached_commands_.push({CommandType::SET_ADDRESS_RESOLUTION_ENABLE, HCICommand{std::move(disable_builder)}});
+  if (clear) {
+    auto packet_builder = hci::LeClearResolvingListBuilder::Create();
+    cached_commands_.push({CommandType::CLEAR_RESOLVING_LIST, HCICommand{std::move(packet_builder)}});
+    removed.clear();
+    added.clear();
+    for (const auto& [entry, keys] : target_list) {
+      added.push_back(entry);
+    }
+  }
+  for (const auto& [address_type, address] : removed) {
+    auto packet_builder = hci::LeRemoveDeviceFromResolvingListBuilder::Create(address_type, address);
+    cached_commands_.push({CommandType::REMOVE_DEVICE_FROM_RESOLVING_LIST, HCICommand{std::move(packet_builder)}});
+  }
+  for (const auto& entry : added) {
+    const auto& [peer_irk, local_irk] = target_list[entry];
+    auto packet_builder =
+        hci::LeAddDeviceToResolvingListBuilder::Create(entry.first, entry.second, peer_irk, local_irk);
+    cached_commands_.push({CommandType::ADD_DEVICE_TO_RESOLVING_LIST, HCICommand{std::move(packet_builder)}});
+    auto privacy_mode_builder = hci::LeSetPrivacyModeBuilder::Create(entry.first, entry.second, PrivacyMode::DEVICE);
+    cached_commands_.push({CommandType::LE_SET_PRIVACY_MODE, HCICommand{std::move(privacy_mode_builder)}});
+  }
+  auto enable_builder = hci::LeSetAddressResolutionEnableBuilder::Create(hci::Enable::ENABLED);
+  cached_commands_.push({CommandType::SET_ADDRESS_RESOLUTION_ENABLE, HCICommand{std::move(enable_builder)}});
+
+  resolving_list_ = std::move(target_list);
+  resolving_list_in_sync_ = true;
 }
 
 template <class View>
-void LeAddressManager::on_command_complete(CommandCompleteView view) {
+bool LeAddressManager::on_command_complete(CommandCompleteView view) {
   auto op_code = view.GetCommandOpCode();
 
   auto complete_view = View::Create(view);
   if (!complete_view.IsValid()) {
     LOG_ERROR("Received %s complete with invalid packet", hci::OpCodeText(op_code).c_str());
-    return;
+    return false;
   }
   auto status = complete_view.GetStatus();
   if (status != ErrorCode::SUCCESS) {
@@ -590,10 +838,13 @@ void LeAddressManager::on_command_complete(CommandCompleteView view) {
         "Received %s complete with status %s",
         hci::OpCodeText(op_code).c_str(),
         ErrorCodeText(complete_view.GetStatus()).c_str());
+    return false;
   }
+  return true;
 }
 
 void LeAddressManager::OnCommandComplete(bluetooth::hci::CommandCompleteView view) {
+  command_in_flight_ = false;
   if (!view.IsValid()) {
     LOG_ERROR("Received command complete with invalid packet");
     return;
@@ -630,23 +881,33 @@ void LeAddressManager::OnCommandComplete(bluetooth::hci::CommandCompleteView vie
       break;
 
     case OpCode::LE_ADD_DEVICE_TO_RESOLVING_LIST:
-      on_command_complete<LeAddDeviceToResolvingListCompleteView>(view);
+      if (!on_command_complete<LeAddDeviceToResolvingListCompleteView>(view)) {
+        resolving_list_in_sync_ = false;
+      }
       break;
 
     case OpCode::LE_REMOVE_DEVICE_FROM_RESOLVING_LIST:
-      on_command_complete<LeRemoveDeviceFromResolvingListCompleteView>(view);
+      if (!on_command_complete<LeRemoveDeviceFromResolvingListCompleteView>(view)) {
+        resolving_list_in_sync_ = false;
+      }
       break;
 
     case OpCode::LE_CLEAR_RESOLVING_LIST:
-      on_command_complete<LeClearResolvingListCompleteView>(view);
+      if (!on_command_complete<LeClearResolvingListCompleteView>(view)) {
+        resolving_list_in_sync_ = false;
+      }
       break;
 
     case OpCode::LE_ADD_DEVICE_TO_FILTER_ACCEPT_LIST:
-      on_command_complete<LeAddDeviceToFilterAcceptListCompleteView>(view);
+      if (!on_command_complete<LeAddDeviceToFilterAcceptListCompleteView>(view)) {
+        filter_accept_list_in_sync_ = false;
+      }
       break;
 
     case OpCode::LE_REMOVE_DEVICE_FROM_FILTER_ACCEPT_LIST:
-      on_command_complete<LeRemoveDeviceFromFilterAcceptListCompleteView>(view);
+      if (!on_command_complete<LeRemoveDeviceFromFilterAcceptListCompleteView>(view)) {
+        filter_accept_list_in_sync_ = false;
+      }
       break;
 
     case OpCode::LE_SET_ADDRESS_RESOLUTION_ENABLE:
@@ -654,7 +915,9 @@ void LeAddressManager::OnCommandComplete(bluetooth::hci::CommandCompleteView vie
       break;
 
     case OpCode::LE_CLEAR_FILTER_ACCEPT_LIST:
-      on_command_complete<LeClearFilterAcceptListCompleteView>(view);
+      if (!on_command_complete<LeClearFilterAcceptListCompleteView>(view)) {
+        filter_accept_list_in_sync_ = false;
+      }
       break;
 
     default:
@@ -15,7 +15,12 @@
  */
 #pragma once
 
+#include <array>
+#include <chrono>
 #include <map>
+#include <optional>
+#include <set>
+#include <utility>
 #include <variant>
 
 #include "common/callback.h"
@@ -94,6 +99,37 @@ class LeAddressManager {
   void RemoveDeviceFromResolvingList(PeerAddressType peer_identity_address_type, Address peer_identity_address);
   void ClearFilterAcceptList();
   void ClearResolvingList();
+
+  // Filter accept list and resolving list changes applied together by ApplyListTransaction(). The registered
+  // clients are paused once for the whole transaction, and only the entries that differ from the current lists
+  // are sent to the controller.
+  class ListTransaction {
+   public:
+    void AddDeviceToFilterAcceptList(FilterAcceptListAddressType connect_list_address_type, Address address);
+    void RemoveDeviceFromFilterAcceptList(FilterAcceptListAddressType connect_list_address_type, Address address);
+    void ClearFilterAcceptList();
+    void AddDeviceToResolvingList(
+        PeerAddressType peer_identity_address_type,
+        Address peer_identity_address,
+        const std::array<uint8_t, 16>& peer_irk,
+        const std::array<uint8_t, 16>& local_irk);
+    void RemoveDeviceFromResolvingList(PeerAddressType peer_identity_address_type, Address peer_identity_address);
+    void ClearResolvingList();
+
+   private:
+    friend class LeAddressManager;
+    using FilterAcceptListEntry = std::pair<FilterAcceptListAddressType, Address>;
+    using ResolvingListEntry = std::pair<PeerAddressType, Address>;
+    using ResolvingListKeys = std::pair<std::array<uint8_t, 16>, std::array<uint8_t, 16>>;
+
+    // Applied on top of the current lists, or of empty lists if they are cleared
+    bool clear_filter_accept_list_ = false;
+    std::map<FilterAcceptListEntry, bool> filter_accept_list_changes_;  // true to add, false to remove
+    bool clear_resolving_list_ = false;
+    std::map<ResolvingListEntry, std::optional<ResolvingListKeys>> resolving_list_changes_;  // nullopt to remove
+  };
+  void ApplyListTransaction(ListTransaction transaction);
+
   void OnCommandComplete(CommandCompleteView view);
   std::chrono::milliseconds GetNextPrivateAddressIntervalMs();
 
@@ -147,6 +183,21 @@ class LeAddressManager {
 
   void pause_registered_clients();
   void push_command(Command command);
+  void add_device_to_filter_accept_list(FilterAcceptListAddressType connect_list_address_type, Address address);
+  void remove_device_from_filter_accept_list(
+      FilterAcceptListAddressType connect_list_address_type, Address address);
+  void clear_filter_accept_list();
+  void add_device_to_resolving_list(
+      PeerAddressType peer_identity_address_type,
+      Address peer_identity_address,
+      const std::array<uint8_t, 16>& peer_irk,
+      const std::array<uint8_t, 16>& local_irk);
+  void remove_device_from_resolving_list(PeerAddressType peer_identity_address_type, Address peer_identity_address);
+  void clear_resolving_list();
+  void apply_list_transaction(ListTransaction transaction);
+  void send_cached_commands();
+  void push_filter_accept_list_changes(const ListTransaction& transaction);
+  void push_resolving_list_changes(const ListTransaction& transaction);
   void ack_pause(LeAddressManagerCallback* callback);
   void resume_registered_clients();
   void ack_resume(LeAddressManagerCallback* callback);
@@ -163,7 +214,7 @@ class LeAddressManager {
   void handle_next_command();
   void check_cached_commands();
   template <class View>
-  void on_command_complete(CommandCompleteView view);
+  bool on_command_complete(CommandCompleteView view);
 
   common::Callback<void(std::unique_ptr<CommandBuilder>)> enqueue_command_;
   os::Handler* handler_;
@@ -177,7 +228,19 @@ class LeAddressManager {
   uint8_t connect_list_size_;
   uint8_t resolving_list_size_;
   std::queue<Command> cached_commands_;
+  // A cached command was sent and its completion was not handled yet
+  bool command_in_flight_{false};
   bool supports_ble_privacy_{false};
+
+  // The list contents once the cached commands are sent. A failed list command leaves the controller list
+  // unknown, and the next transaction rewrites the whole list.
+  std::set<ListTransaction::FilterAcceptListEntry> filter_accept_list_;
+  std::map<ListTransaction::ResolvingListEntry, ListTransaction::ResolvingListKeys> resolving_list_;
+  bool filter_accept_list_in_sync_{true};
+  bool resolving_list_in_sync_{true};
+
+  // Start of the current pause of the registered clients
+  std::optional<std::chrono::steady_clock::time_point> pause_start_;
 };
 
 }  // namespace hci
@@ -18,6 +18,10 @@
 
 #include <gtest/gtest.h>
 
+#include <algorithm>
+#include <chrono>
+#include <vector>
+
 #include "common/init_flags.h"
 #include "hci/hci_layer.h"
 #include "hci/octets.h"
@@ -100,6 +104,25 @@ class TestHciLayer : public HciLayer {
     return command_packet_view;
   }
 
+  size_t NumberOfQueuedCommands() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return command_queue_.size();
+  }
+
+  // Completes the oldest command with |status|, and returns its op code
+  OpCode CompleteNextCommand(ErrorCode status = ErrorCode::SUCCESS) {
+    OpCode op_code;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      CommandView command = GetLastCommand();
+      EXPECT_TRUE(command.IsValid());
+      op_code = command.GetOpCode();
+    }
+    std::vector<uint8_t> status_vector{static_cast<uint8_t>(status)};
+    IncomingEvent(CommandCompleteBuilder::Create(uint8_t{1}, op_code, std::make_unique<RawBuilder>(status_vector)));
+    return op_code;
+  }
+
   void IncomingEvent(std::unique_ptr<EventBuilder> event_builder) {
     auto packet = GetPacketView(std::move(event_builder));
     EventView event = EventView::Create(packet);
@@ -132,6 +155,7 @@ class RotatorClient : public LeAddressManagerCallback {
 
   void OnPause() {
     paused = true;
+    pause_count++;
     le_address_manager_->AckPause(this);
   }
 
@@ -155,6 +179,7 @@ class RotatorClient : public LeAddressManagerCallback {
   }
 
   bool paused{false};
+  size_t pause_count{0};
   LeAddressManager* le_address_manager_;
   size_t id_;
   std::unique_ptr<std::promise<void>> resume_promise_;
@@ -313,7 +338,7 @@ class LeAddressManagerWithSingleClientTest : public LeAddressManagerTest {
         LeAddressManager::AddressPolicy::USE_RESOLVABLE_ADDRESS,
         remote_address,
         irk,
-        false,
+        supports_ble_privacy_,
         minimum_rotation_time,
         maximum_rotation_time);
 
@@ -339,6 +364,9 @@ class LeAddressManagerWithSingleClientTest : public LeAddressManagerTest {
     delete handler_;
     delete thread_;
   }
+
+ protected:
+  bool supports_ble_privacy_ = false;
 };
 
 TEST_F(LeAddressManagerWithSingleClientTest, add_device_to_connect_list) {
@@ -544,6 +572,209 @@ TEST_F(LeAddressManagerWithSingleClientTest, register_during_command_complete) {
   clients[1].get()->WaitForResume();
 }
 
+class LeAddressManagerListTransactionTest : public LeAddressManagerWithSingleClientTest {
+ public:
+  void SetUp() override {
+    supports_ble_privacy_ = true;
+    LeAddressManagerWithSingleClientTest::SetUp();
+    clients[0].get()->WaitForResume();
+    for (uint8_t i = 0; i < kDevices; i++) {
+      addresses_.push_back(Address({i, 0x02, 0x03, 0x04, 0x05, 0x06}));
+    }
+  }
+
+  // Answers every command the address manager sends, until it stops sending commands. Returns the op codes of the
+  // list commands.
+  std::vector<OpCode> CompleteAllCommands(ErrorCode status = ErrorCode::SUCCESS) {
+    std::vector<OpCode> op_codes;
+    while (true) {
+      // A command complete takes two handler hops to send the next command
+      for (int i = 0; i < 3; i++) {
+        sync_handler(handler_);
+      }
+      if (test_hci_layer_->NumberOfQueuedCommands() == 0) {
+        return op_codes;
+      }
+      OpCode op_code = test_hci_layer_->CompleteNextCommand(status);
+      // Ignore the address rotation
+      if (op_code != OpCode::LE_SET_RANDOM_ADDRESS) {
+        op_codes.push_back(op_code);
+      }
+    }
+  }
+
+  static size_t Count(const std::vector<OpCode>& op_codes, OpCode op_code) {
+    return std::count(op_codes.begin(), op_codes.end(), op_code);
+  }
+
+  static constexpr uint8_t kDevices = 100;
+  const Octet16 peer_irk_ = {
+      0xec, 0x02, 0x34, 0xa3, 0x57, 0xc8, 0xad, 0x05, 0x34, 0x10, 0x10, 0xa6, 0x0a, 0x39, 0x7d, 0x9b};
+  const Octet16 local_irk_ = {
+      0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f, 0x10};
+  std::vector<Address> addresses_;
+};
+
+// Restoring the bonded devices at boot: each device used to pause the clients, with four commands for its
+// resolving list entry.
+TEST_F(LeAddressManagerListTransactionTest, bulk_update_single_calls_and_transaction) {
+  auto start = std::chrono::steady_clock::now();
+  size_t pause_count = clients[0]->pause_count;
+  size_t commands = 0;
+  for (const Address& address : addresses_) {
+    le_address_manager_->AddDeviceToFilterAcceptList(FilterAcceptListAddressType::RANDOM, address);
+    le_address_manager_->AddDeviceToResolvingList(
+        PeerAddressType::RANDOM_DEVICE_OR_IDENTITY_ADDRESS, address, peer_irk_, local_irk_);
+    commands += CompleteAllCommands().size();
+  }
+  auto single_calls_ms =
+      std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+  ASSERT_EQ(commands, 5u * kDevices);
+  ASSERT_EQ(clients[0]->pause_count - pause_count, size_t{kDevices});
+  LOG_INFO("Single calls: %zu commands, %lld ms", commands, static_cast<long long>(single_calls_ms));
+
+  start = std::chrono::steady_clock::now();
+  pause_count = clients[0]->pause_count;
+  LeAddressManager::ListTransaction transaction;
+  transaction.ClearFilterAcceptList();
+  transaction.ClearResolvingList();
+  for (const Address& address : addresses_) {
+    transaction.AddDeviceToFilterAcceptList(FilterAcceptListAddressType::PUBLIC, address);
+    transaction.AddDeviceToResolvingList(
+        PeerAddressType::PUBLIC_DEVICE_OR_IDENTITY_ADDRESS, address, peer_irk_, local_irk_);
+  }
+  le_address_manager_->ApplyListTransaction(transaction);
+  auto op_codes = CompleteAllCommands();
+  auto transaction_ms =
+      std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+  LOG_INFO("Transaction: %zu commands, %lld ms", op_codes.size(), static_cast<long long>(transaction_ms));
+
+  // Every entry changes: both lists are cleared and written again, in one pause
+  ASSERT_EQ(clients[0]->pause_count - pause_count, 1u);
+  ASSERT_EQ(Count(op_codes, OpCode::LE_CLEAR_FILTER_ACCEPT_LIST), 1u);
+  ASSERT_EQ(Count(op_codes, OpCode::LE_ADD_DEVICE_TO_FILTER_ACCEPT_LIST), size_t{kDevices});
+  ASSERT_EQ(Count(op_codes, OpCode::LE_SET_ADDRESS_RESOLUTION_ENABLE), 2u);
+  ASSERT_EQ(Count(op_codes, OpCode::LE_CLEAR_RESOLVING_LIST), 1u);
+  ASSERT_EQ(Count(op_codes, OpCode::LE_ADD_DEVICE_TO_RESOLVING_LIST), size_t{kDevices});
+  ASSERT_EQ(Count(op_codes, OpCode::LE_SET_PRIVACY_MODE), size_t{kDevices});
+  ASSERT_EQ(op_codes.size(), 4u + 3u * kDevices);
+  clients[0].get()->WaitForResume();
+}
+
+TEST_F(LeAddressManagerListTransactionTest, only_changes_are_sent) {
+  LeAddressManager::ListTransaction transaction;
+  for (const Address& address : addresses_) {
+    transaction.AddDeviceToFilterAcceptList(FilterAcceptListAddressType::RANDOM, address);
+  }
+  le_address_manager_->ApplyListTransaction(transaction);
+  ASSERT_EQ(CompleteAllCommands().size(), size_t{kDevices});
+
+  // The same list again: nothing is sent, and the clients are not paused
+  size_t pause_count = clients[0]->pause_count;
+  le_address_manager_->ApplyListTransaction(transaction);
+  ASSERT_TRUE(CompleteAllCommands().empty());
+  ASSERT_EQ(clients[0]->pause_count, pause_count);
+
+  Address new_address({0xff, 0x02, 0x03, 0x04, 0x05, 0x06});
+  LeAddressManager::ListTransaction update;
+  update.ClearFilterAcceptList();
+  for (const Address& address : addresses_) {
+    update.AddDeviceToFilterAcceptList(FilterAcceptListAddressType::RANDOM, address);
+  }
+  update.RemoveDeviceFromFilterAcceptList(FilterAcceptListAddressType::RANDOM, addresses_[0]);
+  update.AddDeviceToFilterAcceptList(FilterAcceptListAddressType::RANDOM, new_address);
+  le_address_manager_->ApplyListTransaction(update);
+  auto op_codes = CompleteAllCommands();
+  ASSERT_EQ(
+      op_codes,
+      std::vector<OpCode>(
+          {OpCode::LE_REMOVE_DEVICE_FROM_FILTER_ACCEPT_LIST, OpCode::LE_ADD_DEVICE_TO_FILTER_ACCEPT_LIST}));
+  ASSERT_EQ(clients[0]->pause_count, pause_count + 1);
+  clients[0].get()->WaitForResume();
+}
+
+TEST_F(LeAddressManagerListTransactionTest, resolving_list_keys_change) {
+  LeAddressManager::ListTransaction transaction;
+  transaction.AddDeviceToResolvingList(
+      PeerAddressType::RANDOM_DEVICE_OR_IDENTITY_ADDRESS, addresses_[0], peer_irk_, local_irk_);
+  transaction.AddDeviceToResolvingList(
+      PeerAddressType::RANDOM_DEVICE_OR_IDENTITY_ADDRESS, addresses_[1], peer_irk_, local_irk_);
+  le_address_manager_->ApplyListTransaction(transaction);
+  ASSERT_EQ(CompleteAllCommands().size(), 6u);
+
+  Octet16 new_peer_irk = peer_irk_;
+  new_peer_irk[0]++;
+  LeAddressManager::ListTransaction update;
+  update.AddDeviceToResolvingList(
+      PeerAddressType::RANDOM_DEVICE_OR_IDENTITY_ADDRESS, addresses_[0], new_peer_irk, local_irk_);
+  update.AddDeviceToResolvingList(
+      PeerAddressType::RANDOM_DEVICE_OR_IDENTITY_ADDRESS, addresses_[1], peer_irk_, local_irk_);
+  le_address_manager_->ApplyListTransaction(update);
+  ASSERT_EQ(
+      CompleteAllCommands(),
+      std::vector<OpCode>({
+          OpCode::LE_SET_ADDRESS_RESOLUTION_ENABLE,
+          OpCode::LE_REMOVE_DEVICE_FROM_RESOLVING_LIST,
+          OpCode::LE_ADD_DEVICE_TO_RESOLVING_LIST,
+          OpCode::LE_SET_PRIVACY_MODE,
+          OpCode::LE_SET_ADDRESS_RESOLUTION_ENABLE,
+      }));
+  clients[0].get()->WaitForResume();
+}
+
+TEST_F(LeAddressManagerListTransactionTest, failed_command_rewrites_list) {
+  LeAddressManager::ListTransaction transaction;
+  transaction.AddDeviceToFilterAcceptList(FilterAcceptListAddressType::RANDOM, addresses_[0]);
+  transaction.AddDeviceToFilterAcceptList(FilterAcceptListAddressType::RANDOM, addresses_[1]);
+  le_address_manager_->ApplyListTransaction(transaction);
+  ASSERT_EQ(CompleteAllCommands(ErrorCode::MEMORY_CAPACITY_EXCEEDED).size(), 2u);
+
+  // The controller list is unknown: it is cleared and written again
+  LeAddressManager::ListTransaction update;
+  update.AddDeviceToFilterAcceptList(FilterAcceptListAddressType::RANDOM, addresses_[2]);
+  le_address_manager_->ApplyListTransaction(update);
+  ASSERT_EQ(
+      CompleteAllCommands(),
+      std::vector<OpCode>({
+          OpCode::LE_CLEAR_FILTER_ACCEPT_LIST,
+          OpCode::LE_ADD_DEVICE_TO_FILTER_ACCEPT_LIST,
+          OpCode::LE_ADD_DEVICE_TO_FILTER_ACCEPT_LIST,
+          OpCode::LE_ADD_DEVICE_TO_FILTER_ACCEPT_LIST,
+      }));
+  clients[0].get()->WaitForResume();
+}
+
+TEST_F(LeAddressManagerListTransactionTest, commands_wait_for_the_command_in_flight) {
+  le_address_manager_->Unregister(clients[0].get());
+  sync_handler(handler_);
+
+  LeAddressManager::ListTransaction transaction;
+  transaction.AddDeviceToFilterAcceptList(FilterAcceptListAddressType::RANDOM, addresses_[0]);
+  le_address_manager_->ApplyListTransaction(transaction);
+  sync_handler(handler_);
+  ASSERT_EQ(test_hci_layer_->NumberOfQueuedCommands(), 1u);
+
+  // Without clients to pause, the next commands still wait for the one in flight
+  LeAddressManager::ListTransaction update;
+  update.AddDeviceToFilterAcceptList(FilterAcceptListAddressType::RANDOM, addresses_[1]);
+  le_address_manager_->ApplyListTransaction(update);
+  le_address_manager_->AddDeviceToResolvingList(
+      PeerAddressType::RANDOM_DEVICE_OR_IDENTITY_ADDRESS, addresses_[2], peer_irk_, local_irk_);
+  sync_handler(handler_);
+  ASSERT_EQ(test_hci_layer_->NumberOfQueuedCommands(), 1u);
+
+  ASSERT_EQ(
+      CompleteAllCommands(),
+      std::vector<OpCode>({
+          OpCode::LE_ADD_DEVICE_TO_FILTER_ACCEPT_LIST,
+          OpCode::LE_ADD_DEVICE_TO_FILTER_ACCEPT_LIST,
+          OpCode::LE_SET_ADDRESS_RESOLUTION_ENABLE,
+          OpCode::LE_ADD_DEVICE_TO_RESOLVING_LIST,
+          OpCode::LE_SET_PRIVACY_MODE,
+          OpCode::LE_SET_ADDRESS_RESOLUTION_ENABLE,
+      }));
+}
+
 }  // namespace
 }  // namespace hci
 }  // namespace bluetooth
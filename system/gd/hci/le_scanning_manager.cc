@@ -680,14 +680,7 @@ struct LeScanningManager::impl : public LeAddressManagerCallback {
   }
 
   bool is_bonded(Address target_address) {
-    for (auto device : storage_module_->GetBondedDevices()) {
-      if (device.GetAddress() == target_address) {
-        LOG_DEBUG("Addresses match!");
-        return true;
-      }
-    }
-    LOG_DEBUG("Addresse DON'Ts match!");
-    return false;
+    return storage_module_->GetBondedDeviceRecord(target_address) != nullptr;
   }
 
   void scan_filter_parameter_setup(
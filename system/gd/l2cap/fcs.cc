@@ -16,9 +16,11 @@
 
 #include "l2cap/fcs.h"
 
+#include <array>
+
 namespace {
 // Table for optimizing the CRC calculation, which is a bitwise operation.
-static const uint16_t crctab[256] = {
+constexpr uint16_t crctab[256] = {
     0x0000, 0xc0c1, 0xc181, 0x0140, 0xc301, 0x03c0, 0x0280, 0xc241, 0xc601, 0x06c0, 0x0780, 0xc741, 0x0500, 0xc5c1,
     0xc481, 0x0440, 0xcc01, 0x0cc0, 0x0d80, 0xcd41, 0x0f00, 0xcfc1, 0xce81, 0x0e40, 0x0a00, 0xcac1, 0xcb81, 0x0b40,
     0xc901, 0x09c0, 0x0880, 0xc841, 0xd801, 0x18c0, 0x1980, 0xd941, 0x1b00, 0xdbc1, 0xda81, 0x1a40, 0x1e00, 0xdec1,
@@ -39,6 +41,28 @@ static const uint16_t crctab[256] = {
     0x4c80, 0x8c41, 0x4400, 0x84c1, 0x8581, 0x4540, 0x8701, 0x47c0, 0x4680, 0x8641, 0x8201, 0x42c0, 0x4380, 0x8341,
     0x4100, 0x81c1, 0x8081, 0x4040,
 };
+
+// slice_tables[k][b] is the CRC of byte b followed by k zero bytes, so that 8 input bytes can be looked up
+// independently of each other instead of through a chain of 8 dependent lookups.
+constexpr std::array<std::array<uint16_t, 256>, 8> MakeSliceTables() {
+  std::array<std::array<uint16_t, 256>, 8> tables{};
+  for (int b = 0; b < 256; b++) {
+    tables[0][b] = crctab[b];
+  }
+  for (int k = 1; k < 8; k++) {
+    for (int b = 0; b < 256; b++) {
+      uint16_t prev = tables[k - 1][b];
+      tables[k][b] = (prev >> 8) ^ crctab[prev & 0x00ff];
+    }
+  }
+  return tables;
+}
+
+constexpr std::array<std::array<uint16_t, 256>, 8> slice_tables = MakeSliceTables();
+
+uint16_t AddByteToCrc(uint16_t crc, uint8_t byte) {
+  return ((crc >> 8) & 0x00ff) ^ crctab[(crc & 0x00ff) ^ byte];
+}
 }  // namespace
 
 namespace bluetooth {
@@ -46,14 +70,30 @@ namespace l2cap {
 
 void Fcs::Initialize() {
   crc = 0;
+  pending_bytes = 0;
+  num_pending_bytes = 0;
 }
 
 void Fcs::AddByte(uint8_t byte) {
-  crc = ((crc >> 8) & 0x00ff) ^ crctab[(crc & 0x00ff) ^ byte];
+  pending_bytes |= static_cast<uint64_t>(byte) << (8 * num_pending_bytes);
+  if (++num_pending_bytes < 8) {
+    return;
+  }
+  // Only the first two bytes overlap with the 16 bit CRC
+  uint64_t x = pending_bytes ^ crc;
+  crc = slice_tables[7][x & 0xff] ^ slice_tables[6][(x >> 8) & 0xff] ^ slice_tables[5][(x >> 16) & 0xff] ^
+        slice_tables[4][(x >> 24) & 0xff] ^ slice_tables[3][(x >> 32) & 0xff] ^ slice_tables[2][(x >> 40) & 0xff] ^
+        slice_tables[1][(x >> 48) & 0xff] ^ slice_tables[0][x >> 56];
+  pending_bytes = 0;
+  num_pending_bytes = 0;
 }
 
 uint16_t Fcs::GetChecksum() const {
-  return crc;
+  uint16_t result = crc;
+  for (int i = 0; i < num_pending_bytes; i++) {
+    result = AddByteToCrc(result, (pending_bytes >> (8 * i)) & 0xff);
+  }
+  return result;
 }
 
 }  // namespace l2cap
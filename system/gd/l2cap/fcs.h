@@ -22,6 +22,7 @@ namespace bluetooth {
 namespace l2cap {
 
 // Frame Check Sequence from the L2CAP spec.
+// Bytes are folded into the CRC eight at a time (slicing-by-8), the remainder is folded in by GetChecksum().
 class Fcs {
  public:
   void Initialize();
@@ -32,6 +33,9 @@ class Fcs {
 
  private:
   uint16_t crc;
+  // Up to 7 bytes not yet folded into crc, the oldest one in the least significant byte
+  uint64_t pending_bytes;
+  uint8_t num_pending_bytes;
 };
 
 }  // namespace l2cap
@@ -16,6 +16,8 @@
 
 #include "l2cap/internal/enhanced_retransmission_mode_channel_data_controller.h"
 
+#include <algorithm>
+#include <deque>
 #include <map>
 #include <queue>
 #include <vector>
@@ -23,8 +25,7 @@
 #include "common/bind.h"
 #include "l2cap/internal/ilink.h"
 #include "os/alarm.h"
-#include "packet/fragmenting_inserter.h"
-#include "packet/raw_builder.h"
+#include "packet/bit_inserter.h"
 
 namespace bluetooth {
 namespace l2cap {
@@ -48,8 +49,9 @@ struct ErtmController::impl {
   // We don't support extended window
   static constexpr uint8_t kMaxTxWin = 64;
 
-  // We don't support sending SREJ
-  static constexpr bool kSendSrej = false;
+  // Recover from lost I-frames with one SREJ per missing frame instead of a REJ, so that the remote only retransmits
+  // the lost frames and not everything sent after them
+  static constexpr bool kSendSrej = true;
 
   // States (@see 8.6.5.2): Transmitter state and receiver state
 
@@ -80,9 +82,9 @@ struct ErtmController::impl {
   int unacked_frames_ = 0;
   // TODO: Instead of having a map, we may consider about a better data structure
   // Map from TxSeq to (SAR, SDU size for START packet, information payload)
-  std::map<uint8_t, std::tuple<SegmentationAndReassembly, uint16_t, std::shared_ptr<packet::RawBuilder>>> unacked_list_;
+  std::map<uint8_t, std::tuple<SegmentationAndReassembly, uint16_t, CopyablePacketBuilder>> unacked_list_;
   // Stores (SAR, SDU size for START packet, information payload)
-  std::queue<std::tuple<SegmentationAndReassembly, uint16_t, std::unique_ptr<packet::RawBuilder>>> pending_frames_;
+  std::queue<std::tuple<SegmentationAndReassembly, uint16_t, CopyablePacketBuilder>> pending_frames_;
   int retry_count_ = 0;
   std::map<uint8_t /* tx_seq, */, int /* count */> retry_i_frames_;
   bool rnr_sent_ = false;
@@ -90,21 +92,24 @@ struct ErtmController::impl {
   bool srej_actioned_ = false;
   uint16_t srej_save_req_seq_ = 0;
   bool send_rej_ = false;
-  int buffer_seq_srej_ = 0;
+  // TxSeq of the frames requested with SREJ, in the order they were requested
+  std::deque<uint8_t> srej_list_;
+  // Map from TxSeq to (SAR, SDU size for START packet, information payload) of the frames received while in SREJ_SENT
+  std::map<uint8_t, std::tuple<SegmentationAndReassembly, uint16_t, packet::PacketView<true>>> srej_saved_frames_;
   int frames_sent_ = 0;
   os::Alarm retrans_timer_;
   os::Alarm monitor_timer_;
 
   // Events (@see 8.6.5.4)
 
-  void data_request(SegmentationAndReassembly sar, std::unique_ptr<packet::RawBuilder> pdu, uint16_t sdu_size = 0) {
+  void data_request(SegmentationAndReassembly sar, const CopyablePacketBuilder& pdu, uint16_t sdu_size = 0) {
     // Note: sdu_size only applies to START packet
     if (tx_state_ == TxState::XMIT && !remote_busy() && rem_window_not_full()) {
-      send_data(sar, sdu_size, std::move(pdu));
+      send_data(sar, sdu_size, pdu);
     } else if (tx_state_ == TxState::XMIT && (remote_busy() || rem_window_full())) {
-      pend_data(sar, sdu_size, std::move(pdu));
+      pend_data(sar, sdu_size, pdu);
     } else if (tx_state_ == TxState::WAIT_F) {
-      pend_data(sar, sdu_size, std::move(pdu));
+      pend_data(sar, sdu_size, pdu);
     }
   }
 
@@ -198,7 +203,11 @@ struct ErtmController::impl {
       } else if (with_unexpected_tx_seq(tx_seq) && with_valid_req_seq(req_seq) && with_valid_f_bit(f) &&
                  !local_busy()) {
         if constexpr (kSendSrej) {
-          // We don't support sending SREJ
+          pass_to_tx(req_seq, f);
+          init_srej();
+          send_srej(tx_seq);
+          save_i_frame_srej(tx_seq, sar, sdu_size, payload);
+          rx_state_ = RxState::SREJ_SENT;
         } else {
           pass_to_tx(req_seq, f);
           send_rej();
@@ -240,7 +249,38 @@ struct ErtmController::impl {
         pass_to_tx(req_seq, f);
       }
     } else if (rx_state_ == RxState::SREJ_SENT) {
-      // SREJ NOT SUPPORTED
+      if (with_valid_req_seq(req_seq) && with_valid_f_bit(f)) {
+        pass_to_tx(req_seq, f);
+        if (f == Final::POLL_RESPONSE) {
+          if (!rej_actioned_) {
+            retransmit_i_frames(req_seq);
+            send_pending_i_frames();
+          } else {
+            rej_actioned_ = false;
+          }
+        }
+      }
+      if (with_expected_tx_seq_srej(tx_seq) && with_valid_req_seq(req_seq) && with_valid_f_bit(f)) {
+        save_i_frame_srej(tx_seq, sar, sdu_size, payload);
+        pop_srej_list();
+        data_indication_srej();
+      } else if (with_unexpected_tx_seq_srej(tx_seq) && with_valid_req_seq(req_seq) && with_valid_f_bit(f)) {
+        // The frames requested before this one were lost again, request them again
+        send_srej_list(tx_seq);
+        save_i_frame_srej(tx_seq, sar, sdu_size, payload);
+        pop_srej_list();
+      } else if (with_expected_tx_seq(tx_seq) && with_valid_req_seq(req_seq) && with_valid_f_bit(f)) {
+        increment_expected_tx_seq();
+        save_i_frame_srej(tx_seq, sar, sdu_size, payload);
+      } else if (with_duplicate_tx_seq(tx_seq) && with_valid_req_seq(req_seq) && with_valid_f_bit(f)) {
+        // Either saved already, or delivered before the SREJ was sent
+      } else if (with_unexpected_tx_seq(tx_seq) && with_valid_req_seq(req_seq) && with_valid_f_bit(f)) {
+        send_srej(tx_seq);
+        save_i_frame_srej(tx_seq, sar, sdu_size, payload);
+      } else if ((with_invalid_tx_seq(tx_seq) && controller_->local_tx_window_ > kMaxTxWin / 2) ||
+                 with_invalid_req_seq(req_seq)) {
+        CloseChannel();
+      }
     }
   }
 
@@ -296,12 +336,37 @@ struct ErtmController::impl {
         CloseChannel();
       }
     } else if (rx_state_ == RxState::SREJ_SENT) {
-      // SREJ NOT SUPPORTED
+      if (p == Poll::NOT_SET && f == Final::NOT_SET && with_valid_req_seq(req_seq) && with_valid_f_bit(f)) {
+        pass_to_tx(req_seq, f);
+        if (remote_busy() && unacked_frames_ > 0) {
+          start_retrans_timer();
+        }
+        remote_busy_ = false;
+        send_pending_i_frames();
+      } else if (f == Final::POLL_RESPONSE && with_valid_req_seq(req_seq) && with_valid_f_bit(f)) {
+        remote_busy_ = false;
+        pass_to_tx(req_seq, f);
+        if (!rej_actioned_) {
+          retransmit_i_frames(req_seq, p);
+        } else {
+          rej_actioned_ = false;
+        }
+        send_pending_i_frames();
+      } else if (p == Poll::POLL && with_valid_req_seq(req_seq) && with_valid_f_bit(f)) {
+        pass_to_tx(req_seq, f);
+        if (remote_busy() && unacked_frames_ > 0) {
+          start_retrans_timer();
+        }
+        remote_busy_ = false;
+        send_srej_tail(Final::POLL_RESPONSE);
+      } else if (with_invalid_req_seq(req_seq)) {
+        CloseChannel();
+      }
     }
   }
 
   void recv_rej(uint8_t req_seq, Poll p = Poll::NOT_SET, Final f = Final::NOT_SET) {
-    if (rx_state_ == RxState::RECV) {
+    if (rx_state_ == RxState::RECV || rx_state_ == RxState::SREJ_SENT) {
       if (f == Final::NOT_SET && with_valid_req_seq_retrans(req_seq) &&
           retry_i_frames_less_than_max_transmit(req_seq) && with_valid_f_bit(f)) {
         remote_busy_ = false;
@@ -351,8 +416,6 @@ struct ErtmController::impl {
       } else if (with_invalid_req_seq_retrans(req_seq)) {
         CloseChannel();
       }
-    } else if (rx_state_ == RxState::SREJ_SENT) {
-      // SREJ NOT SUPPORTED
     }
   }
 
@@ -383,12 +446,23 @@ struct ErtmController::impl {
         CloseChannel();
       }
     } else if (rx_state_ == RxState::SREJ_SENT) {
-      // SREJ NOT SUPPORTED
+      if (p == Poll::NOT_SET && with_valid_req_seq(req_seq) && with_valid_f_bit(f)) {
+        remote_busy_ = true;
+        pass_to_tx(req_seq, f);
+        stop_retrans_timer();
+      } else if (p == Poll::POLL && with_valid_req_seq(req_seq) && with_valid_f_bit(f)) {
+        remote_busy_ = true;
+        pass_to_tx(req_seq, f);
+        stop_retrans_timer();
+        send_srej_tail(Final::POLL_RESPONSE);
+      } else if (with_invalid_req_seq_retrans(req_seq)) {
+        CloseChannel();
+      }
     }
   }
 
   void recv_srej(uint8_t req_seq, Poll p = Poll::NOT_SET, Final f = Final::NOT_SET) {
-    if (rx_state_ == RxState::RECV) {
+    if (rx_state_ == RxState::RECV || rx_state_ == RxState::SREJ_SENT) {
       if (p == Poll::NOT_SET && f == Final::NOT_SET && with_valid_req_seq_retrans(req_seq) &&
           retry_i_frames_less_than_max_transmit(req_seq) && with_valid_f_bit(f)) {
         remote_busy_ = false;
@@ -456,8 +530,6 @@ struct ErtmController::impl {
       } else if (with_invalid_req_seq_retrans(req_seq)) {
         CloseChannel();
       }
-    } else if (rx_state_ == RxState::SREJ_SENT) {
-      // SREJ NOT SUPPORTED
     }
   }
 
@@ -547,29 +619,13 @@ struct ErtmController::impl {
     return !with_invalid_tx_seq(tx_seq) && !with_expected_tx_seq(tx_seq);
   }
 
-  bool with_expected_tx_seq_srej() {
-    // We don't support sending SREJ
-    return false;
-  }
-
-  bool send_req_is_true() {
-    // We don't support sending SREJ
-    return false;
-  }
-
-  bool srej_list_is_one() {
-    // We don't support sending SREJ
-    return false;
-  }
-
-  bool with_unexpected_tx_seq_srej() {
-    // We don't support sending SREJ
-    return false;
+  bool with_expected_tx_seq_srej(uint8_t tx_seq) {
+    return !srej_list_.empty() && srej_list_.front() == tx_seq;
   }
 
-  bool with_duplicate_tx_seq_srej() {
-    // We don't support sending SREJ
-    return false;
+  bool with_unexpected_tx_seq_srej(uint8_t tx_seq) {
+    return !with_expected_tx_seq_srej(tx_seq) &&
+           std::find(srej_list_.begin(), srej_list_.end(), tx_seq) != srej_list_.end();
   }
 
   // Actions (@see 8.6.5.6)
@@ -597,14 +653,12 @@ struct ErtmController::impl {
     controller_->send_pdu(std::move(builder));
   }
 
-  void send_data(SegmentationAndReassembly sar, uint16_t sdu_size, std::unique_ptr<packet::RawBuilder> segment,
+  void send_data(SegmentationAndReassembly sar, uint16_t sdu_size, const CopyablePacketBuilder& segment,
                  Final f = Final::NOT_SET) {
-    std::shared_ptr<packet::RawBuilder> shared_segment(segment.release());
     unacked_list_.emplace(std::piecewise_construct, std::forward_as_tuple(next_tx_seq_),
-                          std::forward_as_tuple(sar, sdu_size, shared_segment));
+                          std::forward_as_tuple(sar, sdu_size, segment));
 
-    std::unique_ptr<CopyablePacketBuilder> copyable_packet_builder =
-        std::make_unique<CopyablePacketBuilder>(std::get<2>(unacked_list_.find(next_tx_seq_)->second));
+    std::unique_ptr<CopyablePacketBuilder> copyable_packet_builder = std::make_unique<CopyablePacketBuilder>(segment);
     _send_i_frame(sar, std::move(copyable_packet_builder), buffer_seq_, next_tx_seq_, sdu_size, f);
     unacked_frames_++;
     frames_sent_++;
@@ -613,12 +667,12 @@ struct ErtmController::impl {
     start_retrans_timer();
   }
 
-  void pend_data(SegmentationAndReassembly sar, uint16_t sdu_size, std::unique_ptr<packet::RawBuilder> data) {
-    pending_frames_.emplace(std::make_tuple(sar, sdu_size, std::move(data)));
+  void pend_data(SegmentationAndReassembly sar, uint16_t sdu_size, const CopyablePacketBuilder& data) {
+    pending_frames_.emplace(sar, sdu_size, data);
   }
 
   void process_req_seq(uint8_t req_seq) {
-    for (int i = expected_ack_seq_; i < req_seq; i++) {
+    for (uint8_t i = expected_ack_seq_; i != req_seq; i = (i + 1) % kMaxTxWin) {
       unacked_list_.erase(i);
       retry_i_frames_[i] = 0;
     }
@@ -640,19 +694,19 @@ struct ErtmController::impl {
   }
 
   void send_rr(Poll p) {
-    _send_s_frame(SupervisoryFunction::RECEIVER_READY, expected_tx_seq_, p, Final::NOT_SET);
+    _send_s_frame(SupervisoryFunction::RECEIVER_READY, buffer_seq_, p, Final::NOT_SET);
   }
 
   void send_rr(Final f) {
-    _send_s_frame(SupervisoryFunction::RECEIVER_READY, expected_tx_seq_, Poll::NOT_SET, f);
+    _send_s_frame(SupervisoryFunction::RECEIVER_READY, buffer_seq_, Poll::NOT_SET, f);
   }
 
   void send_rnr(Poll p) {
-    _send_s_frame(SupervisoryFunction::RECEIVER_NOT_READY, expected_tx_seq_, p, Final::NOT_SET);
+    _send_s_frame(SupervisoryFunction::RECEIVER_NOT_READY, buffer_seq_, p, Final::NOT_SET);
   }
 
   void send_rnr(Final f) {
-    _send_s_frame(SupervisoryFunction::RECEIVER_NOT_READY, expected_tx_seq_, Poll::NOT_SET, f);
+    _send_s_frame(SupervisoryFunction::RECEIVER_NOT_READY, buffer_seq_, Poll::NOT_SET, f);
     rnr_sent_ = true;
   }
 
@@ -683,8 +737,27 @@ struct ErtmController::impl {
     }
   }
 
-  void send_srej() {
-    // Sending SREJ is not supported
+  // Request every frame from ExpectedTxSeq up to but not including |tx_seq|
+  void send_srej(uint8_t tx_seq) {
+    for (uint8_t i = expected_tx_seq_; i != tx_seq; i = (i + 1) % kMaxTxWin) {
+      _send_s_frame(SupervisoryFunction::SELECT_REJECT, i, Poll::NOT_SET, Final::NOT_SET);
+      srej_list_.push_back(i);
+    }
+    expected_tx_seq_ = (tx_seq + 1) % kMaxTxWin;
+  }
+
+  // Request again the frames requested before |tx_seq|, and move them to the tail of the SREJ list
+  void send_srej_list(uint8_t tx_seq) {
+    while (srej_list_.front() != tx_seq) {
+      uint8_t i = srej_list_.front();
+      _send_s_frame(SupervisoryFunction::SELECT_REJECT, i, Poll::NOT_SET, Final::NOT_SET);
+      srej_list_.pop_front();
+      srej_list_.push_back(i);
+    }
+  }
+
+  void send_srej_tail(Final f) {
+    _send_s_frame(SupervisoryFunction::SELECT_REJECT, srej_list_.back(), Poll::NOT_SET, f);
   }
 
   void start_retrans_timer() {
@@ -733,11 +806,13 @@ struct ErtmController::impl {
   }
 
   void init_srej() {
-    // We don't support sending SREJ
+    srej_list_.clear();
+    srej_saved_frames_.clear();
   }
 
-  void save_i_frame_srej() {
-    // We don't support sending SREJ
+  void save_i_frame_srej(uint8_t tx_seq, SegmentationAndReassembly sar, uint16_t sdu_size,
+                         const packet::PacketView<true>& payload) {
+    srej_saved_frames_.emplace(tx_seq, std::make_tuple(sar, sdu_size, payload));
   }
 
   void store_or_ignore() {
@@ -763,7 +838,7 @@ struct ErtmController::impl {
       retry_i_frames_[i]++;
       frames_sent_++;
       f = Final::NOT_SET;
-      i++;
+      i = (i + 1) % kMaxTxWin;
     }
     if (i != req_seq) {
       start_retrans_timer();
@@ -790,7 +865,7 @@ struct ErtmController::impl {
     }
     while (rem_window_not_full() && !pending_frames_.empty()) {
       auto& frame = pending_frames_.front();
-      send_data(std::get<0>(frame), std::get<1>(frame), std::move(std::get<2>(frame)), f);
+      send_data(std::get<0>(frame), std::get<1>(frame), std::get<2>(frame), f);
       pending_frames_.pop();
       f = Final::NOT_SET;
     }
@@ -801,32 +876,48 @@ struct ErtmController::impl {
   }
 
   void pop_srej_list() {
-    // We don't support sending SREJ
+    srej_list_.pop_front();
   }
 
+  // Pass the saved frames that are now in sequence to the upper layer, and go back to RECV once nothing is missing
   void data_indication_srej() {
-    // We don't support sending SREJ
+    auto frame = srej_saved_frames_.find(buffer_seq_);
+    if (frame == srej_saved_frames_.end()) {
+      return;
+    }
+    while (frame != srej_saved_frames_.end()) {
+      data_indication(std::get<0>(frame->second), std::get<1>(frame->second), std::get<2>(frame->second));
+      srej_saved_frames_.erase(frame);
+      frame = srej_saved_frames_.find(buffer_seq_);
+    }
+    if (srej_list_.empty()) {
+      rx_state_ = RxState::RECV;
+    }
+    send_ack(Final::NOT_SET);
   }
 };
 
-// Segmentation is handled here
+// Segmentation is handled here. The SDU is serialized once, and each segment is a slice of that buffer
 void ErtmController::OnSdu(std::unique_ptr<packet::BasePacketBuilder> sdu) {
   auto sdu_size = sdu->size();
-  std::vector<std::unique_ptr<packet::RawBuilder>> segments;
-  auto size_each_packet = (remote_mps_ - 4 /* basic L2CAP header */ - 2 /* SDU length */ - 2 /* Enhanced control */ -
-                           (fcs_enabled_ ? 2 : 0));
-  packet::FragmentingInserter fragmenting_inserter(size_each_packet, std::back_insert_iterator(segments));
-  sdu->Serialize(fragmenting_inserter);
-  fragmenting_inserter.finalize();
-  if (segments.size() == 1) {
-    pimpl_->data_request(SegmentationAndReassembly::UNSEGMENTED, std::move(segments[0]));
+  auto sdu_buffer = std::make_shared<std::vector<uint8_t>>();
+  sdu_buffer->reserve(sdu_size);
+  BitInserter it(*sdu_buffer);
+  sdu->Serialize(it);
+  size_t size_each_packet = (remote_mps_ - 4 /* basic L2CAP header */ - 2 /* SDU length */ - 2 /* Enhanced control */ -
+                             (fcs_enabled_ ? 2 : 0));
+  if (sdu_size <= size_each_packet) {
+    pimpl_->data_request(SegmentationAndReassembly::UNSEGMENTED, CopyablePacketBuilder(sdu_buffer, 0, sdu_size));
     return;
   }
-  pimpl_->data_request(SegmentationAndReassembly::START, std::move(segments[0]), sdu_size);
-  for (size_t i = 1; i < segments.size() - 1; i++) {
-    pimpl_->data_request(SegmentationAndReassembly::CONTINUATION, std::move(segments[i]));
+  pimpl_->data_request(SegmentationAndReassembly::START, CopyablePacketBuilder(sdu_buffer, 0, size_each_packet),
+                       sdu_size);
+  size_t begin = size_each_packet;
+  for (; sdu_size - begin > size_each_packet; begin += size_each_packet) {
+    pimpl_->data_request(SegmentationAndReassembly::CONTINUATION,
+                         CopyablePacketBuilder(sdu_buffer, begin, begin + size_each_packet));
   }
-  pimpl_->data_request(SegmentationAndReassembly::END, std::move(segments.back()));
+  pimpl_->data_request(SegmentationAndReassembly::END, CopyablePacketBuilder(sdu_buffer, begin, sdu_size));
 }
 
 void ErtmController::OnPdu(packet::PacketView<true> pdu) {
@@ -1050,11 +1141,13 @@ void ErtmController::close_channel() {
 }
 
 size_t ErtmController::CopyablePacketBuilder::size() const {
-  return builder_->size();
+  return end_ - begin_;
 }
 
 void ErtmController::CopyablePacketBuilder::Serialize(BitInserter& it) const {
-  builder_->Serialize(it);
+  for (size_t i = begin_; i < end_; i++) {
+    it.insert_byte((*sdu_)[i]);
+  }
 }
 
 }  // namespace internal
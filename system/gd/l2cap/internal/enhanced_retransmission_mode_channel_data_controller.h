@@ -80,16 +80,21 @@ class ErtmController : public DataController {
     }
   };
 
+  // A segment of an SDU, as the range [begin, end) of the buffer the whole SDU was serialized into. Copies share the
+  // buffer, so segments are sliced and retransmitted without copying the payload.
   class CopyablePacketBuilder : public packet::BasePacketBuilder {
    public:
-    CopyablePacketBuilder(std::shared_ptr<packet::RawBuilder> builder) : builder_(std::move(builder)) {}
+    CopyablePacketBuilder(std::shared_ptr<const std::vector<uint8_t>> sdu, size_t begin, size_t end)
+        : sdu_(std::move(sdu)), begin_(begin), end_(end) {}
 
     void Serialize(BitInserter& it) const override;
 
     size_t size() const override;
 
    private:
-    std::shared_ptr<packet::RawBuilder> builder_;
+    std::shared_ptr<const std::vector<uint8_t>> sdu_;
+    size_t begin_;
+    size_t end_;
   };
 
   PacketViewForReassembly reassembly_stage_{PacketView<kLittleEndian>(std::make_shared<std::vector<uint8_t>>())};
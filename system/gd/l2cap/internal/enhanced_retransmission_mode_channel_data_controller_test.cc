@@ -18,6 +18,8 @@
 
 #include <gtest/gtest.h>
 
+#include <random>
+
 #include "l2cap/internal/ilink_mock.h"
 #include "l2cap/internal/scheduler_mock.h"
 #include "l2cap/l2cap_packets.h"
@@ -50,6 +52,48 @@ void sync_handler(os::Handler* handler) {
   EXPECT_EQ(status, std::future_status::ready);
 }
 
+// Carries the PDUs of one controller to another one on the handler thread, like a baseband link that loses the
+// I-frames selected by |drop_i_frame|, which gets the index of each transmitted I-frame, retransmissions included.
+class LossyLinkScheduler : public Scheduler {
+ public:
+  LossyLinkScheduler(os::Handler* handler, std::function<bool(int)> drop_i_frame)
+      : handler_(handler), drop_i_frame_(std::move(drop_i_frame)) {}
+
+  void Connect(ErtmController* from, ErtmController* to) {
+    from_ = from;
+    to_ = to;
+  }
+
+  void OnPacketsReady(Cid /* cid */, int number_packets) override {
+    handler_->Post(common::BindOnce(&LossyLinkScheduler::deliver, common::Unretained(this), number_packets));
+  }
+
+  int i_frames_sent_ = 0;
+  int i_frames_dropped_ = 0;
+  size_t i_frame_bytes_sent_ = 0;
+
+ private:
+  void deliver(int number_packets) {
+    for (int i = 0; i < number_packets; i++) {
+      auto pdu = GetPacketView(from_->GetNextPacket());
+      auto standard_view = StandardFrameWithFcsView::Create(BasicFrameWithFcsView::Create(pdu));
+      if (standard_view.IsValid() && standard_view.GetFrameType() == FrameType::I_FRAME) {
+        i_frame_bytes_sent_ += pdu.size();
+        if (drop_i_frame_(i_frames_sent_++)) {
+          i_frames_dropped_++;
+          continue;
+        }
+      }
+      to_->OnPdu(pdu);
+    }
+  }
+
+  os::Handler* handler_;
+  std::function<bool(int)> drop_i_frame_;
+  ErtmController* from_ = nullptr;
+  ErtmController* to_ = nullptr;
+};
+
 class ErtmDataControllerTest : public ::testing::Test {
  protected:
   void SetUp() override {
@@ -204,6 +248,70 @@ TEST_F(ErtmDataControllerTest, receive_packet_with_fcs) {
   EXPECT_EQ(data, "abcd");
 }
 
+TEST_F(ErtmDataControllerTest, goodput_on_lossy_link) {
+  constexpr int kNumSdus = 100;
+  constexpr size_t kSduSize = 3000;
+  common::BidiQueue<Scheduler::UpperEnqueue, Scheduler::UpperDequeue> sender_queue{10};
+  common::BidiQueue<Scheduler::UpperEnqueue, Scheduler::UpperDequeue> receiver_queue{10};
+  testing::MockILink link;
+  EXPECT_CALL(link, SendDisconnectionRequest).Times(0);
+  // 10% of the I-frames are lost, S-frames always go through
+  std::mt19937 random_engine(1);
+  std::bernoulli_distribution loss(0.1);
+  LossyLinkScheduler to_receiver(queue_handler_, [&](int) { return loss(random_engine); });
+  LossyLinkScheduler to_sender(queue_handler_, [](int) { return false; });
+  ErtmController sender{&link, 1, 2, sender_queue.GetDownEnd(), queue_handler_, &to_receiver};
+  ErtmController receiver{&link, 2, 1, receiver_queue.GetDownEnd(), queue_handler_, &to_sender};
+  to_receiver.Connect(&sender, &receiver);
+  to_sender.Connect(&receiver, &sender);
+  RetransmissionAndFlowControlConfigurationOption option;
+  option.tx_window_size_ = 10;
+  option.max_transmit_ = 20;
+  option.retransmission_time_out_ = 100;
+  option.monitor_time_out_ = 200;
+  option.maximum_pdu_size_ = 1000;
+  for (auto* controller : {&sender, &receiver}) {
+    controller->SetRetransmissionAndFlowControlOptions(option);
+    controller->EnableFcs(true);
+  }
+
+  std::vector<std::string> received;
+  std::promise<void> all_received;
+  receiver_queue.GetUpEnd()->RegisterDequeue(queue_handler_, common::Bind([&] {
+    auto sdu = receiver_queue.GetUpEnd()->TryDequeue();
+    received.emplace_back(sdu->begin(), sdu->end());
+    if (received.size() == kNumSdus) {
+      all_received.set_value();
+    }
+  }));
+  std::vector<std::string> sent;
+  for (int i = 0; i < kNumSdus; i++) {
+    sent.emplace_back(kSduSize, static_cast<char>('a' + i % 26));
+  }
+  queue_handler_->Post(common::BindOnce(
+      [](ErtmController* controller, const std::vector<std::string>* sdus) {
+        for (const auto& sdu : *sdus) {
+          controller->OnSdu(CreateSdu(std::vector<uint8_t>(sdu.begin(), sdu.end())));
+        }
+      },
+      &sender,
+      &sent));
+  auto future = all_received.get_future();
+  EXPECT_EQ(future.wait_for(std::chrono::seconds(10)), std::future_status::ready);
+  receiver_queue.GetUpEnd()->UnregisterDequeue();
+  sync_handler(queue_handler_);
+  EXPECT_EQ(received.size(), sent.size());
+  EXPECT_EQ(received, sent);
+
+  // Share of the transmitted I-frame bytes that carried new data. Only the lost frames are sent again, while going
+  // back to the first lost frame would resend most of the window for each loss.
+  double goodput = static_cast<double>(kNumSdus * kSduSize) / to_receiver.i_frame_bytes_sent_;
+  RecordProperty("i_frames_sent", to_receiver.i_frames_sent_);
+  RecordProperty("i_frames_dropped", to_receiver.i_frames_dropped_);
+  RecordProperty("goodput_percent", static_cast<int>(goodput * 100));
+  EXPECT_GT(goodput, 0.75);
+}
+
 }  // namespace
 }  // namespace internal
 }  // namespace l2cap
@@ -16,14 +16,23 @@
 
 #include "l2cap/internal/le_credit_based_channel_data_controller.h"
 
+#include <algorithm>
+#include <optional>
+
+#include "common/bind.h"
 #include "l2cap/l2cap_packets.h"
 #include "l2cap/le/internal/link.h"
-#include "packet/fragmenting_inserter.h"
-#include "packet/raw_builder.h"
+#include "packet/bit_inserter.h"
 
 namespace bluetooth {
 namespace l2cap {
 namespace internal {
+namespace {
+// Weight of a new sample in the moving averages of the receive rate, PDU gap and credit round trip time
+constexpr double kSampleWeight = 0.25;
+// A PDU that needed a credit packet and came this many average gaps after the previous one was waiting for it
+constexpr double kStallGapFactor = 4;
+}  // namespace
 
 LeCreditBasedDataController::LeCreditBasedDataController(ILink* link, Cid cid, Cid remote_cid,
                                                          UpperQueueDownEnd* channel_queue_end, os::Handler* handler,
@@ -40,31 +49,38 @@ void LeCreditBasedDataController::OnSdu(std::unique_ptr<packet::BasePacketBuilde
   if (sdu_size > mtu_) {
     LOG_WARN("Received sdu_size %d > mtu %d", static_cast<int>(sdu_size), mtu_);
   }
-  std::vector<std::unique_ptr<packet::RawBuilder>> segments;
-  // TODO: We don't need to waste 2 bytes for continuation segment.
-  packet::FragmentingInserter fragmenting_inserter(mps_ - 2, std::back_insert_iterator(segments));
-  sdu->Serialize(fragmenting_inserter);
-  fragmenting_inserter.finalize();
+  // The SDU is serialized once, and each K-frame carries a slice of that buffer
+  auto sdu_buffer = std::make_shared<std::vector<uint8_t>>();
+  sdu_buffer->reserve(sdu_size);
+  BitInserter it(*sdu_buffer);
+  sdu->Serialize(it);
+  // Only the first K-frame carries the SDU length
+  size_t end = std::min<size_t>(sdu_size, mps_ - 2);
   std::unique_ptr<BasicFrameBuilder> builder;
-  builder = FirstLeInformationFrameBuilder::Create(remote_cid_, sdu_size, std::move(segments[0]));
+  builder = FirstLeInformationFrameBuilder::Create(remote_cid_, sdu_size,
+                                                   std::make_unique<SegmentBuilder>(sdu_buffer, 0, end));
   pdu_queue_.emplace(std::move(builder));
-  for (size_t i = 1; i < segments.size(); i++) {
-    builder = BasicFrameBuilder::Create(remote_cid_, std::move(segments[i]));
+  size_t num_segments = 1;
+  for (size_t begin = end; begin < sdu_size; begin = end) {
+    end = std::min<size_t>(sdu_size, begin + mps_);
+    builder = BasicFrameBuilder::Create(remote_cid_, std::make_unique<SegmentBuilder>(sdu_buffer, begin, end));
     pdu_queue_.emplace(std::move(builder));
+    num_segments++;
   }
-  if (credits_ >= segments.size()) {
-    scheduler_->OnPacketsReady(cid_, segments.size());
-    credits_ -= segments.size();
+  if (credits_ >= num_segments) {
+    scheduler_->OnPacketsReady(cid_, num_segments);
+    credits_ -= num_segments;
   } else if (credits_ > 0) {
     scheduler_->OnPacketsReady(cid_, credits_);
-    pending_frames_count_ += (segments.size() - credits_);
+    pending_frames_count_ += (num_segments - credits_);
     credits_ = 0;
   } else {
-    pending_frames_count_ += segments.size();
+    pending_frames_count_ += num_segments;
   }
 }
 
 void LeCreditBasedDataController::OnPdu(packet::PacketView<true> pdu) {
+  on_pdu_received();
   auto basic_frame_view = BasicFrameView::Create(pdu);
   if (!basic_frame_view.IsValid()) {
     LOG_WARN("Received invalid frame");
@@ -90,15 +106,21 @@ void LeCreditBasedDataController::OnPdu(packet::PacketView<true> pdu) {
     reassembly_stage_.AppendPacketView(payload);
   }
   if (remaining_sdu_continuation_packet_size_ == 0) {
+    // Withhold credits while the upper layer is not draining the SDUs buffered here
+    constexpr size_t kEnqueueBufferBusyThreshold = 3;
     enqueue_buffer_.Enqueue(std::make_unique<PacketView<kLittleEndian>>(reassembly_stage_), handler_);
+    if (enqueue_buffer_.Size() == kEnqueueBufferBusyThreshold && !credits_withheld_) {
+      credits_withheld_ = true;
+      enqueue_buffer_.NotifyOnEmpty(common::BindOnce(&LeCreditBasedDataController::on_enqueue_buffer_empty,
+                                                     common::Unretained(this)));
+    }
   } else if (remaining_sdu_continuation_packet_size_ < 0 || reassembly_stage_.size() > mtu_) {
     LOG_WARN("Received larger SDU size than expected");
     reassembly_stage_ = PacketViewForReassembly(PacketView<kLittleEndian>(std::make_shared<std::vector<uint8_t>>()));
     remaining_sdu_continuation_packet_size_ = 0;
     link_->SendDisconnectionRequest(cid_, remote_cid_);
   }
-  // TODO: Improve the logic by sending credit only after user dequeued the SDU
-  link_->SendLeCredit(cid_, 1);
+  replenish_credits();
 }
 
 std::unique_ptr<packet::BasePacketBuilder> LeCreditBasedDataController::GetNextPacket() {
@@ -124,8 +146,8 @@ void LeCreditBasedDataController::OnCredit(uint16_t credits) {
   credits_ = total_credits;
   if (pending_frames_count_ > 0 && credits_ >= pending_frames_count_) {
     scheduler_->OnPacketsReady(cid_, pending_frames_count_);
-    pending_frames_count_ = 0;
     credits_ -= pending_frames_count_;
+    pending_frames_count_ = 0;
   } else if (pending_frames_count_ > 0) {
     scheduler_->OnPacketsReady(cid_, credits_);
     pending_frames_count_ -= credits_;
@@ -133,6 +155,96 @@ void LeCreditBasedDataController::OnCredit(uint16_t credits) {
   }
 }
 
+void LeCreditBasedDataController::SetInitialCredit(uint16_t credits) {
+  remote_credits_ = credits;
+  initial_credit_ = std::max<uint16_t>(credits, kMinCreditTarget);
+  credit_target_ = initial_credit_;
+  credit_sent_time_ = std::chrono::steady_clock::now();
+}
+
+void LeCreditBasedDataController::on_pdu_received() {
+  auto now = std::chrono::steady_clock::now();
+  std::chrono::duration<double, std::milli> gap = now - last_pdu_time_;
+  bool has_gap = pdus_received_ > 0;
+  // Only a credit packet the remote could not do without tells about the round trip, the later ones arrived in time
+  std::optional<CreditPacket> needed_credit_packet;
+  while (!credit_packets_.empty() && credit_packets_.front().first_pdu <= pdus_received_) {
+    if (credit_packets_.front().first_pdu == pdus_received_) {
+      needed_credit_packet = credit_packets_.front();
+    }
+    credit_packets_.pop();
+  }
+  bool waited = false;
+  if (needed_credit_packet && needed_credit_packet->window_limited) {
+    if (needed_credit_packet->remote_out_of_credits) {
+      waited = true;
+    } else if (has_gap && rx_gap_ms_ > 0 && gap.count() > kStallGapFactor * rx_gap_ms_) {
+      // The remote used its credits before the credit packet reached it, so half of the window was too small to
+      // cover the credit round trip
+      waited = true;
+      remote_stalled_ = true;
+    }
+  }
+  if (waited) {
+    std::chrono::duration<double, std::milli> rtt = now - needed_credit_packet->sent_time;
+    credit_rtt_ms_ =
+        credit_rtt_ms_ == 0 ? rtt.count() : (1 - kSampleWeight) * credit_rtt_ms_ + kSampleWeight * rtt.count();
+  } else if (has_gap) {
+    // Idle periods are not part of the usual gap, which can still grow by a factor with each sample
+    double sample = rx_gap_ms_ == 0 ? gap.count() : std::min(gap.count(), kStallGapFactor * rx_gap_ms_);
+    rx_gap_ms_ = rx_gap_ms_ == 0 ? sample : (1 - kSampleWeight) * rx_gap_ms_ + kSampleWeight * sample;
+  }
+  last_pdu_time_ = now;
+  pdus_received_++;
+  pdus_since_credit_sent_++;
+  if (remote_credits_ > 0) {
+    remote_credits_--;
+  }
+}
+
+void LeCreditBasedDataController::replenish_credits(bool window_limited) {
+  if (credits_withheld_ || remote_credits_ > credit_target_ / 2) {
+    return;
+  }
+  auto now = std::chrono::steady_clock::now();
+  std::chrono::duration<double, std::milli> elapsed = now - credit_sent_time_;
+  if (pdus_since_credit_sent_ > 0 && elapsed.count() > 0) {
+    double rate = pdus_since_credit_sent_ / elapsed.count();
+    rx_rate_ = rx_rate_ == 0 ? rate : (1 - kSampleWeight) * rx_rate_ + kSampleWeight * rate;
+  }
+  // The remote waits for these credits, or waited for the previous ones, so the window does not cover the credit round
+  // trip
+  bool out_of_credits = remote_credits_ == 0;
+  bool window_too_small = window_limited && (out_of_credits || remote_stalled_);
+  size_t target = window_too_small ? 2 * credit_target_ : credit_target_;
+  target = std::max(target, static_cast<size_t>(2 * rx_rate_ * credit_rtt_ms_));
+  credit_target_ = std::clamp<size_t>(target, kMinCreditTarget, std::max(initial_credit_, kMaxCreditTarget));
+  remote_stalled_ = false;
+  uint16_t credits = credit_target_ - remote_credits_;
+  link_->SendLeCredit(cid_, credits);
+  credit_packets_.push({pdus_received_ + remote_credits_, now, window_limited, out_of_credits});
+  remote_credits_ += credits;
+  credit_sent_time_ = now;
+  pdus_since_credit_sent_ = 0;
+}
+
+void LeCreditBasedDataController::on_enqueue_buffer_empty() {
+  // The upper layer did not keep up with the remote, so it should not be given as many credits
+  credits_withheld_ = false;
+  credit_target_ = std::max<uint16_t>(kMinCreditTarget, credit_target_ / 2);
+  replenish_credits(false);
+}
+
+size_t LeCreditBasedDataController::SegmentBuilder::size() const {
+  return end_ - begin_;
+}
+
+void LeCreditBasedDataController::SegmentBuilder::Serialize(BitInserter& it) const {
+  for (size_t i = begin_; i < end_; i++) {
+    it.insert_byte((*sdu_)[i]);
+  }
+}
+
 }  // namespace internal
 }  // namespace l2cap
 }  // namespace bluetooth
@@ -16,6 +16,7 @@
 
 #pragma once
 
+#include <chrono>
 #include <memory>
 #include <unordered_map>
 #include <utility>
@@ -58,6 +59,8 @@ class LeCreditBasedDataController : public DataController {
   void SetMps(uint16_t mps);
   // TODO: Handle credits
   void OnCredit(uint16_t credits);
+  // Credits given to the remote in the connection request or response
+  void SetInitialCredit(uint16_t credits);
 
  private:
   Cid cid_;
@@ -72,6 +75,54 @@ class LeCreditBasedDataController : public DataController {
   uint16_t credits_ = 0;
   uint16_t pending_frames_count_ = 0;
 
+  // Credits are returned to the remote in batches, once it has used half of the credit target. The target doubles
+  // when the remote runs out of credits or stalls waiting for them, follows the receive rate times the credit round
+  // trip time, and is halved, down to kMinCreditTarget, when the upper layer does not drain the received SDUs.
+  static constexpr uint16_t kMinCreditTarget = 1;
+  static constexpr uint16_t kMaxCreditTarget = 1024;
+  uint16_t remote_credits_ = 0;
+  uint16_t initial_credit_ = 1;
+  uint16_t credit_target_ = 1;
+  bool credits_withheld_ = false;
+  // A credit packet sent to the remote. The remote can't send the PDU with index |first_pdu| before it receives the
+  // packet, as the credits it had before are used by then
+  struct CreditPacket {
+    uint64_t first_pdu;
+    std::chrono::steady_clock::time_point sent_time;
+    // false when the credits had been withheld, hence a remote waiting for them is not limited by the window
+    bool window_limited;
+    // The remote had no credits left, so it waits for the packet a whole credit round trip
+    bool remote_out_of_credits;
+  };
+  std::queue<CreditPacket> credit_packets_;
+  uint64_t pdus_received_ = 0;
+  std::chrono::steady_clock::time_point last_pdu_time_;
+  // Set when the remote used its credits and waited for a credit packet that was sent before it ran out
+  bool remote_stalled_ = false;
+  // Moving averages of the receive rate in PDUs per millisecond, of the time between two PDUs, and of the time between
+  // sending credits to a stalled remote and receiving its next PDU
+  double rx_rate_ = 0;
+  double rx_gap_ms_ = 0;
+  double credit_rtt_ms_ = 0;
+  uint16_t pdus_since_credit_sent_ = 0;
+  std::chrono::steady_clock::time_point credit_sent_time_;
+
+  // A segment of an SDU, as the range [begin, end) of the buffer the whole SDU was serialized into
+  class SegmentBuilder : public packet::BasePacketBuilder {
+   public:
+    SegmentBuilder(std::shared_ptr<const std::vector<uint8_t>> sdu, size_t begin, size_t end)
+        : sdu_(std::move(sdu)), begin_(begin), end_(end) {}
+
+    void Serialize(BitInserter& it) const override;
+
+    size_t size() const override;
+
+   private:
+    std::shared_ptr<const std::vector<uint8_t>> sdu_;
+    size_t begin_;
+    size_t end_;
+  };
+
   class PacketViewForReassembly : public packet::PacketView<kLittleEndian> {
    public:
     PacketViewForReassembly(const PacketView& packetView) : PacketView(packetView) {}
@@ -81,6 +132,11 @@ class LeCreditBasedDataController : public DataController {
   };
   PacketViewForReassembly reassembly_stage_{PacketView<kLittleEndian>(std::make_shared<std::vector<uint8_t>>())};
   uint16_t remaining_sdu_continuation_packet_size_ = 0;
+
+  void on_pdu_received();
+  // |window_limited| is false when the remote ran out of credits because they were withheld
+  void replenish_credits(bool window_limited = true);
+  void on_enqueue_buffer_empty();
 };
 
 }  // namespace internal
@@ -18,6 +18,8 @@
 
 #include <gtest/gtest.h>
 
+#include <thread>
+
 #include "l2cap/internal/ilink_mock.h"
 #include "l2cap/internal/scheduler_mock.h"
 #include "l2cap/l2cap_packets.h"
@@ -144,6 +146,9 @@ TEST_F(LeCreditBasedDataControllerTest, receive_segmented) {
   testing::MockILink link;
   LeCreditBasedDataController controller{&link, 0x41, 0x41, channel_queue.GetDownEnd(), queue_handler_, &scheduler};
   controller.OnCredit(10);
+  controller.SetInitialCredit(2);
+  // Half of a window of two credits is one K-frame
+  EXPECT_CALL(link, SendLeCredit(0x41, 1)).Times(2);
   auto segment1 = CreateSdu({'a', 'b', 'c', 'd'});
   auto builder1 = FirstLeInformationFrameBuilder::Create(0x41, 7, std::move(segment1));
   auto base_view = GetPacketView(std::move(builder1));
@@ -151,7 +156,6 @@ TEST_F(LeCreditBasedDataControllerTest, receive_segmented) {
   auto segment2 = CreateSdu({'e', 'f', 'g'});
   auto builder2 = BasicFrameBuilder::Create(0x41, std::move(segment2));
   base_view = GetPacketView(std::move(builder2));
-  EXPECT_CALL(link, SendLeCredit(0x41, 1));
   controller.OnPdu(base_view);
   sync_handler(queue_handler_);
   auto payload = channel_queue.GetUpEnd()->TryDequeue();
@@ -179,6 +183,176 @@ TEST_F(LeCreditBasedDataControllerTest, receive_segmented_with_wrong_sdu_length)
   EXPECT_EQ(payload, nullptr);
 }
 
+TEST_F(LeCreditBasedDataControllerTest, return_credits_in_batches) {
+  common::BidiQueue<Scheduler::UpperEnqueue, Scheduler::UpperDequeue> channel_queue{10};
+  testing::MockScheduler scheduler;
+  testing::MockILink link;
+  LeCreditBasedDataController controller{&link, 0x41, 0x41, channel_queue.GetDownEnd(), queue_handler_, &scheduler};
+  controller.SetInitialCredit(10);
+  EXPECT_CALL(link, SendLeCredit).Times(0);
+  controller.OnPdu(GetPacketView(FirstLeInformationFrameBuilder::Create(0x41, 5, CreateSdu({'a'}))));
+  for (int i = 0; i < 3; i++) {
+    controller.OnPdu(GetPacketView(BasicFrameBuilder::Create(0x41, CreateSdu({'a'}))));
+  }
+  ::testing::Mock::VerifyAndClearExpectations(&link);
+  // The remote has used half of its credits
+  EXPECT_CALL(link, SendLeCredit(0x41, 5));
+  controller.OnPdu(GetPacketView(BasicFrameBuilder::Create(0x41, CreateSdu({'a'}))));
+  sync_handler(queue_handler_);
+  auto payload = channel_queue.GetUpEnd()->TryDequeue();
+  EXPECT_NE(payload, nullptr);
+  EXPECT_EQ(std::string(payload->begin(), payload->end()), "aaaaa");
+}
+
+TEST_F(LeCreditBasedDataControllerTest, grow_credit_target_when_remote_runs_out) {
+  common::BidiQueue<Scheduler::UpperEnqueue, Scheduler::UpperDequeue> channel_queue{10};
+  testing::MockScheduler scheduler;
+  testing::MockILink link;
+  LeCreditBasedDataController controller{&link, 0x41, 0x41, channel_queue.GetDownEnd(), queue_handler_, &scheduler};
+  controller.SetInitialCredit(1);
+  EXPECT_CALL(link, SendLeCredit(0x41, 2));
+  controller.OnPdu(GetPacketView(FirstLeInformationFrameBuilder::Create(0x41, 1, CreateSdu({'a'}))));
+  sync_handler(queue_handler_);
+}
+
+TEST_F(LeCreditBasedDataControllerTest, grow_credit_target_when_remote_stalls) {
+  common::BidiQueue<Scheduler::UpperEnqueue, Scheduler::UpperDequeue> channel_queue{10};
+  testing::MockScheduler scheduler;
+  testing::MockILink link;
+  LeCreditBasedDataController controller{&link, 0x41, 0x41, channel_queue.GetDownEnd(), queue_handler_, &scheduler};
+  // One SDU spread over many K-frames, so that the upper layer queue is not involved
+  controller.SetMtu(0xffff);
+  controller.SetInitialCredit(100);
+  controller.OnPdu(GetPacketView(FirstLeInformationFrameBuilder::Create(0x41, 0xfff0, CreateSdu({'a'}))));
+  auto receive = [&](int count) {
+    for (int i = 0; i < count; i++) {
+      controller.OnPdu(GetPacketView(BasicFrameBuilder::Create(0x41, CreateSdu({'a'}))));
+    }
+  };
+
+  // The remote gets credits back each time it has used half of them, before it runs out
+  EXPECT_CALL(link, SendLeCredit(0x41, 50)).Times(2);
+  receive(99);
+  ::testing::Mock::VerifyAndClearExpectations(&link);
+
+  // It then uses the credits it had when the first credit packet was sent before that packet reaches it, and waits
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  EXPECT_CALL(link, SendLeCredit(0x41, ::testing::Ge(150)));
+  receive(50);
+}
+
+TEST_F(LeCreditBasedDataControllerTest, withhold_credits_until_upper_layer_drains) {
+  common::BidiQueue<Scheduler::UpperEnqueue, Scheduler::UpperDequeue> channel_queue{1};
+  testing::MockScheduler scheduler;
+  testing::MockILink link;
+  LeCreditBasedDataController controller{&link, 0x41, 0x41, channel_queue.GetDownEnd(), queue_handler_, &scheduler};
+  controller.SetInitialCredit(10);
+  EXPECT_CALL(link, SendLeCredit).Times(0);
+  for (int i = 0; i < 10; i++) {
+    controller.OnPdu(GetPacketView(FirstLeInformationFrameBuilder::Create(0x41, 1, CreateSdu({'a'}))));
+  }
+  sync_handler(queue_handler_);
+  ::testing::Mock::VerifyAndClearExpectations(&link);
+  // The target is halved, below the initial credits
+  EXPECT_CALL(link, SendLeCredit(0x41, 5));
+  for (int i = 0; i < 10; i++) {
+    EXPECT_NE(channel_queue.GetUpEnd()->TryDequeue(), nullptr);
+    sync_handler(queue_handler_);
+  }
+}
+
+// Carries the K-frames of one controller to another one on the handler thread
+class LoopbackScheduler : public Scheduler {
+ public:
+  explicit LoopbackScheduler(os::Handler* handler) : handler_(handler) {}
+
+  void Connect(LeCreditBasedDataController* from, LeCreditBasedDataController* to) {
+    from_ = from;
+    to_ = to;
+  }
+
+  void OnPacketsReady(Cid /* cid */, int number_packets) override {
+    handler_->Post(common::BindOnce(&LoopbackScheduler::deliver, common::Unretained(this), number_packets));
+  }
+
+  int k_frames_sent_ = 0;
+
+ private:
+  void deliver(int number_packets) {
+    for (int i = 0; i < number_packets; i++) {
+      to_->OnPdu(GetPacketView(from_->GetNextPacket()));
+      k_frames_sent_++;
+    }
+  }
+
+  os::Handler* handler_;
+  LeCreditBasedDataController* from_ = nullptr;
+  LeCreditBasedDataController* to_ = nullptr;
+};
+
+TEST_F(LeCreditBasedDataControllerTest, loopback_throughput) {
+  constexpr int kNumSdus = 200;
+  constexpr size_t kSduSize = 1000;
+  common::BidiQueue<Scheduler::UpperEnqueue, Scheduler::UpperDequeue> sender_queue{10};
+  common::BidiQueue<Scheduler::UpperEnqueue, Scheduler::UpperDequeue> receiver_queue{10};
+  testing::MockILink sender_link;
+  testing::MockILink receiver_link;
+  LoopbackScheduler to_receiver(queue_handler_);
+  LeCreditBasedDataController sender{&sender_link, 0x41, 0x42, sender_queue.GetDownEnd(), queue_handler_,
+                                     &to_receiver};
+  LeCreditBasedDataController receiver{&receiver_link, 0x42, 0x41, receiver_queue.GetDownEnd(), queue_handler_,
+                                       &to_receiver};
+  to_receiver.Connect(&sender, &receiver);
+  for (auto* controller : {&sender, &receiver}) {
+    controller->SetMtu(kSduSize);
+    controller->SetMps(251);
+  }
+  int credit_packets = 0;
+  EXPECT_CALL(receiver_link, SendLeCredit).WillRepeatedly([&](Cid /* cid */, uint16_t credits) {
+    credit_packets++;
+    queue_handler_->Post(common::BindOnce(&LeCreditBasedDataController::OnCredit, common::Unretained(&sender),
+                                          credits));
+  });
+  EXPECT_CALL(receiver_link, SendDisconnectionRequest).Times(0);
+  receiver.SetInitialCredit(10);
+  sender.OnCredit(10);
+
+  std::vector<std::string> received;
+  std::promise<void> all_received;
+  receiver_queue.GetUpEnd()->RegisterDequeue(queue_handler_, common::Bind([&] {
+    auto sdu = receiver_queue.GetUpEnd()->TryDequeue();
+    received.emplace_back(sdu->begin(), sdu->end());
+    if (received.size() == kNumSdus) {
+      all_received.set_value();
+    }
+  }));
+  std::vector<std::string> sent;
+  for (int i = 0; i < kNumSdus; i++) {
+    sent.emplace_back(kSduSize, static_cast<char>('a' + i % 26));
+  }
+  auto start = std::chrono::steady_clock::now();
+  queue_handler_->Post(common::BindOnce(
+      [](LeCreditBasedDataController* controller, const std::vector<std::string>* sdus) {
+        for (const auto& sdu : *sdus) {
+          controller->OnSdu(CreateSdu(std::vector<uint8_t>(sdu.begin(), sdu.end())));
+        }
+      },
+      &sender,
+      &sent));
+  auto future = all_received.get_future();
+  EXPECT_EQ(future.wait_for(std::chrono::seconds(10)), std::future_status::ready);
+  auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+  receiver_queue.GetUpEnd()->UnregisterDequeue();
+  sync_handler(queue_handler_);
+  EXPECT_EQ(received, sent);
+
+  // Credits go back in batches instead of one credit packet per K-frame
+  EXPECT_LT(credit_packets, to_receiver.k_frames_sent_ / 4);
+  RecordProperty("k_frames", to_receiver.k_frames_sent_);
+  RecordProperty("credit_packets", credit_packets);
+  RecordProperty("elapsed_us", static_cast<int>(elapsed.count()));
+}
+
 }  // namespace
 }  // namespace internal
 }  // namespace l2cap
@@ -21,6 +21,7 @@
 #include <forward_list>
 #include <memory>
 
+#include "l2cap/fcs.h"
 #include "os/log.h"
 #include "packet/bit_inserter.h"
 #include "packet/raw_builder.h"
@@ -164,5 +165,25 @@ TEST(L2capFuzzRegressions, ConfigurationRequestFuzz_manual_5655429176229888) {
   auto sif = StandardInformationFrameWithFcsView::Create(sfwf);
   ASSERT_FALSE(sif.IsValid());
 }
+
+TEST(L2capFcsTest, matches_bitwise_crc_for_every_length) {
+  std::vector<uint8_t> bytes;
+  for (size_t length = 0; length < 40; length++) {
+    uint16_t expected = 0;
+    for (auto byte : bytes) {
+      expected ^= byte;
+      for (int bit = 0; bit < 8; bit++) {
+        expected = (expected & 1) ? (expected >> 1) ^ 0xA001 : expected >> 1;
+      }
+    }
+    Fcs fcs;
+    fcs.Initialize();
+    for (auto byte : bytes) {
+      fcs.AddByte(byte);
+    }
+    ASSERT_EQ(fcs.GetChecksum(), expected) << "length " << length;
+    bytes.push_back(static_cast<uint8_t>(length * 37 + 11));
+  }
+}
 }  // namespace l2cap
 }  // namespace bluetooth
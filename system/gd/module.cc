@@ -17,6 +17,12 @@
 
 #include "module.h"
 
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <sstream>
+#include <thread>
+
 #include "common/init_flags.h"
 #include "module_dumper_flatbuffer.h"
 
@@ -26,6 +32,8 @@ using ::bluetooth::os::Thread;
 namespace bluetooth {
 
 constexpr std::chrono::milliseconds kModuleStopTimeout = std::chrono::milliseconds(2000);
+// Most of the start up time is spent waiting for the controller, so a few threads are enough
+constexpr size_t kMaxParallelModuleStarts = 4;
 
 ModuleFactory::ModuleFactory(std::function<Module*()> ctor) : ctor_(ctor) {
 }
@@ -54,12 +62,14 @@ Module* Module::GetDependency(const ModuleFactory* module) const {
 }
 
 Module* ModuleRegistry::Get(const ModuleFactory* module) const {
+  std::lock_guard<std::mutex> lock(mutex_);
   auto instance = started_modules_.find(module);
   ASSERT_LOG(instance != started_modules_.end(), "Request for module not started up, maybe not in Start(ModuleList)?");
   return instance->second;
 }
 
 bool ModuleRegistry::IsStarted(const ModuleFactory* module) const {
+  std::lock_guard<std::mutex> lock(mutex_);
   return started_modules_.find(module) != started_modules_.end();
 }
 
@@ -69,15 +79,91 @@ void ModuleRegistry::Start(ModuleList* modules, Thread* thread) {
   }
 }
 
+void ModuleRegistry::StartInParallel(ModuleList* modules, Thread* thread) {
+  // Construct every module that is not started yet, so that the whole dependency graph is known
+  std::map<const ModuleFactory*, Module*> pending;
+  std::vector<const ModuleFactory*> construct_order;
+  std::function<void(const ModuleFactory*)> construct = [&](const ModuleFactory* module) {
+    if (IsStarted(module) || pending.find(module) != pending.end()) {
+      return;
+    }
+    Module* instance = module->ctor_();
+    set_registry_and_handler(instance, thread);
+    instance->ListDependencies(&instance->dependencies_);
+    pending[module] = instance;
+    for (auto dependency : instance->dependencies_.list_) {
+      construct(dependency);
+    }
+    construct_order.push_back(module);
+  };
+  for (auto module : modules->list_) {
+    construct(module);
+  }
+
+  std::map<const ModuleFactory*, size_t> waiting_on;
+  std::map<const ModuleFactory*, std::vector<const ModuleFactory*>> dependents;
+  std::deque<const ModuleFactory*> ready;
+  for (auto module : construct_order) {
+    size_t count = 0;
+    for (auto dependency : pending[module]->dependencies_.list_) {
+      if (pending.find(dependency) != pending.end()) {
+        dependents[dependency].push_back(module);
+        count++;
+      }
+    }
+    waiting_on[module] = count;
+    if (count == 0) {
+      ready.push_back(module);
+    }
+  }
+
+  // Workers start whatever module has all its dependencies started
+  std::mutex schedule_mutex;
+  std::condition_variable schedule_cv;
+  size_t remaining = pending.size();
+  auto worker = [&]() {
+    std::unique_lock<std::mutex> lock(schedule_mutex);
+    while (true) {
+      schedule_cv.wait(lock, [&]() { return !ready.empty() || remaining == 0; });
+      if (remaining == 0) {
+        return;
+      }
+      const ModuleFactory* module = ready.front();
+      ready.pop_front();
+      lock.unlock();
+      start_instance(module, pending.at(module));
+      lock.lock();
+      remaining--;
+      for (auto dependent : dependents[module]) {
+        if (--waiting_on[dependent] == 0) {
+          ready.push_back(dependent);
+        }
+      }
+      schedule_cv.notify_all();
+    }
+  };
+
+  std::vector<std::thread> workers;
+  for (size_t i = 0; i < std::min(kMaxParallelModuleStarts, pending.size()); i++) {
+    workers.emplace_back(worker);
+  }
+  for (auto& worker_thread : workers) {
+    worker_thread.join();
+  }
+}
+
 void ModuleRegistry::set_registry_and_handler(Module* instance, Thread* thread) const {
   instance->registry_ = this;
   instance->handler_ = new Handler(thread);
 }
 
 Module* ModuleRegistry::Start(const ModuleFactory* module, Thread* thread) {
-  auto started_instance = started_modules_.find(module);
-  if (started_instance != started_modules_.end()) {
-    return started_instance->second;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto started_instance = started_modules_.find(module);
+    if (started_instance != started_modules_.end()) {
+      return started_instance->second;
+    }
   }
 
   LOG_INFO("Constructing next module");
@@ -86,16 +172,36 @@ Module* ModuleRegistry::Start(const ModuleFactory* module, Thread* thread) {
 
   LOG_INFO("Starting dependencies of %s", instance->ToString().c_str());
   instance->ListDependencies(&instance->dependencies_);
-  Start(&instance->dependencies_, thread);
+  for (auto dependency : instance->dependencies_.list_) {
+    Start(dependency, thread);
+  }
 
   LOG_INFO("Finished starting dependencies and calling Start() of %s", instance->ToString().c_str());
+  start_instance(module, instance);
+  return instance;
+}
 
-  last_instance_ = "starting " + instance->ToString();
+void ModuleRegistry::start_instance(const ModuleFactory* module, Module* instance) {
+  std::string name = instance->ToString();
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    last_instance_ = "starting " + name;
+  }
+
+  auto begin = std::chrono::steady_clock::now();
   instance->Start();
+  auto duration =
+      std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - begin);
+
+  std::lock_guard<std::mutex> lock(mutex_);
   start_order_.push_back(module);
   started_modules_[module] = instance;
-  LOG_INFO("Started %s", instance->ToString().c_str());
-  return instance;
+  ModuleTimes& times = module_times_[module];
+  times.name = name;
+  times.dependencies = instance->dependencies_.list_;
+  times.start_duration = duration;
+  times.stop_duration = {};
+  LOG_INFO("Started %s in %lld us", name.c_str(), static_cast<long long>(duration.count()));
 }
 
 void ModuleRegistry::StopAll() {
@@ -105,18 +211,24 @@ void ModuleRegistry::StopAll() {
     ASSERT(instance != started_modules_.end());
     last_instance_ = "stopping " + instance->second->ToString();
 
+    auto begin = std::chrono::steady_clock::now();
     // Clear the handler before stopping the module to allow it to shut down gracefully.
     LOG_INFO("Stopping Handler of Module %s", instance->second->ToString().c_str());
     instance->second->handler_->Clear();
     instance->second->handler_->WaitUntilStopped(kModuleStopTimeout);
     LOG_INFO("Stopping Module %s", instance->second->ToString().c_str());
     instance->second->Stop();
+    auto duration =
+        std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - begin);
+    std::lock_guard<std::mutex> lock(mutex_);
+    module_times_[*it].stop_duration = duration;
   }
   for (auto it = start_order_.rbegin(); it != start_order_.rend(); it++) {
     auto instance = started_modules_.find(*it);
     ASSERT(instance != started_modules_.end());
     delete instance->second->handler_;
     delete instance->second;
+    std::lock_guard<std::mutex> lock(mutex_);
     started_modules_.erase(instance);
   }
 
@@ -124,7 +236,71 @@ void ModuleRegistry::StopAll() {
   start_order_.clear();
 }
 
+std::string ModuleRegistry::GetStartUpReport() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  // The critical path of a module is the longest chain of start times through its dependencies,
+  // which is how long it takes to start when every independent module starts concurrently
+  std::map<const ModuleFactory*, std::chrono::microseconds> critical_path;
+  std::map<const ModuleFactory*, const ModuleFactory*> critical_dependency;
+  std::function<std::chrono::microseconds(const ModuleFactory*)> path_to = [&](const ModuleFactory* module) {
+    auto it = critical_path.find(module);
+    if (it != critical_path.end()) {
+      return it->second;
+    }
+    auto times = module_times_.find(module);
+    if (times == module_times_.end()) {
+      return std::chrono::microseconds(0);
+    }
+    std::chrono::microseconds longest(0);
+    for (auto dependency : times->second.dependencies) {
+      if (module_times_.find(dependency) == module_times_.end()) {
+        continue;
+      }
+      std::chrono::microseconds path = path_to(dependency);
+      if (path >= longest) {
+        longest = path;
+        critical_dependency[module] = dependency;
+      }
+    }
+    critical_path[module] = longest + times->second.start_duration;
+    return critical_path[module];
+  };
+
+  std::ostringstream report;
+  std::chrono::microseconds total_start(0);
+  std::chrono::microseconds total_stop(0);
+  const ModuleFactory* last = nullptr;
+  report << "  Module start and stop times:\n";
+  for (const auto& [module, times] : module_times_) {
+    report << "    " << times.name << " start:" << times.start_duration.count() << "us"
+           << " stop:" << times.stop_duration.count() << "us\n";
+    total_start += times.start_duration;
+    total_stop += times.stop_duration;
+    if (last == nullptr || path_to(module) > path_to(last)) {
+      last = module;
+    }
+  }
+  report << "  Total start:" << total_start.count() << "us stop:" << total_stop.count() << "us\n";
+
+  if (last != nullptr) {
+    report << "  Critical path " << path_to(last).count() << "us:";
+    std::vector<std::string> path;
+    for (auto module = last; module != nullptr;) {
+      path.push_back(module_times_.at(module).name);
+      auto dependency = critical_dependency.find(module);
+      module = dependency != critical_dependency.end() ? dependency->second : nullptr;
+    }
+    for (auto it = path.rbegin(); it != path.rend(); it++) {
+      report << " " << *it;
+    }
+    report << "\n";
+  }
+  return report.str();
+}
+
 os::Handler* ModuleRegistry::GetModuleHandler(const ModuleFactory* module) const {
+  std::lock_guard<std::mutex> lock(mutex_);
   auto started_instance = started_modules_.find(module);
   if (started_instance != started_modules_.end()) {
     return started_instance->second->GetHandler();
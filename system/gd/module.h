@@ -21,6 +21,7 @@
 #include <functional>
 #include <future>
 #include <map>
+#include <mutex>
 #include <string>
 #include <utility>
 #include <vector>
@@ -139,6 +140,10 @@ class ModuleRegistry {
   // in dependency order
   void Start(ModuleList* modules, ::bluetooth::os::Thread* thread);
 
+  // Same as Start(), but modules that do not depend on each other
+  // are started concurrently
+  void StartInParallel(ModuleList* modules, ::bluetooth::os::Thread* thread);
+
   template <class T>
   T* Start(::bluetooth::os::Thread* thread) {
     return static_cast<T*>(Start(&T::Factory, thread));
@@ -149,16 +154,33 @@ class ModuleRegistry {
   // Stop all running modules in reverse order of start
   void StopAll();
 
+  // How long each module took to start and stop, and the chain of
+  // dependencies that bounded the start up time
+  std::string GetStartUpReport() const;
+
  protected:
+  struct ModuleTimes {
+    std::string name;
+    std::vector<const ModuleFactory*> dependencies;
+    std::chrono::microseconds start_duration{};
+    std::chrono::microseconds stop_duration{};
+  };
+
   Module* Get(const ModuleFactory* module) const;
 
   void set_registry_and_handler(Module* instance, ::bluetooth::os::Thread* thread) const;
 
   os::Handler* GetModuleHandler(const ModuleFactory* module) const;
 
+  // Calls Start() of a module whose dependencies are started, and registers it
+  void start_instance(const ModuleFactory* module, Module* instance);
+
   std::map<const ModuleFactory*, Module*> started_modules_;
   std::vector<const ModuleFactory*> start_order_;
   std::string last_instance_;
+  std::map<const ModuleFactory*, ModuleTimes> module_times_;
+  // Guards the members above while modules start concurrently
+  mutable std::mutex mutex_;
 };
 
 class TestModuleRegistry : public ModuleRegistry {
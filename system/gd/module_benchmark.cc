@@ -0,0 +1,111 @@
+/*
+ * Copyright 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <chrono>
+#include <string>
+#include <thread>
+
+#include "benchmark/benchmark.h"
+#include "module.h"
+#include "os/thread.h"
+
+using ::benchmark::State;
+using ::bluetooth::Module;
+using ::bluetooth::ModuleFactory;
+using ::bluetooth::ModuleList;
+using ::bluetooth::ModuleRegistry;
+using ::bluetooth::os::Thread;
+
+namespace {
+
+// Stands in for a stack module whose Start() waits |kStartMs| on the controller
+template <int kId, int kStartMs, class... Dependencies>
+class FakeModule : public Module {
+ public:
+  static const ModuleFactory Factory;
+
+ protected:
+  void ListDependencies([[maybe_unused]] ModuleList* list) const override {
+    (list->add<Dependencies>(), ...);
+  }
+
+  void Start() override {
+    std::this_thread::sleep_for(std::chrono::milliseconds(kStartMs));
+  }
+
+  void Stop() override {}
+
+  std::string ToString() const override {
+    return "FakeModule" + std::to_string(kId);
+  }
+};
+
+template <int kId, int kStartMs, class... Dependencies>
+const ModuleFactory FakeModule<kId, kStartMs, Dependencies...>::Factory =
+    ModuleFactory([]() { return new FakeModule<kId, kStartMs, Dependencies...>(); });
+
+// Roughly the shape and start up costs of the GD stack modules
+using FakeHal = FakeModule<0, 1>;
+using FakeHciLayer = FakeModule<1, 2, FakeHal>;
+using FakeStorage = FakeModule<2, 3>;
+using FakeController = FakeModule<3, 5, FakeHciLayer>;
+using FakeAclManager = FakeModule<4, 2, FakeController, FakeStorage>;
+using FakeLeAdvertising = FakeModule<5, 2, FakeController>;
+using FakeLeScanning = FakeModule<6, 2, FakeController, FakeStorage>;
+using FakeSecurity = FakeModule<7, 3, FakeAclManager, FakeStorage>;
+using FakeShim = FakeModule<8, 1, FakeSecurity, FakeLeAdvertising, FakeLeScanning>;
+
+class BM_ModuleRegistry : public ::benchmark::Fixture {
+ protected:
+  void SetUp(State& st) override {
+    benchmark::Fixture::SetUp(st);
+    thread_ = new Thread("BM_ModuleRegistry thread", Thread::Priority::NORMAL);
+  }
+
+  void TearDown(State& st) override {
+    delete thread_;
+    thread_ = nullptr;
+    benchmark::Fixture::TearDown(st);
+  }
+
+  Thread* thread_ = nullptr;
+};
+
+BENCHMARK_DEFINE_F(BM_ModuleRegistry, start_stop)(State& state) {
+  for (auto _ : state) {
+    ModuleRegistry registry;
+    ModuleList list;
+    list.add<FakeShim>();
+    registry.Start(&list, thread_);
+    registry.StopAll();
+  }
+};
+
+BENCHMARK_REGISTER_F(BM_ModuleRegistry, start_stop)->Iterations(20)->UseRealTime();
+
+BENCHMARK_DEFINE_F(BM_ModuleRegistry, start_stop_in_parallel)(State& state) {
+  for (auto _ : state) {
+    ModuleRegistry registry;
+    ModuleList list;
+    list.add<FakeShim>();
+    registry.StartInParallel(&list, thread_);
+    registry.StopAll();
+  }
+};
+
+BENCHMARK_REGISTER_F(BM_ModuleRegistry, start_stop_in_parallel)->Iterations(20)->UseRealTime();
+
+}  // namespace
@@ -272,6 +272,42 @@ TEST_F(ModuleTest, two_dependencies) {
   EXPECT_FALSE(registry_->IsStarted<TestModuleTwoDependencies>());
 }
 
+TEST_F(ModuleTest, two_dependencies_in_parallel) {
+  ModuleList list;
+  list.add<TestModuleTwoDependencies>();
+  registry_->StartInParallel(&list, thread_);
+
+  EXPECT_TRUE(registry_->IsStarted<TestModuleNoDependency>());
+  EXPECT_TRUE(registry_->IsStarted<TestModuleOneDependency>());
+  EXPECT_TRUE(registry_->IsStarted<TestModuleNoDependencyTwo>());
+  EXPECT_TRUE(registry_->IsStarted<TestModuleTwoDependencies>());
+
+  registry_->StopAll();
+
+  EXPECT_FALSE(registry_->IsStarted<TestModuleNoDependency>());
+  EXPECT_FALSE(registry_->IsStarted<TestModuleOneDependency>());
+  EXPECT_FALSE(registry_->IsStarted<TestModuleNoDependencyTwo>());
+  EXPECT_FALSE(registry_->IsStarted<TestModuleTwoDependencies>());
+}
+
+TEST_F(ModuleTest, start_up_report) {
+  ModuleList list;
+  list.add<TestModuleTwoDependencies>();
+  registry_->Start(&list, thread_);
+  registry_->StopAll();
+
+  std::string report = registry_->GetStartUpReport();
+  EXPECT_NE(report.find("TestModuleNoDependency start:"), std::string::npos);
+  EXPECT_NE(report.find("TestModuleNoDependencyTwo start:"), std::string::npos);
+  EXPECT_NE(report.find("TestModuleOneDependency start:"), std::string::npos);
+  EXPECT_NE(report.find("TestModuleTwoDependencies start:"), std::string::npos);
+
+  // The critical path ends with the module that depends on every other one
+  auto critical_path = report.find("Critical path");
+  ASSERT_NE(critical_path, std::string::npos);
+  EXPECT_NE(report.find(" TestModuleTwoDependencies\n", critical_path), std::string::npos);
+}
+
 void post_to_module_one_handler() {
   std::this_thread::sleep_for(std::chrono::milliseconds(100));
   test_module_one_dependency_handler->Post(common::BindOnce([] { FAIL(); }));
@@ -20,6 +20,7 @@
 
 #include "common/bind.h"
 #include "common/callback.h"
+#include "common/task_tracer.h"
 #include "os/log.h"
 #include "os/reactor.h"
 #include "os/utils.h"
@@ -28,7 +29,7 @@ namespace bluetooth {
 namespace os {
 using common::OnceClosure;
 
-Handler::Handler(Thread* thread) : tasks_(new std::queue<OnceClosure>()), thread_(thread) {
+Handler::Handler(Thread* thread) : tasks_(new std::queue<Task>()), thread_(thread) {
   event_ = thread_->GetReactor()->NewEvent();
   reactable_ = thread_->GetReactor()->Register(
       event_->Id(), common::Bind(&Handler::handle_next_event, common::Unretained(this)), common::Closure());
@@ -43,19 +44,26 @@ Handler::~Handler() {
 }
 
 void Handler::Post(OnceClosure closure) {
+  // Closures carry no location, so the caller address stands for the post site.
+  const void* post_site = nullptr;
+  uint64_t post_us = 0;
+  if (common::TaskTracer::IsEnabled()) {
+    post_site = __builtin_return_address(0);
+    post_us = common::TaskTracer::NowUs();
+  }
   {
     std::lock_guard<std::mutex> lock(mutex_);
     if (was_cleared()) {
       LOG_WARN("Posting to a handler which has been cleared");
       return;
     }
-    tasks_->emplace(std::move(closure));
+    tasks_->push(Task{std::move(closure), post_site, post_us});
   }
   event_->Notify();
 }
 
 void Handler::Clear() {
-  std::queue<OnceClosure>* tmp = nullptr;
+  std::queue<Task>* tmp = nullptr;
   {
     std::lock_guard<std::mutex> lock(mutex_);
     ASSERT_LOG(!was_cleared(), "Handlers must only be cleared once");
@@ -75,7 +83,7 @@ void Handler::WaitUntilStopped(std::chrono::milliseconds timeout) {
 }
 
 void Handler::handle_next_event() {
-  common::OnceClosure closure;
+  Task task;
   {
     std::lock_guard<std::mutex> lock(mutex_);
     bool has_data = event_->Read();
@@ -85,10 +93,23 @@ void Handler::handle_next_event() {
     }
     ASSERT_LOG(has_data, "Notified for work but no work available");
 
-    closure = std::move(tasks_->front());
+    task = std::move(tasks_->front());
     tasks_->pop();
   }
-  std::move(closure).Run();
+  if (task.post_us == 0) {
+    std::move(task.closure).Run();
+    return;
+  }
+
+  // The closure may destroy this handler, so nothing of it is used after the closure ran.
+  common::TaskTraceBuffer* trace_buffer = thread_->GetTaskTraceBuffer();
+  common::TaskTrace trace;
+  trace.program_counter = task.post_site;
+  trace.ready_us = task.post_us;
+  trace.start_us = common::TaskTracer::NowUs();
+  std::move(task.closure).Run();
+  trace.end_us = common::TaskTracer::NowUs();
+  trace_buffer->Record(trace);
 }
 
 }  // namespace os
@@ -98,10 +98,17 @@ class Handler : public common::IPostableContext {
   friend class RepeatingAlarm;
 
  private:
+  // A posted closure, with its post site and post time when task tracing is enabled
+  struct Task {
+    common::OnceClosure closure;
+    const void* post_site = nullptr;
+    uint64_t post_us = 0;
+  };
+
   inline bool was_cleared() const {
     return tasks_ == nullptr;
   };
-  std::queue<common::OnceClosure>* tasks_;
+  std::queue<Task>* tasks_;
   Thread* thread_;
   std::unique_ptr<Reactor::Event> event_;
   Reactor::Reactable* reactable_;
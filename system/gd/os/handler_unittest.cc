@@ -21,6 +21,7 @@
 
 #include "common/bind.h"
 #include "common/callback.h"
+#include "common/task_tracer.h"
 #include "gtest/gtest.h"
 #include "os/log.h"
 
@@ -64,6 +65,23 @@ TEST_F(HandlerTest, post_task_invoked) {
   handler_->Clear();
 }
 
+TEST_F(HandlerTest, post_task_traced_when_enabled) {
+  common::TaskTracer::SetEnabled(true);
+  handler_->Post(common::BindOnce([] {}));
+  common::TaskTracer::SetEnabled(false);
+  std::promise<void> closure_ran;
+  auto future = closure_ran.get_future();
+  handler_->Post(common::BindOnce(&std::promise<void>::set_value, common::Unretained(&closure_ran)));
+  future.wait();
+
+  // Only the first task was posted while tracing was enabled.
+  auto tasks = thread_->GetTaskTraceBuffer()->GetRecentTasks();
+  ASSERT_EQ(tasks.size(), 1u);
+  ASSERT_NE(tasks[0].program_counter, nullptr);
+  ASSERT_GE(tasks[0].end_us, tasks[0].start_us);
+  handler_->Clear();
+}
+
 TEST_F(HandlerTest, post_task_cleared) {
   int val = 0;
   std::promise<void> closure_started;
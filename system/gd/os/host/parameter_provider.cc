@@ -32,6 +32,7 @@ std::mutex parameter_mutex;
 std::string config_file_path;
 std::string snoop_log_file_path;
 std::string snooz_log_file_path;
+std::string controller_snapshot_file_path;
 }  // namespace
 
 // Write to $PWD/bt_stack.conf if $PWD can be found, otherwise, write to $HOME/bt_stack.conf
@@ -96,6 +97,22 @@ void ParameterProvider::OverrideSnoozLogFilePath(const std::string& path) {
   snooz_log_file_path = path;
 }
 
+// Host builds only persist the snapshot when a path is given
+std::string ParameterProvider::ControllerSnapshotFilePath() {
+  {
+    std::lock_guard<std::mutex> lock(parameter_mutex);
+    if (!controller_snapshot_file_path.empty()) {
+      return controller_snapshot_file_path;
+    }
+  }
+  return "";
+}
+
+void ParameterProvider::OverrideControllerSnapshotFilePath(const std::string& path) {
+  std::lock_guard<std::mutex> lock(parameter_mutex);
+  controller_snapshot_file_path = path;
+}
+
 std::string ParameterProvider::SyspropsFilePath() {
   return "";
 }
@@ -32,6 +32,7 @@ std::mutex parameter_mutex;
 std::string config_file_path;
 std::string snoop_log_file_path;
 std::string snooz_log_file_path;
+std::string controller_snapshot_file_path;
 std::string sysprops_file_path;
 }  // namespace
 
@@ -77,6 +78,21 @@ std::string ParameterProvider::SnoozLogFilePath() {
   return "/var/log/bluetooth/btsnooz_hci.log";
 }
 
+std::string ParameterProvider::ControllerSnapshotFilePath() {
+  {
+    std::lock_guard<std::mutex> lock(parameter_mutex);
+    if (!controller_snapshot_file_path.empty()) {
+      return controller_snapshot_file_path;
+    }
+  }
+  return "/var/lib/bluetooth/bt_controller_snapshot";
+}
+
+void ParameterProvider::OverrideControllerSnapshotFilePath(const std::string& path) {
+  std::lock_guard<std::mutex> lock(parameter_mutex);
+  controller_snapshot_file_path = path;
+}
+
 std::string ParameterProvider::SyspropsFilePath() {
   {
     std::lock_guard<std::mutex> lock(parameter_mutex);
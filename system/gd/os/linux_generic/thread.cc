@@ -33,7 +33,7 @@ constexpr int kRealTimeFifoSchedulingPriority = 1;
 }
 
 Thread::Thread(const std::string& name, const Priority priority)
-    : name_(name), reactor_(), running_thread_(&Thread::run, this, priority) {}
+    : name_(name), reactor_(), trace_buffer_(name), running_thread_(&Thread::run, this, priority) {}
 
 void Thread::run(Priority priority) {
   if (priority == Priority::REAL_TIME) {
@@ -72,6 +72,10 @@ Reactor* Thread::GetReactor() const {
   return &reactor_;
 }
 
+common::TaskTraceBuffer* Thread::GetTaskTraceBuffer() {
+  return &trace_buffer_;
+}
+
 std::string Thread::GetThreadName() const {
   return name_;
 }
@@ -40,6 +40,12 @@ class ParameterProvider {
 
   static void OverrideSnoozLogFilePath(const std::string& path);
 
+  // Return the path to the controller capabilities snapshot, or an empty string if the snapshot
+  // should not be persisted
+  static std::string ControllerSnapshotFilePath();
+
+  static void OverrideControllerSnapshotFilePath(const std::string& path);
+
   // Return the path to the default sysprops file
   static std::string SyspropsFilePath();
 
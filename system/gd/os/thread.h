@@ -20,6 +20,7 @@
 #include <string>
 #include <thread>
 
+#include "common/task_tracer.h"
 #include "os/reactor.h"
 #include "os/utils.h"
 
@@ -64,11 +65,15 @@ class Thread {
   // Return the pointer of underlying reactor. The ownership is NOT transferred.
   Reactor* GetReactor() const;
 
+  // Return the buffer recording the tasks run by this thread. Must only be written from this thread.
+  common::TaskTraceBuffer* GetTaskTraceBuffer();
+
  private:
   void run(Priority priority);
   mutable std::mutex mutex_;
   const std::string name_;
   mutable Reactor reactor_;
+  common::TaskTraceBuffer trace_buffer_;
   std::thread running_thread_;
 };
 
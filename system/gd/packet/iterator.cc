@@ -130,7 +130,7 @@ uint8_t Iterator<little_endian>::operator*() const {
       end_);
   size_t index = index_;
 
-  for (auto view : data_) {
+  for (const auto& view : data_) {
     if (index < view.size()) {
       return view[index];
     }
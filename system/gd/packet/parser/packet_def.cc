@@ -89,7 +89,9 @@ void PacketDef::GenParserDefinition(std::ostream& s, bool generate_fuzzing, bool
   // Constructor from a View
   if (parent_ != nullptr) {
     s << "explicit " << name_ << "View(" << parent_->name_ << "View parent)";
-    s << " : " << parent_->name_ << "View(std::move(parent)) { was_validated_ = false; }";
+    // The parent fields do not need to be validated again if the parent view already was
+    s << " : " << parent_->name_ << "View(std::move(parent)) {";
+    s << "parent_was_validated_ = was_validated_; was_validated_ = false; }";
   } else {
     s << "explicit " << name_ << "View(PacketView<" << (is_little_endian_ ? "" : "!") << "kLittleEndian> packet) ";
     s << " : PacketView<" << (is_little_endian_ ? "" : "!") << "kLittleEndian>(packet) { was_validated_ = false;}";
@@ -212,7 +214,7 @@ void PacketDef::GenValidator(std::ostream& s) const {
     s << "virtual bool Validate() const {" << std::endl;
   } else {
     s << "bool Validate() const override {" << std::endl;
-    s << "  if (!" << parent_->name_ << "View::Validate()) {" << std::endl;
+    s << "  if (!parent_was_validated_ && !" << parent_->name_ << "View::Validate()) {" << std::endl;
     s << "    return false;" << std::endl;
     s << "  }" << std::endl;
   }
@@ -343,6 +345,7 @@ void PacketDef::GenValidator(std::ostream& s) const {
   s << "}\n";
   if (parent_ == nullptr) {
     s << "bool was_validated_{false};\n";
+    s << "bool parent_was_validated_{false};\n";
   }
 }
 
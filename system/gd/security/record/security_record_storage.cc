@@ -131,57 +131,49 @@ void SecurityRecordStorage::SaveSecurityRecords(std::set<std::shared_ptr<record:
 }
 
 void SecurityRecordStorage::LoadSecurityRecords(std::set<std::shared_ptr<record::SecurityRecord>>* records) {
-  for (auto device : storage_module_->GetBondedDevices()) {
-    auto address_type = (device.GetDeviceType() == hci::DeviceType::BR_EDR) ? hci::AddressType::PUBLIC_DEVICE_ADDRESS
-                                                                            : device.Le().GetAddressType();
-    auto address_with_type = hci::AddressWithType(device.GetAddress(), *address_type);
+  for (const auto& device : storage_module_->GetBondedDeviceRecords()) {
+    bool is_classic_only =
+        device->Has(storage::DeviceProperty::DEVICE_TYPE) && device->device_type == hci::DeviceType::BR_EDR;
+    bool is_le_only = device->Has(storage::DeviceProperty::DEVICE_TYPE) && device->device_type == hci::DeviceType::LE;
+    auto address_type = is_classic_only ? hci::AddressType::PUBLIC_DEVICE_ADDRESS : device->le_address_type;
+    auto address_with_type = hci::AddressWithType(device->address, address_type);
 
     auto record = std::make_shared<record::SecurityRecord>(address_with_type);
-    if (device.GetDeviceType() != hci::DeviceType::LE) {
-      record->SetLinkKey(device.Classic().GetLinkKey()->bytes, *device.Classic().GetLinkKeyType());
+    if (!is_le_only && device->Has(storage::DeviceProperty::LINK_KEY)) {
+      record->SetLinkKey(device->link_key.bytes, device->link_key_type);
     }
-    if (device.GetDeviceType() != hci::DeviceType::BR_EDR) {
-      record->pseudo_address_ = std::make_optional<hci::AddressWithType>(
-          *device.Le().GetLegacyPseudoAddress(), *device.Le().GetAddressType());
-
-      if (device.Le().GetPeerId()) {
-        auto peerid = common::ByteArray<23>::FromString(*device.Le().GetPeerId());
-        record->remote_irk = std::make_optional<std::array<uint8_t, 16>>();
-        std::copy_n(peerid->data(), record->remote_irk->size(), record->remote_irk->data());
-
-        uint8_t idaddress_type;
-        hci::Address idaddress;
-        std::copy_n(peerid->data() + 16, 1, &idaddress_type);
-        std::copy_n(peerid->data() + 17, 6, idaddress.data());
-        record->identity_address_ =
-            std::make_optional<hci::AddressWithType>(idaddress, static_cast<hci::AddressType>(idaddress_type));
+    if (!is_classic_only) {
+      if (device->Has(storage::DeviceProperty::LE_LEGACY_PSEUDO_ADDRESS)) {
+        record->pseudo_address_ =
+            std::make_optional<hci::AddressWithType>(device->le_legacy_pseudo_address, device->le_address_type);
       }
 
-      if (device.Le().GetPeerEncryptionKeys()) {
-        auto peer_encryption_keys = common::ByteArray<28>::FromString(*device.Le().GetPeerEncryptionKeys());
-        record->remote_ltk = std::make_optional<std::array<uint8_t, 16>>();
-        record->remote_rand = std::make_optional<std::array<uint8_t, 8>>();
-        record->remote_ediv = std::make_optional(0);
-
-        std::copy_n(peer_encryption_keys->data(), 16, record->remote_ltk->data());
-        std::copy_n(peer_encryption_keys->data() + 16, 8, record->remote_rand->data());
-        std::copy_n(peer_encryption_keys->data() + 24, 2, &(*record->remote_ediv));
-        record->security_level = peer_encryption_keys->data()[26];
-        record->key_size = peer_encryption_keys->data()[27];
+      if (device->Has(storage::DeviceProperty::LE_PEER_ID)) {
+        const auto& peer_id = device->le_peer_id;
+        record->remote_irk = std::make_optional<std::array<uint8_t, 16>>(peer_id.irk);
+        record->identity_address_ =
+            std::make_optional<hci::AddressWithType>(peer_id.identity_address, peer_id.identity_address_type);
       }
 
-      if (device.Le().GetPeerSignatureResolvingKeys()) {
-        auto peer_signature_resolving_keys =
-            common::ByteArray<21>::FromString(*device.Le().GetPeerSignatureResolvingKeys());
-        record->remote_signature_key = std::make_optional<std::array<uint8_t, 16>>();
+      if (device->Has(storage::DeviceProperty::LE_PEER_ENCRYPTION_KEYS)) {
+        const auto& peer_encryption_keys = device->le_peer_encryption_keys;
+        record->remote_ltk = std::make_optional<std::array<uint8_t, 16>>(peer_encryption_keys.ltk);
+        record->remote_rand = std::make_optional<std::array<uint8_t, 8>>(peer_encryption_keys.rand);
+        record->remote_ediv = std::make_optional(peer_encryption_keys.ediv);
+        record->security_level = peer_encryption_keys.security_level;
+        record->key_size = peer_encryption_keys.key_size;
+      }
 
-        std::copy_n(peer_signature_resolving_keys->data() + 4, 16, record->remote_signature_key->data());
-        record->security_level = peer_signature_resolving_keys->data()[20];
+      if (device->Has(storage::DeviceProperty::LE_PEER_SIGNATURE_RESOLVING_KEYS)) {
+        const auto& peer_signature_resolving_keys = device->le_peer_signature_resolving_keys;
+        record->remote_signature_key =
+            std::make_optional<std::array<uint8_t, 16>>(peer_signature_resolving_keys.csrk);
+        record->security_level = peer_signature_resolving_keys.security_level;
       }
     }
-    record->SetIsEncryptionRequired(device.GetIsEncryptionRequired() == 1 ? true : false);
-    record->SetAuthenticated(device.GetIsAuthenticated() == 1 ? true : false);
-    record->SetRequiresMitmProtection(device.GetRequiresMitmProtection() == 1 ? true : false);
+    record->SetIsEncryptionRequired(device->is_encryption_required == 1 ? true : false);
+    record->SetAuthenticated(device->is_authenticated == 1 ? true : false);
+    record->SetRequiresMitmProtection(device->requires_mitm_protection == 1 ? true : false);
     records->insert(record);
   }
 }
@@ -139,6 +139,10 @@ void Dumpsys::impl::DumpWithArgsAsync(int fd, const char** args) {
   std::string dumpsys_data;
   dumper.DumpState(&dumpsys_data);
 
+  // Plain text, kept ahead of the JSON so that the JSON can be parsed as is
+  dprintf(fd, " ----- Module Start Up -----\n");
+  dprintf(fd, "%s", registry->GetStartUpReport().c_str());
+
   dprintf(fd, " ----- Filtering as Developer -----\n");
   FilterAsDeveloper(&dumpsys_data);
 
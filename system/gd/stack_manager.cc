@@ -35,6 +35,8 @@ using ::bluetooth::os::WakelockManager;
 
 namespace bluetooth {
 
+static const char kPropertyParallelStart[] = "bluetooth.gd.parallel_start";
+
 void StackManager::StartUp(ModuleList* modules, Thread* stack_thread) {
   management_thread_ = new Thread("management_thread", Thread::Priority::NORMAL);
   handler_ = new Handler(management_thread_);
@@ -62,7 +64,12 @@ void StackManager::StartUp(ModuleList* modules, Thread* stack_thread) {
 }
 
 void StackManager::handle_start_up(ModuleList* modules, Thread* stack_thread, std::promise<void> promise) {
-  registry_.Start(modules, stack_thread);
+  if (os::GetSystemPropertyBool(kPropertyParallelStart, /* default_value = */ false)) {
+    registry_.StartInParallel(modules, stack_thread);
+  } else {
+    registry_.Start(modules, stack_thread);
+  }
+  LOG_INFO("Stack started\n%s", registry_.GetStartUpReport().c_str());
   promise.set_value();
 }
 
@@ -16,6 +16,8 @@
 
 #include "storage/config_cache.h"
 
+#include <algorithm>
+#include <atomic>
 #include <ios>
 #include <sstream>
 #include <utility>
@@ -58,6 +60,9 @@ const std::string ConfigCache::kDefaultSectionName = "Global";
 
 std::string kEncryptedStr = "encrypted";
 
+// Shared by all caches, so that revisions stay unique when a cache is moved into another one
+static std::atomic<uint64_t> next_section_revision = 0;
+
 ConfigCache::ConfigCache(size_t temp_device_capacity, std::unordered_set<std::string_view> persistent_property_names)
     : persistent_property_names_(std::move(persistent_property_names)),
       information_sections_(),
@@ -78,6 +83,7 @@ ConfigCache::ConfigCache(ConfigCache&& other) noexcept
   ASSERT_LOG(
       other.persistent_config_changed_callback_ == nullptr,
       "Can't assign after setting the callback");
+  other.OnAllSectionsChanged();
 }
 
 ConfigCache& ConfigCache::operator=(ConfigCache&& other) noexcept {
@@ -94,6 +100,8 @@ ConfigCache& ConfigCache::operator=(ConfigCache&& other) noexcept {
   information_sections_ = std::move(other.information_sections_);
   persistent_devices_ = std::move(other.persistent_devices_);
   temporary_devices_ = std::move(other.temporary_devices_);
+  OnAllSectionsChanged();
+  other.OnAllSectionsChanged();
   return *this;
 }
 
@@ -113,10 +121,12 @@ void ConfigCache::Clear() {
   std::lock_guard<std::recursive_mutex> lock(mutex_);
   if (information_sections_.size() > 0) {
     information_sections_.clear();
+    OnAllSectionsChanged();
     PersistentConfigChangedCallback();
   }
   if (persistent_devices_.size() > 0) {
     persistent_devices_.clear();
+    OnAllSectionsChanged();
     PersistentConfigChangedCallback();
   }
   if (temporary_devices_.size() > 0) {
@@ -125,56 +135,65 @@ void ConfigCache::Clear() {
 }
 
 bool ConfigCache::HasSection(const std::string& section) const {
+  if (GetSnapshot()->sections.count(section) > 0) {
+    return true;
+  }
   std::lock_guard<std::recursive_mutex> lock(mutex_);
-  return information_sections_.contains(section) || persistent_devices_.contains(section) ||
-         temporary_devices_.contains(section);
+  // the section might have moved from temporary_devices_ into the snapshot since it was read, re-read the snapshot
+  // with mutex_ held so that one of the two lookups sees it
+  return temporary_devices_.contains(section) || GetSnapshot()->sections.count(section) > 0;
 }
 
 bool ConfigCache::HasProperty(const std::string& section, const std::string& property) const {
-  std::lock_guard<std::recursive_mutex> lock(mutex_);
-  auto section_iter = information_sections_.find(section);
-  if (section_iter != information_sections_.end()) {
-    return section_iter->second.find(property) != section_iter->second.end();
-  }
-  section_iter = persistent_devices_.find(section);
-  if (section_iter != persistent_devices_.end()) {
-    return section_iter->second.find(property) != section_iter->second.end();
-  }
-  section_iter = temporary_devices_.find(section);
-  if (section_iter != temporary_devices_.end()) {
-    return section_iter->second.find(property) != section_iter->second.end();
+  // sections are unique among all three maps, hence a section found in the snapshot has the answer
+  auto snapshot = GetSnapshot();
+  auto snapshot_section_iter = snapshot->sections.find(section);
+  if (snapshot_section_iter == snapshot->sections.end()) {
+    std::lock_guard<std::recursive_mutex> lock(mutex_);
+    auto section_iter = temporary_devices_.find(section);
+    if (section_iter != temporary_devices_.end()) {
+      return section_iter->second.find(property) != section_iter->second.end();
+    }
+    // not temporary, but it might have been when the snapshot was read, the snapshot read with mutex_ held is current
+    snapshot = GetSnapshot();
+    snapshot_section_iter = snapshot->sections.find(section);
+    if (snapshot_section_iter == snapshot->sections.end()) {
+      return false;
+    }
   }
-  return false;
+  return snapshot_section_iter->second->Find(*snapshot->property_ids, property) != nullptr;
 }
 
 std::optional<std::string> ConfigCache::GetProperty(const std::string& section, const std::string& property) const {
-  std::lock_guard<std::recursive_mutex> lock(mutex_);
-  auto section_iter = information_sections_.find(section);
-  if (section_iter != information_sections_.end()) {
-    auto property_iter = section_iter->second.find(property);
-    if (property_iter != section_iter->second.end()) {
-      return property_iter->second;
-    }
-  }
-  section_iter = persistent_devices_.find(section);
-  if (section_iter != persistent_devices_.end()) {
-    auto property_iter = section_iter->second.find(property);
-    if (property_iter != section_iter->second.end()) {
-      std::string value = property_iter->second;
-      if (os::ParameterProvider::GetBtKeystoreInterface() != nullptr && value == kEncryptedStr) {
-        return os::ParameterProvider::GetBtKeystoreInterface()->get_key(section + "-" + property);
+  // sections are unique among all three maps, hence a section found in the snapshot has the answer
+  auto snapshot = GetSnapshot();
+  auto snapshot_section_iter = snapshot->sections.find(section);
+  if (snapshot_section_iter == snapshot->sections.end()) {
+    std::lock_guard<std::recursive_mutex> lock(mutex_);
+    auto section_iter = temporary_devices_.find(section);
+    if (section_iter != temporary_devices_.end()) {
+      auto property_iter = section_iter->second.find(property);
+      if (property_iter != section_iter->second.end()) {
+        return property_iter->second;
       }
-      return value;
+      return std::nullopt;
     }
-  }
-  section_iter = temporary_devices_.find(section);
-  if (section_iter != temporary_devices_.end()) {
-    auto property_iter = section_iter->second.find(property);
-    if (property_iter != section_iter->second.end()) {
-      return property_iter->second;
+    // not temporary, but it might have been when the snapshot was read, the snapshot read with mutex_ held is current
+    snapshot = GetSnapshot();
+    snapshot_section_iter = snapshot->sections.find(section);
+    if (snapshot_section_iter == snapshot->sections.end()) {
+      return std::nullopt;
     }
   }
-  return std::nullopt;
+  const std::string* value = snapshot_section_iter->second->Find(*snapshot->property_ids, property);
+  if (value == nullptr) {
+    return std::nullopt;
+  }
+  if (snapshot_section_iter->second->is_persistent_device &&
+      os::ParameterProvider::GetBtKeystoreInterface() != nullptr && *value == kEncryptedStr) {
+    return os::ParameterProvider::GetBtKeystoreInterface()->get_key(section + "-" + property);
+  }
+  return *value;
 }
 
 void ConfigCache::SetProperty(std::string section, std::string property, std::string value) {
@@ -190,6 +209,7 @@ void ConfigCache::SetProperty(std::string section, std::string property, std::st
       section_iter = information_sections_.try_emplace_back(section, common::ListMap<std::string, std::string>{}).first;
     }
     section_iter->second.insert_or_assign(property, std::move(value));
+    OnSectionChanged(section);
     PersistentConfigChangedCallback();
     return;
   }
@@ -213,6 +233,7 @@ void ConfigCache::SetProperty(std::string section, std::string property, std::st
       }
     }
     section_iter->second.insert_or_assign(property, std::move(value));
+    OnSectionChanged(section);
     PersistentConfigChangedCallback();
     return;
   }
@@ -228,6 +249,7 @@ bool ConfigCache::RemoveSection(const std::string& section) {
   std::lock_guard<std::recursive_mutex> lock(mutex_);
   // sections are unique among all three maps, hence removing from one of them is enough
   if (information_sections_.extract(section) || persistent_devices_.extract(section)) {
+    OnSectionChanged(section);
     PersistentConfigChangedCallback();
     return true;
   } else {
@@ -245,6 +267,7 @@ bool ConfigCache::RemoveProperty(const std::string& section, const std::string&
       information_sections_.erase(section_iter);
     }
     if (value.has_value()) {
+      OnSectionChanged(section);
       PersistentConfigChangedCallback();
       return true;
     } else {
@@ -263,6 +286,7 @@ bool ConfigCache::RemoveProperty(const std::string& section, const std::string&
       temporary_devices_.insert_or_assign(section, std::move(section_properties->second));
     }
     if (value.has_value()) {
+      OnSectionChanged(section);
       PersistentConfigChangedCallback();
       if (os::ParameterProvider::GetBtKeystoreInterface() != nullptr && os::ParameterProvider::IsCommonCriteriaMode() &&
           InEncryptKeyNameList(property)) {
@@ -328,6 +352,7 @@ void ConfigCache::RemoveSectionWithProperty(const std::string& property) {
     for (auto it = config_section->begin(); it != config_section->end();) {
       if (it->second.contains(property)) {
         LOG_INFO("Removing persistent section %s with property %s", it->first.c_str(), property.c_str());
+        OnSectionChanged(it->first);
         it = config_section->erase(it);
         num_persistent_removed++;
         continue;
@@ -349,13 +374,7 @@ void ConfigCache::RemoveSectionWithProperty(const std::string& property) {
 }
 
 std::vector<std::string> ConfigCache::GetPersistentSections() const {
-  std::lock_guard<std::recursive_mutex> lock(mutex_);
-  std::vector<std::string> paired_devices;
-  paired_devices.reserve(persistent_devices_.size());
-  for (const auto& elem : persistent_devices_) {
-    paired_devices.emplace_back(elem.first);
-  }
-  return paired_devices;
+  return GetSnapshot()->persistent_sections;
 }
 
 void ConfigCache::Commit(std::queue<MutationEntry>& mutation_entries) {
@@ -473,6 +492,7 @@ bool ConfigCache::FixDeviceTypeInconsistencies() {
   for (auto* config_section : {&information_sections_, &persistent_devices_}) {
     for (auto& elem : *config_section) {
       if (FixDeviceTypeInconsistencyInSection(elem.first, elem.second)) {
+        OnSectionChanged(elem.first);
         persistent_device_changed = true;
       }
     }
@@ -518,8 +538,136 @@ bool ConfigCache::HasAtLeastOneMatchingPropertiesInSection(
 }
 
 bool ConfigCache::IsPersistentSection(const std::string& section) const {
+  auto snapshot = GetSnapshot();
+  auto section_iter = snapshot->sections.find(section);
+  return section_iter != snapshot->sections.end() && section_iter->second->is_persistent_device;
+}
+
+std::optional<uint64_t> ConfigCache::GetPersistentSectionRevision(const std::string& section) const {
+  auto snapshot = GetSnapshot();
+  auto section_iter = snapshot->sections.find(section);
+  if (section_iter == snapshot->sections.end() || !section_iter->second->is_persistent_device) {
+    return std::nullopt;
+  }
+  return section_iter->second->revision;
+}
+
+const std::string* ConfigCache::Snapshot::Section::Find(
+    const PropertyIds& property_ids, const std::string& property) const {
+  auto id_iter = property_ids.find(property);
+  if (id_iter == property_ids.end()) {
+    return nullptr;
+  }
+  auto property_iter = std::lower_bound(
+      properties.begin(), properties.end(), id_iter->second, [](const auto& entry, uint32_t id) {
+        return entry.first < id;
+      });
+  if (property_iter == properties.end() || property_iter->first != id_iter->second) {
+    return nullptr;
+  }
+  return &property_iter->second;
+}
+
+std::shared_ptr<const ConfigCache::Snapshot> ConfigCache::GetSnapshot() const {
+  auto snapshot = std::atomic_load(&snapshot_);
+  if (snapshot != nullptr) {
+    return snapshot;
+  }
   std::lock_guard<std::recursive_mutex> lock(mutex_);
-  return persistent_devices_.contains(section);
+  // another reader might have built it while we were waiting for the lock
+  snapshot = std::atomic_load(&snapshot_);
+  if (snapshot == nullptr) {
+    snapshot = BuildSnapshot();
+    std::atomic_store(&snapshot_, snapshot);
+  }
+  return snapshot;
+}
+
+std::shared_ptr<const ConfigCache::Snapshot> ConfigCache::BuildSnapshot() const {
+  auto snapshot = std::make_shared<Snapshot>();
+  bool rebuild_all = all_sections_changed_ || last_snapshot_ == nullptr;
+
+  // Property ids are only added, so sections kept from the last snapshot remain valid. Start from scratch when
+  // rebuilding everything, to drop the names no longer used.
+  std::shared_ptr<Snapshot::PropertyIds> new_property_ids;
+  if (rebuild_all) {
+    new_property_ids = std::make_shared<Snapshot::PropertyIds>();
+    snapshot->property_ids = new_property_ids;
+  } else {
+    snapshot->property_ids = last_snapshot_->property_ids;
+    snapshot->sections = last_snapshot_->sections;
+  }
+  auto intern = [&](const std::string& property) {
+    auto id_iter = snapshot->property_ids->find(property);
+    if (id_iter != snapshot->property_ids->end()) {
+      return id_iter->second;
+    }
+    if (new_property_ids == nullptr) {
+      new_property_ids = std::make_shared<Snapshot::PropertyIds>(*snapshot->property_ids);
+      snapshot->property_ids = new_property_ids;
+    }
+    uint32_t id = new_property_ids->size();
+    new_property_ids->emplace(property, id);
+    return id;
+  };
+  auto build_section = [&](const common::ListMap<std::string, std::string>& properties, bool is_persistent_device) {
+    auto section = std::make_shared<Snapshot::Section>();
+    section->is_persistent_device = is_persistent_device;
+    section->revision = next_section_revision++;
+    section->properties.reserve(properties.size());
+    for (const auto& property : properties) {
+      section->properties.emplace_back(intern(property.first), property.second);
+    }
+    std::sort(section->properties.begin(), section->properties.end(), [](const auto& a, const auto& b) {
+      return a.first < b.first;
+    });
+    return section;
+  };
+
+  if (rebuild_all) {
+    for (const auto& elem : information_sections_) {
+      snapshot->sections.emplace(elem.first, build_section(elem.second, false));
+    }
+    for (const auto& elem : persistent_devices_) {
+      snapshot->sections.emplace(elem.first, build_section(elem.second, true));
+    }
+  } else {
+    for (const auto& section : changed_sections_) {
+      snapshot->sections.erase(section);
+      auto section_iter = information_sections_.find(section);
+      if (section_iter != information_sections_.end()) {
+        snapshot->sections.emplace(section, build_section(section_iter->second, false));
+        continue;
+      }
+      section_iter = persistent_devices_.find(section);
+      if (section_iter != persistent_devices_.end()) {
+        snapshot->sections.emplace(section, build_section(section_iter->second, true));
+      }
+    }
+  }
+
+  snapshot->persistent_sections.reserve(persistent_devices_.size());
+  for (const auto& elem : persistent_devices_) {
+    snapshot->persistent_sections.emplace_back(elem.first);
+  }
+
+  last_snapshot_ = snapshot;
+  changed_sections_.clear();
+  all_sections_changed_ = false;
+  return snapshot;
+}
+
+void ConfigCache::OnSectionChanged(const std::string& section) {
+  if (!all_sections_changed_) {
+    changed_sections_.insert(section);
+  }
+  std::atomic_store(&snapshot_, std::shared_ptr<const Snapshot>());
+}
+
+void ConfigCache::OnAllSectionsChanged() {
+  all_sections_changed_ = true;
+  changed_sections_.clear();
+  std::atomic_store(&snapshot_, std::shared_ptr<const Snapshot>());
 }
 
 }  // namespace storage
@@ -15,13 +15,16 @@
  */
 #pragma once
 
+#include <cstdint>
 #include <functional>
 #include <list>
+#include <memory>
 #include <mutex>
 #include <optional>
 #include <queue>
 #include <string>
 #include <string_view>
+#include <unordered_map>
 #include <unordered_set>
 #include <utility>
 #include <vector>
@@ -48,7 +51,8 @@ class Mutation;
 // The definition of persistent sections is up to the user and is defined through the |persistent_property_names|
 // argument. When these properties are link key properties, then persistent sections is equal to bonded devices
 //
-// This class is thread safe
+// This class is thread safe. Information and persistent device sections are read from an immutable snapshot without
+// taking the config mutex, only reads of temporary devices and writes take it.
 class ConfigCache {
  public:
   ConfigCache(size_t temp_device_capacity, std::unordered_set<std::string_view> persistent_property_names);
@@ -77,6 +81,9 @@ class ConfigCache {
   virtual std::vector<std::string> GetPersistentSections() const;
   // Return true if a section is persistent
   virtual bool IsPersistentSection(const std::string& section) const;
+  // Return a number that changes every time a persistent |section| is modified, std::nullopt if the section is not
+  // persistent. Lets users cache values parsed from a section until it changes
+  virtual std::optional<uint64_t> GetPersistentSectionRevision(const std::string& section) const;
   // Return true if a section has one of the properties in |property_names|
   virtual bool HasAtLeastOneMatchingPropertiesInSection(
       const std::string& section, const std::unordered_set<std::string_view>& property_names) const;
@@ -125,7 +132,38 @@ class ConfigCache {
   static const std::string kDefaultSectionName;
 
  private:
+  // Immutable view of the information and persistent device sections. Sections are shared between snapshots until
+  // they change, and property names are interned so that sections hold ids instead of copies of the names.
+  struct Snapshot {
+    using PropertyIds = std::unordered_map<std::string, uint32_t>;
+    struct Section {
+      bool is_persistent_device;
+      // unique among all sections ever built, so that a rebuilt section never has the revision of a previous one
+      uint64_t revision;
+      // pair<property id, value>, sorted by property id
+      std::vector<std::pair<uint32_t, std::string>> properties;
+      const std::string* Find(const PropertyIds& property_ids, const std::string& property) const;
+    };
+    std::shared_ptr<const PropertyIds> property_ids;
+    std::unordered_map<std::string, std::shared_ptr<const Section>> sections;
+    std::vector<std::string> persistent_sections;
+  };
+
+  // Returns the current snapshot, building it first if a writer changed the cache since the last one
+  std::shared_ptr<const Snapshot> GetSnapshot() const;
+  // Must be called with mutex_ held
+  std::shared_ptr<const Snapshot> BuildSnapshot() const;
+  // Record a change to an information or persistent device section, must be called with mutex_ held
+  void OnSectionChanged(const std::string& section);
+  void OnAllSectionsChanged();
+
   mutable std::recursive_mutex mutex_;
+  // Published snapshot, read with std::atomic_load, nullptr after a change until the next read rebuilds it
+  mutable std::shared_ptr<const Snapshot> snapshot_;
+  // Last built snapshot and the sections changed since, guarded by mutex_
+  mutable std::shared_ptr<const Snapshot> last_snapshot_;
+  mutable std::unordered_set<std::string> changed_sections_;
+  mutable bool all_sections_changed_ = true;
   // A callback to notify interested party that a persistent config change has just happened, empty by default
   std::function<void()> persistent_config_changed_callback_;
   // A set of property names that if set would make a section persistent and if non of these properties are set, a
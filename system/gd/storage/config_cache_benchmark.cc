@@ -0,0 +1,110 @@
+/*
+ * Copyright 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <atomic>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <thread>
+
+#include "benchmark/benchmark.h"
+#include "storage/config_cache.h"
+#include "storage/device.h"
+
+using ::benchmark::State;
+
+namespace bluetooth {
+namespace storage {
+
+constexpr int kBondedDevices = 32;
+
+std::string BondedDeviceAddress(int i) {
+  char address[18];
+  std::snprintf(address, sizeof(address), "AA:BB:CC:DD:%02X:%02X", (i >> 8) & 0xff, i & 0xff);
+  return address;
+}
+
+// Reads of bonded device sections, from one or more threads, the way btif_config and the security layer do them.
+// With an argument of 1, a writer thread keeps updating the same devices meanwhile.
+class BM_ConfigCache : public ::benchmark::Fixture {
+ protected:
+  void SetUp(State& st) override {
+    ::benchmark::Fixture::SetUp(st);
+    if (st.thread_index() != 0) return;
+    config_ = std::make_unique<ConfigCache>(100, Device::kLinkKeyProperties);
+    for (int i = 0; i < kBondedDevices; i++) {
+      config_->SetProperty(BondedDeviceAddress(i), "LinkKey", "fedcba9876543210fedcba9876543210");
+      config_->SetProperty(BondedDeviceAddress(i), "Name", "Benchmark Headset");
+      config_->SetProperty(BondedDeviceAddress(i), "DevType", "1");
+    }
+    stop_writer_ = false;
+    if (st.range(0) != 0) {
+      writer_ = std::thread([this] {
+        int i = 0;
+        while (!stop_writer_) {
+          config_->SetProperty(BondedDeviceAddress(i % kBondedDevices), "Timestamp", std::to_string(i));
+          i++;
+        }
+      });
+    }
+  }
+
+  void TearDown(State& st) override {
+    if (st.thread_index() == 0) {
+      stop_writer_ = true;
+      if (writer_.joinable()) {
+        writer_.join();
+      }
+      config_.reset();
+    }
+    ::benchmark::Fixture::TearDown(st);
+  }
+
+  std::unique_ptr<ConfigCache> config_;
+  std::thread writer_;
+  std::atomic<bool> stop_writer_;
+};
+
+BENCHMARK_DEFINE_F(BM_ConfigCache, get_property)(State& state) {
+  int i = state.thread_index();
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(config_->GetProperty(BondedDeviceAddress(i % kBondedDevices), "DevType"));
+    i++;
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK_REGISTER_F(BM_ConfigCache, get_property)->Arg(0)->Arg(1)->ThreadRange(1, 8);
+
+BENCHMARK_DEFINE_F(BM_ConfigCache, is_persistent_section)(State& state) {
+  int i = state.thread_index();
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(config_->IsPersistentSection(BondedDeviceAddress(i % kBondedDevices)));
+    i++;
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK_REGISTER_F(BM_ConfigCache, is_persistent_section)->Arg(0)->Arg(1)->ThreadRange(1, 8);
+
+BENCHMARK_DEFINE_F(BM_ConfigCache, get_persistent_sections)(State& state) {
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(config_->GetPersistentSections());
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK_REGISTER_F(BM_ConfigCache, get_persistent_sections)->Arg(0)->Arg(1)->ThreadRange(1, 8);
+
+}  // namespace storage
+}  // namespace bluetooth
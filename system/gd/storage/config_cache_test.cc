@@ -19,7 +19,10 @@
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
 
+#include <atomic>
 #include <cstdio>
+#include <thread>
+#include <vector>
 
 #include "hci/enum_helper.h"
 #include "storage/device.h"
@@ -413,4 +416,140 @@ TEST(ConfigCacheTest, test_empty_persistent_properties) {
   ASSERT_THAT(config.GetPersistentSections(), ElementsAre());
 }
 
-}  // namespace testing
\ No newline at end of file
+TEST(ConfigCacheTest, test_reads_follow_section_moves) {
+  ConfigCache config(100, Device::kLinkKeyProperties);
+  config.SetProperty("AA:BB:CC:DD:EE:FF", "Name", "Hello");
+  ASSERT_FALSE(config.IsPersistentSection("AA:BB:CC:DD:EE:FF"));
+  ASSERT_TRUE(config.HasSection("AA:BB:CC:DD:EE:FF"));
+
+  // becomes persistent
+  config.SetProperty("AA:BB:CC:DD:EE:FF", "LinkKey", "AABBAABBCCDDEE");
+  ASSERT_TRUE(config.IsPersistentSection("AA:BB:CC:DD:EE:FF"));
+  ASSERT_THAT(config.GetPersistentSections(), ElementsAre("AA:BB:CC:DD:EE:FF"));
+  ASSERT_THAT(config.GetProperty("AA:BB:CC:DD:EE:FF", "Name"), Optional(StrEq("Hello")));
+  ASSERT_FALSE(config.HasProperty("AA:BB:CC:DD:EE:FF", "DevType"));
+
+  // a property never seen before
+  config.SetProperty("AA:BB:CC:DD:EE:FF", "DevType", "1");
+  ASSERT_THAT(config.GetProperty("AA:BB:CC:DD:EE:FF", "DevType"), Optional(StrEq("1")));
+
+  // becomes temporary again
+  ASSERT_TRUE(config.RemoveProperty("AA:BB:CC:DD:EE:FF", "LinkKey"));
+  ASSERT_FALSE(config.IsPersistentSection("AA:BB:CC:DD:EE:FF"));
+  ASSERT_THAT(config.GetPersistentSections(), ElementsAre());
+  ASSERT_THAT(config.GetProperty("AA:BB:CC:DD:EE:FF", "Name"), Optional(StrEq("Hello")));
+  ASSERT_FALSE(config.HasProperty("AA:BB:CC:DD:EE:FF", "LinkKey"));
+
+  config.Clear();
+  ASSERT_FALSE(config.HasSection("AA:BB:CC:DD:EE:FF"));
+}
+
+TEST(ConfigCacheTest, test_persistent_section_revision) {
+  ConfigCache config(100, Device::kLinkKeyProperties);
+  config.SetProperty("AA:BB:CC:DD:EE:FF", "Name", "Hello");
+  ASSERT_FALSE(config.GetPersistentSectionRevision("AA:BB:CC:DD:EE:FF"));
+  config.SetProperty("AA:BB:CC:DD:EE:FF", "LinkKey", "AABBAABBCCDDEE");
+  config.SetProperty("AA:BB:CC:DD:EE:EF", "LinkKey", "AABBAABBCCDDEE");
+  config.SetProperty("Adapter", "Address", "01:02:03:04:05:06");
+  ASSERT_FALSE(config.GetPersistentSectionRevision("Adapter"));
+  auto revision = config.GetPersistentSectionRevision("AA:BB:CC:DD:EE:FF");
+  ASSERT_TRUE(revision);
+
+  // unchanged by changes to other sections
+  config.SetProperty("AA:BB:CC:DD:EE:EF", "Name", "World");
+  config.SetProperty("Adapter", "Name", "Phone");
+  ASSERT_EQ(config.GetPersistentSectionRevision("AA:BB:CC:DD:EE:FF"), revision);
+
+  config.SetProperty("AA:BB:CC:DD:EE:FF", "Name", "World");
+  auto new_revision = config.GetPersistentSectionRevision("AA:BB:CC:DD:EE:FF");
+  ASSERT_TRUE(new_revision);
+  ASSERT_NE(new_revision, revision);
+
+  // a rebuild of all sections must not bring a revision back
+  config.Clear();
+  config.SetProperty("AA:BB:CC:DD:EE:FF", "LinkKey", "AABBAABBCCDDEE");
+  ASSERT_NE(config.GetPersistentSectionRevision("AA:BB:CC:DD:EE:FF"), revision);
+  ASSERT_NE(config.GetPersistentSectionRevision("AA:BB:CC:DD:EE:FF"), new_revision);
+
+  ASSERT_TRUE(config.RemoveProperty("AA:BB:CC:DD:EE:FF", "LinkKey"));
+  ASSERT_FALSE(config.GetPersistentSectionRevision("AA:BB:CC:DD:EE:FF"));
+}
+
+TEST(ConfigCacheTest, test_concurrent_reads_and_writes) {
+  constexpr int kDevices = 20;
+  constexpr int kWrites = 2000;
+  ConfigCache config(100, Device::kLinkKeyProperties);
+  for (int i = 0; i < kDevices; i++) {
+    config.SetProperty(GetTestAddress(i), "LinkKey", "AABBAABBCCDDEE");
+    config.SetProperty(GetTestAddress(i), "Counter", "0");
+  }
+
+  std::atomic<bool> done = false;
+  std::vector<std::thread> readers;
+  for (int r = 0; r < 4; r++) {
+    readers.emplace_back([&config, &done] {
+      while (!done) {
+        for (int i = 0; i < kDevices; i++) {
+          // every device stays persistent while its counter is updated
+          ASSERT_TRUE(config.IsPersistentSection(GetTestAddress(i)));
+          ASSERT_TRUE(config.GetProperty(GetTestAddress(i), "Counter"));
+        }
+        ASSERT_EQ(config.GetPersistentSections().size(), static_cast<size_t>(kDevices));
+      }
+    });
+  }
+
+  for (int n = 1; n <= kWrites; n++) {
+    config.SetProperty(GetTestAddress(n % kDevices), "Counter", std::to_string(n));
+  }
+  done = true;
+  for (auto& reader : readers) {
+    reader.join();
+  }
+  for (int i = 0; i < kDevices; i++) {
+    int last = kWrites - ((kWrites - i) % kDevices);
+    ASSERT_THAT(config.GetProperty(GetTestAddress(i), "Counter"), Optional(StrEq(std::to_string(last))));
+  }
+}
+
+TEST(ConfigCacheTest, test_concurrent_reads_while_sections_move_between_temporary_and_persistent) {
+  constexpr int kDevices = 10;
+  constexpr int kMoves = 1000;
+  ConfigCache config(100, Device::kLinkKeyProperties);
+  for (int i = 0; i < kDevices; i++) {
+    config.SetProperty(GetTestAddress(i), "Name", "Device");
+  }
+
+  std::atomic<bool> done = false;
+  std::vector<std::thread> readers;
+  for (int r = 0; r < 4; r++) {
+    readers.emplace_back([&config, &done] {
+      while (!done) {
+        for (int i = 0; i < kDevices; i++) {
+          // every device exists throughout, whether it is temporary or persistent at the time of the read
+          ASSERT_TRUE(config.HasSection(GetTestAddress(i)));
+          ASSERT_TRUE(config.HasProperty(GetTestAddress(i), "Name"));
+          ASSERT_THAT(config.GetProperty(GetTestAddress(i), "Name"), Optional(StrEq("Device")));
+        }
+      }
+    });
+  }
+
+  for (int n = 0; n < kMoves; n++) {
+    auto address = GetTestAddress(n % kDevices);
+    // setting a link key moves the section to persistent devices, removing it moves the section back
+    config.SetProperty(address, "LinkKey", "AABBAABBCCDDEE");
+    ASSERT_TRUE(config.IsPersistentSection(address));
+    ASSERT_TRUE(config.RemoveProperty(address, "LinkKey"));
+    ASSERT_FALSE(config.IsPersistentSection(address));
+  }
+  done = true;
+  for (auto& reader : readers) {
+    reader.join();
+  }
+  for (int i = 0; i < kDevices; i++) {
+    ASSERT_THAT(config.GetProperty(GetTestAddress(i), "Name"), Optional(StrEq("Device")));
+  }
+}
+
+}  // namespace testing
@@ -0,0 +1,184 @@
+/*
+ * Copyright 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "storage/device_record.h"
+
+#include <algorithm>
+#include <utility>
+
+#include "common/byte_array.h"
+#include "storage/config_cache_helper.h"
+
+namespace bluetooth {
+namespace storage {
+
+namespace {
+
+// Indexed by DeviceProperty, names must match the ones used by Device, ClassicDevice and LeDevice
+constexpr std::array<std::string_view, static_cast<size_t>(DeviceProperty::COUNT)> kDevicePropertyNames = {
+    "Name",
+    "DevClass",
+    "DevType",
+    "Manufacturer",
+    "LmpVer",
+    "LmpSubVer",
+    "PinLength",
+    "IsAuthenticated",
+    "RequiresMitmProtection",
+    "IsEncryptionRequired",
+    "LinkKey",
+    "LinkKeyType",
+    "AddrType",
+    "LE_KEY_PID",
+    "LE_KEY_PENC",
+    "LE_KEY_PCSRK",
+    "LeLegacyPseudoAddr",
+};
+
+// Reads |property| into |field| and marks it present in |record|, leaves both untouched if it is missing or invalid
+template <typename T>
+void LoadProperty(
+    ConfigCacheHelper& helper, const std::string& section, DeviceProperty property, DeviceRecord& record, T& field) {
+  auto value = helper.Get<T>(section, std::string(DevicePropertyName(property)));
+  if (!value) {
+    return;
+  }
+  field = std::move(*value);
+  record.present.set(static_cast<size_t>(property));
+}
+
+}  // namespace
+
+std::string_view DevicePropertyName(DeviceProperty property) {
+  return kDevicePropertyNames[static_cast<size_t>(property)];
+}
+
+DeviceRecord DeviceRecord::FromConfig(ConfigCache& config, const hci::Address& address, uint64_t revision) {
+  DeviceRecord record;
+  record.address = address;
+  record.revision = revision;
+
+  ConfigCacheHelper helper(config);
+  std::string section = address.ToString();
+  LoadProperty(helper, section, DeviceProperty::NAME, record, record.name);
+  LoadProperty(helper, section, DeviceProperty::CLASS_OF_DEVICE, record, record.class_of_device);
+  LoadProperty(helper, section, DeviceProperty::DEVICE_TYPE, record, record.device_type);
+  LoadProperty(helper, section, DeviceProperty::MANUFACTURER_CODE, record, record.manufacturer_code);
+  LoadProperty(helper, section, DeviceProperty::LMP_VERSION, record, record.lmp_version);
+  LoadProperty(helper, section, DeviceProperty::LMP_SUB_VERSION, record, record.lmp_sub_version);
+  LoadProperty(helper, section, DeviceProperty::PIN_LENGTH, record, record.pin_length);
+  LoadProperty(helper, section, DeviceProperty::IS_AUTHENTICATED, record, record.is_authenticated);
+  LoadProperty(helper, section, DeviceProperty::REQUIRES_MITM_PROTECTION, record, record.requires_mitm_protection);
+  LoadProperty(helper, section, DeviceProperty::IS_ENCRYPTION_REQUIRED, record, record.is_encryption_required);
+  LoadProperty(helper, section, DeviceProperty::LINK_KEY, record, record.link_key);
+  LoadProperty(helper, section, DeviceProperty::LINK_KEY_TYPE, record, record.link_key_type);
+  LoadProperty(helper, section, DeviceProperty::LE_ADDRESS_TYPE, record, record.le_address_type);
+  LoadProperty(helper, section, DeviceProperty::LE_LEGACY_PSEUDO_ADDRESS, record, record.le_legacy_pseudo_address);
+
+  // LE keys are stored as hex strings of the packed key fields, see SecurityRecordStorage
+  common::ByteArray<23> peer_id;
+  LoadProperty(helper, section, DeviceProperty::LE_PEER_ID, record, peer_id);
+  if (record.Has(DeviceProperty::LE_PEER_ID)) {
+    std::copy_n(peer_id.data(), 16, record.le_peer_id.irk.data());
+    record.le_peer_id.identity_address_type = static_cast<hci::AddressType>(peer_id.data()[16]);
+    std::copy_n(peer_id.data() + 17, 6, record.le_peer_id.identity_address.data());
+  }
+
+  common::ByteArray<28> peer_encryption_keys;
+  LoadProperty(helper, section, DeviceProperty::LE_PEER_ENCRYPTION_KEYS, record, peer_encryption_keys);
+  if (record.Has(DeviceProperty::LE_PEER_ENCRYPTION_KEYS)) {
+    auto& keys = record.le_peer_encryption_keys;
+    std::copy_n(peer_encryption_keys.data(), 16, keys.ltk.data());
+    std::copy_n(peer_encryption_keys.data() + 16, 8, keys.rand.data());
+    std::copy_n(peer_encryption_keys.data() + 24, 2, reinterpret_cast<uint8_t*>(&keys.ediv));
+    keys.security_level = peer_encryption_keys.data()[26];
+    keys.key_size = peer_encryption_keys.data()[27];
+  }
+
+  common::ByteArray<21> peer_signature_resolving_keys;
+  LoadProperty(
+      helper, section, DeviceProperty::LE_PEER_SIGNATURE_RESOLVING_KEYS, record, peer_signature_resolving_keys);
+  if (record.Has(DeviceProperty::LE_PEER_SIGNATURE_RESOLVING_KEYS)) {
+    auto& keys = record.le_peer_signature_resolving_keys;
+    std::copy_n(peer_signature_resolving_keys.data(), 4, reinterpret_cast<uint8_t*>(&keys.counter));
+    std::copy_n(peer_signature_resolving_keys.data() + 4, 16, keys.csrk.data());
+    keys.security_level = peer_signature_resolving_keys.data()[20];
+  }
+
+  return record;
+}
+
+std::shared_ptr<const DeviceRecord> DeviceRecordCache::Get(const hci::Address& address) {
+  auto section_iter = sections_.find(address);
+  if (section_iter == sections_.end()) {
+    return Get(address.ToString(), address);
+  }
+  return Get(section_iter->second, address);
+}
+
+std::shared_ptr<const DeviceRecord> DeviceRecordCache::Get(const std::string& section, const hci::Address& address) {
+  auto revision = config_->GetPersistentSectionRevision(section);
+  if (!revision) {
+    records_.erase(section);
+    // |section| might belong to this entry, do not use it after
+    sections_.erase(address);
+    return nullptr;
+  }
+  auto& record = records_[section];
+  if (record == nullptr || record->revision != *revision) {
+    record = std::make_shared<const DeviceRecord>(DeviceRecord::FromConfig(*config_, address, *revision));
+    sections_.emplace(address, section);
+  }
+  return record;
+}
+
+std::vector<std::shared_ptr<const DeviceRecord>> DeviceRecordCache::GetAll() {
+  auto persistent_sections = config_->GetPersistentSections();
+  std::vector<std::shared_ptr<const DeviceRecord>> result;
+  result.reserve(persistent_sections.size());
+  for (const auto& section : persistent_sections) {
+    // Parsing an address is not free either, reuse the one of the current record
+    auto record_iter = records_.find(section);
+    std::optional<hci::Address> address;
+    if (record_iter != records_.end()) {
+      address = record_iter->second->address;
+    } else {
+      address = hci::Address::FromString(section);
+    }
+    if (!address) {
+      continue;
+    }
+    auto record = Get(section, *address);
+    if (record != nullptr) {
+      result.push_back(std::move(record));
+    }
+  }
+  // Drop the records of devices that are no longer bonded
+  if (records_.size() > result.size()) {
+    for (auto record_iter = records_.begin(); record_iter != records_.end();) {
+      if (config_->IsPersistentSection(record_iter->first)) {
+        ++record_iter;
+        continue;
+      }
+      sections_.erase(record_iter->second->address);
+      record_iter = records_.erase(record_iter);
+    }
+  }
+  return result;
+}
+
+}  // namespace storage
+}  // namespace bluetooth
@@ -0,0 +1,145 @@
+/*
+ * Copyright 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <array>
+#include <bitset>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "hci/address.h"
+#include "hci/class_of_device.h"
+#include "hci/enum_helper.h"
+#include "hci/hci_packets.h"
+#include "hci/link_key.h"
+#include "storage/config_cache.h"
+
+namespace bluetooth {
+namespace storage {
+
+// Device properties that have a typed field in DeviceRecord. Each one is stored under the same name as the matching
+// Device, ClassicDevice or LeDevice property in the legacy config file
+enum class DeviceProperty : uint8_t {
+  NAME = 0,
+  CLASS_OF_DEVICE,
+  DEVICE_TYPE,
+  MANUFACTURER_CODE,
+  LMP_VERSION,
+  LMP_SUB_VERSION,
+  PIN_LENGTH,
+  IS_AUTHENTICATED,
+  REQUIRES_MITM_PROTECTION,
+  IS_ENCRYPTION_REQUIRED,
+  LINK_KEY,
+  LINK_KEY_TYPE,
+  LE_ADDRESS_TYPE,
+  LE_PEER_ID,
+  LE_PEER_ENCRYPTION_KEYS,
+  LE_PEER_SIGNATURE_RESOLVING_KEYS,
+  LE_LEGACY_PSEUDO_ADDRESS,
+  COUNT,
+};
+
+// Name of |property| in the legacy config file
+std::string_view DevicePropertyName(DeviceProperty property);
+
+// Typed copy of the properties of a bonded device section, parsed once from the config strings.
+//
+// A record is immutable and tied to the section revision it was parsed from, StorageModule replaces it with a new one
+// after the section changes. Records are a read view only: changes still go through Device, ClassicDevice and LeDevice
+// mutation entries, so that the legacy config file format is unchanged.
+struct DeviceRecord {
+  // IRK + Identity Address Type + Identity Address, from LE_KEY_PID
+  struct LePeerId {
+    std::array<uint8_t, 16> irk;
+    hci::AddressType identity_address_type;
+    hci::Address identity_address;
+  };
+  // LTK + RAND + EDIV + Security Level + Key Length, from LE_KEY_PENC
+  struct LePeerEncryptionKeys {
+    std::array<uint8_t, 16> ltk;
+    std::array<uint8_t, 8> rand;
+    uint16_t ediv;
+    uint8_t security_level;
+    uint8_t key_size;
+  };
+  // counter + CSRK + security level, from LE_KEY_PCSRK
+  struct LePeerSignatureResolvingKeys {
+    uint32_t counter;
+    std::array<uint8_t, 16> csrk;
+    uint8_t security_level;
+  };
+
+  // Parse all known properties of |address|'s section in |config|, |revision| is the revision of the section
+  static DeviceRecord FromConfig(ConfigCache& config, const hci::Address& address, uint64_t revision);
+
+  // Return true if |property| exists in the section and its value could be parsed
+  bool Has(DeviceProperty property) const {
+    return present[static_cast<size_t>(property)];
+  }
+
+  hci::Address address;
+  uint64_t revision = 0;
+  std::bitset<static_cast<size_t>(DeviceProperty::COUNT)> present;
+
+  std::string name;
+  hci::ClassOfDevice class_of_device;
+  hci::DeviceType device_type = hci::DeviceType::UNKNOWN;
+  uint16_t manufacturer_code = 0;
+  uint8_t lmp_version = 0;
+  uint16_t lmp_sub_version = 0;
+  int pin_length = 0;
+  int is_authenticated = 0;
+  int requires_mitm_protection = 0;
+  int is_encryption_required = 0;
+
+  hci::LinkKey link_key;
+  hci::KeyType link_key_type = hci::KeyType::COMBINATION;
+
+  hci::AddressType le_address_type = hci::AddressType::PUBLIC_DEVICE_ADDRESS;
+  LePeerId le_peer_id = {};
+  LePeerEncryptionKeys le_peer_encryption_keys = {};
+  LePeerSignatureResolvingKeys le_peer_signature_resolving_keys = {};
+  hci::Address le_legacy_pseudo_address;
+};
+
+// Records of the bonded devices of a ConfigCache, parsed on first use and replaced when their section changes.
+// Not thread safe, StorageModule serializes the calls.
+class DeviceRecordCache {
+ public:
+  explicit DeviceRecordCache(ConfigCache* config) : config_(config) {}
+
+  // Return the record of the bonded device whose section is keyed by |address|, nullptr if it is not bonded
+  std::shared_ptr<const DeviceRecord> Get(const hci::Address& address);
+  // Return the records of all bonded devices
+  std::vector<std::shared_ptr<const DeviceRecord>> GetAll();
+
+ private:
+  std::shared_ptr<const DeviceRecord> Get(const std::string& section, const hci::Address& address);
+
+  ConfigCache* config_;
+  // Records by section, and the section of each record address, so that lookups need no address conversion
+  std::unordered_map<std::string, std::shared_ptr<const DeviceRecord>> records_;
+  std::unordered_map<hci::Address, std::string> sections_;
+};
+
+}  // namespace storage
+}  // namespace bluetooth
@@ -0,0 +1,154 @@
+/*
+ * Copyright 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_set>
+
+#include "benchmark/benchmark.h"
+#include "storage/classic_device.h"
+#include "storage/config_cache.h"
+#include "storage/device.h"
+#include "storage/device_record.h"
+#include "storage/le_device.h"
+
+using ::benchmark::State;
+
+namespace bluetooth {
+namespace storage {
+
+constexpr int kDualModeDevices = 32;
+
+hci::Address DualModeDeviceAddress(int i) {
+  return hci::Address({0x01, 0x02, 0x03, 0x04, static_cast<uint8_t>(i >> 8), static_cast<uint8_t>(i)});
+}
+
+// Bonded dual mode devices with the properties read by SecurityRecordStorage when restoring security records, and by
+// the security layer when a device reconnects.
+class BM_DeviceRecord : public ::benchmark::Fixture {
+ protected:
+  void SetUp(State& st) override {
+    ::benchmark::Fixture::SetUp(st);
+    config_ = std::make_unique<ConfigCache>(100, Device::kLinkKeyProperties);
+    memory_only_config_ = std::make_unique<ConfigCache>(100, std::unordered_set<std::string_view>());
+    for (int i = 0; i < kDualModeDevices; i++) {
+      std::string section = DualModeDeviceAddress(i).ToString();
+      config_->SetProperty(section, "Name", "Benchmark Headset");
+      config_->SetProperty(section, "DevClass", "2360324");
+      config_->SetProperty(section, "DevType", "3");
+      config_->SetProperty(section, "AddrType", "1");
+      config_->SetProperty(section, "LinkKey", "fedcba9876543210fedcba9876543210");
+      config_->SetProperty(section, "LinkKeyType", "8");
+      config_->SetProperty(section, "LeLegacyPseudoAddr", section);
+      config_->SetProperty(section, "LE_KEY_PID", "000102030405060708090a0b0c0d0e0f" "01" "c6c5c4c3c2c1");
+      config_->SetProperty(
+          section, "LE_KEY_PENC", "101112131415161718191a1b1c1d1e1f" "2021222324252627" "3412" "02" "10");
+      config_->SetProperty(section, "LE_KEY_PCSRK", "05000000" "303132333435363738393a3b3c3d3e3f" "01");
+      config_->SetProperty(section, "IsAuthenticated", "1");
+      config_->SetProperty(section, "IsEncryptionRequired", "1");
+      config_->SetProperty(section, "RequiresMitmProtection", "1");
+    }
+    records_ = std::make_unique<DeviceRecordCache>(config_.get());
+  }
+
+  void TearDown(State& st) override {
+    records_.reset();
+    memory_only_config_.reset();
+    config_.reset();
+    ::benchmark::Fixture::TearDown(st);
+  }
+
+  std::unique_ptr<ConfigCache> config_;
+  std::unique_ptr<ConfigCache> memory_only_config_;
+  std::unique_ptr<DeviceRecordCache> records_;
+};
+
+// Read everything SecurityRecordStorage needs from all bonded devices, through the Device getters
+BENCHMARK_DEFINE_F(BM_DeviceRecord, restore_bonded_devices_with_getters)(State& state) {
+  for (auto _ : state) {
+    for (const auto& section : config_->GetPersistentSections()) {
+      Device device(config_.get(), memory_only_config_.get(), section);
+      benchmark::DoNotOptimize(device.GetDeviceType());
+      benchmark::DoNotOptimize(device.GetIsAuthenticated());
+      benchmark::DoNotOptimize(device.GetIsEncryptionRequired());
+      benchmark::DoNotOptimize(device.GetRequiresMitmProtection());
+      auto classic = device.Classic();
+      benchmark::DoNotOptimize(classic.GetLinkKey());
+      benchmark::DoNotOptimize(classic.GetLinkKeyType());
+      auto le = device.Le();
+      benchmark::DoNotOptimize(le.GetAddressType());
+      benchmark::DoNotOptimize(le.GetLegacyPseudoAddress());
+      benchmark::DoNotOptimize(le.GetPeerId());
+      benchmark::DoNotOptimize(le.GetPeerEncryptionKeys());
+      benchmark::DoNotOptimize(le.GetPeerSignatureResolvingKeys());
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * kDualModeDevices);
+}
+BENCHMARK_REGISTER_F(BM_DeviceRecord, restore_bonded_devices_with_getters);
+
+// The same with records, which are parsed once per device and then reused until a device changes. The first
+// iteration parses them, as bonded devices are restored once per stack start; the others measure the reuse.
+BENCHMARK_DEFINE_F(BM_DeviceRecord, restore_bonded_devices_with_records)(State& state) {
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(records_->GetAll());
+  }
+  state.SetItemsProcessed(state.iterations() * kDualModeDevices);
+}
+BENCHMARK_REGISTER_F(BM_DeviceRecord, restore_bonded_devices_with_records);
+
+// Parse every bonded device from scratch, the cost paid once per device on first use and after each change
+BENCHMARK_DEFINE_F(BM_DeviceRecord, parse_records)(State& state) {
+  int i = 0;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(DeviceRecord::FromConfig(*config_, DualModeDeviceAddress(i % kDualModeDevices), 0));
+    i++;
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK_REGISTER_F(BM_DeviceRecord, parse_records);
+
+// Look up the LE keys of a reconnecting device through the LeDevice getters
+BENCHMARK_DEFINE_F(BM_DeviceRecord, connection_key_lookup_with_getters)(State& state) {
+  int i = 0;
+  for (auto _ : state) {
+    LeDevice le(config_.get(), memory_only_config_.get(), DualModeDeviceAddress(i % kDualModeDevices).ToString());
+    benchmark::DoNotOptimize(le.GetAddressType());
+    benchmark::DoNotOptimize(le.GetPeerId());
+    benchmark::DoNotOptimize(le.GetPeerEncryptionKeys());
+    i++;
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK_REGISTER_F(BM_DeviceRecord, connection_key_lookup_with_getters);
+
+// The same with records. The getters return hex strings that still need decoding, the record has the key bytes.
+BENCHMARK_DEFINE_F(BM_DeviceRecord, connection_key_lookup_with_records)(State& state) {
+  int i = 0;
+  for (auto _ : state) {
+    auto record = records_->Get(DualModeDeviceAddress(i % kDualModeDevices));
+    benchmark::DoNotOptimize(record->le_address_type);
+    benchmark::DoNotOptimize(record->le_peer_id);
+    benchmark::DoNotOptimize(record->le_peer_encryption_keys);
+    i++;
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK_REGISTER_F(BM_DeviceRecord, connection_key_lookup_with_records);
+
+}  // namespace storage
+}  // namespace bluetooth
@@ -0,0 +1,180 @@
+/*
+ * Copyright 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "storage/device_record.h"
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include "storage/classic_device.h"
+#include "storage/device.h"
+#include "storage/le_device.h"
+#include "storage/mutation.h"
+
+using bluetooth::hci::Address;
+using bluetooth::hci::AddressType;
+using bluetooth::hci::ClassOfDevice;
+using bluetooth::hci::DeviceType;
+using bluetooth::hci::KeyType;
+using bluetooth::storage::ConfigCache;
+using bluetooth::storage::Device;
+using bluetooth::storage::DeviceProperty;
+using bluetooth::storage::DevicePropertyName;
+using bluetooth::storage::DeviceRecord;
+using bluetooth::storage::DeviceRecordCache;
+using bluetooth::storage::Mutation;
+using ::testing::ElementsAreArray;
+
+TEST(DeviceRecordTest, property_names_match_device_properties) {
+  ASSERT_EQ(DevicePropertyName(DeviceProperty::NAME), "Name");
+  ASSERT_EQ(DevicePropertyName(DeviceProperty::DEVICE_TYPE), "DevType");
+  ASSERT_EQ(DevicePropertyName(DeviceProperty::LINK_KEY), "LinkKey");
+  ASSERT_EQ(DevicePropertyName(DeviceProperty::LE_PEER_ENCRYPTION_KEYS), "LE_KEY_PENC");
+  ASSERT_EQ(DevicePropertyName(DeviceProperty::LE_LEGACY_PSEUDO_ADDRESS), "LeLegacyPseudoAddr");
+  for (uint8_t i = 0; i < static_cast<uint8_t>(DeviceProperty::COUNT); i++) {
+    ASSERT_FALSE(DevicePropertyName(static_cast<DeviceProperty>(i)).empty());
+  }
+}
+
+TEST(DeviceRecordTest, empty_section) {
+  ConfigCache config(10, Device::kLinkKeyProperties);
+  Address address = {{0x01, 0x02, 0x03, 0x04, 0x05, 0x06}};
+  auto record = DeviceRecord::FromConfig(config, address, 1);
+  ASSERT_EQ(record.address, address);
+  ASSERT_EQ(record.revision, 1u);
+  ASSERT_TRUE(record.present.none());
+}
+
+TEST(DeviceRecordTest, matches_device_getters) {
+  ConfigCache config(10, Device::kLinkKeyProperties);
+  ConfigCache memory_only_config(10, {});
+  Address address = {{0x01, 0x02, 0x03, 0x04, 0x05, 0x06}};
+  Address pseudo_address = {{0x11, 0x12, 0x13, 0x14, 0x15, 0x16}};
+  Device device(&config, &memory_only_config, address, Device::ConfigKeyAddressType::LEGACY_KEY_ADDRESS);
+  {
+    // Classic() and Le() need the device type
+    Mutation mutation(&config, &memory_only_config);
+    mutation.Add(device.SetDeviceType(DeviceType::DUAL));
+    mutation.Commit();
+  }
+  Mutation mutation(&config, &memory_only_config);
+  mutation.Add(device.SetName("Headset"));
+  mutation.Add(device.SetClassOfDevice(ClassOfDevice({0x04, 0x04, 0x24})));
+  mutation.Add(device.SetManufacturerCode(0x00e0));
+  mutation.Add(device.SetLmpVersion(10));
+  mutation.Add(device.SetIsAuthenticated(1));
+  mutation.Add(device.Classic().SetLinkKey(bluetooth::hci::kExampleLinkKey));
+  mutation.Add(device.Classic().SetLinkKeyType(KeyType::AUTHENTICATED_P256));
+  mutation.Add(device.Le().SetAddressType(AddressType::RANDOM_DEVICE_ADDRESS));
+  mutation.Add(device.Le().SetLegacyPseudoAddress(pseudo_address));
+  mutation.Commit();
+
+  auto record = DeviceRecord::FromConfig(config, address, 1);
+  ASSERT_TRUE(record.Has(DeviceProperty::NAME));
+  ASSERT_EQ(record.name, *device.GetName());
+  ASSERT_EQ(record.class_of_device, *device.GetClassOfDevice());
+  ASSERT_EQ(record.device_type, DeviceType::DUAL);
+  ASSERT_EQ(record.manufacturer_code, 0x00e0);
+  ASSERT_EQ(record.lmp_version, 10);
+  ASSERT_FALSE(record.Has(DeviceProperty::LMP_SUB_VERSION));
+  ASSERT_EQ(record.is_authenticated, 1);
+  ASSERT_FALSE(record.Has(DeviceProperty::REQUIRES_MITM_PROTECTION));
+  ASSERT_EQ(record.link_key, *device.Classic().GetLinkKey());
+  ASSERT_EQ(record.link_key_type, KeyType::AUTHENTICATED_P256);
+  ASSERT_EQ(record.le_address_type, AddressType::RANDOM_DEVICE_ADDRESS);
+  ASSERT_EQ(record.le_legacy_pseudo_address, pseudo_address);
+  ASSERT_FALSE(record.Has(DeviceProperty::LE_PEER_ID));
+}
+
+TEST(DeviceRecordTest, le_keys) {
+  ConfigCache config(10, Device::kLinkKeyProperties);
+  Address address = {{0x01, 0x02, 0x03, 0x04, 0x05, 0x06}};
+  // IRK, identity address type and identity address
+  config.SetProperty(address.ToString(), "LE_KEY_PID", "000102030405060708090a0b0c0d0e0f" "01" "c6c5c4c3c2c1");
+  // LTK, RAND, EDIV, security level and key size
+  config.SetProperty(
+      address.ToString(), "LE_KEY_PENC", "101112131415161718191a1b1c1d1e1f" "2021222324252627" "3412" "02" "10");
+  // counter, CSRK and security level
+  config.SetProperty(address.ToString(), "LE_KEY_PCSRK", "05000000" "303132333435363738393a3b3c3d3e3f" "01");
+
+  auto record = DeviceRecord::FromConfig(config, address, 1);
+  ASSERT_TRUE(record.Has(DeviceProperty::LE_PEER_ID));
+  ASSERT_THAT(record.le_peer_id.irk, ElementsAreArray({0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15}));
+  ASSERT_EQ(record.le_peer_id.identity_address_type, AddressType::RANDOM_DEVICE_ADDRESS);
+  ASSERT_EQ(record.le_peer_id.identity_address, Address({0xc6, 0xc5, 0xc4, 0xc3, 0xc2, 0xc1}));
+
+  ASSERT_TRUE(record.Has(DeviceProperty::LE_PEER_ENCRYPTION_KEYS));
+  const auto& encryption_keys = record.le_peer_encryption_keys;
+  ASSERT_EQ(encryption_keys.ltk[0], 0x10);
+  ASSERT_EQ(encryption_keys.ltk[15], 0x1f);
+  ASSERT_THAT(encryption_keys.rand, ElementsAreArray({0x20, 0x21, 0x22, 0x23, 0x24, 0x25, 0x26, 0x27}));
+  ASSERT_EQ(encryption_keys.ediv, 0x1234);
+  ASSERT_EQ(encryption_keys.security_level, 2);
+  ASSERT_EQ(encryption_keys.key_size, 16);
+
+  ASSERT_TRUE(record.Has(DeviceProperty::LE_PEER_SIGNATURE_RESOLVING_KEYS));
+  const auto& signature_keys = record.le_peer_signature_resolving_keys;
+  ASSERT_EQ(signature_keys.counter, 5u);
+  ASSERT_EQ(signature_keys.csrk[0], 0x30);
+  ASSERT_EQ(signature_keys.csrk[15], 0x3f);
+  ASSERT_EQ(signature_keys.security_level, 1);
+}
+
+TEST(DeviceRecordTest, invalid_values_are_not_present) {
+  ConfigCache config(10, Device::kLinkKeyProperties);
+  Address address = {{0x01, 0x02, 0x03, 0x04, 0x05, 0x06}};
+  config.SetProperty(address.ToString(), "LinkKey", "fedcba0987654321fedcba0987654328");
+  config.SetProperty(address.ToString(), "DevType", "7");
+  config.SetProperty(address.ToString(), "LmpVer", "256");
+  config.SetProperty(address.ToString(), "LE_KEY_PENC", "1011");
+
+  auto record = DeviceRecord::FromConfig(config, address, 1);
+  ASSERT_TRUE(record.Has(DeviceProperty::LINK_KEY));
+  ASSERT_FALSE(record.Has(DeviceProperty::DEVICE_TYPE));
+  ASSERT_FALSE(record.Has(DeviceProperty::LMP_VERSION));
+  ASSERT_FALSE(record.Has(DeviceProperty::LE_PEER_ENCRYPTION_KEYS));
+}
+
+TEST(DeviceRecordCacheTest, records_follow_section_changes) {
+  ConfigCache config(10, Device::kLinkKeyProperties);
+  DeviceRecordCache records(&config);
+  Address address = {{0x01, 0x02, 0x03, 0x04, 0x05, 0x06}};
+  Address other_address = {{0x01, 0x02, 0x03, 0x04, 0x05, 0x07}};
+  config.SetProperty(address.ToString(), "Name", "Headset");
+  ASSERT_EQ(records.Get(address), nullptr);
+
+  config.SetProperty(address.ToString(), "LinkKey", "fedcba0987654321fedcba0987654328");
+  config.SetProperty(other_address.ToString(), "LinkKey", "fedcba0987654321fedcba0987654329");
+  auto record = records.Get(address);
+  ASSERT_NE(record, nullptr);
+  ASSERT_EQ(record->name, "Headset");
+  ASSERT_EQ(records.GetAll().size(), 2u);
+
+  // kept while other sections change
+  config.SetProperty(other_address.ToString(), "Name", "Watch");
+  ASSERT_EQ(records.Get(address), record);
+
+  config.SetProperty(address.ToString(), "Name", "Speaker");
+  auto new_record = records.Get(address);
+  ASSERT_NE(new_record, record);
+  ASSERT_EQ(new_record->name, "Speaker");
+  ASSERT_EQ(record->name, "Headset");
+
+  ASSERT_TRUE(config.RemoveSection(other_address.ToString()));
+  auto all_records = records.GetAll();
+  ASSERT_EQ(all_records.size(), 1u);
+  ASSERT_EQ(all_records[0], new_record);
+}
@@ -97,6 +97,7 @@ struct StorageModule::impl {
   ConfigCache cache_;
   ConfigCache memory_only_cache_;
   bool has_pending_config_save_ = false;
+  DeviceRecordCache device_records_{&cache_};
 };
 
 Mutation StorageModule::Modify() {
@@ -258,6 +259,16 @@ std::vector<Device> StorageModule::GetBondedDevices() {
   return result;
 }
 
+std::shared_ptr<const DeviceRecord> StorageModule::GetBondedDeviceRecord(const hci::Address& address) {
+  std::lock_guard<std::recursive_mutex> lock(mutex_);
+  return pimpl_->device_records_.Get(address);
+}
+
+std::vector<std::shared_ptr<const DeviceRecord>> StorageModule::GetBondedDeviceRecords() {
+  std::lock_guard<std::recursive_mutex> lock(mutex_);
+  return pimpl_->device_records_.GetAll();
+}
+
 bool StorageModule::is_config_checksum_pass(int check_bit) {
   return ((os::ParameterProvider::GetCommonCriteriaConfigCompareResult() & check_bit) == check_bit);
 }
@@ -27,6 +27,7 @@
 #include "module.h"
 #include "storage/config_cache.h"
 #include "storage/device.h"
+#include "storage/device_record.h"
 #include "storage/mutation.h"
 
 namespace bluetooth {
@@ -108,6 +109,15 @@ class StorageModule : public bluetooth::Module {
   // Get a list of bonded devices from config
   std::vector<Device> GetBondedDevices();
 
+  // Typed records of bonded devices, parsed once and shared until the device's config section changes. Prefer these
+  // over the Device getters, which parse config strings on every call, when reading many properties or on every
+  // connection. Records are read only, use Modify() to change a device.
+  //
+  // Get the record of the bonded device whose config section is keyed by |address|, nullptr if it is not bonded
+  std::shared_ptr<const DeviceRecord> GetBondedDeviceRecord(const hci::Address& address);
+  // Get the records of all bonded devices
+  std::vector<std::shared_ptr<const DeviceRecord>> GetBondedDeviceRecords();
+
   // Modify the underlying config by starting a mutation. All entries in the mutation will be applied atomically when
   // Commit() is called. User should never touch ConfigCache() directly.
   Mutation Modify();
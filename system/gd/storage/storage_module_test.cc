@@ -38,9 +38,11 @@ namespace testing {
 
 using bluetooth::TestModuleRegistry;
 using bluetooth::hci::Address;
+using bluetooth::hci::DeviceType;
 using bluetooth::os::fake_timer::fake_timerfd_advance;
 using bluetooth::storage::ConfigCache;
 using bluetooth::storage::Device;
+using bluetooth::storage::DeviceProperty;
 using bluetooth::storage::LegacyConfigFile;
 using bluetooth::storage::StorageModule;
 
@@ -277,6 +279,45 @@ TEST_F(StorageModuleTest, get_bonded_devices_test) {
   test_registry_.StopAll();
 }
 
+TEST_F(StorageModuleTest, get_bonded_device_records_test) {
+  // Prepare config file
+  ASSERT_TRUE(bluetooth::os::WriteToFile(temp_config_.string(), kReadTestConfig));
+
+  // Set up
+  auto* storage = new TestStorageModule(temp_config_.string(), kTestConfigSaveDelay, false, false);
+  test_registry_.InjectTestModule(&StorageModule::Factory, storage);
+
+  auto address = Address::FromString("01:02:03:ab:cd:ea");
+  auto records = storage->GetBondedDeviceRecords();
+  ASSERT_EQ(records.size(), 1u);
+  ASSERT_EQ(records[0]->address, address);
+  ASSERT_TRUE(records[0]->Has(DeviceProperty::LINK_KEY));
+  ASSERT_EQ(records[0]->link_key.ToString(), "fedcba0987654321fedcba0987654328");
+  ASSERT_FALSE(records[0]->Has(DeviceProperty::DEVICE_TYPE));
+
+  // The same record is shared until the device changes
+  auto record = storage->GetBondedDeviceRecord(*address);
+  ASSERT_EQ(record, records[0]);
+  ASSERT_EQ(storage->GetBondedDeviceRecord(*Address::FromString("01:02:03:ab:cd:eb")), nullptr);
+
+  auto mutation = storage->Modify();
+  mutation.Add(storage->GetDeviceByLegacyKey(*address).SetDeviceType(DeviceType::BR_EDR));
+  mutation.Commit();
+  auto new_record = storage->GetBondedDeviceRecord(*address);
+  ASSERT_NE(new_record, record);
+  ASSERT_EQ(new_record->device_type, DeviceType::BR_EDR);
+  // Records given out before are left untouched
+  ASSERT_FALSE(record->Has(DeviceProperty::DEVICE_TYPE));
+
+  // No record once the device is no longer bonded
+  storage->RemovePropertyPublic(address->ToString(), "LinkKey");
+  ASSERT_EQ(storage->GetBondedDeviceRecord(*address), nullptr);
+  ASSERT_TRUE(storage->GetBondedDeviceRecords().empty());
+
+  // Tear down
+  test_registry_.StopAll();
+}
+
 TEST_F(StorageModuleTest, unchanged_config_causes_no_write) {
   // Prepare config file
   ASSERT_TRUE(bluetooth::os::WriteToFile(temp_config_.string(), kReadTestConfig));
@@ -21,6 +21,7 @@
 #include <time.h>
 
 #include <chrono>
+#include <cinttypes>
 #include <cstdint>
 #include <functional>
 #include <future>
@@ -1250,6 +1251,8 @@ void DumpsysAcl(int fd) {
     LOG_DUMPSYS(fd, "    link_supervision_timeout:%.3f sec",
                 ticks_to_seconds(link.link_super_tout));
     LOG_DUMPSYS(fd, "    disconnect_reason:0x%02x", link.disconnect_reason);
+    LOG_DUMPSYS(fd, "    tx_shim_copied packets:%" PRIu64 " bytes:%" PRIu64,
+                link.tx_shim_copied_packets, link.tx_shim_copied_bytes);
 
     if (link.is_transport_br_edr()) {
       for (int j = 0; j < HCI_EXT_FEATURES_PAGE_MAX + 1; j++) {
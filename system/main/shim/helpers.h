@@ -104,12 +104,11 @@ inline tBLE_BD_ADDR ToLegacyAddressWithType(
   return legacy_address_with_type;
 }
 
+// Copies the payload once, straight into the builder.
 inline std::unique_ptr<bluetooth::packet::RawBuilder> MakeUniquePacket(
     const uint8_t* data, size_t len, bool is_flushable) {
-  bluetooth::packet::RawBuilder builder;
-  std::vector<uint8_t> bytes(data, data + len);
-  auto payload = std::make_unique<bluetooth::packet::RawBuilder>();
-  payload->AddOctets(bytes);
+  auto payload = std::make_unique<bluetooth::packet::RawBuilder>(
+      std::vector<uint8_t>(data, data + len));
   payload->SetFlushable(is_flushable);
   return payload;
 }
@@ -17,14 +17,161 @@
 // - All strings are case sensitive.
 
 #include <stdbool.h>
+
+#include <initializer_list>
+#include <iterator>
 #include <list>
 #include <memory>
 #include <string>
+#include <unordered_map>
+#include <utility>
 
 // The default section name to use if a key/value pair is not defined within
 // a section.
 #define CONFIG_DEFAULT_SECTION "Global"
 
+// A std::list that also keeps a hash index from the |Key| member of each
+// element to the first element with that key, so lookups by key are O(1)
+// while iteration (and therefore serialization) keeps insertion order.
+// Elements must not be renamed in place while they are in the list.
+template <typename T, std::string T::*Key>
+class config_list {
+ public:
+  using value_type = T;
+  using iterator = typename std::list<T>::iterator;
+  using const_iterator = typename std::list<T>::const_iterator;
+
+  config_list() = default;
+  config_list(std::initializer_list<T> init) : list_(init) { Reindex(); }
+  config_list(const config_list& other) : list_(other.list_) { Reindex(); }
+  config_list(config_list&& other) { *this = std::move(other); }
+
+  config_list& operator=(const config_list& other) {
+    if (this != &other) {
+      list_ = other.list_;
+      Reindex();
+    }
+    return *this;
+  }
+
+  config_list& operator=(std::initializer_list<T> init) {
+    list_ = init;
+    Reindex();
+    return *this;
+  }
+
+  config_list& operator=(config_list&& other) {
+    if (this != &other) {
+      // Iterators into |other.list_| stay valid in |list_| after the move.
+      list_ = std::move(other.list_);
+      index_ = std::move(other.index_);
+      duplicates_ = other.duplicates_;
+      other.list_.clear();
+      other.index_.clear();
+      other.duplicates_ = 0;
+    }
+    return *this;
+  }
+
+  iterator begin() { return list_.begin(); }
+  iterator end() { return list_.end(); }
+  const_iterator begin() const { return list_.begin(); }
+  const_iterator end() const { return list_.end(); }
+
+  size_t size() const { return list_.size(); }
+  bool empty() const { return list_.empty(); }
+
+  T& front() { return list_.front(); }
+  T& back() { return list_.back(); }
+  const T& front() const { return list_.front(); }
+  const T& back() const { return list_.back(); }
+
+  void push_back(const T& value) { emplace_back(value); }
+  void push_back(T&& value) { emplace_back(std::move(value)); }
+
+  template <class... Args>
+  T& emplace_back(Args&&... args) {
+    list_.emplace_back(std::forward<Args>(args)...);
+    Index(std::prev(list_.end()));
+    return list_.back();
+  }
+
+  void pop_front() { erase(list_.begin()); }
+
+  iterator erase(const_iterator pos) {
+    Unindex(pos);
+    return list_.erase(pos);
+  }
+
+  void clear() {
+    list_.clear();
+    index_.clear();
+    duplicates_ = 0;
+  }
+
+  template <class Compare>
+  void sort(Compare comp) {
+    list_.sort(comp);
+    // Sorting keeps iterators valid, but may reorder elements sharing a key.
+    if (duplicates_ != 0) Reindex();
+  }
+
+  // Returns the first element whose key is |key|, or end() if there is none.
+  iterator find(const std::string& key) {
+    auto it = index_.find(key);
+    return it == index_.end() ? list_.end() : it->second;
+  }
+
+  const_iterator find(const std::string& key) const {
+    auto it = index_.find(key);
+    return it == index_.end() ? list_.end() : const_iterator(it->second);
+  }
+
+ private:
+  void Index(iterator it) {
+    if (!index_.emplace((*it).*Key, it).second) duplicates_++;
+  }
+
+  void Unindex(const_iterator pos) {
+    auto it = index_.find((*pos).*Key);
+    if (it != index_.end() && const_iterator(it->second) == pos) {
+      index_.erase(it);
+      if (duplicates_ != 0) IndexFirst((*pos).*Key, pos);
+      return;
+    }
+
+    // |pos| is a later duplicate, or is not indexed under its current key
+    // because it was moved from before being erased. Drop whichever entry
+    // still refers to it.
+    for (auto entry = index_.begin(); entry != index_.end(); ++entry) {
+      if (const_iterator(entry->second) == pos) {
+        index_.erase(entry);
+        return;
+      }
+    }
+  }
+
+  // Indexes the first element other than |skip| with |key|, if any.
+  void IndexFirst(const std::string& key, const_iterator skip) {
+    for (auto it = list_.begin(); it != list_.end(); ++it) {
+      if (const_iterator(it) != skip && (*it).*Key == key) {
+        index_.emplace(key, it);
+        return;
+      }
+    }
+  }
+
+  void Reindex() {
+    index_.clear();
+    duplicates_ = 0;
+    for (auto it = list_.begin(); it != list_.end(); ++it) Index(it);
+  }
+
+  std::list<T> list_;
+  std::unordered_map<std::string, iterator> index_;
+  size_t duplicates_ = 0;
+};
+
 struct entry_t {
   std::string key;
   std::string value;
@@ -32,14 +179,14 @@ struct entry_t {
 
 struct section_t {
   std::string name;
-  std::list<entry_t> entries;
+  config_list<entry_t, &entry_t::key> entries;
   void Set(std::string key, std::string value);
   std::list<entry_t>::iterator Find(const std::string& key);
   bool Has(const std::string& key);
 };
 
 struct config_t {
-  std::list<section_t> sections;
+  config_list<section_t, &section_t::name> sections;
   std::list<section_t>::iterator Find(const std::string& section);
   bool Has(const std::string& section);
 };
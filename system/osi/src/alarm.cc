@@ -31,12 +31,12 @@
 #include <time.h>
 
 #include <mutex>
+#include <vector>
 
 #include "check.h"
 #include "os/log.h"
 #include "osi/include/allocator.h"
 #include "osi/include/fixed_queue.h"
-#include "osi/include/list.h"
 #include "osi/include/osi.h"
 #include "osi/include/thread.h"
 #include "osi/include/wakelock.h"
@@ -97,6 +97,9 @@ struct alarm_t {
   void* data;
   alarm_stats_t stats;
 
+  size_t heap_index;  // Position in |alarms|, or ALARM_NOT_PENDING
+  uint64_t sequence;  // Insertion order, breaks ties between equal deadlines
+
   bool for_msg_loop;  // True, if the alarm should be processed on message loop
   CancelableClosureInStruct closure;  // posted to message loop for processing
 };
@@ -108,11 +111,17 @@ struct alarm_t {
 int64_t TIMER_INTERVAL_FOR_WAKELOCK_IN_MS = 3000;
 static const clockid_t CLOCK_ID = CLOCK_BOOTTIME;
 
+static const size_t ALARM_NOT_PENDING = SIZE_MAX;
+
 // This mutex ensures that the |alarm_set|, |alarm_cancel|, and alarm callback
 // functions execute serially and not concurrently. As a result, this mutex
-// also protects the |alarms| list.
+// also protects the |alarms| heap.
 static std::mutex alarms_mutex;
-static list_t* alarms;
+// Binary min-heap of pending alarms, ordered by deadline and then by insertion
+// order so alarms with equal deadlines still fire in the order they were set.
+// Each alarm records its own position, so set and cancel are O(log n).
+static std::vector<alarm_t*>* alarms;
+static uint64_t next_alarm_sequence;
 static timer_t timer;
 static timer_t wakeup_timer;
 static bool timer_set;
@@ -134,6 +143,7 @@ static void alarm_set_internal(alarm_t* alarm, uint64_t period_ms,
                                fixed_queue_t* queue, bool for_msg_loop);
 static void alarm_cancel_internal(alarm_t* alarm);
 static void remove_pending_alarm(alarm_t* alarm);
+static bool insert_next_instance(alarm_t* alarm);
 static void schedule_next_instance(alarm_t* alarm);
 static void reschedule_root_alarm(void);
 static void alarm_queue_ready(fixed_queue_t* queue, void* context);
@@ -147,6 +157,73 @@ static void update_scheduling_stats(alarm_stats_t* stats, uint64_t now_ms,
 static void alarm_register_processing_queue(fixed_queue_t* queue,
                                             thread_t* thread);
 
+static alarm_t* alarm_heap_top(void) {
+  return alarms->empty() ? NULL : alarms->front();
+}
+
+static bool alarm_heap_less(const alarm_t* a, const alarm_t* b) {
+  if (a->deadline_ms != b->deadline_ms) return a->deadline_ms < b->deadline_ms;
+  return a->sequence < b->sequence;
+}
+
+static void alarm_heap_place(size_t index, alarm_t* alarm) {
+  (*alarms)[index] = alarm;
+  alarm->heap_index = index;
+}
+
+static void alarm_heap_sift_up(size_t index) {
+  alarm_t* alarm = (*alarms)[index];
+  while (index > 0) {
+    size_t parent = (index - 1) / 2;
+    if (!alarm_heap_less(alarm, (*alarms)[parent])) break;
+    alarm_heap_place(index, (*alarms)[parent]);
+    index = parent;
+  }
+  alarm_heap_place(index, alarm);
+}
+
+static void alarm_heap_sift_down(size_t index) {
+  const size_t size = alarms->size();
+  alarm_t* alarm = (*alarms)[index];
+  while (true) {
+    size_t child = 2 * index + 1;
+    if (child >= size) break;
+    if (child + 1 < size &&
+        alarm_heap_less((*alarms)[child + 1], (*alarms)[child]))
+      child++;
+    if (!alarm_heap_less((*alarms)[child], alarm)) break;
+    alarm_heap_place(index, (*alarms)[child]);
+    index = child;
+  }
+  alarm_heap_place(index, alarm);
+}
+
+// The caller must hold the |alarms_mutex|
+static void alarm_heap_push(alarm_t* alarm) {
+  alarm->sequence = next_alarm_sequence++;
+  alarms->push_back(alarm);
+  alarm_heap_sift_up(alarms->size() - 1);
+}
+
+// Removes |alarm| from the heap if it is pending.
+// The caller must hold the |alarms_mutex|
+static void alarm_heap_remove(alarm_t* alarm) {
+  const size_t index = alarm->heap_index;
+  if (index == ALARM_NOT_PENDING) return;
+  alarm->heap_index = ALARM_NOT_PENDING;
+
+  alarm_t* last = alarms->back();
+  alarms->pop_back();
+  if (last == alarm) return;
+
+  alarm_heap_place(index, last);
+  if (index > 0 && alarm_heap_less(last, (*alarms)[(index - 1) / 2])) {
+    alarm_heap_sift_up(index);
+  } else {
+    alarm_heap_sift_down(index);
+  }
+}
+
 static void update_stat(stat_t* stat, uint64_t delta_ms) {
   if (stat->max_ms < delta_ms) stat->max_ms = delta_ms;
   stat->total_ms += delta_ms;
@@ -160,7 +237,7 @@ alarm_t* alarm_new_periodic(const char* name) {
 }
 
 static alarm_t* alarm_new_internal(const char* name, bool is_periodic) {
-  // Make sure we have a list we can insert alarms into.
+  // Make sure we have a heap we can insert alarms into.
   if (!alarms && !lazy_initialize()) {
     CHECK(false);  // if initialization failed, we should not continue
     return NULL;
@@ -171,6 +248,7 @@ static alarm_t* alarm_new_internal(const char* name, bool is_periodic) {
   std::shared_ptr<std::recursive_mutex> ptr(new std::recursive_mutex());
   ret->callback_mutex = ptr;
   ret->is_periodic = is_periodic;
+  ret->heap_index = ALARM_NOT_PENDING;
   ret->stats.name = osi_strdup(name);
 
   ret->for_msg_loop = false;
@@ -255,8 +333,7 @@ void alarm_cancel(alarm_t* alarm) {
 // Internal implementation of canceling an alarm.
 // The caller must hold the |alarms_mutex|
 static void alarm_cancel_internal(alarm_t* alarm) {
-  bool needs_reschedule =
-      (!list_is_empty(alarms) && list_front(alarms) == alarm);
+  bool needs_reschedule = (alarm_heap_top() == alarm);
 
   remove_pending_alarm(alarm);
 
@@ -296,7 +373,9 @@ void alarm_cleanup(void) {
   semaphore_free(alarm_expired);
   alarm_expired = NULL;
 
-  list_free(alarms);
+  // Alarms may outlive the heap, make sure they do not keep a stale position.
+  for (alarm_t* alarm : *alarms) alarm->heap_index = ALARM_NOT_PENDING;
+  delete alarms;
   alarms = NULL;
 }
 
@@ -310,11 +389,7 @@ static bool lazy_initialize(void) {
 
   std::lock_guard<std::mutex> lock(alarms_mutex);
 
-  alarms = list_new(NULL);
-  if (!alarms) {
-    LOG_ERROR("%s unable to allocate alarm list.", __func__);
-    goto error;
-  }
+  alarms = new std::vector<alarm_t*>();
 
   if (!timer_create_internal(CLOCK_ID, &timer)) goto error;
   timer_initialized = true;
@@ -375,7 +450,7 @@ error:
 
   if (timer_initialized) timer_delete(timer);
 
-  list_free(alarms);
+  delete alarms;
   alarms = NULL;
 
   return false;
@@ -393,10 +468,10 @@ static uint64_t now_ms(void) {
   return (ts.tv_sec * 1000LL) + (ts.tv_nsec / 1000000LL);
 }
 
-// Remove alarm from internal alarm list and the processing queue
+// Remove alarm from internal alarm heap and the processing queue
 // The caller must hold the |alarms_mutex|
 static void remove_pending_alarm(alarm_t* alarm) {
-  list_remove(alarms, alarm);
+  alarm_heap_remove(alarm);
 
   if (alarm->for_msg_loop) {
     alarm->closure.i.Cancel();
@@ -409,12 +484,14 @@ static void remove_pending_alarm(alarm_t* alarm) {
   }
 }
 
+// Computes the next deadline for |alarm| and (re)inserts it into the heap.
+// Returns true if the earliest deadline changed and the root alarm needs to be
+// re-scheduled.
 // Must be called with |alarms_mutex| held
-static void schedule_next_instance(alarm_t* alarm) {
-  // If the alarm is currently set and it's at the start of the list,
+static bool insert_next_instance(alarm_t* alarm) {
+  // If the alarm is currently set and it's at the top of the heap,
   // we'll need to re-schedule since we've adjusted the earliest deadline.
-  bool needs_reschedule =
-      (!list_is_empty(alarms) && list_front(alarms) == alarm);
+  bool needs_reschedule = (alarm_heap_top() == alarm);
   if (alarm->callback) remove_pending_alarm(alarm);
 
   // Calculate the next deadline for this alarm
@@ -425,28 +502,16 @@ static void schedule_next_instance(alarm_t* alarm) {
         ((just_now_ms - alarm->creation_time_ms) % alarm->period_ms);
   alarm->deadline_ms = just_now_ms + (alarm->period_ms - ms_into_period);
 
-  // Add it into the timer list sorted by deadline (earliest deadline first).
-  if (list_is_empty(alarms) ||
-      ((alarm_t*)list_front(alarms))->deadline_ms > alarm->deadline_ms) {
-    list_prepend(alarms, alarm);
-  } else {
-    for (list_node_t* node = list_begin(alarms); node != list_end(alarms);
-         node = list_next(node)) {
-      list_node_t* next = list_next(node);
-      if (next == list_end(alarms) ||
-          ((alarm_t*)list_node(next))->deadline_ms > alarm->deadline_ms) {
-        list_insert_after(alarms, node, alarm);
-        break;
-      }
-    }
-  }
+  alarm_heap_push(alarm);
 
   // If the new alarm has the earliest deadline, we need to re-evaluate our
   // schedule.
-  if (needs_reschedule ||
-      (!list_is_empty(alarms) && list_front(alarms) == alarm)) {
-    reschedule_root_alarm();
-  }
+  return needs_reschedule || alarm_heap_top() == alarm;
+}
+
+// Must be called with |alarms_mutex| held
+static void schedule_next_instance(alarm_t* alarm) {
+  if (insert_next_instance(alarm)) reschedule_root_alarm();
 }
 
 // NOTE: must be called with |alarms_mutex| held
@@ -461,9 +526,9 @@ static void reschedule_root_alarm(void) {
   struct itimerspec timer_time;
   memset(&timer_time, 0, sizeof(timer_time));
 
-  if (list_is_empty(alarms)) goto done;
+  next = alarm_heap_top();
+  if (next == NULL) goto done;
 
-  next = static_cast<alarm_t*>(list_front(alarms));
   next_expiration = next->deadline_ms - now_ms();
   if (next_expiration < TIMER_INTERVAL_FOR_WAKELOCK_IN_MS) {
     if (!timer_set) {
@@ -608,50 +673,55 @@ static void timer_callback(UNUSED_ATTR void* ptr) {
   semaphore_post(alarm_expired);
 }
 
+// Enqueues |alarm| for processing by the thread that owns its queue.
+// Must be called with |alarms_mutex| held
+static void enqueue_expired_alarm(alarm_t* alarm) {
+  if (alarm->for_msg_loop) {
+    if (!get_main_thread()) {
+      LOG_ERROR("%s: message loop already NULL. Alarm: %s", __func__,
+                alarm->stats.name);
+      return;
+    }
+
+    alarm->closure.i.Reset(Bind(alarm_ready_mloop, alarm));
+    get_main_thread()->DoInThread(FROM_HERE, alarm->closure.i.callback());
+  } else {
+    fixed_queue_enqueue(alarm->queue, alarm);
+  }
+}
+
 // Function running on |dispatcher_thread| that performs the following:
 //   (1) Receives a signal using |alarm_exired| that the alarm has expired
-//   (2) Dispatches the alarm callback for processing by the corresponding
-// thread for that alarm.
+//   (2) Dispatches the callbacks of all expired alarms for processing by the
+// corresponding thread for each alarm, then re-arms the timer once.
 static void callback_dispatch(UNUSED_ATTR void* context) {
   while (true) {
     semaphore_wait(alarm_expired);
     if (!dispatcher_thread_active) break;
 
     std::lock_guard<std::mutex> lock(alarms_mutex);
+    const uint64_t just_now_ms = now_ms();
+
+    // Take into account that the alarm may get cancelled before we get to it,
+    // in which case the alarm at the top may be in the future and there is
+    // nothing to dispatch. Bound the loop by the number of pending alarms so
+    // that zero-period alarms are dispatched at most once per wakeup.
+    size_t budget = alarms->size();
     alarm_t* alarm;
+    while (budget-- > 0 && (alarm = alarm_heap_top()) != NULL &&
+           alarm->deadline_ms <= just_now_ms) {
+      alarm_heap_remove(alarm);
+
+      if (alarm->is_periodic) {
+        alarm->prev_deadline_ms = alarm->deadline_ms;
+        insert_next_instance(alarm);
+        alarm->stats.rescheduled_count++;
+      }
 
-    // Take into account that the alarm may get cancelled before we get to it.
-    // We're done here if there are no alarms or the alarm at the front is in
-    // the future. Exit right away since there's nothing left to do.
-    if (list_is_empty(alarms) ||
-        (alarm = static_cast<alarm_t*>(list_front(alarms)))->deadline_ms >
-            now_ms()) {
-      reschedule_root_alarm();
-      continue;
+      enqueue_expired_alarm(alarm);
     }
 
-    list_remove(alarms, alarm);
-
-    if (alarm->is_periodic) {
-      alarm->prev_deadline_ms = alarm->deadline_ms;
-      schedule_next_instance(alarm);
-      alarm->stats.rescheduled_count++;
-    }
     reschedule_root_alarm();
-
-    // Enqueue the alarm for processing
-    if (alarm->for_msg_loop) {
-      if (!get_main_thread()) {
-        LOG_ERROR("%s: message loop already NULL. Alarm: %s", __func__,
-                  alarm->stats.name);
-        continue;
-      }
-
-      alarm->closure.i.Reset(Bind(alarm_ready_mloop, alarm));
-      get_main_thread()->DoInThread(FROM_HERE, alarm->closure.i.callback());
-    } else {
-      fixed_queue_enqueue(alarm->queue, alarm);
-    }
   }
 
   LOG_INFO("%s Callback thread exited", __func__);
@@ -729,12 +799,10 @@ void alarm_debug_dump(int fd) {
 
   uint64_t just_now_ms = now_ms();
 
-  dprintf(fd, "  Total Alarms: %zu\n\n", list_length(alarms));
+  dprintf(fd, "  Total Alarms: %zu\n\n", alarms->size());
 
   // Dump info for each alarm
-  for (list_node_t* node = list_begin(alarms); node != list_end(alarms);
-       node = list_next(node)) {
-    alarm_t* alarm = (alarm_t*)list_node(node);
+  for (alarm_t* alarm : *alarms) {
     alarm_stats_t* stats = &alarm->stats;
 
     dprintf(fd, "  Alarm : %s (%s)\n", stats->name,
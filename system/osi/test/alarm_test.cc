@@ -22,6 +22,8 @@
 #include <gtest/gtest.h>
 #include <hardware/bluetooth.h>
 
+#include <vector>
+
 #include "common/message_loop_thread.h"
 #include "osi/include/fixed_queue.h"
 #include "osi/include/osi.h"
@@ -319,6 +321,45 @@ TEST_F(AlarmTest, test_callback_ordering) {
   EXPECT_FALSE(is_wake_lock_acquired);
 }
 
+// Arm, re-arm and cancel a large number of alarms, and make sure the ones
+// left armed still fire in deadline order.
+TEST_F(AlarmTest, test_set_cancel_10k_alarms) {
+  const int kNumAlarms = 10000;
+  std::vector<alarm_t*> alarms(kNumAlarms);
+
+  for (int i = 0; i < kNumAlarms; i++) {
+    const std::string alarm_name =
+        "alarm_test.test_set_cancel_10k_alarms[" + std::to_string(i) + "]";
+    alarms[i] = alarm_new(alarm_name.c_str());
+  }
+
+  // Arm every alarm far in the future, in reverse deadline order.
+  for (int i = 0; i < kNumAlarms; i++) {
+    alarm_set(alarms[i], 3600000 - i, cb, NULL);
+  }
+
+  for (int i = 1; i < kNumAlarms; i += 2) {
+    alarm_cancel(alarms[i]);
+    EXPECT_FALSE(alarm_is_scheduled(alarms[i]));
+  }
+
+  for (int i = 0; i < kNumAlarms; i += 2) {
+    EXPECT_TRUE(alarm_is_scheduled(alarms[i]));
+    alarm_set(alarms[i], 100, ordered_cb, INT_TO_PTR(i / 2));
+  }
+
+  for (int i = 1; i <= kNumAlarms / 2; i++) {
+    semaphore_wait(semaphore);
+    EXPECT_GE(cb_counter, i);
+  }
+  EXPECT_EQ(cb_counter, kNumAlarms / 2);
+  EXPECT_EQ(cb_misordered_counter, 0);
+
+  for (int i = 0; i < kNumAlarms; i++) alarm_free(alarms[i]);
+
+  EXPECT_FALSE(is_wake_lock_acquired);
+}
+
 // Test whether the callbacks are involed in the expected order on a
 // message loop.
 TEST_F(AlarmTest, test_callback_ordering_on_mloop) {
@@ -240,6 +240,44 @@ TEST_F(ConfigTest, config_remove_key_missing) {
   EXPECT_EQ(config_get_int(*config, "DID", "productId", 999), 999);
 }
 
+TEST_F(ConfigTest, config_keeps_insertion_order) {
+  std::unique_ptr<config_t> config = config_new_empty();
+  config_set_string(config.get(), "c", "key", "1");
+  config_set_string(config.get(), "a", "key", "2");
+  config_set_string(config.get(), "b", "key", "3");
+  config_set_string(config.get(), "a", "other", "4");
+  EXPECT_TRUE(config_remove_section(config.get(), "a"));
+  config_set_string(config.get(), "a", "key", "5");
+
+  std::string names;
+  for (const section_t& section : config->sections) names += section.name;
+  EXPECT_EQ(names, "cba");
+  EXPECT_FALSE(config_has_key(*config, "a", "other"));
+  EXPECT_EQ(config_get_int(*config, "a", "key", 0), 5);
+  EXPECT_EQ(config_get_int(*config, "b", "key", 0), 3);
+}
+
+TEST_F(ConfigTest, config_lookup_after_direct_list_changes) {
+  config_t config;
+  config.sections = {section_t{.name = "dup"}, section_t{.name = "other"},
+                     section_t{.name = "dup"}};
+  ASSERT_EQ(config.Find("dup"), config.sections.begin());
+
+  config.sections.erase(config.sections.begin());
+  ASSERT_NE(config.Find("dup"), config.sections.end());
+  EXPECT_EQ(&*config.Find("dup"), &config.sections.back());
+
+  // Sections moved out of before being erased must not stay indexed.
+  auto other = config.Find("other");
+  section_t moved = std::move(*other);
+  config.sections.erase(other);
+  EXPECT_EQ(config.Find("other"), config.sections.end());
+  EXPECT_EQ(config.sections.size(), 1u);
+
+  config_t copy = config;
+  EXPECT_EQ(&*copy.Find("dup"), &copy.sections.front());
+}
+
 TEST_F(ConfigTest, config_save_basic) {
   std::unique_ptr<config_t> config = config_new(CONFIG_FILE);
   EXPECT_TRUE(config_save(*config, CONFIG_FILE));
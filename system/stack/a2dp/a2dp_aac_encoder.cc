@@ -25,6 +25,7 @@
 #include <string.h>
 
 #include "a2dp_aac.h"
+#include "a2dp_bitrate_adapter.h"
 #include "common/time_util.h"
 #include "internal_include/bt_target.h"
 #include "os/log.h"
@@ -83,6 +84,7 @@ typedef struct {
   tA2DP_FEEDING_PARAMS feeding_params;
   tA2DP_AAC_ENCODER_PARAMS aac_encoder_params;
   tA2DP_AAC_FEEDING_STATE aac_feeding_state;
+  tA2DP_BITRATE_ADAPTER bitrate_adapter;
 
   a2dp_aac_encoder_stats_t stats;
 } tA2DP_AAC_ENCODER_CB;
@@ -152,7 +154,7 @@ static void a2dp_aac_encoder_update(A2dpCodecConfig* a2dp_codec_config,
       &a2dp_aac_encoder_cb.aac_encoder_params;
   uint8_t codec_info[AVDT_CODEC_SIZE];
   AACENC_ERROR aac_error;
-  int aac_param_value, aac_sampling_freq, aac_peak_bit_rate;
+  int aac_param_value, aac_sampling_freq, aac_peak_bit_rate, aac_bit_rate;
 
   *p_restart_input = false;
   *p_restart_output = false;
@@ -281,6 +283,7 @@ static void a2dp_aac_encoder_update(A2dpCodecConfig* a2dp_codec_config,
   aac_peak_bit_rate =
       A2DP_ComputeMaxBitRateAac(p_codec_info, a2dp_aac_encoder_cb.TxAaMtuSize);
   aac_param_value = std::min(aac_param_value, aac_peak_bit_rate);
+  aac_bit_rate = aac_param_value;
   LOG_INFO("%s: MTU = %d Sampling Frequency = %d Bit Rate = %d", __func__,
            a2dp_aac_encoder_cb.TxAaMtuSize, aac_sampling_freq, aac_param_value);
   if (aac_param_value == -1) {
@@ -392,6 +395,15 @@ static void a2dp_aac_encoder_update(A2dpCodecConfig* a2dp_codec_config,
     return;  // TODO: Return an error?
   }
 
+  // The bit rate is only adapted to the link in CBR mode: in VBR mode the
+  // encoder ignores AACENC_BITRATE.
+  if (aac_param_value == A2DP_AAC_VARIABLE_BIT_RATE_DISABLED) {
+    a2dp_bitrate_adapter_init(&a2dp_aac_encoder_cb.bitrate_adapter,
+                              aac_bit_rate, aac_bit_rate / 2);
+  } else {
+    a2dp_bitrate_adapter_init(&a2dp_aac_encoder_cb.bitrate_adapter, 0, 0);
+  }
+
   // Mark the end of setting the encoder's parameters
   aac_error =
       aacEncEncode(a2dp_aac_encoder_cb.aac_handle, NULL, NULL, NULL, NULL);
@@ -475,6 +487,21 @@ int a2dp_aac_get_effective_frame_size() {
   return a2dp_aac_encoder_cb.TxAaMtuSize;
 }
 
+void a2dp_aac_set_transmit_queue_length(size_t transmit_queue_length) {
+  tA2DP_BITRATE_ADAPTER* p_adapter = &a2dp_aac_encoder_cb.bitrate_adapter;
+  if (!a2dp_aac_encoder_cb.has_aac_handle ||
+      !a2dp_bitrate_adapter_update(p_adapter, transmit_queue_length)) {
+    return;
+  }
+  AACENC_ERROR aac_error = aacEncoder_SetParam(
+      a2dp_aac_encoder_cb.aac_handle, AACENC_BITRATE, p_adapter->bitrate);
+  if (aac_error != AACENC_OK) {
+    LOG_ERROR("%s: Cannot set AAC parameter AACENC_BITRATE to %u: "
+              "AAC error 0x%x",
+              __func__, p_adapter->bitrate, aac_error);
+  }
+}
+
 void a2dp_aac_send_frames(uint64_t timestamp_us) {
   uint8_t nb_frame = 0;
   uint8_t nb_iterations = 0;
@@ -718,6 +745,17 @@ void A2dpCodecConfigAacSource::debug_codec_dump(int fd) {
   dprintf(fd, "  Encoder interval (ms): %" PRIu64 "\n",
           a2dp_aac_get_encoder_interval_ms());
   dprintf(fd, "  Effective MTU: %d\n", a2dp_aac_get_effective_frame_size());
+  const tA2DP_BITRATE_ADAPTER& adapter = a2dp_aac_encoder_cb.bitrate_adapter;
+  if (adapter.max_bitrate != 0) {
+    dprintf(fd,
+            "  Adaptive bit rate (current/max)                         : %u / "
+            "%u\n",
+            adapter.bitrate, adapter.max_bitrate);
+    dprintf(fd,
+            "  Adaptive bit rate changes (decreases/increases)         : %zu / "
+            "%zu\n",
+            adapter.decreases, adapter.increases);
+  }
   dprintf(fd,
           "  Packet counts (expected/dropped)                        : %zu / "
           "%zu\n",
@@ -255,6 +255,10 @@ int a2dp_aac_get_effective_frame_size() {
   return a2dp_aac_encoder_cb.TxAaMtuSize;
 }
 
+void a2dp_aac_set_transmit_queue_length(size_t /* transmit_queue_length */) {
+  // The codec server does not support changing the bit rate.
+}
+
 void a2dp_aac_send_frames(uint64_t timestamp_us) {
   uint8_t nb_frame = 0;
   uint8_t nb_iterations = 0;
@@ -0,0 +1,89 @@
+/*
+ * Copyright 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "a2dp_bitrate_adapter"
+
+#include "a2dp_bitrate_adapter.h"
+
+#include <algorithm>
+
+#include "osi/include/log.h"
+
+// A transmit queue at least this long means the link is congested.
+#define A2DP_BITRATE_ADAPTER_CONGESTED_QUEUE_LENGTH 4
+// A transmit queue at most this long means the link keeps up.
+#define A2DP_BITRATE_ADAPTER_DRAINED_QUEUE_LENGTH 1
+// Encoder ticks to wait for a decrease to take effect before decreasing again.
+#define A2DP_BITRATE_ADAPTER_DECREASE_HOLD_TICKS 5
+// Encoder ticks the queue must stay drained for before increasing (~3s).
+#define A2DP_BITRATE_ADAPTER_INCREASE_TICKS 150
+// Number of steps from the minimum to the maximum bit rate when increasing.
+#define A2DP_BITRATE_ADAPTER_INCREASE_STEPS 8
+
+void a2dp_bitrate_adapter_init(tA2DP_BITRATE_ADAPTER* p_adapter,
+                               uint32_t max_bitrate, uint32_t min_bitrate) {
+  *p_adapter = {};
+  p_adapter->max_bitrate = max_bitrate;
+  p_adapter->min_bitrate = std::min(min_bitrate, max_bitrate);
+  p_adapter->bitrate = max_bitrate;
+  p_adapter->ticks_since_decrease = A2DP_BITRATE_ADAPTER_DECREASE_HOLD_TICKS;
+}
+
+bool a2dp_bitrate_adapter_update(tA2DP_BITRATE_ADAPTER* p_adapter,
+                                 size_t transmit_queue_length) {
+  if (p_adapter->max_bitrate == 0) return false;
+
+  if (p_adapter->ticks_since_decrease <
+      A2DP_BITRATE_ADAPTER_DECREASE_HOLD_TICKS) {
+    p_adapter->ticks_since_decrease++;
+  }
+
+  uint32_t bitrate = p_adapter->bitrate;
+  if (transmit_queue_length >= A2DP_BITRATE_ADAPTER_CONGESTED_QUEUE_LENGTH) {
+    p_adapter->drained_ticks = 0;
+    if (p_adapter->ticks_since_decrease <
+        A2DP_BITRATE_ADAPTER_DECREASE_HOLD_TICKS) {
+      return false;
+    }
+    bitrate = std::max(p_adapter->min_bitrate, bitrate - bitrate / 4);
+    p_adapter->ticks_since_decrease = 0;
+  } else if (transmit_queue_length <=
+             A2DP_BITRATE_ADAPTER_DRAINED_QUEUE_LENGTH) {
+    if (++p_adapter->drained_ticks < A2DP_BITRATE_ADAPTER_INCREASE_TICKS) {
+      return false;
+    }
+    p_adapter->drained_ticks = 0;
+    uint32_t step = std::max<uint32_t>(
+        1, (p_adapter->max_bitrate - p_adapter->min_bitrate) /
+               A2DP_BITRATE_ADAPTER_INCREASE_STEPS);
+    bitrate = std::min(p_adapter->max_bitrate, bitrate + step);
+  } else {
+    p_adapter->drained_ticks = 0;
+    return false;
+  }
+
+  if (bitrate == p_adapter->bitrate) return false;
+
+  if (bitrate < p_adapter->bitrate) {
+    p_adapter->decreases++;
+  } else {
+    p_adapter->increases++;
+  }
+  LOG_VERBOSE("%s: bit rate %u -> %u, transmit queue length %zu", __func__,
+              p_adapter->bitrate, bitrate, transmit_queue_length);
+  p_adapter->bitrate = bitrate;
+  return true;
+}
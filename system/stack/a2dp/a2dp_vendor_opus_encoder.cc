@@ -24,6 +24,7 @@
 #include <stdio.h>
 #include <string.h>
 
+#include "a2dp_bitrate_adapter.h"
 #include "a2dp_vendor.h"
 #include "a2dp_vendor_opus.h"
 #include "common/time_util.h"
@@ -79,6 +80,7 @@ typedef struct {
   tA2DP_FEEDING_PARAMS feeding_params;
   tA2DP_OPUS_ENCODER_PARAMS opus_encoder_params;
   tA2DP_OPUS_FEEDING_STATE opus_feeding_state;
+  tA2DP_BITRATE_ADAPTER bitrate_adapter;
 
   a2dp_opus_encoder_stats_t stats;
 } tA2DP_OPUS_ENCODER_CB;
@@ -273,6 +275,9 @@ static bool a2dp_vendor_opus_encoder_update(uint16_t peer_mtu,
     LOG_ERROR("failed to set encoder bitrate");
     return false;
   }
+  a2dp_bitrate_adapter_init(&a2dp_opus_encoder_cb.bitrate_adapter,
+                            p_encoder_params->bitrate,
+                            p_encoder_params->bitrate / 2);
 
   // Set the Audio format from pcm_wlength
   if (p_encoder_params->pcm_wlength == 2)
@@ -477,7 +482,16 @@ static bool a2dp_opus_read_feeding(uint8_t* read_buffer, uint32_t* bytes_read) {
 void a2dp_vendor_opus_set_transmit_queue_length(size_t transmit_queue_length) {
   a2dp_opus_encoder_cb.TxQueueLength = transmit_queue_length;
 
-  return;
+  tA2DP_BITRATE_ADAPTER* p_adapter = &a2dp_opus_encoder_cb.bitrate_adapter;
+  if (!a2dp_opus_encoder_cb.has_opus_handle ||
+      !a2dp_bitrate_adapter_update(p_adapter, transmit_queue_length)) {
+    return;
+  }
+  int error = opus_encoder_ctl(a2dp_opus_encoder_cb.opus_handle,
+                               OPUS_SET_BITRATE(p_adapter->bitrate));
+  if (error != OPUS_OK) {
+    LOG_ERROR("failed to set encoder bitrate to %u", p_adapter->bitrate);
+  }
 }
 
 uint64_t A2dpCodecConfigOpusSource::encoderIntervalMs() const {
@@ -517,6 +531,13 @@ void A2dpCodecConfigOpusSource::debug_codec_dump(int fd) {
           "  OPUS transmission bitrate (Kbps)                        : %d\n",
           p_encoder_params->bitrate);
 
+  dprintf(fd,
+          "  OPUS adaptive bitrate (current/decreases/increases)     : %u / "
+          "%zu / %zu\n",
+          a2dp_opus_encoder_cb.bitrate_adapter.bitrate,
+          a2dp_opus_encoder_cb.bitrate_adapter.decreases,
+          a2dp_opus_encoder_cb.bitrate_adapter.increases);
+
   dprintf(fd,
           "  OPUS saved transmit queue length                        : %zu\n",
           a2dp_opus_encoder_cb.TxQueueLength);
@@ -41,4 +41,6 @@ void tACL_CONN::Reset() {
   rs_disc_pending = BTM_SEC_RS_NOT_PENDING;
   switch_role_state_ = BTM_ACL_SWKEY_STATE_IDLE;
   sca = 0;
+  tx_shim_copied_packets = 0;
+  tx_shim_copied_bytes = 0;
 }
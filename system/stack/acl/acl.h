@@ -308,6 +308,15 @@ struct tACL_CONN {
  public:
   uint8_t sca; /* Sleep clock accuracy */
 
+  /* Packets and bytes copied into GD packet builders when sent through the
+   * shim, the last copy of outgoing data before it reaches the controller */
+  uint64_t tx_shim_copied_packets;
+  uint64_t tx_shim_copied_bytes;
+  void count_tx_shim_copy(size_t len) {
+    tx_shim_copied_packets++;
+    tx_shim_copied_bytes += len;
+  }
+
   void Reset();
 };
 
@@ -73,6 +73,7 @@
 #include "stack/include/btm_ble_api.h"
 #include "stack/include/btm_iso_api.h"
 #include "stack/include/hci_error_code.h"
+#include "stack/include/hcidefs.h"
 #include "stack/include/hcimsgs.h"
 #include "stack/include/l2cap_acl_interface.h"
 #include "stack/include/l2cdefs.h"
@@ -2634,6 +2635,7 @@ void acl_send_data_packet_br_edr(const RawAddress& bd_addr, BT_HDR* p_buf) {
       return;
     }
     power_telemetry::GetInstance().LogTxAclPktData(p_buf->len);
+    p_acl->count_tx_shim_copy(p_buf->len - HCI_DATA_PREAMBLE_SIZE);
     return bluetooth::shim::ACL_WriteData(p_acl->hci_handle, p_buf);
 }
 
@@ -2646,6 +2648,7 @@ void acl_send_data_packet_ble(const RawAddress& bd_addr, BT_HDR* p_buf) {
       return;
     }
     power_telemetry::GetInstance().LogTxAclPktData(p_buf->len);
+    p_acl->count_tx_shim_copy(p_buf->len - HCI_DATA_PREAMBLE_SIZE);
     return bluetooth::shim::ACL_WriteData(p_acl->hci_handle, p_buf);
 }
 
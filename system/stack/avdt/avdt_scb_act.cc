@@ -31,13 +31,22 @@
 #include "avdt_api.h"
 #include "avdt_int.h"
 #include "internal_include/bt_target.h"
+#include "l2cdefs.h"
 #include "os/log.h"
 #include "osi/include/allocator.h"
 #include "osi/include/osi.h"
 #include "stack/include/bt_hdr.h"
 #include "stack/include/bt_types.h"
+#include "stack/include/hcidefs.h"
 #include "types/raw_address.h"
 
+static_assert(AVDT_MEDIA_LOWER_HDR_SIZE ==
+                  L2CAP_PKT_OVERHEAD + HCI_DATA_PREAMBLE_SIZE,
+              "Media packet headroom does not match the L2CAP and HCI headers");
+static_assert(AVDT_MEDIA_OFFSET >=
+                  AVDT_MEDIA_HDR_SIZE + AVDT_MEDIA_LOWER_HDR_SIZE,
+              "AVDT_MEDIA_OFFSET is too small for the media packet headers");
+
 /* This table is used to lookup the callback event that matches a particular
  * state machine API request event.  Note that state machine API request
  * events are at the beginning of the event list starting at zero, thus
@@ -1005,11 +1014,19 @@ void avdt_scb_hdl_write_req(AvdtpScb* p_scb, tAVDT_SCB_EVT* p_data) {
         A2DP_UsesRtpHeader(is_content_protection, p_scb->curr_cfg.codec_info);
   }
 
+  /* The headers are written into the headroom of the buffer, make sure there
+   * is enough of it rather than let a lower layer write in front of it. */
+  uint16_t headroom = AVDT_MEDIA_LOWER_HDR_SIZE;
+  if (add_rtp_header) headroom += AVDT_MEDIA_HDR_SIZE;
+  if (p_data->apiwrite.p_buf->offset < headroom) {
+    LOG_ERROR("Dropped media packet; offset %d is below headroom %d",
+              p_data->apiwrite.p_buf->offset, headroom);
+    osi_free(p_data->apiwrite.p_buf);
+    return;
+  }
+
   /* Build a media packet, and add an RTP header if required. */
   if (add_rtp_header) {
-    if (p_data->apiwrite.p_buf->offset < AVDT_MEDIA_HDR_SIZE) {
-      return;
-    }
 
     ssrc = avdt_scb_gen_ssrc(p_scb);
 
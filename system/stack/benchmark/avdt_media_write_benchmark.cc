@@ -0,0 +1,197 @@
+/*
+ * Copyright 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <base/logging.h>
+#include <benchmark/benchmark.h>
+#include <string.h>
+
+#include <string>
+#include <vector>
+
+#include "common/init_flags.h"
+#include "internal_include/bt_target.h"
+#include "main/shim/helpers.h"
+#include "osi/include/allocator.h"
+#include "packet/bit_inserter.h"
+#include "stack/avdt/avdt_int.h"
+#include "stack/btm/btm_int_types.h"
+#include "stack/include/a2dp_codec_api.h"
+#include "stack/include/avdt_api.h"
+#include "stack/include/bt_hdr.h"
+#include "stack/include/hcidefs.h"
+#include "stack/include/l2cap_acl_interface.h"
+#include "stack/l2cap/l2c_int.h"
+#include "test/mock/mock_device_controller.h"
+#include "test/mock/mock_stack_acl.h"
+#include "types/raw_address.h"
+
+using ::benchmark::State;
+
+// Media packets written the way the A2DP source writes them: an encoder
+// buffer with AVDT_MEDIA_OFFSET of headroom goes through AVDT_WriteReqOpt,
+// AVDTP adds the RTP header, L2CAP its basic mode and HCI headers, and the
+// ACL data write copies it into a GD packet builder as the shim does. The
+// controller acknowledges every packet, so the link never congests.
+
+tBTM_CB btm_cb;
+
+// The stream is SBC, which uses an RTP header
+bool A2DP_UsesRtpHeader(bool /* content_protection_enabled */,
+                        const uint8_t* /* p_codec_info */) {
+  return true;
+}
+tA2DP_CODEC_TYPE A2DP_GetCodecType(const uint8_t* /* p_codec_info */) {
+  return A2DP_MEDIA_CT_SBC;
+}
+const char* A2DP_CodecName(const uint8_t* /* p_codec_info */) { return "SBC"; }
+std::string A2DP_CodecInfoString(const uint8_t* /* p_codec_info */) {
+  return "SBC";
+}
+
+namespace {
+
+constexpr uint16_t kAclHandle = 0x0001;
+constexpr uint16_t kAclBufferCount = 8;
+constexpr uint16_t kAclDataSize = 1021;
+constexpr uint16_t kPeerMtu = 1005;
+constexpr uint16_t kRemoteCid = 0x0041;
+constexpr uint8_t kPeerId = 1;
+const RawAddress kPeerAddress{{0x11, 0x22, 0x33, 0x44, 0x55, 0x66}};
+
+void AvdtConnCallback(uint8_t /* handle */, const RawAddress& /* bd_addr */,
+                      uint8_t /* event */, tAVDT_CTRL* /* p_data */,
+                      uint8_t /* scb_index */) {}
+
+void StreamCtrlCallback(uint8_t /* handle */, const RawAddress& /* bd_addr */,
+                        uint8_t /* event */, tAVDT_CTRL* /* p_data */,
+                        uint8_t /* scb_index */) {}
+
+// Bytes handed to the controller, as serialized from the GD packet builder
+size_t sent_bytes = 0;
+
+// What the shim ACL data write does with each packet L2CAP sends
+void SendAclData(const RawAddress& /* bd_addr */, BT_HDR* p_buf) {
+  auto packet = bluetooth::MakeUniquePacket(
+      p_buf->data + p_buf->offset + HCI_DATA_PREAMBLE_SIZE,
+      p_buf->len - HCI_DATA_PREAMBLE_SIZE, bluetooth::IsPacketFlushable(p_buf));
+  osi_free(p_buf);
+
+  std::vector<uint8_t> bytes;
+  bytes.reserve(packet->size());
+  bluetooth::packet::BitInserter inserter(bytes);
+  packet->Serialize(inserter);
+  sent_bytes += bytes.size();
+  benchmark::DoNotOptimize(bytes.data());
+}
+
+// Opens a streaming AVDTP source over a connected L2CAP media channel, and
+// returns its handle
+uint8_t OpenMediaStream() {
+  bluetooth::common::InitFlags::SetAllForTesting();
+  test::mock::device_controller::acl_data_size_classic = kAclDataSize;
+  test::mock::stack_acl::acl_send_data_packet_br_edr.body = SendAclData;
+
+  l2c_init();
+  l2c_link_init(kAclBufferCount);
+
+  AvdtpRcb reg{};
+  reg.ctrl_mtu = 672;
+  reg.ret_tout = 4;
+  reg.sig_tout = 4;
+  reg.idle_tout = 10;
+  AVDT_Register(&reg, AvdtConnCallback);
+
+  tL2C_LCB* p_lcb = l2cu_allocate_lcb(kPeerAddress, false, BT_TRANSPORT_BR_EDR);
+  CHECK(p_lcb != nullptr);
+  l2cu_set_lcb_handle(*p_lcb, kAclHandle);
+  p_lcb->link_state = LST_CONNECTED;
+
+  tL2C_CCB* p_ccb = l2cu_allocate_ccb(p_lcb, 0, false);
+  CHECK(p_ccb != nullptr);
+  p_ccb->p_rcb = l2cu_find_rcb_by_psm(AVDT_PSM);
+  CHECK(p_ccb->p_rcb != nullptr);
+  p_ccb->remote_cid = kRemoteCid;
+  p_ccb->peer_cfg.mtu = kPeerMtu;
+  p_ccb->chnl_state = CST_OPEN;
+  l2c_link_adjust_chnl_allocation();
+
+  uint8_t handle = 0;
+  AvdtpStreamConfig config{};
+  config.p_avdt_ctrl_cback = StreamCtrlCallback;
+  config.tsep = AVDT_TSEP_SRC;
+  CHECK(AVDT_CreateStream(kPeerId, &handle, config) == AVDT_SUCCESS);
+
+  AvdtpCcb* p_avdt_ccb = avdt_ccb_alloc_by_channel_index(kPeerAddress, 0);
+  CHECK(p_avdt_ccb != nullptr);
+  AvdtpScb* p_scb = avdt_scb_by_hdl(handle);
+  p_scb->p_ccb = p_avdt_ccb;
+  p_scb->in_use = true;
+  p_scb->state = AVDT_SCB_STREAM_ST;
+  uint8_t tcid = avdt_ad_type_to_tcid(AVDT_CHAN_MEDIA, p_scb);
+  avdtp_cb.ad.rt_tbl[avdt_ccb_to_idx(p_avdt_ccb)][tcid].lcid =
+      p_ccb->local_cid;
+  return handle;
+}
+
+}  // namespace
+
+static void BM_AvdtMediaWrite(State& state) {
+  static const uint8_t handle = OpenMediaStream();
+  const uint16_t payload_len = static_cast<uint16_t>(state.range(0));
+  sent_bytes = 0;
+  uint32_t time_stamp = 0;
+
+  for (auto _ : state) {
+    // Encoded media, as the encoders write it
+    BT_HDR* p_buf = (BT_HDR*)osi_malloc(BT_DEFAULT_BUFFER_SIZE);
+    p_buf->offset = AVDT_MEDIA_OFFSET;
+    p_buf->len = payload_len;
+    p_buf->layer_specific = 0;
+    memset(p_buf->data + p_buf->offset, 0x5a, payload_len);
+
+    AVDT_WriteReqOpt(handle, p_buf, time_stamp, 0x60, AVDT_DATA_OPT_NONE);
+    time_stamp += 128;
+
+    // Number of Completed Packets from the controller
+    l2c_packets_completed(kAclHandle, 1);
+  }
+
+  // Every packet carries the payload, the RTP header and the L2CAP header
+  const size_t packet_len = payload_len + AVDT_MEDIA_HDR_SIZE +
+                            AVDT_MEDIA_LOWER_HDR_SIZE - HCI_DATA_PREAMBLE_SIZE;
+  CHECK(sent_bytes == static_cast<size_t>(state.iterations()) * packet_len);
+  state.SetItemsProcessed(static_cast<int64_t>(state.iterations()));
+  state.SetBytesProcessed(
+      static_cast<int64_t>(state.iterations() * payload_len));
+}
+
+// A short payload, a typical SBC payload, and a payload filling the MTU
+BENCHMARK(BM_AvdtMediaWrite)
+    ->Arg(128)
+    ->Arg(595)
+    ->Arg(kPeerMtu - AVDT_MEDIA_HDR_SIZE);
+
+int main(int argc, char** argv) {
+  // Disable LOG() output from libchrome
+  logging::LoggingSettings log_settings;
+  log_settings.logging_dest = logging::LoggingDestination::LOG_NONE;
+  CHECK(logging::InitLogging(log_settings)) << "Failed to set up logging";
+  ::benchmark::Initialize(&argc, argv);
+  if (::benchmark::ReportUnrecognizedArguments(argc, argv)) {
+    return 1;
+  }
+  ::benchmark::RunSpecifiedBenchmarks();
+}
@@ -0,0 +1,96 @@
+/*
+ * Copyright 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <base/logging.h>
+#include <benchmark/benchmark.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "stack/include/bt_uuid16.h"
+#include "stack/include/sdpdefs.h"
+#include "stack/sdp/internal/sdp_api.h"
+#include "stack/sdp/sdpint.h"
+#include "test/mock/mock_osi_allocator.h"
+
+using ::benchmark::State;
+using bluetooth::Uuid;
+
+// Service searches over a full server database, where the only matching
+// record is the last one. The searched service class is given as a 128-bit
+// UUID while the records hold 16-bit ones, so every comparison has to
+// account for the UUID sizes.
+
+static void create_serial_port_record(uint16_t service_uuid, uint8_t scn) {
+  uint32_t handle = SDP_CreateRecord();
+  CHECK(handle != 0);
+  CHECK(SDP_AddServiceClassIdList(handle, 1, &service_uuid));
+  tSDP_PROTOCOL_ELEM proto_list[2] = {};
+  proto_list[0].protocol_uuid = UUID_PROTOCOL_L2CAP;
+  proto_list[1].protocol_uuid = UUID_PROTOCOL_RFCOMM;
+  proto_list[1].num_params = 1;
+  proto_list[1].params[0] = scn;
+  CHECK(SDP_AddProtocolList(handle, 2, proto_list));
+}
+
+static void BM_ServiceSearchFullDatabase(State& state) {
+  test::mock::osi_allocator::osi_malloc.body = [](size_t size) {
+    return malloc(size);
+  };
+  test::mock::osi_allocator::osi_free.body = [](void* ptr) { free(ptr); };
+
+  SDP_DeleteRecord(0);
+  for (int i = 0; i < SDP_MAX_RECORDS; i++) {
+    create_serial_port_record(UUID_SERVCLASS_HF_HANDSFREE, i + 1);
+  }
+  tSDP_RECORD* p_last = &sdp_cb.server_db.record[SDP_MAX_RECORDS - 1];
+  uint16_t service_uuid = UUID_SERVCLASS_SERIAL_PORT;
+  CHECK(SDP_AddServiceClassIdList(p_last->record_handle, 1, &service_uuid));
+
+  tSDP_UUID_SEQ seq{};
+  seq.num_uids = 2;
+  seq.uuid_entry[0].len = Uuid::kNumBytes128;
+  memcpy(seq.uuid_entry[0].value,
+         Uuid::From16Bit(UUID_SERVCLASS_SERIAL_PORT).To128BitBE().data(),
+         Uuid::kNumBytes128);
+  seq.uuid_entry[1].len = Uuid::kNumBytes16;
+  seq.uuid_entry[1].value[0] = UUID_PROTOCOL_L2CAP >> 8;
+  seq.uuid_entry[1].value[1] = UUID_PROTOCOL_L2CAP & 0xff;
+
+  for (auto _ : state) {
+    const tSDP_RECORD* p_rec = sdp_db_service_search(nullptr, &seq);
+    CHECK(p_rec == p_last);
+    benchmark::DoNotOptimize(p_rec);
+  }
+  state.SetItemsProcessed(static_cast<int64_t>(state.iterations()));
+
+  SDP_DeleteRecord(0);
+  test::mock::osi_allocator::osi_malloc = {};
+  test::mock::osi_allocator::osi_free = {};
+}
+
+BENCHMARK(BM_ServiceSearchFullDatabase);
+
+int main(int argc, char** argv) {
+  // Disable LOG() output from libchrome
+  logging::LoggingSettings log_settings;
+  log_settings.logging_dest = logging::LoggingDestination::LOG_NONE;
+  CHECK(logging::InitLogging(log_settings)) << "Failed to set up logging";
+  ::benchmark::Initialize(&argc, argv);
+  if (::benchmark::ReportUnrecognizedArguments(argc, argv)) {
+    return 1;
+  }
+  ::benchmark::RunSpecifiedBenchmarks();
+}
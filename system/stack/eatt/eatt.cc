@@ -125,6 +125,11 @@ void EattExtension::AddFromStorage(const RawAddress& bd_addr) {
   if (p_eatt_impl) p_eatt_impl->add_from_storage(bd_addr);
 }
 
+void EattExtension::Dump(int fd) {
+  eatt_impl* p_eatt_impl = EattExtension::impl::GetImplInstance();
+  if (p_eatt_impl) p_eatt_impl->dump(fd);
+}
+
 EattExtension::EattExtension() : pimpl_(std::make_unique<impl>()) {}
 
 bool EattExtension::IsEattSupportedByPeer(const RawAddress& bd_addr) {
@@ -181,8 +186,9 @@ EattChannel* EattExtension::GetChannelWithQueuedDataToSend(
 }
 
 EattChannel* EattExtension::GetChannelAvailableForClientRequest(
-    const RawAddress& bd_addr) {
-  return pimpl_->eatt_impl_->get_channel_available_for_client_request(bd_addr);
+    const RawAddress& bd_addr, uint16_t min_payload_size) {
+  return pimpl_->eatt_impl_->get_channel_available_for_client_request(
+      bd_addr, min_payload_size);
 }
 
 /* Start stop GATT indication timer per CID */
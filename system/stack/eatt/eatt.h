@@ -18,6 +18,7 @@
 #pragma once
 
 #include <algorithm>
+#include <array>
 #include <deque>
 
 #include "stack/gatt/gatt_int.h"
@@ -27,6 +28,13 @@
 #define EATT_DEFAULT_MTU (256)
 #define EATT_MAX_TX_MTU  (1024)
 #define EATT_ALL_CIDS (0xFFFF)
+/* Bucket i counts round trips shorter than 2^i ms, the last one the rest */
+#define EATT_RTT_HISTOGRAM_BUCKETS (12)
+
+/* Channels lost while the link stays up are reopened after
+ * EATT_REOPEN_BASE_DELAY_MS, doubling the delay on every further attempt. */
+#define EATT_REOPEN_BASE_DELAY_MS (1000)
+#define EATT_MAX_REOPEN_ATTEMPTS (3)
 
 namespace bluetooth {
 namespace eatt {
@@ -57,6 +65,12 @@ class EattChannel {
   alarm_t* ind_confirmation_timer_;
   /* GATT client command queue */
   std::deque<tGATT_CMD_Q> cl_cmd_q_;
+  /* Time the client request awaiting response was sent, 0 when none */
+  uint64_t req_sent_ms_;
+  /* Client request round trip times */
+  std::array<uint32_t, EATT_RTT_HISTOGRAM_BUCKETS> rtt_histogram_;
+  uint64_t rtt_sum_ms_;
+  uint32_t rsp_count_;
 
   EattChannel(RawAddress& bda, uint16_t cid, uint16_t tx_mtu, uint16_t rx_mtu)
       : bda_(bda),
@@ -65,7 +79,11 @@ class EattChannel {
         state_(EattChannelState::EATT_CHANNEL_PENDING),
         indicate_handle_(0),
         ind_ack_timer_(NULL),
-        ind_confirmation_timer_(NULL) {
+        ind_confirmation_timer_(NULL),
+        req_sent_ms_(0),
+        rtt_histogram_(),
+        rtt_sum_ms_(0),
+        rsp_count_(0) {
     cl_cmd_q_ = std::deque<tGATT_CMD_Q>();
     EattChannelSetTxMTU(tx_mtu);
   }
@@ -100,6 +118,27 @@ class EattChannel {
   void EattChannelSetTxMTU(uint16_t tx_mtu) {
     this->tx_mtu_ = std::min<uint16_t>(tx_mtu, EATT_MAX_TX_MTU);
   }
+
+  /* ATT MTU for EATT is min from tx and rx mtu */
+  uint16_t EattChannelGetPayloadSize() const {
+    return std::min<uint16_t>(tx_mtu_, rx_mtu_);
+  }
+
+  void EattChannelRequestSent(uint64_t now_ms) { req_sent_ms_ = now_ms; }
+
+  void EattChannelResponseReceived(uint64_t now_ms) {
+    if (req_sent_ms_ == 0 || now_ms < req_sent_ms_) return;
+
+    uint64_t rtt_ms = now_ms - req_sent_ms_;
+    req_sent_ms_ = 0;
+
+    size_t bucket = 0;
+    while (bucket < EATT_RTT_HISTOGRAM_BUCKETS - 1 && (rtt_ms >> bucket) != 0)
+      bucket++;
+    rtt_histogram_[bucket]++;
+    rtt_sum_ms_ += rtt_ms;
+    rsp_count_++;
+  }
 };
 
 /* Interface class */
@@ -118,6 +157,13 @@ class EattExtension {
 
   static void AddFromStorage(const RawAddress& bd_addr);
 
+  /**
+   * Dump EATT bearers state and round trip statistics.
+   *
+   * @param fd file descriptor to write to
+   */
+  static void Dump(int fd);
+
   /**
    * Checks if EATT is supported on peer device.
    *
@@ -198,6 +244,9 @@ class EattExtension {
   /**
    * Get EATT channel available for indication.
    *
+   * The channel reserved for indications is returned when it is free,
+   * otherwise any other opened channel with no indication pending.
+   *
    * @param bd_addr peer device address
    *
    * @return pointer to EATT channel.
@@ -234,14 +283,20 @@ class EattExtension {
       const RawAddress& bd_addr);
 
   /**
-   * Get EATT channel available to send GATT request.
+   * Get EATT channel best suited to send GATT request.
+   *
+   * Picks the opened channel with the fewest requests outstanding, preferring
+   * one whose ATT MTU fits the request. The channel reserved for indications
+   * is used only when no other channel is opened.
    *
    * @param bd_addr peer device address
+   * @param min_payload_size ATT MTU needed to send the request unsegmented,
+   *                         0 if unknown
    *
-   * @return pointer to EATT channel.
+   * @return pointer to EATT channel, nullptr when none is opened.
    */
   virtual EattChannel* GetChannelAvailableForClientRequest(
-      const RawAddress& bd_addr);
+      const RawAddress& bd_addr, uint16_t min_payload_size = 0);
 
   /**
    * Start GATT indication timer per CID.
@@ -17,6 +17,8 @@
 
 #include <base/logging.h>
 
+#include <cinttypes>
+#include <cstdio>
 #include <map>
 
 #include "bind_helpers.h"
@@ -49,8 +51,23 @@ class eatt_device {
 
   std::map<uint16_t, std::shared_ptr<EattChannel>> eatt_channels;
   bool collision;
+
+  /* Channel reserved for indications, 0 when not assigned yet */
+  uint16_t indication_cid_;
+  /* Channels disconnected by peer and waiting to be reopened */
+  uint8_t num_of_channels_to_reopen_;
+  uint8_t reopen_attempts_;
+  bool reopen_scheduled_;
+
   eatt_device(const RawAddress& bd_addr, uint16_t mtu, uint16_t mps)
-      : rx_mtu_(mtu), rx_mps_(mps), eatt_tcb_(nullptr), collision(false) {
+      : rx_mtu_(mtu),
+        rx_mps_(mps),
+        eatt_tcb_(nullptr),
+        collision(false),
+        indication_cid_(0),
+        num_of_channels_to_reopen_(0),
+        reopen_attempts_(0),
+        reopen_scheduled_(false) {
     bda_ = bd_addr;
   }
 };
@@ -117,7 +134,12 @@ struct eatt_impl {
 
     eatt_dev->eatt_channels.erase(lcid);
 
-    if (eatt_dev->eatt_channels.size() == 0) eatt_dev->eatt_tcb_ = NULL;
+    if (eatt_dev->indication_cid_ == lcid) eatt_dev->indication_cid_ = 0;
+
+    if (eatt_dev->eatt_channels.size() == 0) {
+      eatt_dev->eatt_tcb_ = NULL;
+      eatt_dev->reopen_attempts_ = 0;
+    }
   }
 
   void remove_channel_by_cid(uint16_t lcid) {
@@ -522,6 +544,80 @@ struct eatt_impl {
 
     eatt_dev->eatt_tcb_->eatt--;
     remove_channel_by_cid(eatt_dev, lcid);
+
+    schedule_channels_reopen(eatt_dev);
+  }
+
+  void schedule_channels_reopen(eatt_device* eatt_dev) {
+    /* Nothing to do when the whole EATT goes down, e.g. on ACL disconnection
+     */
+    if (eatt_dev->eatt_channels.empty()) return;
+
+    if (stack_config_get_interface()->get_pts_l2cap_ecoc_upper_tester()) return;
+
+    /* As on connection, channels are created by the central only */
+    if (L2CA_GetBleConnRole(eatt_dev->bda_) != HCI_ROLE_CENTRAL) return;
+
+    eatt_dev->num_of_channels_to_reopen_++;
+    if (eatt_dev->reopen_scheduled_) return;
+
+    if (eatt_dev->reopen_attempts_ >= EATT_MAX_REOPEN_ATTEMPTS) {
+      LOG_WARN("Device %s, giving up reopening %d channels",
+               ADDRESS_TO_LOGGABLE_CSTR(eatt_dev->bda_),
+               eatt_dev->num_of_channels_to_reopen_);
+      eatt_dev->num_of_channels_to_reopen_ = 0;
+      return;
+    }
+
+    int delay_ms = EATT_REOPEN_BASE_DELAY_MS << eatt_dev->reopen_attempts_;
+    eatt_dev->reopen_attempts_++;
+    eatt_dev->reopen_scheduled_ = true;
+
+    bt_status_t status = do_in_main_thread_delayed(
+        FROM_HERE,
+        base::BindOnce(&eatt_impl::reopen_channels, base::Unretained(this),
+                       eatt_dev->bda_),
+#if BASE_VER < 931007
+        base::TimeDelta::FromMilliseconds(delay_ms)
+#else
+        base::Milliseconds(delay_ms)
+#endif
+    );
+
+    LOG_INFO("Device %s, reopening channels in %d ms, status: %d",
+             ADDRESS_TO_LOGGABLE_CSTR(eatt_dev->bda_), delay_ms, (int)status);
+  }
+
+  void reopen_channels(const RawAddress& bda) {
+    eatt_device* eatt_dev = find_device_by_address(bda);
+    if (!eatt_dev) return;
+
+    eatt_dev->reopen_scheduled_ = false;
+    int num_of_channels = eatt_dev->num_of_channels_to_reopen_;
+    eatt_dev->num_of_channels_to_reopen_ = 0;
+
+    if (num_of_channels == 0 || eatt_dev->eatt_channels.empty() ||
+        !eatt_dev->eatt_tcb_) {
+      LOG_DEBUG("Device %s, nothing to reopen", ADDRESS_TO_LOGGABLE_CSTR(bda));
+      return;
+    }
+
+    num_of_channels = std::min(
+        num_of_channels, L2CAP_CREDIT_BASED_MAX_CIDS -
+                             static_cast<int>(eatt_dev->eatt_channels.size()));
+    if (num_of_channels <= 0) return;
+
+    if (is_channel_connection_pending(eatt_dev)) {
+      /* Retry once the ongoing channel creation is done. Scheduling counts
+       * one more channel itself. */
+      eatt_dev->num_of_channels_to_reopen_ = num_of_channels - 1;
+      schedule_channels_reopen(eatt_dev);
+      return;
+    }
+
+    LOG_INFO("Device %s, reopening %d channels", ADDRESS_TO_LOGGABLE_CSTR(bda),
+             num_of_channels);
+    connect_eatt(eatt_dev, num_of_channels);
   }
 
   void eatt_l2cap_data_ind(uint16_t lcid, BT_HDR* data_p) {
@@ -666,8 +762,35 @@ struct eatt_impl {
     return (iter != eatt_dev->eatt_channels.end());
   };
 
+  /* Indications are kept on a single channel so that client requests,
+   * balanced over the remaining ones, do not compete with them for credits.
+   */
+  EattChannel* get_indication_channel(eatt_device* eatt_dev) {
+    auto it = eatt_dev->eatt_channels.find(eatt_dev->indication_cid_);
+    if (it != eatt_dev->eatt_channels.end()) {
+      return it->second->state_ == EattChannelState::EATT_CHANNEL_OPENED
+                 ? it->second.get()
+                 : nullptr;
+    }
+
+    for (const std::pair<uint16_t, std::shared_ptr<EattChannel>>& el :
+         eatt_dev->eatt_channels) {
+      if (el.second->state_ == EattChannelState::EATT_CHANNEL_OPENED) {
+        eatt_dev->indication_cid_ = el.first;
+        return el.second.get();
+      }
+    }
+    return nullptr;
+  }
+
   EattChannel* get_channel_available_for_indication(const RawAddress& bd_addr) {
     eatt_device* eatt_dev = find_device_by_address(bd_addr);
+    if (!eatt_dev) return nullptr;
+
+    EattChannel* ind_channel = get_indication_channel(eatt_dev);
+    if (ind_channel && !GATT_HANDLE_IS_VALID(ind_channel->indicate_handle_))
+      return ind_channel;
+
     auto iter = find_if(
         eatt_dev->eatt_channels.begin(), eatt_dev->eatt_channels.end(),
         [](const std::pair<uint16_t, std::shared_ptr<EattChannel>>& el) {
@@ -679,20 +802,41 @@ struct eatt_impl {
                                                    : iter->second.get();
   };
 
+  static bool is_better_for_client_request(const EattChannel* channel,
+                                           const EattChannel* best,
+                                           uint16_t min_payload_size) {
+    if (channel->cl_cmd_q_.size() != best->cl_cmd_q_.size())
+      return channel->cl_cmd_q_.size() < best->cl_cmd_q_.size();
+
+    bool fits = channel->EattChannelGetPayloadSize() >= min_payload_size;
+    bool best_fits = best->EattChannelGetPayloadSize() >= min_payload_size;
+    if (fits != best_fits) return fits;
+
+    return channel->EattChannelGetPayloadSize() >
+           best->EattChannelGetPayloadSize();
+  }
+
   EattChannel* get_channel_available_for_client_request(
-      const RawAddress& bd_addr) {
+      const RawAddress& bd_addr, uint16_t min_payload_size) {
     eatt_device* eatt_dev = find_device_by_address(bd_addr);
     if (!eatt_dev) return nullptr;
 
-    auto iter = find_if(
-        eatt_dev->eatt_channels.begin(), eatt_dev->eatt_channels.end(),
-        [](const std::pair<uint16_t, std::shared_ptr<EattChannel>>& el) {
-          return el.second->state_ == EattChannelState::EATT_CHANNEL_OPENED &&
-                 el.second->cl_cmd_q_.empty();
-        });
+    EattChannel* ind_channel = get_indication_channel(eatt_dev);
+    EattChannel* best = nullptr;
 
-    return (iter == eatt_dev->eatt_channels.end()) ? nullptr
-                                                   : iter->second.get();
+    for (const std::pair<uint16_t, std::shared_ptr<EattChannel>>& el :
+         eatt_dev->eatt_channels) {
+      EattChannel* channel = el.second.get();
+      if (channel->state_ != EattChannelState::EATT_CHANNEL_OPENED ||
+          channel == ind_channel)
+        continue;
+
+      if (!best ||
+          is_better_for_client_request(channel, best, min_payload_size))
+        best = channel;
+    }
+
+    return best ? best : ind_channel;
   }
 
   void free_gatt_resources(const RawAddress& bd_addr) {
@@ -947,6 +1091,8 @@ struct eatt_impl {
     eatt_dev->eatt_tcb_->eatt = 0;
     eatt_dev->eatt_tcb_ = nullptr;
     eatt_dev->collision = false;
+    eatt_dev->indication_cid_ = 0;
+    eatt_dev->reopen_attempts_ = 0;
   }
 
   void upper_tester_connect(const RawAddress& bd_addr, eatt_device* eatt_dev,
@@ -1045,6 +1191,42 @@ struct eatt_impl {
 
     if (!eatt_dev) add_eatt_device(bd_addr);
   }
+
+  void dump(int fd) {
+    dprintf(fd, "\nEATT bearers:\n");
+    for (const eatt_device& eatt_dev : devices_) {
+      if (eatt_dev.eatt_channels.empty()) continue;
+
+      dprintf(fd, "  Device %s, indication cid 0x%04x, reopen attempts %d\n",
+              ADDRESS_TO_LOGGABLE_CSTR(eatt_dev.bda_), eatt_dev.indication_cid_,
+              eatt_dev.reopen_attempts_);
+
+      for (const std::pair<uint16_t, std::shared_ptr<EattChannel>>& el :
+           eatt_dev.eatt_channels) {
+        const EattChannel* channel = el.second.get();
+        dprintf(fd,
+                "    cid 0x%04x state %d mtu %d/%d queued %zu responses %u "
+                "avg rtt %" PRIu64 " ms\n",
+                channel->cid_, static_cast<int>(channel->state_),
+                channel->tx_mtu_, channel->rx_mtu_, channel->cl_cmd_q_.size(),
+                channel->rsp_count_,
+                channel->rsp_count_ != 0
+                    ? channel->rtt_sum_ms_ / channel->rsp_count_
+                    : 0);
+
+        if (channel->rsp_count_ == 0) continue;
+
+        dprintf(fd, "      rtt ms:");
+        for (size_t i = 0; i < EATT_RTT_HISTOGRAM_BUCKETS; i++) {
+          if (i == EATT_RTT_HISTOGRAM_BUCKETS - 1)
+            dprintf(fd, " >=%d:%u", 1 << (i - 1), channel->rtt_histogram_[i]);
+          else
+            dprintf(fd, " <%d:%u", 1 << i, channel->rtt_histogram_[i]);
+        }
+        dprintf(fd, "\n");
+      }
+    }
+  }
 };
 
 }  // namespace eatt
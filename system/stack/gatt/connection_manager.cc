@@ -23,16 +23,22 @@
 #include <base/location.h>
 #include <base/logging.h>
 
+#include <algorithm>
+#include <cinttypes>
 #include <map>
 #include <memory>
 #include <set>
+#include <vector>
 
+#include "common/time_util.h"
 #include "internal_include/bt_trace.h"
 #include "main/shim/le_scanning_manager.h"
 #include "os/log.h"
 #include "osi/include/alarm.h"
 #include "stack/btm/btm_ble_bgconn.h"
+#include "stack/btm/btm_sec.h"
 #include "stack/include/advertise_data_parser.h"
+#include "stack/include/bt_device_type.h"
 #include "stack/include/bt_types.h"
 #include "stack/include/btm_ble_api.h"
 #include "stack/include/btm_log_history.h"
@@ -41,6 +47,10 @@
 
 #define DIRECT_CONNECT_TIMEOUT (30 * 1000) /* 30 seconds */
 
+/* Shortest time a background connection target spends in the accept list
+ * before it can be rotated out, to give the scanner a few scan windows. */
+#define BG_CONN_ROTATION_MIN_PERIOD (2 * 1000) /* 2 seconds */
+
 constexpr char kBtmLogTag[] = "TA";
 
 struct closure_data {
@@ -69,6 +79,16 @@ using unique_alarm_ptr = std::unique_ptr<alarm_t, decltype(&alarm_free)>;
 
 namespace connection_manager {
 
+/* Background connection priority of a device. When there are more background
+ * connection targets than the controller accept list can hold, they take turns
+ * in it, and higher priority devices are scanned for first. Connection latency
+ * is reported per priority. */
+typedef enum : uint8_t {
+  BG_CONN_PRIORITY_LOW = 0,
+  BG_CONN_PRIORITY_NORMAL = 1,
+  BG_CONN_PRIORITY_HIGH = 2,
+} tBG_CONN_PRIORITY;
+
 struct tAPPS_CONNECTING {
   // ids of clients doing background connection to given device
   std::set<tAPP_ID> doing_bg_conn;
@@ -77,12 +97,60 @@ struct tAPPS_CONNECTING {
 
   // Apps trying to do direct connection.
   std::map<tAPP_ID, unique_alarm_ptr> doing_direct_conn;
+
+  // Order in which the device last entered or left the accept list
+  uint64_t accept_list_seq = 0;
+  // Rotation round in which the device last entered the accept list
+  uint64_t accept_list_round = 0;
+  // Start of the pending background connection attempt, zero if none
+  uint64_t bg_conn_start_ms = 0;
+  // Last time a connection to the device completed, zero if never
+  uint64_t last_seen_ms = 0;
+  // Background connection priority, from the kind of device
+  tBG_CONN_PRIORITY priority = BG_CONN_PRIORITY_NORMAL;
+};
+
+struct tBG_CONN_LATENCY_STATS {
+  uint64_t connections = 0;
+  uint64_t total_ms = 0;
+  uint64_t max_ms = 0;
 };
 
 namespace {
 // Maps address to apps trying to connect to it
 std::map<RawAddress, tAPPS_CONNECTING> bgconn_dev;
 
+constexpr size_t kBgConnPriorities = BG_CONN_PRIORITY_HIGH + 1;
+
+/* Background connection latency targets, by priority. When the background
+ * connection targets take turns in the accept list, the rotation period is
+ * picked so that all of them are scanned for within the latency target of the
+ * highest priority waiting device. The rotation period does not go below
+ * BG_CONN_ROTATION_MIN_PERIOD though, so a target cannot be met with more
+ * than target / BG_CONN_ROTATION_MIN_PERIOD rounds of devices, e.g. 15 rounds
+ * for the normal priority; this is logged and shown in dumpsys. */
+constexpr uint64_t kBgConnLatencyTargetMs[kBgConnPriorities] = {
+    120 * 1000, /* BG_CONN_PRIORITY_LOW */
+    30 * 1000,  /* BG_CONN_PRIORITY_NORMAL */
+    10 * 1000,  /* BG_CONN_PRIORITY_HIGH */
+};
+
+constexpr const char* kBgConnPriorityNames[kBgConnPriorities] = {
+    "low",
+    "normal",
+    "high",
+};
+
+tBG_CONN_LATENCY_STATS bg_conn_latency[kBgConnPriorities];
+// Whether the last rotation period could not fit the latency target
+bool bg_conn_latency_target_missed = false;
+
+alarm_t* bg_conn_rotation_timer = nullptr;
+bool bg_conn_rotation_pending = false;
+uint64_t bg_conn_rotation_round = 0;
+uint64_t bg_conn_rotated_out = 0;
+uint64_t bg_conn_seq = 0;
+
 int num_of_targeted_announcements_users(void) {
   return std::count_if(
       bgconn_dev.begin(), bgconn_dev.end(), [](const auto& pair) {
@@ -107,6 +175,219 @@ bool is_anyone_connecting(
           !it->second.doing_targeted_announcements_conn.empty());
 }
 
+void bg_conn_set_in_accept_list(tAPPS_CONNECTING& dev, bool in_accept_list) {
+  dev.is_in_accept_list = in_accept_list;
+  dev.accept_list_seq = ++bg_conn_seq;
+  dev.accept_list_round = bg_conn_rotation_round;
+}
+
+/* Device doing only background connection, that did not fit in the accept
+ * list */
+bool bg_conn_is_waiting(const tAPPS_CONNECTING& dev) {
+  return !dev.is_in_accept_list && !dev.doing_bg_conn.empty() &&
+         dev.doing_direct_conn.empty() &&
+         dev.doing_targeted_announcements_conn.empty();
+}
+
+/* Device doing only background connection, in the accept list */
+bool bg_conn_is_rotatable(const tAPPS_CONNECTING& dev) {
+  return dev.is_in_accept_list && !dev.doing_bg_conn.empty() &&
+         dev.doing_direct_conn.empty() &&
+         dev.doing_targeted_announcements_conn.empty();
+}
+
+bool bg_conn_is_connected(const RawAddress& address) {
+  return BTM_GetHCIConnHandle(address, BT_TRANSPORT_LE) != 0xFFFF;
+}
+
+/* Priority of a device, from what the stack knows of it: bonded LE only
+ * devices, which can only come back over LE, come first, then the other
+ * bonded devices, then the devices that are not bonded. */
+tBG_CONN_PRIORITY bg_conn_device_priority(const RawAddress& address) {
+  if (!BTM_IsLinkKeyKnown(address, BT_TRANSPORT_LE)) {
+    return BG_CONN_PRIORITY_LOW;
+  }
+  tBT_DEVICE_TYPE dev_type = BT_DEVICE_TYPE_UNKNOWN;
+  tBLE_ADDR_TYPE addr_type = BLE_ADDR_PUBLIC;
+  BTM_ReadDevInfo(address, &dev_type, &addr_type);
+  return (dev_type == BT_DEVICE_TYPE_BLE) ? BG_CONN_PRIORITY_HIGH
+                                          : BG_CONN_PRIORITY_NORMAL;
+}
+
+/* Waiting devices, the first to enter the accept list first: by priority,
+ * then the most recently seen, then the longest waiting. Connected devices
+ * are skipped, there is no need to scan for them. */
+std::vector<RawAddress> bg_conn_waiting_devices() {
+  std::vector<RawAddress> waiting;
+  for (const auto& entry : bgconn_dev) {
+    if (bg_conn_is_waiting(entry.second) &&
+        !bg_conn_is_connected(entry.first)) {
+      waiting.push_back(entry.first);
+    }
+  }
+  std::sort(waiting.begin(), waiting.end(),
+            [](const RawAddress& a, const RawAddress& b) {
+              tBG_CONN_PRIORITY priority_a = bgconn_dev[a].priority;
+              tBG_CONN_PRIORITY priority_b = bgconn_dev[b].priority;
+              if (priority_a != priority_b) return priority_a > priority_b;
+              uint64_t seen_a = bgconn_dev[a].last_seen_ms;
+              uint64_t seen_b = bgconn_dev[b].last_seen_ms;
+              if (seen_a != seen_b) return seen_a > seen_b;
+              return bgconn_dev[a].accept_list_seq <
+                     bgconn_dev[b].accept_list_seq;
+            });
+  return waiting;
+}
+
+/* Rotatable devices, the first to leave the accept list first: connected
+ * devices, which do not need their entry, then by priority, then the least
+ * recently seen, then the longest in the accept list. With |dwelled_only|,
+ * only the connected ones and the ones that spent a full rotation period in
+ * it. */
+std::vector<RawAddress> bg_conn_rotatable_devices(bool dwelled_only) {
+  std::vector<std::pair<bool, RawAddress>> candidates;
+  for (const auto& entry : bgconn_dev) {
+    if (!bg_conn_is_rotatable(entry.second)) continue;
+    bool connected = bg_conn_is_connected(entry.first);
+    if (!dwelled_only || connected ||
+        entry.second.accept_list_round < bg_conn_rotation_round) {
+      candidates.emplace_back(connected, entry.first);
+    }
+  }
+  std::sort(candidates.begin(), candidates.end(),
+            [](const auto& pair_a, const auto& pair_b) {
+              if (pair_a.first != pair_b.first) return pair_a.first;
+              const RawAddress& a = pair_a.second;
+              const RawAddress& b = pair_b.second;
+              tBG_CONN_PRIORITY priority_a = bgconn_dev[a].priority;
+              tBG_CONN_PRIORITY priority_b = bgconn_dev[b].priority;
+              if (priority_a != priority_b) return priority_a < priority_b;
+              uint64_t seen_a = bgconn_dev[a].last_seen_ms;
+              uint64_t seen_b = bgconn_dev[b].last_seen_ms;
+              if (seen_a != seen_b) return seen_a < seen_b;
+              return bgconn_dev[a].accept_list_seq <
+                     bgconn_dev[b].accept_list_seq;
+            });
+
+  std::vector<RawAddress> rotatable;
+  for (const auto& candidate : candidates) {
+    rotatable.push_back(candidate.second);
+  }
+  return rotatable;
+}
+
+/* The accept list holds |in_list| rotatable devices at a time, so it takes
+ * ceil((in_list + waiting) / in_list) rounds for all of them to be scanned
+ * for. Fit those rounds in the latency target of the most demanding waiting
+ * device. */
+uint64_t bg_conn_rotation_period_ms(size_t waiting, size_t in_list,
+                                    tBG_CONN_PRIORITY top_priority) {
+  uint64_t rounds = (waiting + in_list + in_list - 1) / in_list;
+  uint64_t target_ms = kBgConnLatencyTargetMs[top_priority];
+  bool missed = target_ms / rounds < BG_CONN_ROTATION_MIN_PERIOD;
+  if (missed && !bg_conn_latency_target_missed) {
+    LOG_WARN(
+        "%" PRIu64 " rounds of background connections do not fit in the %s "
+        "priority latency target of %" PRIu64 " ms, it takes %" PRIu64 " ms",
+        rounds, kBgConnPriorityNames[top_priority], target_ms,
+        rounds * BG_CONN_ROTATION_MIN_PERIOD);
+  }
+  bg_conn_latency_target_missed = missed;
+  return std::max<uint64_t>(BG_CONN_ROTATION_MIN_PERIOD, target_ms / rounds);
+}
+
+void bg_conn_rotate(void* data);
+
+void bg_conn_schedule_rotation() {
+  if (bg_conn_rotation_pending) return;
+
+  std::vector<RawAddress> waiting = bg_conn_waiting_devices();
+  if (waiting.empty()) return;
+
+  // Without rotatable devices, the accept list is full of direct connections,
+  // and waiting devices get in when those are removed.
+  size_t in_list = std::count_if(
+      bgconn_dev.begin(), bgconn_dev.end(),
+      [](const auto& pair) { return bg_conn_is_rotatable(pair.second); });
+  if (in_list == 0) return;
+
+  uint64_t period_ms = bg_conn_rotation_period_ms(
+      waiting.size(), in_list, bgconn_dev[waiting.front()].priority);
+
+  if (bg_conn_rotation_timer == nullptr) {
+    bg_conn_rotation_timer = alarm_new("bg_conn_rotation");
+  }
+  bg_conn_rotation_pending = true;
+  alarm_set_on_mloop(bg_conn_rotation_timer, period_ms, bg_conn_rotate,
+                     nullptr);
+}
+
+/* Moves waiting devices into free accept list entries, best first */
+void bg_conn_fill_accept_list() {
+  for (const RawAddress& address : bg_conn_waiting_devices()) {
+    if (!BTM_AcceptlistAdd(address)) return;
+    bg_conn_set_in_accept_list(bgconn_dev[address], true);
+  }
+}
+
+/* Swaps the connected devices, and the devices that dwelled in the accept
+ * list, for waiting devices of the same or higher priority */
+void bg_conn_rotate(void* /* data */) {
+  bg_conn_rotation_pending = false;
+  bg_conn_rotation_round++;
+
+  std::vector<RawAddress> waiting = bg_conn_waiting_devices();
+  std::vector<RawAddress> rotatable = bg_conn_rotatable_devices(true);
+  size_t swapped = 0;
+  while (swapped < waiting.size() && swapped < rotatable.size()) {
+    const RawAddress& in = waiting[swapped];
+    const RawAddress& out = rotatable[swapped];
+    if (bgconn_dev[in].priority < bgconn_dev[out].priority &&
+        !bg_conn_is_connected(out)) {
+      break;
+    }
+
+    BTM_AcceptlistRemove(out);
+    bg_conn_set_in_accept_list(bgconn_dev[out], false);
+    if (!BTM_AcceptlistAdd(in)) {
+      LOG_WARN("Unable to rotate %s into the accept list",
+               ADDRESS_TO_LOGGABLE_CSTR(in));
+      break;
+    }
+    bg_conn_set_in_accept_list(bgconn_dev[in], true);
+    swapped++;
+  }
+  bg_conn_rotated_out += swapped;
+  LOG_DEBUG("round %" PRIu64 ": rotated %zu of %zu waiting devices",
+            bg_conn_rotation_round, swapped, waiting.size());
+
+  bg_conn_schedule_rotation();
+}
+
+/* Makes room in the full accept list for a direct connection, by moving out
+ * the background connection that would be rotated out last */
+bool bg_conn_evict_one() {
+  std::vector<RawAddress> rotatable = bg_conn_rotatable_devices(false);
+  if (rotatable.empty()) return false;
+
+  const RawAddress victim = rotatable.front();
+
+  LOG_INFO("Moving %s out of the accept list for a direct connection",
+           ADDRESS_TO_LOGGABLE_CSTR(victim));
+  BTM_AcceptlistRemove(victim);
+  bg_conn_set_in_accept_list(bgconn_dev[victim], false);
+  bg_conn_schedule_rotation();
+  return true;
+}
+
+/* Removes a device from the accept list, and gives its entry to the best
+ * waiting device */
+void bg_conn_accept_list_remove(const RawAddress& address) {
+  BTM_AcceptlistRemove(address);
+  bg_conn_fill_accept_list();
+  bg_conn_schedule_rotation();
+}
+
 }  // namespace
 
 /** background connection device from the list. Returns pointer to the device
@@ -264,7 +545,8 @@ bool background_connect_targeted_announcement_add(tAPP_ID app_id,
 }
 
 /** Add a device from the background connection list.  Returns true if device
- * added to the list, or already in list, false otherwise */
+ * added to the list, or already in list, false otherwise. When the accept list
+ * is full, the device waits for its turn in it. */
 bool background_connect_add(uint8_t app_id, const RawAddress& address) {
   LOG_DEBUG("app_id=%d, address=%s", static_cast<int>(app_id),
             ADDRESS_TO_LOGGABLE_CSTR(address));
@@ -296,17 +578,23 @@ bool background_connect_add(uint8_t app_id, const RawAddress& address) {
       LOG_DEBUG("Targeted announcement enabled, do not add to AcceptList");
     } else {
       if (!BTM_AcceptlistAdd(address)) {
-        LOG_WARN("Failed to add device %s to accept list for app %d",
+        LOG_INFO("Accept list full, device %s for app %d waits for its turn",
                  ADDRESS_TO_LOGGABLE_CSTR(address), static_cast<int>(app_id));
-        return false;
+      } else {
+        bg_conn_set_in_accept_list(bgconn_dev[address], true);
       }
-      bgconn_dev[address].is_in_accept_list = true;
     }
   }
 
   // create entry for address, and insert app_id.
   // new tAPPS_CONNECTING will be default constructed if not exist
-  bgconn_dev[address].doing_bg_conn.insert(app_id);
+  tAPPS_CONNECTING& dev = bgconn_dev[address];
+  dev.doing_bg_conn.insert(app_id);
+  dev.priority = bg_conn_device_priority(address);
+  if (dev.bg_conn_start_ms == 0) {
+    dev.bg_conn_start_ms = bluetooth::common::time_get_os_boottime_ms();
+  }
+  if (bg_conn_is_waiting(dev)) bg_conn_schedule_rotation();
   return true;
 }
 
@@ -320,8 +608,8 @@ bool remove_unconditional(const RawAddress& address) {
     return false;
   }
 
-  BTM_AcceptlistRemove(address);
   bgconn_dev.erase(it);
+  bg_conn_accept_list_remove(address);
   return true;
 }
 
@@ -366,9 +654,10 @@ bool background_connect_remove(uint8_t app_id, const RawAddress& address) {
         LOG_DEBUG(" Keep using target announcement filtering");
       } else if (!it->second.doing_bg_conn.empty()) {
         if (!BTM_AcceptlistAdd(address)) {
-          LOG_WARN("Could not re add device to accept list");
+          LOG_INFO("Accept list full, device waits for its turn");
+          bg_conn_schedule_rotation();
         } else {
-          bgconn_dev[address].is_in_accept_list = true;
+          bg_conn_set_in_accept_list(bgconn_dev[address], true);
         }
       }
     }
@@ -379,7 +668,7 @@ bool background_connect_remove(uint8_t app_id, const RawAddress& address) {
 
   // no more apps interested - remove from accept list and delete record
   if (accept_list_enabled) {
-    BTM_AcceptlistRemove(address);
+    bg_conn_accept_list_remove(address);
     return true;
   }
 
@@ -400,6 +689,7 @@ void on_app_deregistered(uint8_t app_id) {
   LOG_DEBUG("app_id=%d", static_cast<int>(app_id));
   auto it = bgconn_dev.begin();
   auto end = bgconn_dev.end();
+  bool removed = false;
   /* update the BG conn device list */
   while (it != end) {
     it->second.doing_bg_conn.erase(app_id);
@@ -413,6 +703,12 @@ void on_app_deregistered(uint8_t app_id) {
 
     BTM_AcceptlistRemove(it->first);
     it = bgconn_dev.erase(it);
+    removed = true;
+  }
+
+  if (removed) {
+    bg_conn_fill_accept_list();
+    bg_conn_schedule_rotation();
   }
 }
 
@@ -432,6 +728,20 @@ void on_connection_complete(const RawAddress& address) {
            ADDRESS_TO_LOGGABLE_CSTR(address));
 
   remove_all_clients_with_pending_connections(address);
+
+  auto it = bgconn_dev.find(address);
+  if (it == bgconn_dev.end()) return;
+
+  uint64_t now_ms = bluetooth::common::time_get_os_boottime_ms();
+  it->second.last_seen_ms = now_ms;
+  if (it->second.bg_conn_start_ms != 0) {
+    uint64_t latency_ms = now_ms - it->second.bg_conn_start_ms;
+    tBG_CONN_LATENCY_STATS& stats = bg_conn_latency[it->second.priority];
+    stats.connections++;
+    stats.total_ms += latency_ms;
+    stats.max_ms = std::max(stats.max_ms, latency_ms);
+    it->second.bg_conn_start_ms = 0;
+  }
 }
 
 void on_connection_timed_out_from_shim(const RawAddress& address) {
@@ -443,6 +753,15 @@ void on_connection_timed_out_from_shim(const RawAddress& address) {
  * to true, as there is no need to wipe controller acceptlist in this case. */
 void reset(bool after_reset) {
   bgconn_dev.clear();
+  for (auto& stats : bg_conn_latency) stats = {};
+  bg_conn_latency_target_missed = false;
+  if (bg_conn_rotation_timer != nullptr) {
+    alarm_free(bg_conn_rotation_timer);
+    bg_conn_rotation_timer = nullptr;
+  }
+  bg_conn_rotation_pending = false;
+  bg_conn_rotation_round = 0;
+  bg_conn_rotated_out = 0;
   if (!after_reset) {
     target_announcements_filtering_set(false);
     BTM_AcceptlistClear();
@@ -483,12 +802,14 @@ bool direct_connect_add(uint8_t app_id, const RawAddress& address) {
   }
 
   if (!in_acceptlist) {
-    if (!BTM_AcceptlistAdd(address, true)) {
+    // direct connections take precedence over background connections
+    if (!BTM_AcceptlistAdd(address, true) &&
+        !(bg_conn_evict_one() && BTM_AcceptlistAdd(address, true))) {
       // if we can't add to acceptlist, turn parameters back to slow.
       LOG_WARN("Unable to add le device to acceptlist");
       return false;
     }
-    bgconn_dev[address].is_in_accept_list = true;
+    bg_conn_set_in_accept_list(bgconn_dev[address], true);
   }
 
   // Setup a timer
@@ -544,25 +865,49 @@ bool direct_connect_remove(uint8_t app_id, const RawAddress& address,
             "Failed to re-add device %s to accept list after connection "
             "timeout",
             ADDRESS_TO_LOGGABLE_CSTR(address));
+        bg_conn_set_in_accept_list(it->second, false);
+        bg_conn_schedule_rotation();
       }
     }
     return true;
   }
 
   // no more apps interested - remove from acceptlist
-  BTM_AcceptlistRemove(address);
-
   if (!is_targeted_announcement_enabled) {
     bgconn_dev.erase(it);
   } else {
-    it->second.is_in_accept_list = false;
+    bg_conn_set_in_accept_list(it->second, false);
   }
+  bg_conn_accept_list_remove(address);
 
   return true;
 }
 
+static void dump_bg_conn_scheduling(int fd) {
+  size_t waiting = std::count_if(
+      bgconn_dev.begin(), bgconn_dev.end(),
+      [](const auto& pair) { return bg_conn_is_waiting(pair.second); });
+  dprintf(fd,
+          "\tbackground connections waiting for the accept list: %zu, "
+          "rotation rounds: %" PRIu64 ", rotated out: %" PRIu64 "\n",
+          waiting, bg_conn_rotation_round, bg_conn_rotated_out);
+  if (bg_conn_latency_target_missed) {
+    dprintf(fd, "\tbackground connection latency target missed\n");
+  }
+
+  dprintf(fd, "\tbackground connection latency (ms) count/ave/max:\n");
+  for (size_t i = 0; i < kBgConnPriorities; i++) {
+    const tBG_CONN_LATENCY_STATS& stats = bg_conn_latency[i];
+    dprintf(fd, "\t\t%s priority: %" PRIu64 " / %" PRIu64 " / %" PRIu64 "\n",
+            kBgConnPriorityNames[i], stats.connections,
+            stats.connections != 0 ? stats.total_ms / stats.connections : 0,
+            stats.max_ms);
+  }
+}
+
 void dump(int fd) {
   dprintf(fd, "\nconnection_manager state:\n");
+  dump_bg_conn_scheduling(fd);
   if (bgconn_dev.empty()) {
     dprintf(fd, "\tno Low Energy connection attempts\n");
     return;
@@ -594,6 +939,10 @@ void dump(int fd) {
     }
     dprintf(fd, "\n\t\t is in the allow list: %s",
             entry.second.is_in_accept_list ? "true" : "false");
+    if (!entry.second.doing_bg_conn.empty()) {
+      dprintf(fd, "\n\t\t background connection priority: %s",
+              kBgConnPriorityNames[entry.second.priority]);
+    }
   }
   dprintf(fd, "\n");
 }
@@ -458,6 +458,9 @@ tGATT_STATUS GATTS_HandleValueIndication(uint16_t conn_id, uint16_t attr_handle,
 
   if (!GATT_HANDLE_IS_VALID(attr_handle)) return GATT_ILLEGAL_PARAMETER;
 
+  /* Keep the order of the notifications sent before */
+  gatt_sr_flush_notif_batch(*p_tcb);
+
   tGATT_VALUE indication;
   indication.conn_id = conn_id;
   indication.handle = attr_handle;
@@ -535,7 +538,9 @@ static tGATT_STATUS GATTS_HandleMultileValueNotification(
  *                  val_len: Length of the indicated attribute value.
  *                  p_val: Pointer to the indicated attribute value data.
  *
- * Returns          GATT_SUCCESS if sucessfully sent; otherwise error code.
+ * Returns          GATT_SUCCESS if sucessfully sent or batched; otherwise
+ *                  error code. A batched notification that fails to be sent
+ *                  when the batching window ends is only logged.
  *
  ******************************************************************************/
 tGATT_STATUS GATTS_HandleValueNotification(uint16_t conn_id,
@@ -600,6 +605,11 @@ tGATT_STATUS GATTS_HandleValueNotification(uint16_t conn_id,
   }
 #endif
 
+  if (gatt_notif_batch_get_window_ms() != 0) {
+    return gatt_sr_batch_notification(*p_tcb, p_reg->eatt_support, attr_handle,
+                                      val_len, p_val);
+  }
+
   memset(&notif, 0, sizeof(notif));
   notif.handle = attr_handle;
   notif.len = val_len;
@@ -1073,6 +1083,12 @@ tGATT_STATUS GATTC_Write(uint16_t conn_id, tGATT_WRITE_TYPE type,
   p_clcb->op_subtype = type;
   p_clcb->auth_req = p_write->auth_req;
 
+  /* Prefer a bearer on which the value goes out in a single request */
+  if (type == GATT_WRITE) {
+    p_clcb->cid = gatt_tcb_get_att_cid(*p_tcb, p_reg->eatt_support,
+                                       p_write->len + GATT_HDR_SIZE);
+  }
+
   p_clcb->p_attr_buf = (uint8_t*)osi_malloc(sizeof(tGATT_VALUE));
   memcpy(p_clcb->p_attr_buf, (void*)p_write, sizeof(tGATT_VALUE));
 
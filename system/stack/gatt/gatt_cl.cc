@@ -27,6 +27,7 @@
 #include <base/logging.h>
 #include <string.h>
 
+#include "common/time_util.h"
 #include "gatt_int.h"
 #include "hardware/bt_gatt_types.h"
 #include "internal_include/bt_target.h"
@@ -1257,6 +1258,14 @@ void gatt_client_handle_server_rsp(tGATT_TCB& tcb, uint16_t cid,
   gatt_stop_rsp_timer(p_clcb);
   p_clcb->retry_count = 0;
 
+  if (tcb.eatt && cid != tcb.att_lcid) {
+    EattChannel* channel =
+        EattExtension::GetInstance()->FindEattChannelByCid(tcb.peer_bda, cid);
+    if (channel)
+      channel->EattChannelResponseReceived(
+          bluetooth::common::time_get_os_boottime_ms());
+  }
+
   /* the size of the message may not be bigger than the local max PDU size*/
   /* The message has to be smaller than the agreed MTU, len does not count
    * op_code */
@@ -32,6 +32,8 @@
 #include "internal_include/bt_target.h"
 #include "macros.h"
 #include "osi/include/fixed_queue.h"
+#include "stack/gatt/gatt_notif_batch.h"
+#include "stack/gatt/gatt_sr_pipeline.h"
 #include "stack/include/bt_hdr.h"
 #include "types/bluetooth/uuid.h"
 #include "types/raw_address.h"
@@ -228,6 +230,11 @@ typedef struct {
   uint8_t status;
   uint8_t cback_cnt[GATT_MAX_APPS];
   uint16_t cid;
+  uint64_t start_ms; /* when the request was queued, for the latency stats */
+  /* Read Multiple: next handle to read, and application reads in flight */
+  uint8_t multi_next_idx;
+  uint8_t multi_in_flight;
+  bool multi_sending;
 } tGATT_SR_CMD;
 
 typedef enum : uint8_t {
@@ -319,6 +326,11 @@ typedef struct {
   std::deque<tGATT_CMD_Q> cl_cmd_q;
   alarm_t* ind_ack_timer; /* local app confirm to indication timer */
 
+  /* notifications waiting for the batching window, on the ATT bearer used
+   * by apps without (0) or with (1) EATT support */
+  GattNotificationBatch notif_batch[2];
+  alarm_t* notif_batch_timer;
+
   // TODO(hylo): support byte array data
   /* Client supported feature*/
   uint8_t cl_supp_feat;
@@ -575,6 +587,10 @@ void gatt_sr_send_req_callback(uint16_t conn_id, uint32_t trans_id,
                                uint8_t op_code, tGATTS_DATA* p_req_data);
 uint32_t gatt_sr_enqueue_cmd(tGATT_TCB& tcb, uint16_t cid, uint8_t op_code,
                              uint16_t handle);
+tGATT_STATUS gatt_sr_batch_notification(tGATT_TCB& tcb, bool eatt_support,
+                                        uint16_t handle, uint16_t len,
+                                        uint8_t* p_val);
+void gatt_sr_flush_notif_batch(tGATT_TCB& tcb);
 bool gatt_cancel_open(tGATT_IF gatt_if, const RawAddress& bda);
 void gatt_notify_phy_updated(tHCI_STATUS status, uint16_t handle,
                              uint8_t tx_phy, uint8_t rx_phy);
@@ -595,7 +611,8 @@ bool gatt_tcb_get_cid_available_for_indication(tGATT_TCB* p_tcb,
                                                uint16_t* cid_p);
 bool gatt_tcb_find_indicate_handle(tGATT_TCB& tcb, uint16_t cid,
                                    uint16_t* indicated_handle_p);
-uint16_t gatt_tcb_get_att_cid(tGATT_TCB& tcb, bool eatt_support);
+uint16_t gatt_tcb_get_att_cid(tGATT_TCB& tcb, bool eatt_support,
+                              uint16_t min_payload_size = 0);
 uint16_t gatt_tcb_get_payload_size(tGATT_TCB& tcb, uint16_t cid);
 void gatt_clcb_invalidate(tGATT_TCB* p_tcb, const tGATT_CLCB* p_clcb);
 uint16_t gatt_get_mtu(const RawAddress& bda, tBT_TRANSPORT transport);
@@ -603,8 +620,8 @@ bool gatt_is_pending_mtu_exchange(tGATT_TCB* p_tcb);
 void gatt_set_conn_id_waiting_for_mtu_exchange(tGATT_TCB* p_tcb,
                                                uint16_t conn_id);
 
-void gatt_sr_copy_prep_cnt_to_cback_cnt(tGATT_TCB& p_tcb);
-bool gatt_sr_is_cback_cnt_zero(tGATT_TCB& p_tcb);
+void gatt_sr_copy_prep_cnt_to_cback_cnt(tGATT_TCB& p_tcb, uint16_t cid);
+bool gatt_sr_is_cback_cnt_zero(tGATT_TCB& p_tcb, uint16_t cid);
 bool gatt_sr_is_prep_cnt_zero(tGATT_TCB& p_tcb);
 void gatt_sr_reset_cback_cnt(tGATT_TCB& p_tcb, uint16_t cid);
 void gatt_sr_reset_prep_cnt(tGATT_TCB& tcb);
@@ -132,6 +132,8 @@ void gatt_init(void) {
 
   gatt_cb.over_br_enabled =
       osi_property_get_bool("bluetooth.gatt.over_bredr.enabled", true);
+  gatt_notif_batch_init();
+  gatt_sr_pipeline_init();
   /* Now, register with L2CAP for ATT PSM over BR/EDR */
   if (gatt_cb.over_br_enabled &&
       !L2CA_Register2(BT_PSM_ATT, dyn_info, false /* enable_snoop */, nullptr,
@@ -182,6 +184,9 @@ void gatt_free(void) {
     alarm_free(gatt_cb.tcb[i].ind_ack_timer);
     gatt_cb.tcb[i].ind_ack_timer = NULL;
 
+    alarm_free(gatt_cb.tcb[i].notif_batch_timer);
+    gatt_cb.tcb[i].notif_batch_timer = NULL;
+
     fixed_queue_free(gatt_cb.tcb[i].sr_cmd.multi_rsp_q, NULL);
     gatt_cb.tcb[i].sr_cmd.multi_rsp_q = NULL;
 
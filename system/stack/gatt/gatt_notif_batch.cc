@@ -0,0 +1,124 @@
+/******************************************************************************
+ *
+ *  Copyright 2023 The Android Open Source Project
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at:
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ******************************************************************************/
+
+#include "stack/gatt/gatt_notif_batch.h"
+
+#include <stdio.h>
+
+#include <cinttypes>
+#include <utility>
+
+#include "osi/include/log.h"
+#include "osi/include/properties.h"
+
+namespace {
+
+/* Size of the handle and length of a Multiple Handle Value Notification
+ * tuple */
+constexpr size_t kTupleHeaderSize = 4;
+
+uint64_t window_ms = 0;
+
+/* Notifications added, superseded before being sent, and sent, in how many
+ * PDUs, since the stack started */
+uint64_t added_count = 0;
+uint64_t superseded_count = 0;
+uint64_t sent_count = 0;
+uint64_t pdu_count = 0;
+
+}  // namespace
+
+void GattNotificationBatch::Add(uint16_t handle, const uint8_t* p_val,
+                                uint16_t len) {
+  added_count++;
+  for (auto it = pending_.begin(); it != pending_.end(); it++) {
+    if (it->handle == handle) {
+      tuples_size_ -= kTupleHeaderSize + it->value.size();
+      pending_.erase(it);
+      superseded_count++;
+      break;
+    }
+  }
+
+  pending_.push_back({handle, std::vector<uint8_t>(p_val, p_val + len)});
+  tuples_size_ += kTupleHeaderSize + len;
+}
+
+void GattNotificationBatch::Clear() {
+  pending_.clear();
+  tuples_size_ = 0;
+}
+
+std::vector<std::vector<tGATT_PENDING_NOTIF>> GattNotificationBatch::TakePdus(
+    uint16_t payload_size, bool multi_notif_supported) {
+  std::vector<std::vector<tGATT_PENDING_NOTIF>> pdus;
+  std::vector<tGATT_PENDING_NOTIF> group;
+  size_t group_size = 0;
+  /* All but the opcode */
+  size_t max_tuples_size = payload_size > 1 ? payload_size - 1 : 0;
+
+  for (tGATT_PENDING_NOTIF& notif : pending_) {
+    sent_count++;
+    size_t tuple_size = kTupleHeaderSize + notif.value.size();
+    if (!multi_notif_supported || tuple_size > max_tuples_size) {
+      if (!group.empty()) pdus.push_back(std::move(group));
+      group.clear();
+      group_size = 0;
+      pdus.push_back({std::move(notif)});
+      continue;
+    }
+
+    if (group_size + tuple_size > max_tuples_size) {
+      pdus.push_back(std::move(group));
+      group.clear();
+      group_size = 0;
+    }
+    group.push_back(std::move(notif));
+    group_size += tuple_size;
+  }
+  if (!group.empty()) pdus.push_back(std::move(group));
+
+  pdu_count += pdus.size();
+  Clear();
+  return pdus;
+}
+
+void gatt_notif_batch_init(void) {
+  int32_t window = osi_property_get_int32(
+      "bluetooth.gatt.notification_batching_window_ms", 0);
+  if (window < 0) {
+    LOG_WARN("Invalid notification batching window %d ms, batching disabled",
+             window);
+    window = 0;
+  }
+  window_ms = window;
+}
+
+uint64_t gatt_notif_batch_get_window_ms(void) { return window_ms; }
+
+void gatt_notif_batch_dump(int fd) {
+  dprintf(fd, "\nGATT server notification batching:\n");
+  dprintf(fd, "  Window: %" PRIu64 " ms%s\n", window_ms,
+          window_ms == 0 ? " (disabled)" : "");
+  dprintf(fd,
+          "  Notifications added: %" PRIu64 ", superseded: %" PRIu64
+          ", sent: %" PRIu64 "\n",
+          added_count, superseded_count, sent_count);
+  dprintf(fd, "  PDUs sent: %" PRIu64 ", notifications per PDU: %.2f\n",
+          pdu_count, pdu_count != 0 ? (double)sent_count / pdu_count : 0.0);
+}
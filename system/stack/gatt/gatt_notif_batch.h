@@ -0,0 +1,65 @@
+/******************************************************************************
+ *
+ *  Copyright 2023 The Android Open Source Project
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at:
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ******************************************************************************/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <vector>
+
+/* A server notification waiting to be sent */
+typedef struct {
+  uint16_t handle;
+  std::vector<uint8_t> value;
+} tGATT_PENDING_NOTIF;
+
+/* The notifications a server sends on a connection during the batching
+ * window, to be sent together in Multiple Handle Value Notifications.
+ *
+ * Only the latest value of a handle is kept: a notification supersedes the
+ * pending one of the same handle, and takes its place at the end of the
+ * batch.
+ */
+class GattNotificationBatch {
+ public:
+  void Add(uint16_t handle, const uint8_t* p_val, uint16_t len);
+  void Clear();
+  bool IsEmpty() const { return pending_.empty(); }
+
+  /* Size of the Multiple Handle Value Notification of all pending values */
+  size_t GetMultiNotifSize() const { return 1 + tuples_size_; }
+
+  /* Takes the pending notifications, grouped by the PDU they are sent in.
+   * Groups of more than one notification fit in a Multiple Handle Value
+   * Notification of |payload_size| bytes. Without |multi_notif_supported|,
+   * every group has a single notification. */
+  std::vector<std::vector<tGATT_PENDING_NOTIF>> TakePdus(
+      uint16_t payload_size, bool multi_notif_supported);
+
+ private:
+  std::list<tGATT_PENDING_NOTIF> pending_;
+  /* Size of the handle length value tuples of the pending notifications */
+  size_t tuples_size_ = 0;
+};
+
+/* Reads the batching window; notifications are not batched when it is 0 */
+void gatt_notif_batch_init(void);
+uint64_t gatt_notif_batch_get_window_ms(void);
+
+void gatt_notif_batch_dump(int fd);
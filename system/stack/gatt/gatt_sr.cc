@@ -26,10 +26,12 @@
 
 #include <algorithm>
 
+#include "common/time_util.h"
 #include "gatt_int.h"
 #include "hardware/bt_gatt_types.h"
 #include "internal_include/bt_target.h"
 #include "l2c_api.h"
+#include "osi/include/alarm.h"
 #include "osi/include/allocator.h"
 #include "osi/include/log.h"
 #include "osi/include/osi.h"
@@ -91,6 +93,7 @@ uint32_t gatt_sr_enqueue_cmd(tGATT_TCB& tcb, uint16_t cid, uint8_t op_code,
       p_cmd->op_code = op_code;
       p_cmd->handle = handle;
       p_cmd->status = GATT_NOT_FOUND;
+      p_cmd->start_ms = bluetooth::common::time_get_os_boottime_ms();
       tcb.trans_id %= GATT_TRANS_ID_MAX;
       trans_id = p_cmd->trans_id;
     }
@@ -155,6 +158,11 @@ void gatt_dequeue_sr_cmd(tGATT_TCB& tcb, uint16_t cid) {
                << p_cmd->p_rsp_msg;
   osi_free_and_reset((void**)&p_cmd->p_rsp_msg);
 
+  if (p_cmd->op_code != 0 && p_cmd->start_ms != 0) {
+    gatt_sr_pipeline_record_latency(
+        bluetooth::common::time_get_os_boottime_ms() - p_cmd->start_ms);
+  }
+
   while (!fixed_queue_is_empty(p_cmd->multi_rsp_q))
     osi_free(fixed_queue_try_dequeue(p_cmd->multi_rsp_q));
   fixed_queue_free(p_cmd->multi_rsp_q, NULL);
@@ -180,21 +188,32 @@ static void build_read_multi_rsp(tGATT_SR_CMD* p_cmd, uint16_t mtu) {
 
   p_buf->len = 1;
 
-  /* Now walk through the buffers putting the data into the response in order
-   */
+  /* Now walk through the buffers putting the data into the response in the
+   * order of the request. The applications may answer in any order, so the
+   * response of each handle is looked up, the n-th one for a handle requested
+   * n times. */
   list_t* list = NULL;
-  const list_node_t* node = NULL;
   if (!fixed_queue_is_empty(p_cmd->multi_rsp_q))
     list = fixed_queue_get_list(p_cmd->multi_rsp_q);
   for (ii = 0; ii < p_cmd->multi_req.num_handles; ii++) {
     tGATTS_RSP* p_rsp = NULL;
+    uint16_t handle = p_cmd->multi_req.handles[ii];
 
     if (list != NULL) {
-      if (ii == 0)
-        node = list_begin(list);
-      else
-        node = list_next(node);
-      if (node != list_end(list)) p_rsp = (tGATTS_RSP*)list_node(node);
+      uint16_t skip = 0;
+      for (uint16_t jj = 0; jj < ii; jj++) {
+        if (p_cmd->multi_req.handles[jj] == handle) skip++;
+      }
+      for (const list_node_t* node = list_begin(list); node != list_end(list);
+           node = list_next(node)) {
+        tGATTS_RSP* p_node_rsp = (tGATTS_RSP*)list_node(node);
+        if (p_node_rsp->attr_value.handle != handle) continue;
+        if (skip == 0) {
+          p_rsp = p_node_rsp;
+          break;
+        }
+        skip--;
+      }
     }
 
     if (p_rsp != NULL) {
@@ -227,13 +246,8 @@ static void build_read_multi_rsp(tGATT_SR_CMD* p_cmd, uint16_t mtu) {
         p_buf->len += 2;
       }
 
-      if (p_rsp->attr_value.handle == p_cmd->multi_req.handles[ii]) {
-        ARRAY_TO_STREAM(p, p_rsp->attr_value.value, (uint16_t) len);
-        p_buf->len += (uint16_t) len;
-      } else {
-        p_cmd->status = GATT_NOT_FOUND;
-        break;
-      }
+      ARRAY_TO_STREAM(p, p_rsp->attr_value.value, (uint16_t) len);
+      p_buf->len += (uint16_t) len;
 
       if (is_overflow) break;
 
@@ -298,6 +312,62 @@ static bool process_read_multi_rsp(tGATT_SR_CMD* p_cmd, tGATT_STATUS status,
   return (false);
 }
 
+/*******************************************************************************
+ *
+ * Function         gatt_sr_read_multi_send_next
+ *
+ * Description      This function reads the next handles of a read multiple
+ *                  request, with at most gatt_sr_get_max_app_reads()
+ *                  application reads in flight on the bearer. Values held by
+ *                  the database complete right away.
+ *
+ * Returns          void
+ *
+ ******************************************************************************/
+static void gatt_sr_read_multi_send_next(tGATT_TCB& tcb, tGATT_SR_CMD* p_cmd) {
+  /* Called back from a value completed below, the loop goes on from there */
+  if (p_cmd->multi_sending) return;
+  p_cmd->multi_sending = true;
+
+  const uint32_t trans_id = p_cmd->trans_id;
+  const uint8_t op_code = p_cmd->op_code;
+  tGATT_SEC_FLAG sec_flag;
+  uint8_t key_size;
+  gatt_sr_get_sec_info(tcb.peer_bda, tcb.transport, &sec_flag, &key_size);
+
+  /* The command is dequeued once the response or an error is sent */
+  while (p_cmd->trans_id == trans_id && p_cmd->op_code == op_code &&
+         p_cmd->multi_next_idx < p_cmd->multi_req.num_handles &&
+         p_cmd->multi_in_flight < gatt_sr_get_max_app_reads()) {
+    uint16_t handle = p_cmd->multi_req.handles[p_cmd->multi_next_idx++];
+    auto it = gatt_sr_find_i_rcb_by_handle(handle);
+    if (it == gatt_cb.srv_list_info->end()) {
+      /* The service was removed while the previous handles were read */
+      gatt_send_error_rsp(tcb, p_cmd->cid, GATT_INVALID_HANDLE, op_code,
+                          handle, true);
+      return;
+    }
+    p_cmd->multi_in_flight++;
+
+    tGATTS_RSP* p_msg = (tGATTS_RSP*)osi_calloc(sizeof(tGATTS_RSP));
+    p_msg->attr_value.handle = handle;
+    tGATT_STATUS err = gatts_read_attr_value_by_handle(
+        tcb, p_cmd->cid, it->p_db, op_code, handle, 0, p_msg->attr_value.value,
+        &p_msg->attr_value.len, GATT_MAX_ATTR_LEN, sec_flag, key_size,
+        trans_id);
+
+    if (err != GATT_PENDING) {
+      if (err != GATT_SUCCESS) p_cmd->handle = handle;
+      gatt_sr_process_app_rsp(tcb, it->gatt_if, trans_id, op_code, err, p_msg,
+                              p_cmd);
+    }
+    /* either not using or done using the buffer, release it now */
+    osi_free(p_msg);
+  }
+
+  if (p_cmd->trans_id == trans_id) p_cmd->multi_sending = false;
+}
+
 /*******************************************************************************
  *
  * Function         gatt_sr_process_app_rsp
@@ -322,9 +392,14 @@ tGATT_STATUS gatt_sr_process_app_rsp(tGATT_TCB& tcb, tGATT_IF gatt_if,
 
   if ((op_code == GATT_REQ_READ_MULTI) ||
       (op_code == GATT_REQ_READ_MULTI_VAR)) {
-    /* If no error and still waiting, just return */
-    if (!process_read_multi_rsp(sr_res_p, status, p_msg, payload_size))
+    if (sr_res_p->multi_in_flight) sr_res_p->multi_in_flight--;
+    /* If no error and still waiting, read the next handles and return */
+    if (!process_read_multi_rsp(sr_res_p, status, p_msg, payload_size)) {
+      gatt_sr_read_multi_send_next(tcb, sr_res_p);
       return (GATT_SUCCESS);
+    }
+    /* Nothing more to read after an error */
+    sr_res_p->multi_next_idx = sr_res_p->multi_req.num_handles;
   } else {
     if (op_code == GATT_REQ_PREPARE_WRITE && status == GATT_SUCCESS)
       gatt_sr_update_prep_cnt(tcb, gatt_if, true, false);
@@ -334,7 +409,8 @@ tGATT_STATUS gatt_sr_process_app_rsp(tGATT_TCB& tcb, tGATT_IF gatt_if,
 
     sr_res_p->status = status;
 
-    if (gatt_sr_is_cback_cnt_zero(tcb) && status == GATT_SUCCESS) {
+    if (gatt_sr_is_cback_cnt_zero(tcb, sr_res_p->cid) &&
+        status == GATT_SUCCESS) {
       if (sr_res_p->p_rsp_msg == NULL) {
         sr_res_p->p_rsp_msg = attp_build_sr_msg(
             tcb, (uint8_t)(op_code + 1), (tGATT_SR_MSG*)p_msg, payload_size);
@@ -343,7 +419,7 @@ tGATT_STATUS gatt_sr_process_app_rsp(tGATT_TCB& tcb, tGATT_IF gatt_if,
       }
     }
   }
-  if (gatt_sr_is_cback_cnt_zero(tcb)) {
+  if (gatt_sr_is_cback_cnt_zero(tcb, sr_res_p->cid)) {
     if ((sr_res_p->status == GATT_SUCCESS) && (sr_res_p->p_rsp_msg)) {
       ret_code = attp_send_sr_msg(tcb, sr_res_p->cid, sr_res_p->p_rsp_msg);
       sr_res_p->p_rsp_msg = NULL;
@@ -405,7 +481,7 @@ void gatt_process_exec_write_req(tGATT_TCB& tcb, uint16_t cid, uint8_t op_code,
   /* no prep write is queued */
   if (!gatt_sr_is_prep_cnt_zero(tcb)) {
     trans_id = gatt_sr_enqueue_cmd(tcb, cid, op_code, 0);
-    gatt_sr_copy_prep_cnt_to_cback_cnt(tcb);
+    gatt_sr_copy_prep_cnt_to_cback_cnt(tcb, cid);
 
     for (i = 0; i < GATT_MAX_APPS; i++) {
       if (tcb.prep_cnt[i]) {
@@ -511,24 +587,10 @@ void gatt_process_read_multi_req(tGATT_TCB& tcb, uint16_t cid, uint8_t op_code,
       gatt_sr_reset_cback_cnt(tcb,
                               cid); /* read multiple use multi_rsp_q's count*/
 
-      for (ll = 0; ll < multi_req->num_handles; ll++) {
-        tGATTS_RSP* p_msg = (tGATTS_RSP*)osi_calloc(sizeof(tGATTS_RSP));
-        handle = multi_req->handles[ll];
-        auto it = gatt_sr_find_i_rcb_by_handle(handle);
-
-        p_msg->attr_value.handle = handle;
-        err = gatts_read_attr_value_by_handle(
-            tcb, cid, it->p_db, op_code, handle, 0, p_msg->attr_value.value,
-            &p_msg->attr_value.len, GATT_MAX_ATTR_LEN, sec_flag, key_size,
-            trans_id);
-
-        if (err == GATT_SUCCESS) {
-          gatt_sr_process_app_rsp(tcb, it->gatt_if, trans_id, op_code,
-                                  GATT_SUCCESS, p_msg, sr_cmd_p);
-        }
-        /* either not using or done using the buffer, release it now */
-        osi_free(p_msg);
-      }
+      /* Read the first handles, the following ones are read as the
+       * applications respond. Errors are sent from the response path. */
+      gatt_sr_read_multi_send_next(tcb, sr_cmd_p);
+      err = GATT_PENDING;
     } else
       err = GATT_NO_RESOURCES;
   }
@@ -1453,3 +1515,126 @@ void gatt_server_handle_client_req(tGATT_TCB& tcb, uint16_t cid,
     }
   }
 }
+
+/*******************************************************************************
+ *
+ * Function         gatt_sr_send_notif_batch
+ *
+ * Description      Sends the notifications batched for the ATT bearer of apps
+ *                  with or without EATT support, packed in Multiple Handle
+ *                  Value Notifications when the client supports them.
+ *
+ * Returns          GATT_SUCCESS if all were sent; otherwise the last error.
+ *
+ ******************************************************************************/
+static tGATT_STATUS gatt_sr_send_notif_batch(tGATT_TCB& tcb,
+                                             bool eatt_support) {
+  GattNotificationBatch& batch = tcb.notif_batch[eatt_support];
+  if (batch.IsEmpty()) return GATT_SUCCESS;
+
+  uint16_t cid = gatt_tcb_get_att_cid(tcb, eatt_support);
+  uint16_t payload_size = gatt_tcb_get_payload_size(tcb, cid);
+  if (payload_size == 0) {
+    LOG_WARN("No ATT bearer, dropping batched notifications");
+    batch.Clear();
+    return GATT_WRONG_STATE;
+  }
+
+  bool multi_notif_supported =
+      gatt_sr_is_cl_multi_variable_len_notif_supported(tcb);
+  tGATT_STATUS status = GATT_SUCCESS;
+  for (auto& pdu : batch.TakePdus(payload_size, multi_notif_supported)) {
+    BT_HDR* p_buf;
+    if (pdu.size() == 1) {
+      tGATT_SR_MSG msg;
+      memset(&msg.attr_value, 0, sizeof(msg.attr_value));
+      msg.attr_value.handle = pdu[0].handle;
+      msg.attr_value.len = pdu[0].value.size();
+      std::copy(pdu[0].value.begin(), pdu[0].value.end(),
+                msg.attr_value.value);
+      msg.attr_value.auth_req = GATT_AUTH_REQ_NONE;
+      p_buf = attp_build_sr_msg(tcb, GATT_HANDLE_VALUE_NOTIF, &msg,
+                                payload_size);
+    } else {
+      p_buf = (BT_HDR*)osi_malloc(sizeof(BT_HDR) + payload_size +
+                                  L2CAP_MIN_OFFSET);
+      uint8_t* p = (uint8_t*)(p_buf + 1) + L2CAP_MIN_OFFSET;
+      UINT8_TO_STREAM(p, GATT_HANDLE_MULTI_VALUE_NOTIF);
+      p_buf->offset = L2CAP_MIN_OFFSET;
+      p_buf->len = 1;
+      for (const tGATT_PENDING_NOTIF& notif : pdu) {
+        UINT16_TO_STREAM(p, notif.handle);
+        UINT16_TO_STREAM(p, notif.value.size());
+        ARRAY_TO_STREAM(p, notif.value.data(), (int)notif.value.size());
+        p_buf->len += 4 + notif.value.size();
+      }
+    }
+
+    if (p_buf == NULL) {
+      status = GATT_NO_RESOURCES;
+      continue;
+    }
+    tGATT_STATUS sent = attp_send_sr_msg(tcb, cid, p_buf);
+    if (sent != GATT_SUCCESS && sent != GATT_CONGESTED) status = sent;
+  }
+  return status;
+}
+
+/*******************************************************************************
+ *
+ * Function         gatt_sr_flush_notif_batch
+ *
+ * Description      Sends all the notifications batched on the connection.
+ *
+ * Returns          void
+ *
+ ******************************************************************************/
+void gatt_sr_flush_notif_batch(tGATT_TCB& tcb) {
+  if (tcb.notif_batch[0].IsEmpty() && tcb.notif_batch[1].IsEmpty()) return;
+
+  alarm_cancel(tcb.notif_batch_timer);
+  for (bool eatt_support : {false, true}) {
+    tGATT_STATUS status = gatt_sr_send_notif_batch(tcb, eatt_support);
+    if (status != GATT_SUCCESS) {
+      LOG_WARN("%s, failed to send batched notifications, eatt:%d status:%s",
+               ADDRESS_TO_LOGGABLE_CSTR(tcb.peer_bda), eatt_support,
+               gatt_status_text(status).c_str());
+    }
+  }
+}
+
+static void gatt_sr_notif_batch_timeout(void* data) {
+  tGATT_TCB* p_tcb = (tGATT_TCB*)data;
+  if (!p_tcb->in_use) return;
+  gatt_sr_flush_notif_batch(*p_tcb);
+}
+
+/*******************************************************************************
+ *
+ * Function         gatt_sr_batch_notification
+ *
+ * Description      Adds a notification to the batch of its ATT bearer. The
+ *                  batch is sent when the batching window ends, or as soon as
+ *                  it fills a PDU.
+ *
+ * Returns          GATT_SUCCESS if batched or sent; otherwise error code.
+ *
+ ******************************************************************************/
+tGATT_STATUS gatt_sr_batch_notification(tGATT_TCB& tcb, bool eatt_support,
+                                        uint16_t handle, uint16_t len,
+                                        uint8_t* p_val) {
+  GattNotificationBatch& batch = tcb.notif_batch[eatt_support];
+  batch.Add(handle, p_val, len);
+
+  uint16_t cid = gatt_tcb_get_att_cid(tcb, eatt_support);
+  if (batch.GetMultiNotifSize() >= gatt_tcb_get_payload_size(tcb, cid)) {
+    return gatt_sr_send_notif_batch(tcb, eatt_support);
+  }
+
+  if (!alarm_is_scheduled(tcb.notif_batch_timer)) {
+    alarm_set_on_mloop(tcb.notif_batch_timer,
+                       gatt_notif_batch_get_window_ms(),
+                       gatt_sr_notif_batch_timeout, &tcb);
+  }
+  return GATT_SUCCESS;
+}
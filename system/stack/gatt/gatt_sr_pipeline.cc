@@ -0,0 +1,85 @@
+/******************************************************************************
+ *
+ *  Copyright 2023 The Android Open Source Project
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at:
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ******************************************************************************/
+
+#include "stack/gatt/gatt_sr_pipeline.h"
+
+#include <stdio.h>
+
+#include <algorithm>
+#include <cinttypes>
+
+#include "osi/include/properties.h"
+
+namespace {
+
+constexpr size_t kLatencySamples = 512;
+constexpr int32_t kDefaultMaxAppReads = 4;
+
+uint8_t max_app_reads = kDefaultMaxAppReads;
+
+GattRequestLatency latency(kLatencySamples);
+
+/* Application requests completed since the stack started */
+uint64_t completed_count = 0;
+
+}  // namespace
+
+void GattRequestLatency::Add(uint64_t latency_ms) {
+  if (samples_.empty()) return;
+
+  samples_[next_] = latency_ms;
+  next_ = (next_ + 1) % samples_.size();
+  if (size_ < samples_.size()) size_++;
+}
+
+uint64_t GattRequestLatency::GetPercentile(unsigned percent) const {
+  if (size_ == 0) return 0;
+
+  std::vector<uint64_t> sorted(samples_.begin(), samples_.begin() + size_);
+  std::sort(sorted.begin(), sorted.end());
+
+  /* Nearest rank */
+  size_t rank = (std::min(percent, 100u) * size_ + 99) / 100;
+  return sorted[rank == 0 ? 0 : rank - 1];
+}
+
+void gatt_sr_pipeline_init(void) {
+  int32_t max_reads = osi_property_get_int32(
+      "bluetooth.gatt.server.max_app_reads", kDefaultMaxAppReads);
+  max_app_reads = (uint8_t)std::clamp(max_reads, 1, (int32_t)UINT8_MAX);
+}
+
+uint8_t gatt_sr_get_max_app_reads(void) { return max_app_reads; }
+
+void gatt_sr_pipeline_record_latency(uint64_t latency_ms) {
+  completed_count++;
+  latency.Add(latency_ms);
+}
+
+void gatt_sr_pipeline_dump(int fd) {
+  dprintf(fd, "\nGATT server request pipelining:\n");
+  dprintf(fd, "  Application reads in flight per Read Multiple: %u\n",
+          max_app_reads);
+  dprintf(fd, "  Application requests completed: %" PRIu64 "\n",
+          completed_count);
+  dprintf(fd,
+          "  Latency of the last %zu: p50 %" PRIu64 " ms, p90 %" PRIu64
+          " ms, p99 %" PRIu64 " ms\n",
+          latency.Size(), latency.GetPercentile(50), latency.GetPercentile(90),
+          latency.GetPercentile(99));
+}
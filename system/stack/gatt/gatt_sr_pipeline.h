@@ -0,0 +1,53 @@
+/******************************************************************************
+ *
+ *  Copyright 2023 The Android Open Source Project
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at:
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ******************************************************************************/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/* The time the latest server requests waited for the applications, kept in a
+ * ring of |capacity| samples so the percentiles follow the recent load. */
+class GattRequestLatency {
+ public:
+  explicit GattRequestLatency(size_t capacity) : samples_(capacity) {}
+
+  void Add(uint64_t latency_ms);
+  size_t Size() const { return size_; }
+
+  /* Latency not exceeded by |percent| % of the recorded requests, 0 when
+   * nothing was recorded */
+  uint64_t GetPercentile(unsigned percent) const;
+
+ private:
+  std::vector<uint64_t> samples_;
+  size_t next_ = 0;
+  size_t size_ = 0;
+};
+
+/* Reads the server request pipelining configuration */
+void gatt_sr_pipeline_init(void);
+
+/* Number of application reads a Read Multiple request has in flight on a
+ * bearer */
+uint8_t gatt_sr_get_max_app_reads(void);
+
+void gatt_sr_pipeline_record_latency(uint64_t latency_ms);
+
+void gatt_sr_pipeline_dump(int fd);
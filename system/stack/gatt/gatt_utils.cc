@@ -29,6 +29,7 @@
 #include <cstdint>
 #include <deque>
 
+#include "common/time_util.h"
 #include "hardware/bt_gatt_types.h"
 #include "internal_include/bt_target.h"
 #include "os/log.h"
@@ -462,6 +463,7 @@ tGATT_TCB* gatt_allocate_tcb_by_bdaddr(const RawAddress& bda,
     p_tcb->pending_ind_q = fixed_queue_new(SIZE_MAX);
     p_tcb->conf_timer = alarm_new("gatt.conf_timer");
     p_tcb->ind_ack_timer = alarm_new("gatt.ind_ack_timer");
+    p_tcb->notif_batch_timer = alarm_new("gatt.notif_batch_timer");
     p_tcb->in_use = true;
     p_tcb->tcb_idx = i;
     p_tcb->transport = transport;
@@ -591,6 +593,16 @@ void gatt_start_rsp_timer(tGATT_CLCB* p_clcb) {
   }
   alarm_set_on_mloop(p_clcb->gatt_rsp_timer_ent, timeout_ms, gatt_rsp_timeout,
                      p_clcb);
+
+  /* Request is on air, start measuring its round trip on the EATT bearer */
+  tGATT_TCB* p_tcb = p_clcb->p_tcb;
+  if (p_tcb && p_tcb->eatt && p_clcb->cid != p_tcb->att_lcid) {
+    EattChannel* channel = EattExtension::GetInstance()->FindEattChannelByCid(
+        p_tcb->peer_bda, p_clcb->cid);
+    if (channel)
+      channel->EattChannelRequestSent(
+          bluetooth::common::time_get_os_boottime_ms());
+  }
 }
 
 /*******************************************************************************
@@ -1124,18 +1136,29 @@ bool gatt_tcb_find_indicate_handle(tGATT_TCB& tcb, uint16_t cid,
  *
  * Function         gatt_tcb_get_att_cid
  *
- * Description      This function gets cid for the GATT operation
+ * Description      This function gets cid for the GATT operation. Requests
+ *                  go to the bearer with the fewest requests outstanding,
+ *                  preferring one with ATT MTU of at least min_payload_size.
  *
  * Returns          Available CID
  *
  ******************************************************************************/
 
-uint16_t gatt_tcb_get_att_cid(tGATT_TCB& tcb, bool eatt_support) {
+uint16_t gatt_tcb_get_att_cid(tGATT_TCB& tcb, bool eatt_support,
+                              uint16_t min_payload_size) {
   if (eatt_support && tcb.eatt) {
     EattChannel* channel =
-        EattExtension::GetInstance()->GetChannelAvailableForClientRequest(tcb.peer_bda);
+        EattExtension::GetInstance()->GetChannelAvailableForClientRequest(
+            tcb.peer_bda, min_payload_size);
     if (channel) {
-      return channel->cid_;
+      size_t eatt_load = channel->cl_cmd_q_.size();
+      size_t att_load = tcb.cl_cmd_q.size();
+      if (eatt_load < att_load) return channel->cid_;
+
+      if (eatt_load == att_load &&
+          (channel->EattChannelGetPayloadSize() >= min_payload_size ||
+           tcb.payload_size < min_payload_size))
+        return channel->cid_;
     }
   }
   return tcb.att_lcid;
@@ -1295,10 +1318,23 @@ uint8_t gatt_num_clcb_by_bd_addr(const RawAddress& bda) {
   return num;
 }
 
-void gatt_sr_copy_prep_cnt_to_cback_cnt(tGATT_TCB& tcb) {
+void gatt_sr_copy_prep_cnt_to_cback_cnt(tGATT_TCB& tcb, uint16_t cid) {
+  tGATT_SR_CMD* sr_cmd_p = &tcb.sr_cmd;
+
+  if (cid != tcb.att_lcid) {
+    EattChannel* channel =
+        EattExtension::GetInstance()->FindEattChannelByCid(tcb.peer_bda, cid);
+    if (channel == nullptr) {
+      LOG_WARN("%s, cid 0x%02x already disconnected",
+               ADDRESS_TO_LOGGABLE_CSTR(tcb.peer_bda), cid);
+      return;
+    }
+    sr_cmd_p = &channel->server_outstanding_cmd_;
+  }
+
   for (uint8_t i = 0; i < GATT_MAX_APPS; i++) {
     if (tcb.prep_cnt[i]) {
-      tcb.sr_cmd.cback_cnt[i] = 1;
+      sr_cmd_p->cback_cnt[i] = 1;
     }
   }
 }
@@ -1319,14 +1355,25 @@ tGATT_SR_CMD* gatt_sr_get_cmd_by_trans_id(tGATT_TCB* p_tcb, uint32_t trans_id) {
  *
  * Function         gatt_sr_is_cback_cnt_zero
  *
- * Description      The function searches all LCB with macthing bd address
+ * Description      The function checks the application callback count of
+ *                  the request outstanding on a bearer
  *
- * Returns          True if thetotal application callback count is zero
+ * Returns          True if the total application callback count is zero
  *
  ******************************************************************************/
-bool gatt_sr_is_cback_cnt_zero(tGATT_TCB& tcb) {
+bool gatt_sr_is_cback_cnt_zero(tGATT_TCB& tcb, uint16_t cid) {
+  /* Only the bearer the request arrived on waits for the applications */
+  tGATT_SR_CMD* sr_cmd_p = &tcb.sr_cmd;
+
+  if (cid != tcb.att_lcid) {
+    EattChannel* channel =
+        EattExtension::GetInstance()->FindEattChannelByCid(tcb.peer_bda, cid);
+    if (channel == nullptr) return true;
+    sr_cmd_p = &channel->server_outstanding_cmd_;
+  }
+
   for (uint8_t i = 0; i < GATT_MAX_APPS; i++) {
-    if (tcb.sr_cmd.cback_cnt[i]) {
+    if (sr_cmd_p->cback_cnt[i]) {
       return false;
     }
   }
@@ -1767,6 +1814,8 @@ void gatt_cleanup_upon_disc(const RawAddress& bda, tGATT_DISCONN_REASON reason,
   p_tcb->ind_ack_timer = NULL;
   alarm_free(p_tcb->conf_timer);
   p_tcb->conf_timer = NULL;
+  alarm_free(p_tcb->notif_batch_timer);
+  p_tcb->notif_batch_timer = NULL;
   gatt_free_pending_ind(p_tcb);
   fixed_queue_free(p_tcb->sr_cmd.multi_rsp_q, NULL);
   p_tcb->sr_cmd.multi_rsp_q = NULL;
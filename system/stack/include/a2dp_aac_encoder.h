@@ -80,4 +80,8 @@ int a2dp_aac_get_effective_frame_size();
 // |timestamp_us| is the current timestamp (in microseconds).
 void a2dp_aac_send_frames(uint64_t timestamp_us);
 
+// Set transmit queue length for the A2DP AAC (Adaptive Bit Rate) mechanism.
+// The bit rate is only adapted in CBR mode.
+void a2dp_aac_set_transmit_queue_length(size_t transmit_queue_length);
+
 #endif  // A2DP_AAC_ENCODER_H
@@ -0,0 +1,54 @@
+/*
+ * Copyright 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//
+// Adaptive bit rate for A2DP encoders without a codec specific mechanism.
+//
+// The A2DP Source media task reports the length of its transmit queue once
+// per encoder tick. A growing queue means the link cannot carry the current
+// bit rate: the bit rate is lowered quickly. Once the queue has stayed drained
+// for a while, the bit rate is raised again in small steps, up to the
+// configured bit rate.
+//
+
+#ifndef A2DP_BITRATE_ADAPTER_H
+#define A2DP_BITRATE_ADAPTER_H
+
+#include <cstddef>
+#include <cstdint>
+
+// A plain struct, so that it can live in the memset() encoder control blocks.
+typedef struct {
+  uint32_t max_bitrate;  // The configured bit rate; 0 if adaptation is off
+  uint32_t min_bitrate;
+  uint32_t bitrate;  // The current bit rate
+  size_t drained_ticks;
+  size_t ticks_since_decrease;
+  size_t decreases;
+  size_t increases;
+} tA2DP_BITRATE_ADAPTER;
+
+// Initialize |p_adapter| to adapt between |min_bitrate| and |max_bitrate|,
+// starting at |max_bitrate|. A |max_bitrate| of 0 disables the adaptation.
+void a2dp_bitrate_adapter_init(tA2DP_BITRATE_ADAPTER* p_adapter,
+                               uint32_t max_bitrate, uint32_t min_bitrate);
+
+// Update |p_adapter| with the |transmit_queue_length| of this encoder tick.
+// Returns true if the bit rate changed.
+bool a2dp_bitrate_adapter_update(tA2DP_BITRATE_ADAPTER* p_adapter,
+                                 size_t transmit_queue_length);
+
+#endif  // A2DP_BITRATE_ADAPTER_H
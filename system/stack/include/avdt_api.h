@@ -93,6 +93,14 @@ inline std::string avdt_result_text(const tAVDT_RESULT& result) {
 */
 #define AVDT_MEDIA_OFFSET 23
 
+/* The number of bytes L2CAP (basic mode) and HCI prepend to a media packet.
+ * Media buffers are sent without being copied: AVDTP, L2CAP and HCI write
+ * their headers into the headroom reserved by the buffer offset, so the
+ * offset of a media packet must be at least this plus AVDT_MEDIA_HDR_SIZE
+ * when an RTP header is added.
+ */
+#define AVDT_MEDIA_LOWER_HDR_SIZE 8
+
 /* The marker bit is used by the application to mark significant events such
  * as frame boundaries in the data stream.  This constant is used to check or
  * set the marker bit in the m_pt parameter of an AVDT_WriteReq()
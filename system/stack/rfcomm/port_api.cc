@@ -28,6 +28,7 @@
 
 #include <base/logging.h>
 
+#include <algorithm>
 #include <cstdint>
 
 #include "internal_include/bt_target.h"
@@ -928,42 +929,39 @@ int PORT_WriteDataCO(uint16_t handle, int* p_len) {
   length = RFCOMM_DATA_BUF_SIZE -
            (uint16_t)(sizeof(BT_HDR) + L2CAP_MIN_OFFSET + RFCOMM_DATA_OVERHEAD);
 
-  /* If there are buffers scheduled for transmission check if requested */
-  /* data fits into the end of the queue */
+  /* If there are buffers scheduled for transmission top up the last one */
+  /* up to the negotiated MTU so that queued data goes out in full frames */
   mutex_global_lock();
 
   p_buf = (BT_HDR*)fixed_queue_try_peek_last(p_port->tx.queue);
-  if ((p_buf != NULL) &&
-      (((int)p_buf->len + available) <= (int)p_port->peer_mtu) &&
-      (((int)p_buf->len + available) <= (int)length)) {
-    // if(recv(fd, (uint8_t *)(p_buf + 1) + p_buf->offset + p_buf->len,
-    // available, 0) != available)
-    if (!p_port->p_data_co_callback(
-            handle, (uint8_t*)(p_buf + 1) + p_buf->offset + p_buf->len,
-            available, DATA_CO_CALLBACK_TYPE_OUTGOING))
-
-    {
-      error(
-          "p_data_co_callback DATA_CO_CALLBACK_TYPE_OUTGOING failed, "
-          "available:%d",
-          available);
-      mutex_global_unlock();
-      return (PORT_UNKNOWN_ERROR);
-    }
-    // memcpy ((uint8_t *)(p_buf + 1) + p_buf->offset + p_buf->len, p_data,
-    // max_len);
-    p_port->tx.queue_size += (uint16_t)available;
-
-    *p_len = available;
-    p_buf->len += (uint16_t)available;
-
-    mutex_global_unlock();
+  if (p_buf != NULL) {
+    uint16_t frame_len = std::min(p_port->peer_mtu, length);
+    if (p_buf->len < frame_len) {
+      int fill = std::min((int)(frame_len - p_buf->len), available);
+      // if(recv(fd, (uint8_t *)(p_buf + 1) + p_buf->offset + p_buf->len,
+      // fill, 0) != fill)
+      if (!p_port->p_data_co_callback(
+              handle, (uint8_t*)(p_buf + 1) + p_buf->offset + p_buf->len, fill,
+              DATA_CO_CALLBACK_TYPE_OUTGOING)) {
+        error(
+            "p_data_co_callback DATA_CO_CALLBACK_TYPE_OUTGOING failed, "
+            "fill:%d",
+            fill);
+        mutex_global_unlock();
+        return (PORT_UNKNOWN_ERROR);
+      }
+      p_port->tx.queue_size += (uint16_t)fill;
+      p_buf->len += (uint16_t)fill;
 
-    return (PORT_SUCCESS);
+      *p_len = fill;
+      available -= fill;
+    }
   }
 
   mutex_global_unlock();
 
+  if (available == 0) return (PORT_SUCCESS);
+
   // int max_read = length < p_port->peer_mtu ? length : p_port->peer_mtu;
 
   // max_read = available < max_read ? available : max_read;
@@ -1079,26 +1077,29 @@ int PORT_WriteData(uint16_t handle, const char* p_data, uint16_t max_len,
   length = RFCOMM_DATA_BUF_SIZE -
            (uint16_t)(sizeof(BT_HDR) + L2CAP_MIN_OFFSET + RFCOMM_DATA_OVERHEAD);
 
-  /* If there are buffers scheduled for transmission check if requested */
-  /* data fits into the end of the queue */
+  /* If there are buffers scheduled for transmission top up the last one */
+  /* up to the negotiated MTU so that queued data goes out in full frames */
   mutex_global_lock();
 
   p_buf = (BT_HDR*)fixed_queue_try_peek_last(p_port->tx.queue);
-  if ((p_buf != NULL) && ((p_buf->len + max_len) <= p_port->peer_mtu) &&
-      ((p_buf->len + max_len) <= length)) {
-    memcpy((uint8_t*)(p_buf + 1) + p_buf->offset + p_buf->len, p_data, max_len);
-    p_port->tx.queue_size += max_len;
-
-    *p_len = max_len;
-    p_buf->len += max_len;
-
-    mutex_global_unlock();
-
-    return (PORT_SUCCESS);
+  if (p_buf != NULL) {
+    uint16_t frame_len = std::min(p_port->peer_mtu, length);
+    if (p_buf->len < frame_len) {
+      uint16_t fill = std::min<uint16_t>(frame_len - p_buf->len, max_len);
+      memcpy((uint8_t*)(p_buf + 1) + p_buf->offset + p_buf->len, p_data, fill);
+      p_port->tx.queue_size += fill;
+      p_buf->len += fill;
+
+      *p_len = fill;
+      max_len -= fill;
+      p_data += fill;
+    }
   }
 
   mutex_global_unlock();
 
+  if (!max_len) return (PORT_SUCCESS);
+
   while (max_len) {
     /* if we're over buffer high water mark, we're done */
     if ((p_port->tx.queue_size > PORT_TX_HIGH_WM) ||
@@ -27,6 +27,7 @@
 
 #include <string.h>
 
+#include <algorithm>
 #include <cstdint>
 
 #include "bt_target.h"
@@ -38,6 +39,8 @@
 #include "stack/sdp/sdp_discovery_db.h"
 #include "stack/sdp/sdpint.h"
 
+using bluetooth::Uuid;
+
 /******************************************************************************/
 /*            L O C A L    F U N C T I O N     P R O T O T Y P E S            */
 /******************************************************************************/
@@ -48,6 +51,43 @@ static bool find_uuid_in_seq(uint8_t* p, uint32_t seq_len,
 bool SDP_AddAttribute(uint32_t handle, uint16_t attr_id, uint8_t attr_type,
                       uint32_t attr_len, uint8_t* p_val);
 
+/*******************************************************************************
+ *
+ * Function         sdp_db_record_has_uuid
+ *
+ * Description      This function checks whether a record contains a UUID. The
+ *                  UUID is looked up in the record's UUID index, unless the
+ *                  index overflowed in which case the attributes are parsed.
+ *
+ * Returns          true if found, else false
+ *
+ ******************************************************************************/
+static bool sdp_db_record_has_uuid(const tSDP_RECORD* p_rec,
+                                   const tUID_ENT* p_uuid,
+                                   const uint8_t* p_uuid128) {
+  if (p_rec->uuid_index_overflow) {
+    const tSDP_ATTRIBUTE* p_attr = &p_rec->attribute[0];
+    for (uint16_t xx = 0; xx < p_rec->num_attributes; xx++, p_attr++) {
+      if (p_attr->type == UUID_DESC_TYPE) {
+        if (sdpu_compare_uuid_arrays(p_attr->value_ptr, p_attr->len,
+                                     &p_uuid->value[0], p_uuid->len))
+          return (true);
+      } else if (p_attr->type == DATA_ELE_SEQ_DESC_TYPE) {
+        if (find_uuid_in_seq(p_attr->value_ptr, p_attr->len, &p_uuid->value[0],
+                             p_uuid->len, 0))
+          return (true);
+      }
+    }
+    return (false);
+  }
+
+  for (uint8_t xx = 0; xx < p_rec->num_uuids; xx++) {
+    if (memcmp(p_rec->uuids[xx], p_uuid128, Uuid::kNumBytes128) == 0)
+      return (true);
+  }
+  return (false);
+}
+
 /*******************************************************************************
  *
  * Function         sdp_db_service_search
@@ -61,10 +101,21 @@ bool SDP_AddAttribute(uint32_t handle, uint16_t attr_id, uint8_t attr_type,
  ******************************************************************************/
 const tSDP_RECORD* sdp_db_service_search(const tSDP_RECORD* p_rec,
                                          const tSDP_UUID_SEQ* p_seq) {
-  uint16_t xx, yy;
-  const tSDP_ATTRIBUTE* p_attr;
+  uint16_t yy;
+  uint8_t uuid128[MAX_UUIDS_PER_SEQ][Uuid::kNumBytes128];
   tSDP_RECORD* p_end = &sdp_cb.server_db.record[sdp_cb.server_db.num_records];
 
+  /* Expand the searched UUIDs once, so they can be compared against the */
+  /* record indexes directly. A UUID of invalid size never matches.      */
+  for (yy = 0; yy < p_seq->num_uids; yy++) {
+    if (!sdpu_expand_uuid_to_128(&p_seq->uuid_entry[yy].value[0],
+                                 p_seq->uuid_entry[yy].len, uuid128[yy])) {
+      LOG_WARN("%s: invalid UUID length %d", __func__,
+               p_seq->uuid_entry[yy].len);
+      return (NULL);
+    }
+  }
+
   /* If NULL, start at the beginning, else start at the first specified record
    */
   if (!p_rec)
@@ -76,22 +127,9 @@ const tSDP_RECORD* sdp_db_service_search(const tSDP_RECORD* p_rec,
   /* the record contains all the passed UUIDs in it.                */
   for (; p_rec < p_end; p_rec++) {
     for (yy = 0; yy < p_seq->num_uids; yy++) {
-      p_attr = &p_rec->attribute[0];
-      for (xx = 0; xx < p_rec->num_attributes; xx++, p_attr++) {
-        if (p_attr->type == UUID_DESC_TYPE) {
-          if (sdpu_compare_uuid_arrays(p_attr->value_ptr, p_attr->len,
-                                       &p_seq->uuid_entry[yy].value[0],
-                                       p_seq->uuid_entry[yy].len))
-            break;
-        } else if (p_attr->type == DATA_ELE_SEQ_DESC_TYPE) {
-          if (find_uuid_in_seq(p_attr->value_ptr, p_attr->len,
-                               &p_seq->uuid_entry[yy].value[0],
-                               p_seq->uuid_entry[yy].len, 0))
-            break;
-        }
-      }
       /* If any UUID was not found,  on to the next record */
-      if (xx == p_rec->num_attributes) break;
+      if (!sdp_db_record_has_uuid(p_rec, &p_seq->uuid_entry[yy], uuid128[yy]))
+        break;
     }
 
     /* If every UUID was found in the record, return the record */
@@ -142,6 +180,99 @@ static bool find_uuid_in_seq(uint8_t* p, uint32_t seq_len,
   return (false);
 }
 
+/*******************************************************************************
+ *
+ * Function         sdp_db_index_uuid
+ *
+ * Description      This function adds a UUID to the record's UUID index.
+ *
+ * Returns          void
+ *
+ ******************************************************************************/
+static void sdp_db_index_uuid(tSDP_RECORD* p_rec, const uint8_t* p_uuid,
+                              uint32_t uuid_len) {
+  uint8_t uuid128[Uuid::kNumBytes128];
+
+  /* UUIDs of invalid size can never be matched by a search */
+  if (!sdpu_expand_uuid_to_128(p_uuid, uuid_len, uuid128)) return;
+
+  for (uint8_t xx = 0; xx < p_rec->num_uuids; xx++) {
+    if (memcmp(p_rec->uuids[xx], uuid128, Uuid::kNumBytes128) == 0) {
+      return;
+    }
+  }
+
+  if (p_rec->num_uuids >= SDP_MAX_REC_UUIDS) {
+    p_rec->uuid_index_overflow = true;
+    return;
+  }
+  memcpy(p_rec->uuids[p_rec->num_uuids++], uuid128, Uuid::kNumBytes128);
+}
+
+/*******************************************************************************
+ *
+ * Function         sdp_db_index_uuids_in_seq
+ *
+ * Description      This function adds every UUID of a data element sequence to
+ *                  the record's UUID index. It walks the sequence the same way
+ *                  find_uuid_in_seq does.
+ *
+ * Returns          void
+ *
+ ******************************************************************************/
+static void sdp_db_index_uuids_in_seq(tSDP_RECORD* p_rec, uint8_t* p,
+                                      uint32_t seq_len, int nest_level) {
+  uint8_t* p_end = p + seq_len;
+  uint8_t type;
+  uint32_t len;
+
+  /* A little safety check to avoid excessive recursion */
+  if (nest_level > 3) return;
+
+  while (p < p_end) {
+    type = *p++;
+    p = sdpu_get_len_from_type(p, p_end, type, &len);
+    if (p == NULL || (p + len) > p_end) {
+      LOG_WARN("%s: bad length", __func__);
+      break;
+    }
+    type = type >> 3;
+    if (type == UUID_DESC_TYPE) {
+      sdp_db_index_uuid(p_rec, p, len);
+    } else if (type == DATA_ELE_SEQ_DESC_TYPE) {
+      sdp_db_index_uuids_in_seq(p_rec, p, len, nest_level + 1);
+    }
+    p = p + len;
+  }
+}
+
+/*******************************************************************************
+ *
+ * Function         sdp_db_update_uuid_index
+ *
+ * Description      This function rebuilds the UUID index of a record. It must
+ *                  be called whenever attributes are added to or removed from
+ *                  the record.
+ *
+ * Returns          void
+ *
+ ******************************************************************************/
+void sdp_db_update_uuid_index(tSDP_RECORD* p_rec) {
+  const tSDP_ATTRIBUTE* p_attr = &p_rec->attribute[0];
+
+  p_rec->num_uuids = 0;
+  p_rec->uuid_index_overflow = false;
+
+  for (uint16_t xx = 0; xx < p_rec->num_attributes; xx++, p_attr++) {
+    if (p_attr->len == 0) continue;
+    if (p_attr->type == UUID_DESC_TYPE) {
+      sdp_db_index_uuid(p_rec, p_attr->value_ptr, p_attr->len);
+    } else if (p_attr->type == DATA_ELE_SEQ_DESC_TYPE) {
+      sdp_db_index_uuids_in_seq(p_rec, p_attr->value_ptr, p_attr->len, 0);
+    }
+  }
+}
+
 /*******************************************************************************
  *
  * Function         sdp_db_find_record
@@ -180,14 +311,17 @@ tSDP_RECORD* sdp_db_find_record(uint32_t handle) {
 const tSDP_ATTRIBUTE* sdp_db_find_attr_in_rec(const tSDP_RECORD* p_rec,
                                               uint16_t start_attr,
                                               uint16_t end_attr) {
-  const tSDP_ATTRIBUTE* p_at;
-  uint16_t xx;
-
-  /* Note that the attributes in a record are assumed to be in sorted order */
-  for (xx = 0, p_at = &p_rec->attribute[0]; xx < p_rec->num_attributes;
-       xx++, p_at++) {
-    if ((p_at->id >= start_attr) && (p_at->id <= end_attr)) return (p_at);
-  }
+  /* Note that the attributes in a record are assumed to be in sorted order, */
+  /* so the first attribute not below start_attr is the only candidate      */
+  const tSDP_ATTRIBUTE* p_at = std::lower_bound(
+      &p_rec->attribute[0], &p_rec->attribute[p_rec->num_attributes],
+      start_attr, [](const tSDP_ATTRIBUTE& attr, uint16_t id) {
+        return attr.id < id;
+      });
+
+  if ((p_at != &p_rec->attribute[p_rec->num_attributes]) &&
+      (p_at->id <= end_attr))
+    return (p_at);
 
   /* No matching attribute found */
   return (NULL);
@@ -512,9 +646,11 @@ bool SDP_AddAttributeToRecord(tSDP_RECORD* p_rec, uint16_t attr_id,
         "attr_len:%d ",
         attr_id, attr_len);
     p_attr->id = p_attr->type = p_attr->len = 0;
+    sdp_db_update_uuid_index(p_rec);
     return (false);
   }
   p_rec->num_attributes++;
+  sdp_db_update_uuid_index(p_rec);
   return (true);
 }
 
@@ -900,6 +1036,7 @@ bool SDP_DeleteAttributeFromRecord(tSDP_RECORD* p_rec, uint16_t attr_id) {
         }
         p_rec->free_pad_ptr -= len;
       }
+      sdp_db_update_uuid_index(p_rec);
       return (true);
     }
   }
@@ -48,6 +48,7 @@ static void process_service_attr_rsp(tCONN_CB* p_ccb, uint8_t* p_reply,
                                      uint8_t* p_reply_end);
 static void process_service_search_attr_rsp(tCONN_CB* p_ccb, uint8_t* p_reply,
                                             uint8_t* p_reply_end);
+static tSDP_REASON parse_search_attr_rsp_list(tCONN_CB* p_ccb, bool is_last);
 static uint8_t* save_attr_seq(tCONN_CB* p_ccb, uint8_t* p, uint8_t* p_msg_end);
 static tSDP_DISC_REC* add_record(tSDP_DISCOVERY_DB* p_db,
                                  const RawAddress& p_bda);
@@ -353,54 +354,23 @@ static void process_service_search_rsp(tCONN_CB* p_ccb, uint8_t* p_reply,
  *
  * Function         sdp_copy_raw_data
  *
- * Description      copy the raw data
+ * Description      copy the raw data, as much as fits in the database raw
+ *                  buffer
  *
  *
- * Returns          bool
- *                          true if successful
- *                          false if not copied
+ * Returns          void
  *
  ******************************************************************************/
-static bool sdp_copy_raw_data(tCONN_CB* p_ccb, bool offset) {
-  unsigned int cpy_len, rem_len;
-  uint32_t list_len;
-  uint8_t* p;
-  uint8_t* p_end;
-  uint8_t type;
-
+static void sdp_copy_raw_data(tCONN_CB* p_ccb, const uint8_t* p,
+                              uint32_t len) {
   if (p_ccb->p_db && p_ccb->p_db->raw_data) {
-    cpy_len = p_ccb->p_db->raw_size - p_ccb->p_db->raw_used;
-    list_len = p_ccb->list_len;
-    p = &p_ccb->rsp_list[0];
-    p_end = &p_ccb->rsp_list[0] + list_len;
-
-    if (offset) {
-      cpy_len -= 1;
-      type = *p++;
-      uint8_t* old_p = p;
-      p = sdpu_get_len_from_type(p, p_end, type, &list_len);
-      if (p == NULL || (p + list_len) > p_end) {
-        LOG_WARN("%s: bad length", __func__);
-        return false;
-      }
-      if ((int)cpy_len < (p - old_p)) {
-        LOG_WARN("%s: no bytes left for data", __func__);
-        return false;
-      }
-      cpy_len -= (p - old_p);
-    }
-    if (list_len < cpy_len) {
-      cpy_len = list_len;
-    }
-    rem_len = SDP_MAX_LIST_BYTE_COUNT - (unsigned int)(p - &p_ccb->rsp_list[0]);
-    if (cpy_len > rem_len) {
-      LOG_WARN("rem_len :%d less than cpy_len:%d", rem_len, cpy_len);
-      cpy_len = rem_len;
+    uint32_t cpy_len = p_ccb->p_db->raw_size - p_ccb->p_db->raw_used;
+    if (len < cpy_len) {
+      cpy_len = len;
     }
     memcpy(&p_ccb->p_db->raw_data[p_ccb->p_db->raw_used], p, cpy_len);
     p_ccb->p_db->raw_used += cpy_len;
   }
-  return true;
 }
 
 /*******************************************************************************
@@ -457,11 +427,7 @@ static void process_service_attr_rsp(tCONN_CB* p_ccb, uint8_t* p_reply,
       cont_request_needed = true;
     } else {
       LOG_WARN("process_service_attr_rsp");
-      if (!sdp_copy_raw_data(p_ccb, false)) {
-        LOG_ERROR("sdp_copy_raw_data failed");
-        sdp_disconnect(p_ccb, SDP_ILLEGAL_PARAMETER);
-        return;
-      }
+      sdp_copy_raw_data(p_ccb, &p_ccb->rsp_list[0], p_ccb->list_len);
 
       /* Save the response in the database. Stop on any error */
       if (!save_attr_seq(p_ccb, &p_ccb->rsp_list[0],
@@ -543,9 +509,7 @@ static void process_service_attr_rsp(tCONN_CB* p_ccb, uint8_t* p_reply,
  ******************************************************************************/
 static void process_service_search_attr_rsp(tCONN_CB* p_ccb, uint8_t* p_reply,
                                             uint8_t* p_reply_end) {
-  uint8_t *p, *p_start, *p_end, *p_param_len;
-  uint8_t type;
-  uint32_t seq_len;
+  uint8_t *p_start, *p_param_len;
   uint16_t param_len, lists_byte_count = 0;
   bool cont_request_needed = false;
 
@@ -587,6 +551,15 @@ static void process_service_search_attr_rsp(tCONN_CB* p_ccb, uint8_t* p_reply,
 
       cont_request_needed = true;
     }
+
+    /* Save the records received in full so far, so that only a partially */
+    /* received one is kept in the scratchpad across continuations         */
+    tSDP_REASON reason =
+        parse_search_attr_rsp_list(p_ccb, !cont_request_needed);
+    if (reason != SDP_SUCCESS) {
+      sdp_disconnect(p_ccb, reason);
+      return;
+    }
   }
 
   /* If continuation request (or first time request) */
@@ -661,50 +634,104 @@ static void process_service_search_attr_rsp(tCONN_CB* p_ccb, uint8_t* p_reply,
     return;
   }
 
-/*******************************************************************/
-/* We now have the full response, which is a sequence of sequences */
-/*******************************************************************/
-
-  if (!sdp_copy_raw_data(p_ccb, true)) {
-    LOG_ERROR("sdp_copy_raw_data failed");
-    sdp_disconnect(p_ccb, SDP_ILLEGAL_PARAMETER);
-    return;
-  }
+  /* Every record of the response has been saved by now */
+  /* Since we got everything we need, disconnect the call */
+  sdpu_log_attribute_metrics(p_ccb->device_address, p_ccb->p_db);
+  sdp_disconnect(p_ccb, SDP_SUCCESS);
+}
 
-  p = &p_ccb->rsp_list[0];
+/*******************************************************************************
+ *
+ * Function         parse_search_attr_rsp_list
+ *
+ * Description      This function parses the search attribute response list
+ *                  received so far, which is a sequence of attribute
+ *                  sequences. Every attribute sequence received in full is
+ *                  saved in the database and dropped from the scratchpad.
+ *
+ * Returns          SDP_SUCCESS, or the reason to disconnect with
+ *
+ ******************************************************************************/
+static tSDP_REASON parse_search_attr_rsp_list(tCONN_CB* p_ccb, bool is_last) {
+  uint8_t* p = &p_ccb->rsp_list[0];
+  uint8_t* p_end = &p_ccb->rsp_list[p_ccb->list_len];
+  uint8_t *p_seq, *p_seq_end;
+  uint8_t type;
+  uint32_t seq_len;
 
   /* The contents is a sequence of attribute sequences */
-  type = *p++;
-
-  if ((type >> 3) != DATA_ELE_SEQ_DESC_TYPE) {
-    LOG_WARN("Wrong element in attr_rsp type:0x%02x", type);
-    sdp_disconnect(p_ccb, SDP_ILLEGAL_PARAMETER);
-    return;
-  }
-  p = sdpu_get_len_from_type(p, p + p_ccb->list_len, type, &seq_len);
-  if (p == NULL || (p + seq_len) > (p + p_ccb->list_len)) {
-    LOG_WARN("Illegal search attribute length");
-    sdp_disconnect(p_ccb, SDP_ILLEGAL_PARAMETER);
-    return;
-  }
-  p_end = &p_ccb->rsp_list[p_ccb->list_len];
+  if (!p_ccb->rsp_seq_started) {
+    if (p == p_end) {
+      return (is_last) ? SDP_ILLEGAL_PARAMETER : SDP_SUCCESS;
+    }
 
-  if ((p + seq_len) != p_end) {
-    sdp_disconnect(p_ccb, SDP_INVALID_CONT_STATE);
-    return;
+    type = *p++;
+    if ((type >> 3) != DATA_ELE_SEQ_DESC_TYPE) {
+      LOG_WARN("Wrong element in attr_rsp type:0x%02x", type);
+      return SDP_ILLEGAL_PARAMETER;
+    }
+    p = sdpu_get_len_from_type(p, p_end, type, &seq_len);
+    if (p == NULL) {
+      /* Length is split across responses, wait for the next one */
+      if (!is_last) return SDP_SUCCESS;
+      LOG_WARN("Illegal search attribute length");
+      return SDP_ILLEGAL_PARAMETER;
+    }
+    p_ccb->rsp_seq_started = true;
+    p_ccb->rsp_seq_left = seq_len;
   }
 
   while (p < p_end) {
-    p = save_attr_seq(p_ccb, p, &p_ccb->rsp_list[p_ccb->list_len]);
-    if (!p) {
-      sdp_disconnect(p_ccb, SDP_DB_FULL);
-      return;
+    p_seq = p;
+    type = *p++;
+    p = sdpu_get_len_from_type(p, p_end, type, &seq_len);
+    if (p == NULL || (p + seq_len) > p_end) {
+      /* Not received in full yet */
+      p = p_seq;
+      break;
+    }
+    p_seq_end = p + seq_len;
+
+    if ((uint32_t)(p_seq_end - p_seq) > p_ccb->rsp_seq_left) {
+      return SDP_INVALID_CONT_STATE;
     }
+    p_ccb->rsp_seq_left -= p_seq_end - p_seq;
+
+    sdp_copy_raw_data(p_ccb, p_seq, p_seq_end - p_seq);
+    if (!save_attr_seq(p_ccb, p_seq, p_seq_end)) {
+      return SDP_DB_FULL;
+    }
+    p = p_seq_end;
   }
 
-  /* Since we got everything we need, disconnect the call */
-  sdpu_log_attribute_metrics(p_ccb->device_address, p_ccb->p_db);
-  sdp_disconnect(p_ccb, SDP_SUCCESS);
+  /* Keep the partially received attribute sequence for the next response */
+  p_ccb->list_len = (uint16_t)(p_end - p);
+  memmove(&p_ccb->rsp_list[0], p, p_ccb->list_len);
+
+  if (is_last && (p_ccb->list_len || p_ccb->rsp_seq_left)) {
+    return SDP_INVALID_CONT_STATE;
+  }
+  return SDP_SUCCESS;
+}
+
+/*******************************************************************************
+ *
+ * Function         is_attr_in_filters
+ *
+ * Description      This function checks whether an attribute was requested
+ *                  by the attribute filters of the discovery database.
+ *
+ * Returns          true if requested, or if there are no attribute filters
+ *
+ ******************************************************************************/
+static bool is_attr_in_filters(const tSDP_DISCOVERY_DB* p_db,
+                               uint16_t attr_id) {
+  if (p_db->num_attr_filters == 0) return (true);
+
+  for (uint16_t xx = 0; xx < p_db->num_attr_filters; xx++) {
+    if (p_db->attr_filters[xx] == attr_id) return (true);
+  }
+  return (false);
 }
 
 /*******************************************************************************
@@ -758,6 +785,24 @@ static uint8_t* save_attr_seq(tCONN_CB* p_ccb, uint8_t* p, uint8_t* p_msg_end) {
     }
     BE_STREAM_TO_UINT16(attr_id, p);
 
+    /* Servers may return more attributes than requested. They are saved */
+    /* unless the database asks for the requested ones only.             */
+    if (p_ccb->p_db->skip_unrequested_attrs &&
+        !is_attr_in_filters(p_ccb->p_db, attr_id)) {
+      if (p >= p_seq_end) {
+        LOG_WARN("%s: Missing value in attr_rsp", __func__);
+        return (NULL);
+      }
+      type = *p++;
+      p = sdpu_get_len_from_type(p, p_seq_end, type, &attr_len);
+      if (p == NULL || (p + attr_len) > p_seq_end) {
+        LOG_WARN("%s: Bad len in attr_rsp %d", __func__, attr_len);
+        return (NULL);
+      }
+      p += attr_len;
+      continue;
+    }
+
     /* Now, add the attribute value */
     p = add_attr(p, p_seq_end, p_ccb->p_db, p_rec, attr_id, NULL, 0);
 
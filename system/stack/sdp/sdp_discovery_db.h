@@ -72,6 +72,8 @@ typedef struct {
       raw_data; /* Received record from server. allocated/released by client  */
   uint32_t raw_size; /* size of raw_data */
   uint32_t raw_used; /* length of raw_data used */
+  bool skip_unrequested_attrs; /* Do not save attributes that are not in */
+                               /* attr_filters, off by default            */
 } tSDP_DISCOVERY_DB;
 
 /* This structure is used to add protocol lists and find protocol elements */
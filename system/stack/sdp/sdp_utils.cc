@@ -1123,6 +1123,35 @@ bool sdpu_compare_uuid_arrays(const uint8_t* p_uuid1, uint32_t len1,
   }
 }
 
+/*******************************************************************************
+ *
+ * Function         sdpu_expand_uuid_to_128
+ *
+ * Description      This function expands a BE 16, 32 or 128-bit UUID to its
+ *                  128-bit form using the SDP base UUID, so that UUIDs of
+ *                  different sizes can be compared with a plain memcmp.
+ *
+ * Returns          true if the UUID length was valid, else false
+ *
+ ******************************************************************************/
+bool sdpu_expand_uuid_to_128(const uint8_t* p_uuid, uint32_t len,
+                             uint8_t* p_uuid128) {
+  if (len == Uuid::kNumBytes128) {
+    memcpy(p_uuid128, p_uuid, Uuid::kNumBytes128);
+    return true;
+  }
+
+  memcpy(p_uuid128, sdp_base_uuid, Uuid::kNumBytes128);
+  if (len == 4) {
+    memcpy(p_uuid128, p_uuid, len);
+  } else if (len == 2) {
+    memcpy(p_uuid128 + 2, p_uuid, len);
+  } else {
+    return false;
+  }
+  return true;
+}
+
 /*******************************************************************************
  *
  * Function         sdpu_compare_uuid_with_attr
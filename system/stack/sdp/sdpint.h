@@ -97,6 +97,10 @@ typedef struct {
   uint8_t type;
 } tSDP_ATTRIBUTE;
 
+/* Max UUIDs indexed per record. Records holding more UUIDs than this are
+ * searched by parsing their attributes */
+#define SDP_MAX_REC_UUIDS 24
+
 /* An SDP record consists of a handle, and 1 or more attributes */
 typedef struct {
   uint32_t record_handle;
@@ -104,6 +108,13 @@ typedef struct {
   uint16_t num_attributes;
   tSDP_ATTRIBUTE attribute[SDP_MAX_REC_ATTR];
   uint8_t attr_pad[SDP_MAX_PAD_LEN];
+
+  /* Every UUID contained in the record, expanded to 128 bits. Rebuilt each
+   * time an attribute is added or removed so that service searches do not
+   * have to parse the attribute values */
+  bool uuid_index_overflow;
+  uint8_t num_uuids;
+  uint8_t uuids[SDP_MAX_REC_UUIDS][bluetooth::Uuid::kNumBytes128];
 } tSDP_RECORD;
 
 /* Define the SDP database */
@@ -207,6 +218,10 @@ struct tCONN_CB {
   uint16_t cont_offset;     /* Continuation state data in the server response */
   tSDP_CONT_INFO cont_info; /* structure to hold continuation information for
                                the server response */
+
+  bool rsp_seq_started;  /* true once the outer data element sequence header
+                            of a search attribute response has been parsed */
+  uint32_t rsp_seq_left; /* bytes of that sequence not yet parsed */
   tCONN_CB() = default;
 
  private:
@@ -271,6 +286,8 @@ uint8_t* sdpu_get_len_from_type(uint8_t* p, uint8_t* p_end, uint8_t type,
 bool sdpu_is_base_uuid(uint8_t* p_uuid);
 bool sdpu_compare_uuid_arrays(const uint8_t* p_uuid1, uint32_t len1,
                               const uint8_t* p_uuid2, uint16_t len2);
+bool sdpu_expand_uuid_to_128(const uint8_t* p_uuid, uint32_t len,
+                             uint8_t* p_uuid128);
 bool sdpu_compare_uuid_with_attr(const bluetooth::Uuid& uuid,
                                  tSDP_DISC_ATTR* p_attr);
 
@@ -308,6 +325,7 @@ void sdpu_callback(tCONN_CB& ccb, tSDP_REASON reason);
 const tSDP_RECORD* sdp_db_service_search(const tSDP_RECORD* p_rec,
                                          const tSDP_UUID_SEQ* p_seq);
 tSDP_RECORD* sdp_db_find_record(uint32_t handle);
+void sdp_db_update_uuid_index(tSDP_RECORD* p_rec);
 const tSDP_ATTRIBUTE* sdp_db_find_attr_in_rec(const tSDP_RECORD* p_rec,
                                               uint16_t start_attr,
                                               uint16_t end_attr);
@@ -0,0 +1,94 @@
+/*
+ * Copyright 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "stack/include/a2dp_bitrate_adapter.h"
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+
+namespace {
+constexpr uint32_t kMaxBitrate = 320000;
+constexpr uint32_t kMinBitrate = 160000;
+
+// Feeds |ticks| encoder ticks with the same transmit queue length, and
+// returns how many of them changed the bit rate.
+size_t Feed(tA2DP_BITRATE_ADAPTER* p_adapter, size_t queue_length,
+            size_t ticks) {
+  size_t changes = 0;
+  for (size_t i = 0; i < ticks; i++) {
+    if (a2dp_bitrate_adapter_update(p_adapter, queue_length)) changes++;
+  }
+  return changes;
+}
+}  // namespace
+
+class A2dpBitrateAdapterTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    a2dp_bitrate_adapter_init(&adapter_, kMaxBitrate, kMinBitrate);
+  }
+
+  tA2DP_BITRATE_ADAPTER adapter_;
+};
+
+TEST_F(A2dpBitrateAdapterTest, starts_at_max_bitrate) {
+  EXPECT_EQ(adapter_.bitrate, kMaxBitrate);
+}
+
+TEST_F(A2dpBitrateAdapterTest, drained_queue_keeps_max_bitrate) {
+  EXPECT_EQ(Feed(&adapter_, 0, 1000), 0u);
+  EXPECT_EQ(adapter_.bitrate, kMaxBitrate);
+}
+
+TEST_F(A2dpBitrateAdapterTest, congestion_lowers_bitrate_to_min) {
+  EXPECT_TRUE(a2dp_bitrate_adapter_update(&adapter_, 6));
+  EXPECT_EQ(adapter_.bitrate, kMaxBitrate - kMaxBitrate / 4);
+
+  // The next decrease waits for the first one to take effect.
+  EXPECT_FALSE(a2dp_bitrate_adapter_update(&adapter_, 6));
+
+  Feed(&adapter_, 6, 100);
+  EXPECT_EQ(adapter_.bitrate, kMinBitrate);
+  EXPECT_EQ(adapter_.increases, 0u);
+}
+
+TEST_F(A2dpBitrateAdapterTest, recovers_after_congestion) {
+  Feed(&adapter_, 6, 100);
+  ASSERT_EQ(adapter_.bitrate, kMinBitrate);
+
+  // A short drained period is not enough to increase.
+  EXPECT_EQ(Feed(&adapter_, 0, 100), 0u);
+
+  EXPECT_GT(Feed(&adapter_, 0, 150 * 10), 0u);
+  EXPECT_EQ(adapter_.bitrate, kMaxBitrate);
+}
+
+TEST_F(A2dpBitrateAdapterTest, moderate_queue_holds_bitrate) {
+  Feed(&adapter_, 6, 1);
+  uint32_t bitrate = adapter_.bitrate;
+
+  // A queue between drained and congested neither lowers nor raises.
+  EXPECT_EQ(Feed(&adapter_, 2, 1000), 0u);
+  EXPECT_EQ(adapter_.bitrate, bitrate);
+}
+
+TEST(A2dpBitrateAdapterDisabledTest, zero_max_bitrate_disables_adaptation) {
+  tA2DP_BITRATE_ADAPTER adapter;
+  a2dp_bitrate_adapter_init(&adapter, 0, 0);
+  EXPECT_EQ(Feed(&adapter, 10, 100), 0u);
+  EXPECT_EQ(adapter.bitrate, 0u);
+}
@@ -36,6 +36,8 @@ struct EattExtension::impl : public MockEattExtension {
 
 void EattExtension::AddFromStorage(const RawAddress& bd_addr) {}
 
+void EattExtension::Dump(int fd) {}
+
 EattExtension::EattExtension() : pimpl_(std::make_unique<impl>()) {}
 
 bool EattExtension::IsEattSupportedByPeer(const RawAddress& bd_addr) {
@@ -92,8 +94,8 @@ EattChannel* EattExtension::GetChannelWithQueuedDataToSend(
 }
 
 EattChannel* EattExtension::GetChannelAvailableForClientRequest(
-    const RawAddress& bd_addr) {
-  return pimpl_->GetChannelAvailableForClientRequest(bd_addr);
+    const RawAddress& bd_addr, uint16_t min_payload_size) {
+  return pimpl_->GetChannelAvailableForClientRequest(bd_addr, min_payload_size);
 }
 
 /* Start stop GATT indication timer per CID */
@@ -55,7 +55,7 @@ class MockEattExtension : public EattExtension {
   MOCK_METHOD((EattChannel*), GetChannelWithQueuedDataToSend,
               (const RawAddress& bd_addr));
   MOCK_METHOD((EattChannel*), GetChannelAvailableForClientRequest,
-              (const RawAddress& bd_addr));
+              (const RawAddress& bd_addr, uint16_t min_payload_size));
   MOCK_METHOD((void), StartIndicationConfirmationTimer,
               (const RawAddress& bd_addr, uint16_t cid));
   MOCK_METHOD((void), StopIndicationConfirmationTimer,
@@ -18,6 +18,7 @@
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
 
+#include <utility>
 #include <vector>
 
 #include "bind_helpers.h"
@@ -30,6 +31,7 @@
 #include "mock_l2cap_layer.h"
 #include "stack/include/bt_hdr.h"
 #include "stack/include/bt_psm_types.h"
+#include "stack/include/main_thread.h"
 #include "types/raw_address.h"
 
 using testing::_;
@@ -58,6 +60,21 @@ tGATT_TCB* gatt_find_tcb_by_addr(const RawAddress& bda,
   return &test_tcb;
 }
 
+/* Tasks delayed on the main thread, run by the test when it sees fit */
+static std::vector<std::pair<base::TimeDelta, base::OnceClosure>>
+    main_thread_delayed_tasks;
+bluetooth::common::MessageLoopThread* get_main_thread() { return nullptr; }
+bt_status_t do_in_main_thread(const base::Location& from_here,
+                              base::OnceClosure task) {
+  return BT_STATUS_FAIL;
+}
+bt_status_t do_in_main_thread_delayed(const base::Location& from_here,
+                                      base::OnceClosure task,
+                                      const base::TimeDelta& delay) {
+  main_thread_delayed_tasks.emplace_back(delay, std::move(task));
+  return BT_STATUS_SUCCESS;
+}
+
 namespace {
 const RawAddress test_address({0x11, 0x11, 0x11, 0x11, 0x11, 0x11});
 
@@ -219,6 +236,7 @@ class EattTest : public testing::Test {
 
     // Clear the static memory for each test case
     memset(&test_tcb, 0, sizeof(test_tcb));
+    main_thread_delayed_tasks.clear();
 
     EXPECT_CALL(l2cap_interface_, RegisterLECoc(BT_PSM_EATT, _, _))
         .WillOnce(DoAll(SaveArg<1>(&l2cap_app_info_), Return(BT_PSM_EATT)));
@@ -462,6 +480,38 @@ TEST_F(EattTest, DisonnectByPeerSucceed) {
   ASSERT_TRUE(channel == nullptr);
 }
 
+TEST_F(EattTest, ChannelsDisconnectedByPeerAreReopened) {
+  ConnectDeviceEattSupported(5);
+
+  // Reopening fails every time, each attempt waits twice as long
+  for (int attempt = 0; attempt < EATT_MAX_REOPEN_ATTEMPTS; attempt++) {
+    l2cap_app_info_.pL2CA_DisconnectInd_Cb(connected_cids_[attempt], true);
+
+    ASSERT_EQ(main_thread_delayed_tasks.size(), 1u);
+    ASSERT_EQ(main_thread_delayed_tasks[0].first.InMilliseconds(),
+              EATT_REOPEN_BASE_DELAY_MS << attempt);
+
+    EXPECT_CALL(
+        l2cap_interface_,
+        ConnectCreditBasedReq(
+            BT_PSM_EATT, test_address,
+            testing::Pointee(testing::Field(
+                &tL2CAP_LE_CFG_INFO::number_of_channels, 1))))
+        .WillOnce(Return(std::vector<uint16_t>()));
+    base::OnceClosure task = std::move(main_thread_delayed_tasks[0].second);
+    main_thread_delayed_tasks.clear();
+    std::move(task).Run();
+    testing::Mock::VerifyAndClearExpectations(&l2cap_interface_);
+  }
+
+  // No more attempts for the next lost channel
+  EXPECT_CALL(l2cap_interface_, ConnectCreditBasedReq(_, _, _)).Times(0);
+  l2cap_app_info_.pL2CA_DisconnectInd_Cb(
+      connected_cids_[EATT_MAX_REOPEN_ATTEMPTS], true);
+  ASSERT_TRUE(main_thread_delayed_tasks.empty());
+  ASSERT_EQ(test_tcb.eatt, 5 - EATT_MAX_REOPEN_ATTEMPTS - 1);
+}
+
 TEST_F(EattTest, ReconfigAllSucceed) {
   ConnectDeviceEattSupported(3);
 
@@ -670,4 +720,102 @@ TEST_F(EattTest, ChannelUnavailableWhileReconfiguring) {
   ASSERT_EQ(available_channel_for_indication, nullptr);
 }
 
+TEST_F(EattTest, IndicationsKeptOnDedicatedChannel) {
+  ConnectDeviceEattSupported(3);
+
+  EattChannel* ind_channel =
+      eatt_instance_->GetChannelAvailableForIndication(test_address);
+  ASSERT_NE(ind_channel, nullptr);
+  ASSERT_EQ(ind_channel,
+            eatt_instance_->GetChannelAvailableForIndication(test_address));
+
+  // Client requests are kept off the indication channel
+  for (int i = 0; i < 4; i++) {
+    EattChannel* channel =
+        eatt_instance_->GetChannelAvailableForClientRequest(test_address);
+    ASSERT_NE(channel, nullptr);
+    ASSERT_NE(channel, ind_channel);
+    channel->cl_cmd_q_.push_back(tGATT_CMD_Q{});
+  }
+
+  // Busy indication channel lets another one take the indication
+  ind_channel->indicate_handle_ = 0x0010;
+  EattChannel* channel =
+      eatt_instance_->GetChannelAvailableForIndication(test_address);
+  ASSERT_NE(channel, nullptr);
+  ASSERT_NE(channel, ind_channel);
+
+  DisconnectEattDevice(connected_cids_);
+}
+
+TEST_F(EattTest, ClientRequestsBalancedByOutstandingCount) {
+  ConnectDeviceEattSupported(3);
+
+  EattChannel* ind_channel =
+      eatt_instance_->GetChannelAvailableForIndication(test_address);
+
+  EattChannel* first =
+      eatt_instance_->GetChannelAvailableForClientRequest(test_address);
+  ASSERT_NE(first, nullptr);
+  first->cl_cmd_q_.push_back(tGATT_CMD_Q{});
+
+  EattChannel* second =
+      eatt_instance_->GetChannelAvailableForClientRequest(test_address);
+  ASSERT_NE(second, nullptr);
+  ASSERT_NE(second, first);
+  ASSERT_NE(second, ind_channel);
+  second->cl_cmd_q_.push_back(tGATT_CMD_Q{});
+  second->cl_cmd_q_.push_back(tGATT_CMD_Q{});
+
+  ASSERT_EQ(first,
+            eatt_instance_->GetChannelAvailableForClientRequest(test_address));
+
+  DisconnectEattDevice(connected_cids_);
+}
+
+TEST_F(EattTest, ClientRequestPrefersChannelWithFittingMtu) {
+  ConnectDeviceEattSupported(3);
+
+  EattChannel* ind_channel =
+      eatt_instance_->GetChannelAvailableForIndication(test_address);
+
+  uint16_t new_mtu = 300;
+  tL2CAP_LE_CFG_INFO cfg = {.result = L2CAP_CFG_OK, .mtu = new_mtu};
+  uint16_t big_cid = 0;
+  for (uint16_t cid : connected_cids_) {
+    if (cid != ind_channel->cid_) big_cid = cid;
+  }
+  l2cap_app_info_.pL2CA_CreditBasedReconfigCompleted_Cb(test_address, big_cid,
+                                                        false, &cfg);
+
+  EattChannel* channel =
+      eatt_instance_->GetChannelAvailableForClientRequest(test_address, 200);
+  ASSERT_NE(channel, nullptr);
+  ASSERT_EQ(channel->cid_, big_cid);
+
+  DisconnectEattDevice(connected_cids_);
+}
+
+TEST_F(EattTest, ChannelRoundTripHistogram) {
+  RawAddress addr = test_address;
+  EattChannel channel(addr, 61, EATT_MIN_MTU_MPS, EATT_DEFAULT_MTU);
+
+  // Response without request is not counted
+  channel.EattChannelResponseReceived(1000);
+  ASSERT_EQ(channel.rsp_count_, 0u);
+
+  channel.EattChannelRequestSent(1000);
+  channel.EattChannelResponseReceived(1005);
+  channel.EattChannelRequestSent(2000);
+  channel.EattChannelResponseReceived(2000);
+  channel.EattChannelRequestSent(3000);
+  channel.EattChannelResponseReceived(13000);
+
+  ASSERT_EQ(channel.rsp_count_, 3u);
+  ASSERT_EQ(channel.rtt_sum_ms_, 10005u);
+  ASSERT_EQ(channel.rtt_histogram_[0], 1u);
+  ASSERT_EQ(channel.rtt_histogram_[3], 1u);
+  ASSERT_EQ(channel.rtt_histogram_[EATT_RTT_HISTOGRAM_BUCKETS - 1], 1u);
+}
+
 }  // namespace
@@ -0,0 +1,120 @@
+/*
+ * Copyright 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "stack/gatt/gatt_notif_batch.h"
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <vector>
+
+#include "osi/include/properties.h"
+
+namespace {
+
+const std::vector<uint8_t> kValue1 = {0x01};
+const std::vector<uint8_t> kValue2 = {0x02, 0x02};
+const std::vector<uint8_t> kValue3 = {0x03, 0x03, 0x03};
+
+void Add(GattNotificationBatch& batch, uint16_t handle,
+         const std::vector<uint8_t>& value) {
+  batch.Add(handle, value.data(), value.size());
+}
+
+}  // namespace
+
+TEST(GattNotificationBatchTest, superseded_value_is_dropped) {
+  GattNotificationBatch batch;
+  Add(batch, 0x10, kValue1);
+  Add(batch, 0x20, kValue2);
+  Add(batch, 0x10, kValue3);
+  ASSERT_EQ(batch.GetMultiNotifSize(), 1u + (4 + 2) + (4 + 3));
+
+  auto pdus = batch.TakePdus(23, true);
+  ASSERT_EQ(pdus.size(), 1u);
+  ASSERT_EQ(pdus[0].size(), 2u);
+  // The latest value is sent in the order it was notified
+  ASSERT_EQ(pdus[0][0].handle, 0x20);
+  ASSERT_EQ(pdus[0][0].value, kValue2);
+  ASSERT_EQ(pdus[0][1].handle, 0x10);
+  ASSERT_EQ(pdus[0][1].value, kValue3);
+  ASSERT_TRUE(batch.IsEmpty());
+}
+
+TEST(GattNotificationBatchTest, values_are_packed_up_to_payload_size) {
+  GattNotificationBatch batch;
+  // 7 bytes tuples: 3 of them fit in the 22 bytes after the opcode
+  for (uint16_t handle = 1; handle <= 7; handle++) {
+    Add(batch, handle, kValue3);
+  }
+
+  auto pdus = batch.TakePdus(23, true);
+  ASSERT_EQ(pdus.size(), 3u);
+  ASSERT_EQ(pdus[0].size(), 3u);
+  ASSERT_EQ(pdus[1].size(), 3u);
+  ASSERT_EQ(pdus[2].size(), 1u);
+  ASSERT_EQ(pdus[2][0].handle, 7);
+}
+
+TEST(GattNotificationBatchTest, large_value_is_sent_alone) {
+  GattNotificationBatch batch;
+  std::vector<uint8_t> large(20, 0xff);
+  Add(batch, 1, kValue1);
+  Add(batch, 2, large);
+  Add(batch, 3, kValue1);
+
+  auto pdus = batch.TakePdus(23, true);
+  ASSERT_EQ(pdus.size(), 3u);
+  ASSERT_EQ(pdus[1].size(), 1u);
+  ASSERT_EQ(pdus[1][0].value, large);
+}
+
+TEST(GattNotificationBatchTest, no_multi_notif_support) {
+  GattNotificationBatch batch;
+  Add(batch, 1, kValue1);
+  Add(batch, 2, kValue2);
+  Add(batch, 1, kValue3);
+
+  auto pdus = batch.TakePdus(23, false);
+  ASSERT_EQ(pdus.size(), 2u);
+  ASSERT_EQ(pdus[0].size(), 1u);
+  ASSERT_EQ(pdus[1].size(), 1u);
+  ASSERT_EQ(pdus[1][0].value, kValue3);
+}
+
+TEST(GattNotificationBatchTest, clear) {
+  GattNotificationBatch batch;
+  Add(batch, 1, kValue1);
+  batch.Clear();
+  ASSERT_TRUE(batch.IsEmpty());
+  ASSERT_EQ(batch.GetMultiNotifSize(), 1u);
+  ASSERT_TRUE(batch.TakePdus(23, true).empty());
+}
+
+TEST(GattNotificationBatchTest, negative_window_disables_batching) {
+  const char* kWindowProperty =
+      "bluetooth.gatt.notification_batching_window_ms";
+  osi_property_set(kWindowProperty, "-1");
+  gatt_notif_batch_init();
+  ASSERT_EQ(gatt_notif_batch_get_window_ms(), 0u);
+
+  osi_property_set(kWindowProperty, "15");
+  gatt_notif_batch_init();
+  ASSERT_EQ(gatt_notif_batch_get_window_ms(), 15u);
+
+  osi_property_set(kWindowProperty, "0");
+  gatt_notif_batch_init();
+}
@@ -0,0 +1,50 @@
+/*
+ * Copyright 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "stack/gatt/gatt_sr_pipeline.h"
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+
+TEST(GattRequestLatencyTest, empty_reports_zero) {
+  GattRequestLatency latency(8);
+  ASSERT_EQ(latency.Size(), 0u);
+  ASSERT_EQ(latency.GetPercentile(50), 0u);
+  ASSERT_EQ(latency.GetPercentile(99), 0u);
+}
+
+TEST(GattRequestLatencyTest, percentiles_use_nearest_rank) {
+  GattRequestLatency latency(100);
+  // Added out of order: 1 ms .. 100 ms
+  for (uint64_t ms = 100; ms >= 1; ms--) latency.Add(ms);
+
+  ASSERT_EQ(latency.Size(), 100u);
+  ASSERT_EQ(latency.GetPercentile(0), 1u);
+  ASSERT_EQ(latency.GetPercentile(50), 50u);
+  ASSERT_EQ(latency.GetPercentile(90), 90u);
+  ASSERT_EQ(latency.GetPercentile(99), 99u);
+  ASSERT_EQ(latency.GetPercentile(100), 100u);
+}
+
+TEST(GattRequestLatencyTest, oldest_samples_are_replaced) {
+  GattRequestLatency latency(4);
+  for (int i = 0; i < 4; i++) latency.Add(1000);
+  for (int i = 0; i < 4; i++) latency.Add(10);
+
+  ASSERT_EQ(latency.Size(), 4u);
+  ASSERT_EQ(latency.GetPercentile(99), 10u);
+}
@@ -19,7 +19,11 @@
 #include <stdio.h>
 
 #include <cstdint>
+#include <list>
+#include <memory>
+#include <vector>
 
+#include "osi/include/allocator.h"
 #include "stack/gatt/gatt_int.h"
 #include "stack/include/bt_hdr.h"
 #include "stack/include/main_thread.h"
@@ -50,6 +54,20 @@ struct TestMutables {
     int access_count_{0};
     tGATT_STATUS return_status_{GATT_SUCCESS};
   } gatts_write_attr_perm_check;
+  struct {
+    std::vector<uint16_t> handles_;
+    tGATT_STATUS return_status_{GATT_SUCCESS};
+  } gatts_read_attr_value_by_handle;
+  struct {
+    int access_count_{0};
+    uint16_t cid_{0};
+    std::vector<uint8_t> data_;
+    std::vector<std::vector<uint8_t>> pdus_;
+    tGATT_STATUS return_status_{GATT_SUCCESS};
+  } attp_send_sr_msg;
+  struct {
+    bool supported_{false};
+  } gatt_sr_is_cl_multi_variable_len_notif_supported;
 };
 
 TestMutables test_state_;
@@ -70,7 +88,11 @@ bool is_background_connection(const RawAddress& address) { return false; }
 BT_HDR* attp_build_sr_msg(tGATT_TCB& tcb, uint8_t op_code, tGATT_SR_MSG* p_msg,
                           uint16_t payload_size) {
   test_state_.attp_build_sr_msg.op_code_ = op_code;
-  return nullptr;
+  BT_HDR* p_buf = (BT_HDR*)osi_calloc(sizeof(BT_HDR) + L2CAP_MIN_OFFSET + 1);
+  p_buf->offset = L2CAP_MIN_OFFSET;
+  p_buf->len = 1;
+  *((uint8_t*)(p_buf + 1) + p_buf->offset) = op_code;
+  return p_buf;
 }
 tGATT_STATUS attp_send_cl_confirmation_msg(tGATT_TCB& tcb, uint16_t cid) {
   return GATT_SUCCESS;
@@ -80,7 +102,14 @@ tGATT_STATUS attp_send_cl_msg(tGATT_TCB& tcb, tGATT_CLCB* p_clcb,
   return GATT_SUCCESS;
 }
 tGATT_STATUS attp_send_sr_msg(tGATT_TCB& tcb, uint16_t cid, BT_HDR* p_msg) {
-  return GATT_SUCCESS;
+  test_state_.attp_send_sr_msg.access_count_++;
+  test_state_.attp_send_sr_msg.cid_ = cid;
+  uint8_t* p = (uint8_t*)(p_msg + 1) + p_msg->offset;
+  test_state_.attp_send_sr_msg.data_.assign(p, p + p_msg->len);
+  test_state_.attp_send_sr_msg.pdus_.push_back(
+      test_state_.attp_send_sr_msg.data_);
+  osi_free(p_msg);
+  return test_state_.attp_send_sr_msg.return_status_;
 }
 
 void gatt_act_discovery(tGATT_CLCB* p_clcb) {}
@@ -110,7 +139,8 @@ tGATT_STATUS gatts_read_attr_value_by_handle(
     uint16_t handle, uint16_t offset, uint8_t* p_value, uint16_t* p_len,
     uint16_t mtu, tGATT_SEC_FLAG sec_flag, uint8_t key_size,
     uint32_t trans_id) {
-  return GATT_SUCCESS;
+  test_state_.gatts_read_attr_value_by_handle.handles_.push_back(handle);
+  return test_state_.gatts_read_attr_value_by_handle.return_status_;
 }
 tGATT_STATUS gatts_write_attr_perm_check(tGATT_SVC_DB* p_db, uint8_t op_code,
                                          uint16_t handle, uint16_t offset,
@@ -137,6 +167,10 @@ void ApplicationRequestCallback(uint16_t conn_id, uint32_t trans_id,
 }
 
 bool gatt_sr_is_cl_change_aware(tGATT_TCB& tcb) { return false; }
+bool gatt_sr_is_cl_multi_variable_len_notif_supported(tGATT_TCB& tcb) {
+  return test_state_.gatt_sr_is_cl_multi_variable_len_notif_supported
+      .supported_;
+}
 void gatt_sr_init_cl_status(tGATT_TCB& p_tcb) {}
 void gatt_sr_update_cl_status(tGATT_TCB& p_tcb, bool chg_aware) {
   p_tcb.is_robust_cache_change_aware = chg_aware;
@@ -169,6 +203,48 @@ class GattSrTest : public ::testing::Test {
   tGATT_SRV_LIST_ELEM el_;
 };
 
+/* Server Read Multiple Test */
+class GattSrReadMultiTest : public GattSrTest {
+ protected:
+  void SetUp() override {
+    GattSrTest::SetUp();
+    tcb_.payload_size = 23;
+
+    el_.s_hdl = 0x0001;
+    el_.e_hdl = 0x0020;
+    el_.p_db = &db_;
+    srv_list_.push_back(el_);
+    gatt_cb.srv_list_info = &srv_list_;
+  }
+
+  void TearDown() override { gatt_cb.srv_list_info = nullptr; }
+
+  void ReadMulti(const std::vector<uint16_t>& handles) {
+    std::vector<uint8_t> pdu;
+    for (uint16_t handle : handles) {
+      pdu.push_back(handle & 0xff);
+      pdu.push_back(handle >> 8);
+    }
+    gatt_process_read_multi_req(tcb_, L2CAP_ATT_CID, GATT_REQ_READ_MULTI,
+                                pdu.size(), pdu.data());
+  }
+
+  /* The application answers the read of |handle| with a 1 byte value */
+  void Respond(uint16_t handle) {
+    tGATTS_RSP rsp;
+    memset(&rsp, 0, sizeof(rsp));
+    rsp.attr_value.handle = handle;
+    rsp.attr_value.len = 1;
+    rsp.attr_value.value[0] = (uint8_t)handle;
+    gatt_sr_process_app_rsp(tcb_, el_.gatt_if, tcb_.sr_cmd.trans_id,
+                            GATT_REQ_READ_MULTI, GATT_SUCCESS, &rsp,
+                            &tcb_.sr_cmd);
+  }
+
+  tGATT_SVC_DB db_;
+  std::list<tGATT_SRV_LIST_ELEM> srv_list_;
+};
+
 /* Server Robust Caching Test */
 class GattSrRobustCachingTest : public ::testing::Test {
  protected:
@@ -565,3 +641,230 @@ TEST_F(GattSrRobustCachingTest,
 
   ASSERT_FALSE(should_ignore);
 }
+
+TEST_F(GattSrReadMultiTest, app_reads_in_flight_are_bounded) {
+  test_state_.gatts_read_attr_value_by_handle.return_status_ = GATT_PENDING;
+  const std::vector<uint16_t> handles = {1, 2, 3, 4, 5, 6};
+  const size_t max_reads = gatt_sr_get_max_app_reads();
+  ASSERT_LT(max_reads, handles.size());
+
+  ReadMulti(handles);
+  auto& reads = test_state_.gatts_read_attr_value_by_handle.handles_;
+  ASSERT_EQ(reads.size(), max_reads);
+  ASSERT_EQ(tcb_.sr_cmd.multi_in_flight, max_reads);
+
+  // Every response lets the next handle be read
+  for (size_t i = 0; i < handles.size(); i++) {
+    ASSERT_EQ(reads.size(), std::min(max_reads + i, handles.size()));
+    ASSERT_EQ(test_state_.attp_send_sr_msg.access_count_, 0);
+    Respond(reads[i]);
+  }
+
+  ASSERT_EQ(reads, handles);
+  ASSERT_EQ(test_state_.attp_send_sr_msg.access_count_, 1);
+  ASSERT_EQ(test_state_.attp_send_sr_msg.data_,
+            std::vector<uint8_t>({GATT_RSP_READ_MULTI, 1, 2, 3, 4, 5, 6}));
+  ASSERT_EQ(tcb_.sr_cmd.op_code, 0);
+}
+
+TEST_F(GattSrReadMultiTest, database_values_complete_without_app) {
+  ReadMulti({1, 2, 3, 4, 5, 6});
+
+  // Values held by the database do not count against the bound
+  ASSERT_EQ(test_state_.gatts_read_attr_value_by_handle.handles_.size(), 6u);
+  ASSERT_EQ(test_state_.attp_send_sr_msg.access_count_, 1);
+  ASSERT_EQ(tcb_.sr_cmd.op_code, 0);
+}
+
+TEST_F(GattSrReadMultiTest, responses_out_of_order_are_sent_in_request_order) {
+  test_state_.gatts_read_attr_value_by_handle.return_status_ = GATT_PENDING;
+  ReadMulti({3, 1, 2});
+
+  Respond(2);
+  Respond(3);
+  ASSERT_EQ(test_state_.attp_send_sr_msg.access_count_, 0);
+  Respond(1);
+
+  ASSERT_EQ(test_state_.attp_send_sr_msg.access_count_, 1);
+  ASSERT_EQ(test_state_.attp_send_sr_msg.data_,
+            std::vector<uint8_t>({GATT_RSP_READ_MULTI, 3, 1, 2}));
+}
+
+TEST_F(GattSrReadMultiTest, repeated_handle_is_answered_for_each_occurrence) {
+  test_state_.gatts_read_attr_value_by_handle.return_status_ = GATT_PENDING;
+  ReadMulti({2, 1, 2});
+
+  Respond(1);
+  Respond(2);
+  Respond(2);
+
+  ASSERT_EQ(test_state_.attp_send_sr_msg.data_,
+            std::vector<uint8_t>({GATT_RSP_READ_MULTI, 2, 1, 2}));
+}
+
+/* Server requests on several bearers of a connection */
+namespace {
+constexpr uint16_t kEattCid = 0x0041;
+}  // namespace
+
+class GattSrEattTest : public GattSrTest {
+ protected:
+  void SetUp() override {
+    GattSrTest::SetUp();
+    tcb_.payload_size = 23;
+    tcb_.eatt = 1;
+
+    EattExtension::GetInstance()->Start();
+    mock_eatt_ = MockEattExtension::GetInstance();
+    channel_ = std::make_unique<EattChannel>(tcb_.peer_bda, kEattCid, 100, 100);
+    ON_CALL(*mock_eatt_, FindEattChannelByCid(::testing::_, kEattCid))
+        .WillByDefault(::testing::Return(channel_.get()));
+  }
+
+  void TearDown() override {
+    channel_.reset();
+    EattExtension::GetInstance()->Stop();
+  }
+
+  /* A read an application has to answer arrives on |cid| */
+  uint32_t AppRead(uint16_t cid, uint16_t handle) {
+    uint32_t trans_id = gatt_sr_enqueue_cmd(tcb_, cid, GATT_REQ_READ, handle);
+    gatt_sr_update_cback_cnt(tcb_, cid, el_.gatt_if, true, true);
+    return trans_id;
+  }
+
+  MockEattExtension* mock_eatt_;
+  std::unique_ptr<EattChannel> channel_;
+};
+
+TEST_F(GattSrEattTest, cback_cnt_is_per_bearer) {
+  AppRead(L2CAP_ATT_CID, 0x0010);
+
+  ASSERT_FALSE(gatt_sr_is_cback_cnt_zero(tcb_, L2CAP_ATT_CID));
+  ASSERT_TRUE(gatt_sr_is_cback_cnt_zero(tcb_, kEattCid));
+
+  AppRead(kEattCid, 0x0011);
+  ASSERT_FALSE(gatt_sr_is_cback_cnt_zero(tcb_, kEattCid));
+}
+
+TEST_F(GattSrEattTest, pending_att_read_does_not_hold_eatt_response) {
+  AppRead(L2CAP_ATT_CID, 0x0010);
+  uint32_t trans_id = AppRead(kEattCid, 0x0011);
+
+  tGATTS_RSP rsp;
+  memset(&rsp, 0, sizeof(rsp));
+  rsp.attr_value.handle = 0x0011;
+  rsp.attr_value.len = 1;
+  gatt_sr_process_app_rsp(tcb_, el_.gatt_if, trans_id, GATT_REQ_READ,
+                          GATT_SUCCESS, &rsp,
+                          &channel_->server_outstanding_cmd_);
+
+  ASSERT_EQ(test_state_.attp_send_sr_msg.access_count_, 1);
+  ASSERT_EQ(test_state_.attp_send_sr_msg.cid_, kEattCid);
+  ASSERT_EQ(test_state_.attp_send_sr_msg.data_[0], GATT_RSP_READ);
+  ASSERT_EQ(channel_->server_outstanding_cmd_.op_code, 0);
+  // The ATT bearer still waits for its application
+  ASSERT_EQ(tcb_.sr_cmd.op_code, GATT_REQ_READ);
+  ASSERT_FALSE(gatt_sr_is_cback_cnt_zero(tcb_, L2CAP_ATT_CID));
+}
+
+TEST_F(GattSrEattTest, exec_write_waits_on_its_own_bearer) {
+  tcb_.prep_cnt[el_.gatt_if - 1] = 1;
+  uint8_t flag = GATT_PREP_WRITE_EXEC;
+  gatt_process_exec_write_req(tcb_, kEattCid, GATT_REQ_EXEC_WRITE, 1, &flag);
+
+  ASSERT_FALSE(gatt_sr_is_cback_cnt_zero(tcb_, kEattCid));
+  ASSERT_TRUE(gatt_sr_is_cback_cnt_zero(tcb_, L2CAP_ATT_CID));
+}
+
+/* Server notification batching */
+class GattSrNotifBatchTest : public GattSrTest {
+ protected:
+  void SetUp() override {
+    GattSrTest::SetUp();
+    batch_tcb_.in_use = true;
+    batch_tcb_.att_lcid = L2CAP_ATT_CID;
+    batch_tcb_.payload_size = GATT_DEF_BLE_MTU_SIZE;
+    batch_tcb_.notif_batch_timer = alarm_new("test.notif_batch_timer");
+  }
+
+  void TearDown() override {
+    alarm_free(batch_tcb_.notif_batch_timer);
+    batch_tcb_.notif_batch_timer = NULL;
+  }
+
+  tGATT_STATUS Notify(uint16_t handle, std::vector<uint8_t> value) {
+    return gatt_sr_batch_notification(batch_tcb_, false, handle, value.size(),
+                                      value.data());
+  }
+
+  tGATT_TCB batch_tcb_{};
+};
+
+TEST_F(GattSrNotifBatchTest, full_batch_is_sent_in_multiple_notification) {
+  test_state_.gatt_sr_is_cl_multi_variable_len_notif_supported.supported_ =
+      true;
+  // Two 11 bytes tuples fill the 22 bytes after the opcode
+  ASSERT_EQ(Notify(0x0010, std::vector<uint8_t>(7, 0xaa)), GATT_SUCCESS);
+  ASSERT_EQ(test_state_.attp_send_sr_msg.access_count_, 0);
+  ASSERT_EQ(Notify(0x0011, std::vector<uint8_t>(7, 0xbb)), GATT_SUCCESS);
+
+  std::vector<uint8_t> expected = {GATT_HANDLE_MULTI_VALUE_NOTIF, 0x10, 0x00,
+                                   0x07, 0x00};
+  expected.insert(expected.end(), 7, 0xaa);
+  expected.insert(expected.end(), {0x11, 0x00, 0x07, 0x00});
+  expected.insert(expected.end(), 7, 0xbb);
+  ASSERT_EQ(test_state_.attp_send_sr_msg.pdus_.size(), 1u);
+  ASSERT_EQ(test_state_.attp_send_sr_msg.pdus_[0], expected);
+  ASSERT_EQ(test_state_.attp_send_sr_msg.cid_, L2CAP_ATT_CID);
+  ASSERT_TRUE(batch_tcb_.notif_batch[false].IsEmpty());
+}
+
+TEST_F(GattSrNotifBatchTest, single_notifications_without_multi_notif) {
+  ASSERT_EQ(Notify(0x0010, {0x01}), GATT_SUCCESS);
+  ASSERT_EQ(Notify(0x0011, {0x02}), GATT_SUCCESS);
+  ASSERT_EQ(test_state_.attp_send_sr_msg.access_count_, 0);
+
+  gatt_sr_notif_batch_timeout(&batch_tcb_);
+
+  ASSERT_EQ(test_state_.attp_send_sr_msg.pdus_.size(), 2u);
+  for (const auto& pdu : test_state_.attp_send_sr_msg.pdus_) {
+    ASSERT_EQ(pdu, std::vector<uint8_t>({GATT_HANDLE_VALUE_NOTIF}));
+  }
+  ASSERT_TRUE(batch_tcb_.notif_batch[false].IsEmpty());
+}
+
+TEST_F(GattSrNotifBatchTest, failed_send_of_full_batch_is_returned) {
+  test_state_.attp_send_sr_msg.return_status_ = GATT_INTERNAL_ERROR;
+  ASSERT_EQ(Notify(0x0010, std::vector<uint8_t>(GATT_DEF_BLE_MTU_SIZE, 0xaa)),
+            GATT_INTERNAL_ERROR);
+  ASSERT_EQ(test_state_.attp_send_sr_msg.access_count_, 1);
+  ASSERT_TRUE(batch_tcb_.notif_batch[false].IsEmpty());
+}
+
+TEST_F(GattSrNotifBatchTest, congested_send_is_not_a_failure) {
+  test_state_.attp_send_sr_msg.return_status_ = GATT_CONGESTED;
+  ASSERT_EQ(Notify(0x0010, std::vector<uint8_t>(GATT_DEF_BLE_MTU_SIZE, 0xaa)),
+            GATT_SUCCESS);
+}
+
+TEST_F(GattSrNotifBatchTest, batch_is_dropped_without_bearer) {
+  batch_tcb_.payload_size = 0;
+  ASSERT_EQ(Notify(0x0010, {0x01}), GATT_WRONG_STATE);
+  ASSERT_EQ(test_state_.attp_send_sr_msg.access_count_, 0);
+  ASSERT_TRUE(batch_tcb_.notif_batch[false].IsEmpty());
+}
+
+TEST_F(GattSrNotifBatchTest, failed_send_at_window_end_empties_batch) {
+  test_state_.attp_send_sr_msg.return_status_ = GATT_INTERNAL_ERROR;
+  ASSERT_EQ(Notify(0x0010, {0x01}), GATT_SUCCESS);
+
+  gatt_sr_notif_batch_timeout(&batch_tcb_);
+
+  ASSERT_EQ(test_state_.attp_send_sr_msg.access_count_, 1);
+  ASSERT_TRUE(batch_tcb_.notif_batch[false].IsEmpty());
+  // Nothing is left to send on the next notification
+  test_state_.attp_send_sr_msg.return_status_ = GATT_SUCCESS;
+  gatt_sr_flush_notif_batch(batch_tcb_);
+  ASSERT_EQ(test_state_.attp_send_sr_msg.access_count_, 1);
+}
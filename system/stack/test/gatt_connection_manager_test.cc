@@ -5,17 +5,24 @@
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
 
+#include <cstdio>
 #include <memory>
+#include <set>
+#include <string>
 
 #include "common/init_flags.h"
 #include "osi/include/alarm.h"
 #include "osi/test/alarm_mock.h"
 #include "stack/gatt/connection_manager.h"
+#include "stack/include/bt_device_type.h"
+#include "stack/include/btm_ble_api.h"
 #include "stack/test/common/mock_btm_api_layer.h"
 
 using testing::_;
 using testing::DoAll;
+using testing::Invoke;
 using testing::Mock;
+using testing::NiceMock;
 using testing::Return;
 using testing::SaveArg;
 
@@ -43,6 +50,43 @@ class AcceptlistMock {
 };
 
 std::unique_ptr<AcceptlistMock> localAcceptlistMock;
+
+// Controller accept list of limited capacity, for background connection
+// scheduling tests
+class FakeAcceptList {
+ public:
+  explicit FakeAcceptList(size_t capacity) : capacity_(capacity) {
+    EXPECT_CALL(*localAcceptlistMock, AcceptlistAdd(_))
+        .WillRepeatedly(
+            Invoke([this](const RawAddress& address) { return Add(address); }));
+    EXPECT_CALL(*localAcceptlistMock, AcceptlistAdd(_, _))
+        .WillRepeatedly(Invoke(
+            [this](const RawAddress& address, bool) { return Add(address); }));
+    EXPECT_CALL(*localAcceptlistMock, AcceptlistRemove(_))
+        .WillRepeatedly(Invoke(
+            [this](const RawAddress& address) { entries.erase(address); }));
+  }
+
+  bool Add(const RawAddress& address) {
+    if (entries.count(address) == 0 && entries.size() == capacity_) {
+      return false;
+    }
+    entries.insert(address);
+    ever_added.insert(address);
+    return true;
+  }
+
+  std::set<RawAddress> entries;
+  std::set<RawAddress> ever_added;
+
+ private:
+  size_t capacity_;
+};
+
+RawAddress make_target_address(size_t i) {
+  return RawAddress{{0xc0, 0xde, 0x00, 0x00, static_cast<uint8_t>(i >> 8),
+                     static_cast<uint8_t>(i)}};
+}
 }  // namespace
 
 RawAddress address1{{0x01, 0x01, 0x01, 0x01, 0x01, 0x01}};
@@ -85,22 +129,60 @@ void set_target_announcements_filter(bool enable) {}
 bool L2CA_ConnectFixedChnl(uint16_t fixed_cid, const RawAddress& bd_addr) {
   return false;
 }
-uint16_t BTM_GetHCIConnHandle(RawAddress const&, unsigned char) {
-  return 0xFFFF;
+std::set<RawAddress> connected_devices;
+uint16_t BTM_GetHCIConnHandle(RawAddress const& address, unsigned char) {
+  return connected_devices.count(address) ? 0x0001 : 0xFFFF;
 };
 
+// Bonded devices, and the ones among them that are LE only
+std::set<RawAddress> bonded_devices;
+std::set<RawAddress> le_only_devices;
+void BTM_ReadDevInfo(const RawAddress& address, tBT_DEVICE_TYPE* p_dev_type,
+                     tBLE_ADDR_TYPE* p_addr_type) {
+  *p_dev_type = le_only_devices.count(address) ? BT_DEVICE_TYPE_BLE
+                                               : BT_DEVICE_TYPE_DUMO;
+  *p_addr_type = BLE_ADDR_PUBLIC;
+}
+
 namespace connection_manager {
 class BleConnectionManager : public testing::Test {
+ protected:
   void SetUp() override {
     bluetooth::common::InitFlags::Load(test_flags);
     localAcceptlistMock = std::make_unique<AcceptlistMock>();
+    bluetooth::manager::SetMockBtmApiInterface(&btm_api_interface_);
+    ON_CALL(btm_api_interface_, IsLinkKeyKnown(_, _))
+        .WillByDefault(Invoke([](const RawAddress& address, tBT_TRANSPORT) {
+          return bonded_devices.count(address) != 0;
+        }));
   }
 
   void TearDown() override {
     connection_manager::reset(true);
+    connected_devices.clear();
+    bonded_devices.clear();
+    le_only_devices.clear();
     AlarmMock::Reset();
     localAcceptlistMock.reset();
+    bluetooth::manager::SetMockBtmApiInterface(nullptr);
+  }
+
+  // Returns what dump() prints
+  std::string Dump() {
+    FILE* file = tmpfile();
+    dump(fileno(file));
+    std::string out;
+    rewind(file);
+    char buf[256];
+    size_t len;
+    while ((len = fread(buf, 1, sizeof(buf), file)) > 0) {
+      out.append(buf, len);
+    }
+    fclose(file);
+    return out;
   }
+
+  NiceMock<bluetooth::manager::MockBtmApiInterface> btm_api_interface_;
 };
 
 void on_connection_timed_out(uint8_t app_id, const RawAddress& address) {
@@ -390,4 +472,211 @@ TEST_F(BleConnectionManager,
   Mock::VerifyAndClearExpectations(localAcceptlistMock.get());
 }
 
+/** Verify that background connection targets that do not fit in the accept
+ * list take turns in it, and that all of them get one. */
+TEST_F(BleConnectionManager, test_background_connection_rotation) {
+  constexpr size_t kTargets = 500;
+  constexpr size_t kCapacity = 16;
+  FakeAcceptList accept_list(kCapacity);
+
+  uint64_t rotation_period_ms = 0;
+  alarm_callback_t rotation_callback = nullptr;
+  void* rotation_data = nullptr;
+  EXPECT_CALL(*AlarmMock::Get(), AlarmNew(_)).Times(1);
+  EXPECT_CALL(*AlarmMock::Get(), AlarmSetOnMloop(_, _, _, _))
+      .WillRepeatedly(DoAll(SaveArg<1>(&rotation_period_ms),
+                            SaveArg<2>(&rotation_callback),
+                            SaveArg<3>(&rotation_data)));
+
+  // Bonded dual mode devices, of normal priority
+  for (size_t i = 0; i < kTargets; i++) {
+    bonded_devices.insert(make_target_address(i));
+    EXPECT_TRUE(background_connect_add(CLIENT1, make_target_address(i)));
+  }
+  EXPECT_EQ(accept_list.entries.size(), kCapacity);
+  ASSERT_NE(rotation_callback, nullptr);
+
+  // Every target gets its turn in ceil(500 / 16) = 32 rounds, counting the
+  // first targets added
+  constexpr size_t kRounds = (kTargets + kCapacity - 1) / kCapacity;
+  size_t rounds = 1;
+  while (accept_list.ever_added.size() < kTargets) {
+    ASSERT_LT(rounds, kRounds);
+    rotation_callback(rotation_data);
+    rounds++;
+    EXPECT_EQ(accept_list.entries.size(), kCapacity);
+    // 32 rounds do not fit in the 30 seconds latency target at the minimum
+    // rotation period
+    EXPECT_EQ(rotation_period_ms, 2000u);
+  }
+  EXPECT_EQ(rounds, kRounds);
+  EXPECT_NE(Dump().find("latency target missed"), std::string::npos);
+
+  for (size_t i = 0; i < kTargets; i++) {
+    EXPECT_EQ(get_apps_connecting_to(make_target_address(i)).size(), 1UL);
+  }
+}
+
+/** Verify that the background connection targets seen most recently get in
+ * the accept list first. */
+TEST_F(BleConnectionManager, test_background_connection_rotation_recently_seen) {
+  constexpr size_t kTargets = 10;
+  constexpr size_t kCapacity = 4;
+  FakeAcceptList accept_list(kCapacity);
+
+  alarm_callback_t rotation_callback = nullptr;
+  void* rotation_data = nullptr;
+  EXPECT_CALL(*AlarmMock::Get(), AlarmSetOnMloop(_, _, _, _))
+      .WillRepeatedly(DoAll(SaveArg<2>(&rotation_callback),
+                            SaveArg<3>(&rotation_data)));
+
+  for (size_t i = 0; i < kTargets; i++) {
+    EXPECT_TRUE(background_connect_add(CLIENT1, make_target_address(i)));
+  }
+  ASSERT_NE(rotation_callback, nullptr);
+
+  // The last one to wait for the accept list connected before
+  RawAddress seen = make_target_address(kTargets - 1);
+  ASSERT_EQ(accept_list.entries.count(seen), 0UL);
+  on_connection_complete(seen);
+
+  rotation_callback(rotation_data);
+  EXPECT_EQ(accept_list.entries.size(), kCapacity);
+  EXPECT_EQ(accept_list.entries.count(seen), 1UL);
+}
+
+/** Verify that bonded LE only background connection targets get in the
+ * accept list first and stay in it, while the others take turns in what is
+ * left, within the latency target of the priority they wait with. */
+TEST_F(BleConnectionManager, test_background_connection_rotation_priority) {
+  constexpr size_t kCapacity = 4;
+  constexpr size_t kHighTargets = 2;
+  constexpr size_t kLowTargets = 10;
+  FakeAcceptList accept_list(kCapacity);
+
+  uint64_t rotation_period_ms = 0;
+  alarm_callback_t rotation_callback = nullptr;
+  void* rotation_data = nullptr;
+  EXPECT_CALL(*AlarmMock::Get(), AlarmSetOnMloop(_, _, _, _))
+      .WillRepeatedly(DoAll(SaveArg<1>(&rotation_period_ms),
+                            SaveArg<2>(&rotation_callback),
+                            SaveArg<3>(&rotation_data)));
+
+  // Unbonded devices fill the accept list
+  size_t next = 0;
+  for (; next < kCapacity; next++) {
+    EXPECT_TRUE(background_connect_add(CLIENT1, make_target_address(next)));
+  }
+  EXPECT_EQ(rotation_callback, nullptr);
+
+  // A bonded LE only device has to wait, and ceil(5 / 4) = 2 rounds go in
+  // its 10 seconds latency target
+  std::set<RawAddress> high;
+  for (size_t i = 0; i < kHighTargets; i++, next++) {
+    RawAddress address = make_target_address(next);
+    bonded_devices.insert(address);
+    le_only_devices.insert(address);
+    high.insert(address);
+    EXPECT_TRUE(background_connect_add(CLIENT1, address));
+  }
+  ASSERT_NE(rotation_callback, nullptr);
+  EXPECT_EQ(rotation_period_ms, 5000u);
+
+  for (; next < kLowTargets + kHighTargets; next++) {
+    EXPECT_TRUE(background_connect_add(CLIENT1, make_target_address(next)));
+  }
+
+  // The high priority devices get in at the next rotation, and stay in the
+  // accept list while the low priority ones take turns in what is left
+  for (size_t round = 0; round < 5; round++) {
+    rotation_callback(rotation_data);
+    EXPECT_EQ(accept_list.entries.size(), kCapacity);
+    for (const RawAddress& address : high) {
+      EXPECT_EQ(accept_list.entries.count(address), 1UL);
+    }
+    // Only low priority devices wait, ceil(12 / 4) = 3 rounds in 120 seconds
+    EXPECT_EQ(rotation_period_ms, 40000u);
+  }
+  EXPECT_EQ(accept_list.ever_added.size(), kLowTargets + kHighTargets);
+}
+
+/** Verify that background connection latency is reported per priority. */
+TEST_F(BleConnectionManager, test_background_connection_latency_per_priority) {
+  FakeAcceptList accept_list(8);
+
+  RawAddress low = make_target_address(0);
+  RawAddress normal = make_target_address(1);
+  RawAddress high = make_target_address(2);
+  bonded_devices = {normal, high};
+  le_only_devices = {high};
+
+  EXPECT_TRUE(background_connect_add(CLIENT1, low));
+  EXPECT_TRUE(background_connect_add(CLIENT1, normal));
+  EXPECT_TRUE(background_connect_add(CLIENT1, high));
+
+  std::string dump = Dump();
+  EXPECT_NE(dump.find("low priority: 0 /"), std::string::npos);
+  EXPECT_NE(dump.find("normal priority: 0 /"), std::string::npos);
+  EXPECT_NE(dump.find("high priority: 0 /"), std::string::npos);
+  EXPECT_NE(dump.find("background connection priority: high"),
+            std::string::npos);
+
+  on_connection_complete(high);
+  on_connection_complete(high);
+  on_connection_complete(low);
+
+  // A connection counts once, until the device waits again
+  dump = Dump();
+  EXPECT_NE(dump.find("low priority: 1 /"), std::string::npos);
+  EXPECT_NE(dump.find("normal priority: 0 /"), std::string::npos);
+  EXPECT_NE(dump.find("high priority: 1 /"), std::string::npos);
+  EXPECT_EQ(dump.find("latency target missed"), std::string::npos);
+}
+
+/** Verify that direct connections, removals and completed connections make
+ * room in the full accept list for waiting background connection targets. */
+TEST_F(BleConnectionManager, test_background_connection_accept_list_full) {
+  constexpr size_t kTargets = 10;
+  constexpr size_t kCapacity = 4;
+  FakeAcceptList accept_list(kCapacity);
+
+  alarm_callback_t rotation_callback = nullptr;
+  void* rotation_data = nullptr;
+  EXPECT_CALL(*AlarmMock::Get(), AlarmSetOnMloop(_, _, _, _))
+      .WillOnce(DoAll(SaveArg<2>(&rotation_callback),
+                      SaveArg<3>(&rotation_data)));
+
+  for (size_t i = 0; i < kTargets; i++) {
+    EXPECT_TRUE(background_connect_add(CLIENT1, make_target_address(i)));
+  }
+  EXPECT_EQ(accept_list.ever_added.size(), kCapacity);
+  ASSERT_NE(rotation_callback, nullptr);
+  Mock::VerifyAndClearExpectations(AlarmMock::Get());
+
+  // A direct connection takes the entry of a background connection
+  EXPECT_TRUE(direct_connect_add(CLIENT2, address1));
+  EXPECT_EQ(accept_list.entries.count(address1), 1UL);
+  EXPECT_EQ(accept_list.entries.size(), kCapacity);
+
+  // and gives it back once done
+  on_connection_complete(address1);
+  EXPECT_EQ(accept_list.entries.count(address1), 0UL);
+  EXPECT_EQ(accept_list.entries.size(), kCapacity);
+  EXPECT_EQ(accept_list.ever_added.size(), kCapacity + 2);
+
+  // A removed background connection target makes room for a waiting one
+  RawAddress removed = *accept_list.entries.begin();
+  EXPECT_TRUE(background_connect_remove(CLIENT1, removed));
+  EXPECT_EQ(accept_list.entries.size(), kCapacity);
+  EXPECT_EQ(accept_list.ever_added.size(), kCapacity + 3);
+
+  // and so does a connected one, at the next rotation
+  RawAddress connected = *accept_list.entries.begin();
+  on_connection_complete(connected);
+  connected_devices.insert(connected);
+  rotation_callback(rotation_data);
+  EXPECT_EQ(accept_list.entries.count(connected), 0UL);
+  EXPECT_EQ(accept_list.entries.size(), kCapacity);
+}
+
 }  // namespace connection_manager
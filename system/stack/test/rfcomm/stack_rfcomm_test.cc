@@ -20,15 +20,20 @@
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
 
+#include <string>
+#include <vector>
+
 #include "internal_include/bt_target.h"
 #include "mock_btm_layer.h"
 #include "mock_l2cap_layer.h"
 #include "osi/include/allocator.h"
+#include "osi/include/fixed_queue.h"
 #include "stack/include/bt_hdr.h"
 #include "stack/include/bt_psm_types.h"
 #include "stack/include/l2c_api.h"
 #include "stack/include/port_api.h"
 #include "stack/include/rfcdefs.h"
+#include "stack/rfcomm/rfc_int.h"
 #include "stack_rfcomm_test_utils.h"
 #include "stack_test_packet_utils.h"
 #include "types/raw_address.h"
@@ -62,6 +67,7 @@ namespace {
 
 using testing::_;
 using testing::DoAll;
+using testing::Invoke;
 using testing::Return;
 using testing::Test;
 using testing::StrictMock;
@@ -495,6 +501,163 @@ TEST_F(StackRfcommTest, DISABLED_SingleServerConnectionHelloWorld) {
                                         "\r!dlroW olleH", 4, acl_handle, lcid));
 }
 
+TEST_F(StackRfcommTest, BulkWriteFillsFramesUpToPeerMtu) {
+  static const uint16_t lcid = 0x0054;
+  static const uint8_t dlci = 0x10;
+  static const uint16_t port_handle = 1;
+  static const uint16_t test_mtu = 1000;
+  static const uint16_t test_payload_size = 16 * 1024;
+  static const uint16_t test_frame_count =
+      (test_payload_size + test_mtu - 1) / test_mtu;
+  tRFC_MCB mcb = {};
+  mcb.lcid = lcid;
+  mcb.flow = PORT_FC_CREDIT;
+  mcb.peer_ready = true;
+  mcb.peer_l2cap_mtu = test_mtu;
+  mcb.port_handles[dlci] = port_handle;
+  tPORT& port = rfc_cb.port.port[port_handle - 1];
+  port.in_use = true;
+  port.handle = port_handle;
+  port.state = PORT_CONNECTION_STATE_OPENED;
+  port.dlci = dlci;
+  port.peer_mtu = test_mtu;
+  port.port_ctrl = PORT_CTRL_REQ_SENT | PORT_CTRL_IND_RECEIVED;
+  port.rfc.p_mcb = &mcb;
+  port.rfc.state = RFC_STATE_OPENED;
+  port.credit_tx = test_frame_count;
+  port.credit_rx = RFCOMM_K_MAX;
+  port.credit_rx_max = RFCOMM_K_MAX;
+  port.tx.queue = fixed_queue_new(SIZE_MAX);
+
+  std::string payload(test_payload_size, '\0');
+  for (size_t i = 0; i < payload.size(); ++i) {
+    payload[i] = static_cast<char>(i * 31);
+  }
+
+  // Strip the RFCOMM header and FCS from the outgoing UIH frames so the
+  // payload can be compared at the end
+  std::string received;
+  std::vector<uint16_t> frame_lengths;
+  EXPECT_CALL(l2cap_interface_, DataWrite(lcid, _))
+      .WillRepeatedly(Invoke([&](uint16_t cid, BT_HDR* p_buf) {
+        uint8_t* p = p_buf->data + p_buf->offset;
+        uint8_t control = p[1];
+        uint16_t len = p[2] >> 1;
+        size_t header_len = 3;
+        if (!(p[2] & RFCOMM_EA)) {
+          len |= p[3] << RFCOMM_SHIFT_LENGTH2;
+          header_len++;
+        }
+        if (control & RFCOMM_PF) header_len++;
+        EXPECT_EQ(p_buf->len, header_len + len + 1);
+        received.append(reinterpret_cast<char*>(p + header_len), len);
+        frame_lengths.push_back(len);
+        osi_free(p_buf);
+        return L2CAP_DW_SUCCESS;
+      }));
+
+  // The peer has credits for the whole payload, every frame but the last one
+  // goes out filled up to the MTU
+  uint16_t transmitted_length = 0;
+  ASSERT_EQ(PORT_WriteData(port_handle, payload.data(), test_payload_size,
+                           &transmitted_length),
+            PORT_SUCCESS);
+  ASSERT_EQ(transmitted_length, test_payload_size);
+  ASSERT_EQ(received, payload);
+  ASSERT_EQ(frame_lengths.size(), test_frame_count);
+  for (size_t i = 0; i + 1 < frame_lengths.size(); ++i) {
+    ASSERT_EQ(frame_lengths[i], test_mtu);
+  }
+  ASSERT_EQ(frame_lengths.back(),
+            test_payload_size - (test_frame_count - 1) * test_mtu);
+  ASSERT_TRUE(port.tx.peer_fc);
+
+  // Out of credits, small writes are queued and topped up to the MTU rather
+  // than each starting a frame of its own
+  static const uint16_t test_chunk_size = 310;
+  static const uint16_t test_chunk_count = 10;
+  for (uint16_t i = 0; i < test_chunk_count; ++i) {
+    ASSERT_EQ(PORT_WriteData(port_handle, payload.data() + i * test_chunk_size,
+                             test_chunk_size, &transmitted_length),
+              PORT_SUCCESS);
+    ASSERT_EQ(transmitted_length, test_chunk_size);
+  }
+  ASSERT_EQ(port.tx.queue_size, test_chunk_size * test_chunk_count);
+  ASSERT_EQ(fixed_queue_length(port.tx.queue), 4u);
+  std::string queued;
+  while (!fixed_queue_is_empty(port.tx.queue)) {
+    BT_HDR* p_buf = (BT_HDR*)fixed_queue_dequeue(port.tx.queue);
+    EXPECT_EQ(p_buf->len, fixed_queue_is_empty(port.tx.queue)
+                              ? test_chunk_size * test_chunk_count % test_mtu
+                              : test_mtu);
+    queued.append(reinterpret_cast<char*>(p_buf->data + p_buf->offset),
+                  p_buf->len);
+    osi_free(p_buf);
+  }
+  ASSERT_EQ(queued, payload.substr(0, test_chunk_size * test_chunk_count));
+
+  fixed_queue_free(port.tx.queue, nullptr);
+  port = {};
+}
+
+TEST_F(StackRfcommTest, CreditsPiggybackedOnFramesThatFitPeerL2capMtu) {
+  static const uint16_t lcid = 0x0054;
+  static const uint8_t dlci = 0x10;
+  static const uint16_t l2cap_mtu = 672;
+  tRFC_MCB mcb = {};
+  mcb.lcid = lcid;
+  mcb.flow = PORT_FC_CREDIT;
+  mcb.peer_l2cap_mtu = l2cap_mtu - RFCOMM_MIN_OFFSET - 1;
+  tPORT port = {};
+  port.dlci = dlci;
+  port.peer_mtu = mcb.peer_l2cap_mtu;
+  port.rfc.p_mcb = &mcb;
+  port.rfc.state = RFC_STATE_OPENED;
+  port.credit_tx = RFCOMM_K_MAX;
+  port.credit_rx_max = RFCOMM_K_MAX;
+
+  std::vector<uint16_t> frame_lengths;
+  std::vector<uint8_t> frame_credits;
+  EXPECT_CALL(l2cap_interface_, DataWrite(lcid, _))
+      .WillRepeatedly(Invoke([&](uint16_t cid, BT_HDR* p_buf) {
+        uint8_t* p = p_buf->data + p_buf->offset;
+        size_t header_len = (p[2] & RFCOMM_EA) ? 3 : 4;
+        frame_credits.push_back((p[1] & RFCOMM_PF) ? p[header_len] : 0);
+        frame_lengths.push_back(p_buf->len);
+        osi_free(p_buf);
+        return L2CAP_DW_SUCCESS;
+      }));
+  auto send_frame = [&](uint16_t len) {
+    BT_HDR* p_buf = (BT_HDR*)osi_calloc(sizeof(BT_HDR) + L2CAP_MIN_OFFSET +
+                                        RFCOMM_MIN_OFFSET + len + 1);
+    p_buf->offset = L2CAP_MIN_OFFSET + RFCOMM_MIN_OFFSET;
+    p_buf->len = len;
+    rfc_port_sm_execute(&port, RFC_PORT_EVENT_DATA, p_buf);
+  };
+
+  // A full size frame carries the credits and still fits the L2CAP MTU
+  port.credit_rx = RFCOMM_K_MAX - 3;
+  send_frame(mcb.peer_l2cap_mtu);
+  ASSERT_EQ(frame_credits.size(), 1u);
+  EXPECT_EQ(frame_credits[0], 3);
+  EXPECT_EQ(frame_lengths[0], l2cap_mtu);
+  EXPECT_EQ(port.credit_rx, RFCOMM_K_MAX);
+
+  // Nothing to hand back, no credit octet
+  send_frame(10);
+  ASSERT_EQ(frame_credits.size(), 2u);
+  EXPECT_EQ(frame_credits[1], 0);
+
+  // A frame one octet short of the MTU carries the credits as well
+  port.credit_rx = RFCOMM_K_MAX - 2;
+  send_frame(mcb.peer_l2cap_mtu - 1);
+  ASSERT_EQ(frame_credits.size(), 3u);
+  EXPECT_EQ(frame_credits[2], 2);
+  EXPECT_EQ(frame_lengths[2], l2cap_mtu - 1);
+  EXPECT_EQ(port.credit_rx, RFCOMM_K_MAX);
+  EXPECT_EQ(port.credit_tx, RFCOMM_K_MAX - 3);
+}
+
 TEST_F(StackRfcommTest, DISABLED_MultiServerPortSameDeviceHelloWorld) {
   // Prepare a server channel at kTestChannelNumber0
   static const uint16_t acl_handle = 0x0009;
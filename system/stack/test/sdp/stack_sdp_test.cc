@@ -18,7 +18,10 @@
 #include <gtest/gtest.h>
 #include <stdlib.h>
 
+#include <algorithm>
 #include <cstddef>
+#include <string>
+#include <vector>
 
 #include "osi/include/allocator.h"
 #include "stack/include/bt_uuid16.h"
@@ -32,6 +35,8 @@
 #define BT_DEFAULT_BUFFER_SIZE (4096 + 16)
 #endif
 
+using bluetooth::Uuid;
+
 static int L2CA_ConnectReq2_cid = 0x42;
 static RawAddress addr = RawAddress({0xA1, 0xA2, 0xA3, 0xA4, 0xA5, 0xA6});
 static tSDP_DISCOVERY_DB* sdp_db = nullptr;
@@ -265,6 +270,390 @@ TEST_F(StackSdpMainTest, sdp_status_text) {
                    .c_str());
 }
 
+class StackSdpDbTest : public StackSdpMainTest {
+ protected:
+  void SetUp() override {
+    StackSdpMainTest::SetUp();
+    SDP_DeleteRecord(0);
+  }
+
+  void TearDown() override {
+    SDP_DeleteRecord(0);
+    StackSdpMainTest::TearDown();
+  }
+
+  uint32_t CreateSerialPortRecord(uint16_t service_uuid, uint8_t scn) {
+    uint32_t handle = SDP_CreateRecord();
+    EXPECT_NE(handle, 0u);
+    EXPECT_TRUE(SDP_AddServiceClassIdList(handle, 1, &service_uuid));
+    tSDP_PROTOCOL_ELEM proto_list[2] = {};
+    proto_list[0].protocol_uuid = UUID_PROTOCOL_L2CAP;
+    proto_list[1].protocol_uuid = UUID_PROTOCOL_RFCOMM;
+    proto_list[1].num_params = 1;
+    proto_list[1].params[0] = scn;
+    EXPECT_TRUE(SDP_AddProtocolList(handle, 2, proto_list));
+    return handle;
+  }
+
+  static void AddUuid16(tSDP_UUID_SEQ* p_seq, uint16_t uuid) {
+    tUID_ENT* p_entry = &p_seq->uuid_entry[p_seq->num_uids++];
+    p_entry->len = Uuid::kNumBytes16;
+    p_entry->value[0] = uuid >> 8;
+    p_entry->value[1] = uuid & 0xff;
+  }
+
+  static void AddUuid128(tSDP_UUID_SEQ* p_seq, uint16_t uuid) {
+    tUID_ENT* p_entry = &p_seq->uuid_entry[p_seq->num_uids++];
+    p_entry->len = Uuid::kNumBytes128;
+    memcpy(p_entry->value, Uuid::From16Bit(uuid).To128BitBE().data(),
+           Uuid::kNumBytes128);
+  }
+};
+
+TEST_F(StackSdpDbTest, service_search_matches_uuids_of_any_size) {
+  uint32_t spp_handle = CreateSerialPortRecord(UUID_SERVCLASS_SERIAL_PORT, 3);
+  uint32_t hfp_handle = CreateSerialPortRecord(UUID_SERVCLASS_HF_HANDSFREE, 4);
+
+  tSDP_UUID_SEQ seq{};
+  AddUuid128(&seq, UUID_SERVCLASS_SERIAL_PORT);
+  AddUuid16(&seq, UUID_PROTOCOL_RFCOMM);
+  const tSDP_RECORD* p_rec = sdp_db_service_search(nullptr, &seq);
+  ASSERT_NE(p_rec, nullptr);
+  ASSERT_EQ(p_rec->record_handle, spp_handle);
+  ASSERT_EQ(sdp_db_service_search(p_rec, &seq), nullptr);
+
+  seq = {};
+  AddUuid16(&seq, UUID_PROTOCOL_L2CAP);
+  p_rec = sdp_db_service_search(nullptr, &seq);
+  ASSERT_NE(p_rec, nullptr);
+  ASSERT_EQ(p_rec->record_handle, spp_handle);
+  p_rec = sdp_db_service_search(p_rec, &seq);
+  ASSERT_NE(p_rec, nullptr);
+  ASSERT_EQ(p_rec->record_handle, hfp_handle);
+
+  seq = {};
+  AddUuid16(&seq, UUID_SERVCLASS_AUDIO_SOURCE);
+  ASSERT_EQ(sdp_db_service_search(nullptr, &seq), nullptr);
+}
+
+TEST_F(StackSdpDbTest, service_search_follows_attribute_changes) {
+  uint32_t handle = CreateSerialPortRecord(UUID_SERVCLASS_SERIAL_PORT, 3);
+  tSDP_RECORD* p_rec = sdp_db_find_record(handle);
+  ASSERT_NE(p_rec, nullptr);
+
+  tSDP_UUID_SEQ seq{};
+  AddUuid16(&seq, UUID_SERVCLASS_SERIAL_PORT);
+  ASSERT_EQ(sdp_db_service_search(nullptr, &seq), p_rec);
+
+  ASSERT_TRUE(
+      SDP_DeleteAttributeFromRecord(p_rec, ATTR_ID_SERVICE_CLASS_ID_LIST));
+  ASSERT_EQ(sdp_db_service_search(nullptr, &seq), nullptr);
+
+  uint16_t service_uuid = UUID_SERVCLASS_SERIAL_PORT;
+  ASSERT_TRUE(SDP_AddServiceClassIdList(handle, 1, &service_uuid));
+  ASSERT_EQ(sdp_db_service_search(nullptr, &seq), p_rec);
+}
+
+TEST_F(StackSdpDbTest, find_attr_in_rec) {
+  uint32_t handle = CreateSerialPortRecord(UUID_SERVCLASS_SERIAL_PORT, 3);
+  tSDP_RECORD* p_rec = sdp_db_find_record(handle);
+  ASSERT_NE(p_rec, nullptr);
+
+  const tSDP_ATTRIBUTE* p_attr = sdp_db_find_attr_in_rec(p_rec, 0, 0xffff);
+  ASSERT_NE(p_attr, nullptr);
+  ASSERT_EQ(p_attr->id, ATTR_ID_SERVICE_RECORD_HDL);
+
+  p_attr = sdp_db_find_attr_in_rec(p_rec, ATTR_ID_SERVICE_RECORD_HDL + 1,
+                                   0xffff);
+  ASSERT_NE(p_attr, nullptr);
+  ASSERT_EQ(p_attr->id, ATTR_ID_SERVICE_CLASS_ID_LIST);
+
+  p_attr = sdp_db_find_attr_in_rec(p_rec, ATTR_ID_PROTOCOL_DESC_LIST,
+                                   ATTR_ID_PROTOCOL_DESC_LIST);
+  ASSERT_NE(p_attr, nullptr);
+  ASSERT_EQ(p_attr->id, ATTR_ID_PROTOCOL_DESC_LIST);
+
+  ASSERT_EQ(sdp_db_find_attr_in_rec(p_rec, ATTR_ID_PROTOCOL_DESC_LIST + 1,
+                                    0xffff),
+            nullptr);
+}
+
+TEST_F(StackSdpDbTest, service_search_parses_records_with_too_many_uuids) {
+  constexpr uint16_t kNumServices = SDP_MAX_REC_UUIDS + 6;
+  uint32_t handle = CreateSerialPortRecord(UUID_SERVCLASS_SERIAL_PORT, 3);
+  tSDP_RECORD* p_rec = sdp_db_find_record(handle);
+  ASSERT_NE(p_rec, nullptr);
+  ASSERT_FALSE(p_rec->uuid_index_overflow);
+
+  uint16_t service_uuids[kNumServices];
+  for (uint16_t i = 0; i < kNumServices; i++) {
+    service_uuids[i] = 0x1100 + i;
+  }
+  ASSERT_TRUE(SDP_DeleteAttributeFromRecord(p_rec,
+                                            ATTR_ID_SERVICE_CLASS_ID_LIST));
+  ASSERT_TRUE(SDP_AddServiceClassIdList(handle, kNumServices, service_uuids));
+  ASSERT_TRUE(p_rec->uuid_index_overflow);
+
+  // UUIDs that did not fit in the index are still found
+  tSDP_UUID_SEQ seq{};
+  AddUuid128(&seq, service_uuids[kNumServices - 1]);
+  AddUuid16(&seq, UUID_PROTOCOL_RFCOMM);
+  ASSERT_EQ(sdp_db_service_search(nullptr, &seq), p_rec);
+
+  seq = {};
+  AddUuid16(&seq, 0x1100 + kNumServices);
+  ASSERT_EQ(sdp_db_service_search(nullptr, &seq), nullptr);
+
+  // Back under the limit, the record is searched through its index again
+  ASSERT_TRUE(SDP_DeleteAttributeFromRecord(p_rec,
+                                            ATTR_ID_SERVICE_CLASS_ID_LIST));
+  ASSERT_FALSE(p_rec->uuid_index_overflow);
+  seq = {};
+  AddUuid128(&seq, UUID_PROTOCOL_RFCOMM);
+  ASSERT_EQ(sdp_db_service_search(nullptr, &seq), p_rec);
+  seq = {};
+  AddUuid16(&seq, service_uuids[kNumServices - 1]);
+  ASSERT_EQ(sdp_db_service_search(nullptr, &seq), nullptr);
+}
+
+class StackSdpDiscoveryTest : public StackSdpMainTest {
+ protected:
+  static constexpr uint16_t kTextAttrId = 0x0100;
+  static constexpr size_t kTextLen = 200;
+
+  // Builds a search attribute response list of |num_records| records, each
+  // holding a record handle, a service class list and a long text attribute.
+  static std::vector<uint8_t> BuildAttrLists(int num_records) {
+    std::vector<uint8_t> records;
+    for (int i = 0; i < num_records; i++) {
+      const uint8_t rec_len = 8 + 8 + 5 + kTextLen;
+      const uint16_t uuid = UUID_SERVCLASS_SERIAL_PORT + i;
+      const uint8_t rec[] = {
+          (DATA_ELE_SEQ_DESC_TYPE << 3) | SIZE_IN_NEXT_BYTE, rec_len,
+          (UINT_DESC_TYPE << 3) | SIZE_TWO_BYTES, 0x00, 0x00,
+          (UINT_DESC_TYPE << 3) | SIZE_FOUR_BYTES, 0x00, 0x01, 0x00,
+          static_cast<uint8_t>(i),
+          (UINT_DESC_TYPE << 3) | SIZE_TWO_BYTES, 0x00, 0x01,
+          (DATA_ELE_SEQ_DESC_TYPE << 3) | SIZE_IN_NEXT_BYTE, 3,
+          (UUID_DESC_TYPE << 3) | SIZE_TWO_BYTES,
+          static_cast<uint8_t>(uuid >> 8), static_cast<uint8_t>(uuid),
+          (UINT_DESC_TYPE << 3) | SIZE_TWO_BYTES, kTextAttrId >> 8,
+          kTextAttrId & 0xff, (TEXT_STR_DESC_TYPE << 3) | SIZE_IN_NEXT_BYTE,
+          kTextLen};
+      records.insert(records.end(), rec, rec + sizeof(rec));
+      records.insert(records.end(), kTextLen, 'a' + i % 26);
+    }
+
+    std::vector<uint8_t> lists = {
+        (DATA_ELE_SEQ_DESC_TYPE << 3) | SIZE_IN_NEXT_WORD,
+        static_cast<uint8_t>(records.size() >> 8),
+        static_cast<uint8_t>(records.size())};
+    lists.insert(lists.end(), records.begin(), records.end());
+    return lists;
+  }
+
+  // Feeds one search attribute response fragment to the discovery client.
+  static void ReceiveFragment(tCONN_CB* p_ccb, const uint8_t* p_data,
+                              uint16_t len, bool more) {
+    const uint16_t param_len = 2 + len + (more ? 2 : 1);
+    BT_HDR* p_msg = (BT_HDR*)osi_malloc(sizeof(BT_HDR) + 5 + param_len);
+    p_msg->offset = 0;
+    p_msg->len = 5 + param_len;
+    uint8_t* p = (uint8_t*)(p_msg + 1);
+    UINT8_TO_BE_STREAM(p, SDP_PDU_SERVICE_SEARCH_ATTR_RSP);
+    UINT16_TO_BE_STREAM(p, p_ccb->transaction_id - 1);
+    UINT16_TO_BE_STREAM(p, param_len);
+    UINT16_TO_BE_STREAM(p, len);
+    ARRAY_TO_BE_STREAM(p, p_data, len);
+    UINT8_TO_BE_STREAM(p, more ? 1 : 0);
+    if (more) {
+      UINT8_TO_BE_STREAM(p, 0x42);
+    }
+    sdp_disc_server_rsp(p_ccb, p_msg);
+    osi_free(p_msg);
+  }
+
+  // Starts a search attribute request into |p_db|, returns its connection.
+  tCONN_CB* StartSearch(tSDP_DISCOVERY_DB* p_db) {
+    EXPECT_TRUE(SDP_ServiceSearchAttributeRequest(addr, p_db, nullptr));
+    tCONN_CB* p_ccb = sdpu_find_ccb_by_cid(L2CA_ConnectReq2_cid);
+    EXPECT_NE(p_ccb, nullptr);
+    if (p_ccb == nullptr) return nullptr;
+    tL2CAP_CFG_INFO cfg;
+    sdp_cb.reg_info.pL2CA_ConfigCfm_Cb(p_ccb->connection_id, 0, &cfg);
+    EXPECT_EQ(p_ccb->disc_state, SDP_DISC_WAIT_SEARCH_ATTR);
+    return p_ccb;
+  }
+
+  // Feeds |lists| in fragments of the given lengths, used in turn.
+  static void ReceiveLists(tCONN_CB* p_ccb, const std::vector<uint8_t>& lists,
+                           const std::vector<size_t>& fragment_lens) {
+    size_t pos = 0;
+    for (size_t i = 0; pos < lists.size(); i++) {
+      const size_t len =
+          std::min(fragment_lens[i % fragment_lens.size()], lists.size() - pos);
+      const bool more = pos + len < lists.size();
+      ReceiveFragment(p_ccb, &lists[pos], len, more);
+      pos += len;
+      if (more) {
+        ASSERT_EQ(p_ccb->con_state, SDP_STATE_CONNECTED);
+      }
+    }
+  }
+
+  static int CountRecords(const tSDP_DISCOVERY_DB* p_db) {
+    int num_records = 0;
+    for (tSDP_DISC_REC* p_rec = p_db->p_first_rec; p_rec != nullptr;
+         p_rec = p_rec->p_next_rec) {
+      num_records++;
+    }
+    return num_records;
+  }
+};
+
+TEST_F(StackSdpDiscoveryTest, search_attr_rsp_larger_than_scratchpad) {
+  constexpr int kNumRecords = 40;
+  constexpr uint32_t kDbSize = 32 * 1024;
+  constexpr size_t kFragmentLen = 500;
+  const std::vector<uint8_t> lists = BuildAttrLists(kNumRecords);
+  ASSERT_GT(lists.size(), static_cast<size_t>(SDP_MAX_LIST_BYTE_COUNT));
+
+  const uint16_t attrs[] = {ATTR_ID_SERVICE_RECORD_HDL,
+                            ATTR_ID_SERVICE_CLASS_ID_LIST};
+  Uuid uuid = Uuid::From16Bit(UUID_PROTOCOL_L2CAP);
+  tSDP_DISCOVERY_DB* p_db = (tSDP_DISCOVERY_DB*)osi_malloc(kDbSize);
+  ASSERT_TRUE(SDP_InitDiscoveryDb(p_db, kDbSize, 1, &uuid, 2, attrs));
+
+  ASSERT_TRUE(SDP_ServiceSearchAttributeRequest(addr, p_db, nullptr));
+  tCONN_CB* p_ccb = sdpu_find_ccb_by_cid(L2CA_ConnectReq2_cid);
+  ASSERT_NE(p_ccb, nullptr);
+  tL2CAP_CFG_INFO cfg;
+  sdp_cb.reg_info.pL2CA_ConfigCfm_Cb(p_ccb->connection_id, 0, &cfg);
+  ASSERT_EQ(p_ccb->disc_state, SDP_DISC_WAIT_SEARCH_ATTR);
+
+  for (size_t pos = 0; pos < lists.size(); pos += kFragmentLen) {
+    const size_t len = std::min(kFragmentLen, lists.size() - pos);
+    const bool more = pos + len < lists.size();
+    ReceiveFragment(p_ccb, &lists[pos], len, more);
+    if (more) {
+      // Only the record split across fragments is kept in the scratchpad
+      ASSERT_LT(p_ccb->list_len, 8 + 8 + 5 + kTextLen + 2);
+      ASSERT_EQ(p_ccb->con_state, SDP_STATE_CONNECTED);
+    }
+  }
+  ASSERT_EQ(p_ccb->disconnect_reason, SDP_SUCCESS);
+
+  int num_records = 0;
+  for (tSDP_DISC_REC* p_rec = p_db->p_first_rec; p_rec != nullptr;
+       p_rec = p_rec->p_next_rec, num_records++) {
+    ASSERT_NE(SDP_FindAttributeInRec(p_rec, ATTR_ID_SERVICE_RECORD_HDL),
+              nullptr);
+    ASSERT_NE(SDP_FindAttributeInRec(p_rec, ATTR_ID_SERVICE_CLASS_ID_LIST),
+              nullptr);
+    ASSERT_NE(SDP_FindAttributeInRec(p_rec, kTextAttrId), nullptr);
+  }
+  ASSERT_EQ(num_records, kNumRecords);
+  ASSERT_NE(SDP_FindServiceInDb(p_db, UUID_SERVCLASS_SERIAL_PORT +
+                                          kNumRecords - 1,
+                                nullptr),
+            nullptr);
+
+  sdp_cb.reg_info.pL2CA_DisconnectCfm_Cb(p_ccb->connection_id, 0);
+  ASSERT_EQ(p_ccb->con_state, SDP_STATE_IDLE);
+  osi_free(p_db);
+}
+
+TEST_F(StackSdpDiscoveryTest, search_attr_rsp_split_inside_attributes) {
+  constexpr int kNumRecords = 40;
+  constexpr uint32_t kDbSize = 32 * 1024;
+  const std::vector<uint8_t> lists = BuildAttrLists(kNumRecords);
+  ASSERT_GT(lists.size(), static_cast<size_t>(SDP_MAX_LIST_BYTE_COUNT));
+
+  Uuid uuid = Uuid::From16Bit(UUID_PROTOCOL_L2CAP);
+  tSDP_DISCOVERY_DB* p_db = (tSDP_DISCOVERY_DB*)osi_malloc(kDbSize);
+  ASSERT_TRUE(SDP_InitDiscoveryDb(p_db, kDbSize, 1, &uuid, 0, nullptr));
+  tCONN_CB* p_ccb = StartSearch(p_db);
+  ASSERT_NE(p_ccb, nullptr);
+
+  // Fragment ends fall in the list header, in record and attribute headers,
+  // and in the middle of values
+  ReceiveLists(p_ccb, lists, {1, 2, 3, 5, 8, 13, 21, 34, 55, 89, 144});
+  ASSERT_EQ(p_ccb->disconnect_reason, SDP_SUCCESS);
+
+  ASSERT_EQ(CountRecords(p_db), kNumRecords);
+  int i = 0;
+  for (tSDP_DISC_REC* p_rec = p_db->p_first_rec; p_rec != nullptr;
+       p_rec = p_rec->p_next_rec, i++) {
+    tSDP_DISC_ATTR* p_attr = SDP_FindAttributeInRec(p_rec, kTextAttrId);
+    ASSERT_NE(p_attr, nullptr);
+    ASSERT_EQ(static_cast<size_t>(SDP_DISC_ATTR_LEN(p_attr->attr_len_type)),
+              kTextLen);
+    ASSERT_EQ(std::string(reinterpret_cast<char*>(p_attr->attr_value.v.array),
+                          kTextLen),
+              std::string(kTextLen, 'a' + i % 26));
+    p_attr = SDP_FindAttributeInRec(p_rec, ATTR_ID_SERVICE_RECORD_HDL);
+    ASSERT_NE(p_attr, nullptr);
+    ASSERT_EQ(p_attr->attr_value.v.u32, 0x00010000u + i);
+  }
+
+  sdp_cb.reg_info.pL2CA_DisconnectCfm_Cb(p_ccb->connection_id, 0);
+  osi_free(p_db);
+}
+
+TEST_F(StackSdpDiscoveryTest, search_attr_rsp_skips_unrequested_attrs) {
+  constexpr int kNumRecords = 40;
+  constexpr uint32_t kDbSize = 32 * 1024;
+  const std::vector<uint8_t> lists = BuildAttrLists(kNumRecords);
+
+  // The text attribute is not requested, and the database asks to only
+  // save the requested attributes
+  const uint16_t attrs[] = {ATTR_ID_SERVICE_RECORD_HDL,
+                            ATTR_ID_SERVICE_CLASS_ID_LIST};
+  Uuid uuid = Uuid::From16Bit(UUID_PROTOCOL_L2CAP);
+  tSDP_DISCOVERY_DB* p_db = (tSDP_DISCOVERY_DB*)osi_malloc(kDbSize);
+  ASSERT_TRUE(SDP_InitDiscoveryDb(p_db, kDbSize, 1, &uuid, 2, attrs));
+  p_db->skip_unrequested_attrs = true;
+  tCONN_CB* p_ccb = StartSearch(p_db);
+  ASSERT_NE(p_ccb, nullptr);
+
+  ReceiveLists(p_ccb, lists, {7, 500});
+  ASSERT_EQ(p_ccb->disconnect_reason, SDP_SUCCESS);
+
+  ASSERT_EQ(CountRecords(p_db), kNumRecords);
+  for (tSDP_DISC_REC* p_rec = p_db->p_first_rec; p_rec != nullptr;
+       p_rec = p_rec->p_next_rec) {
+    ASSERT_NE(SDP_FindAttributeInRec(p_rec, ATTR_ID_SERVICE_RECORD_HDL),
+              nullptr);
+    ASSERT_NE(SDP_FindAttributeInRec(p_rec, ATTR_ID_SERVICE_CLASS_ID_LIST),
+              nullptr);
+    ASSERT_EQ(SDP_FindAttributeInRec(p_rec, kTextAttrId), nullptr);
+  }
+
+  sdp_cb.reg_info.pL2CA_DisconnectCfm_Cb(p_ccb->connection_id, 0);
+  osi_free(p_db);
+}
+
+TEST_F(StackSdpDiscoveryTest, search_attr_rsp_truncated_is_rejected) {
+  constexpr uint32_t kDbSize = 32 * 1024;
+  std::vector<uint8_t> lists = BuildAttrLists(3);
+  // The last record is cut in the middle of its text attribute
+  lists.resize(lists.size() - 10);
+
+  Uuid uuid = Uuid::From16Bit(UUID_PROTOCOL_L2CAP);
+  tSDP_DISCOVERY_DB* p_db = (tSDP_DISCOVERY_DB*)osi_malloc(kDbSize);
+  ASSERT_TRUE(SDP_InitDiscoveryDb(p_db, kDbSize, 1, &uuid, 0, nullptr));
+  tCONN_CB* p_ccb = StartSearch(p_db);
+  ASSERT_NE(p_ccb, nullptr);
+
+  ReceiveLists(p_ccb, lists, {100});
+  ASSERT_EQ(p_ccb->disconnect_reason, SDP_INVALID_CONT_STATE);
+  // The records received in full were saved
+  ASSERT_EQ(CountRecords(p_db), 2);
+
+  sdp_cb.reg_info.pL2CA_DisconnectCfm_Cb(p_ccb->connection_id, 0);
+  osi_free(p_db);
+}
+
 static tSDP_DISCOVERY_DB db{};
 static tSDP_DISC_REC rec{};
 static tSDP_DISC_ATTR uuid_desc_attr{};
@@ -453,3 +453,43 @@ TEST_F(StackAvdtpTest, avdt_scb_hdl_pkt_no_frag_regression_test3) {
   // thus vt_data.p_pkt will be set to nullptr
   ASSERT_EQ(evt_data.p_pkt, nullptr);
 }
+
+// Media packets are written with the L2CAP and HCI headers added in front of
+// them, in the headroom left by the encoder. A buffer without that much
+// headroom is dropped and freed rather than written in front of.
+TEST_F(StackAvdtpTest, avdt_scb_hdl_write_req_drops_packet_without_headroom) {
+  const uint16_t payload_size = 100;
+  BT_HDR* p_buf = (BT_HDR*)osi_malloc(sizeof(BT_HDR) +
+                                      AVDT_MEDIA_LOWER_HDR_SIZE + payload_size);
+  p_buf->offset = AVDT_MEDIA_LOWER_HDR_SIZE - 1;
+  p_buf->len = payload_size;
+  tAVDT_SCB_EVT evt_data{};
+  evt_data.apiwrite.p_buf = p_buf;
+
+  AvdtpScb* pscb = avdt_scb_by_hdl(scb_handle_);
+  ASSERT_NE(pscb, nullptr);
+
+  // a leaked buffer would be caught by the address sanitizer
+  avdt_scb_hdl_write_req(pscb, &evt_data);
+  ASSERT_EQ(pscb->p_pkt, nullptr);
+}
+
+TEST_F(StackAvdtpTest, avdt_scb_hdl_write_req_keeps_packet_with_headroom) {
+  const uint16_t payload_size = 100;
+  BT_HDR* p_buf = (BT_HDR*)osi_malloc(sizeof(BT_HDR) +
+                                      AVDT_MEDIA_LOWER_HDR_SIZE + payload_size);
+  p_buf->offset = AVDT_MEDIA_LOWER_HDR_SIZE;
+  p_buf->len = payload_size;
+  tAVDT_SCB_EVT evt_data{};
+  evt_data.apiwrite.p_buf = p_buf;
+
+  AvdtpScb* pscb = avdt_scb_by_hdl(scb_handle_);
+  ASSERT_NE(pscb, nullptr);
+
+  // the codec uses no RTP header, so the buffer is stored as it is
+  avdt_scb_hdl_write_req(pscb, &evt_data);
+  ASSERT_EQ(pscb->p_pkt, p_buf);
+  ASSERT_EQ(pscb->p_pkt->offset, AVDT_MEDIA_LOWER_HDR_SIZE);
+  ASSERT_EQ(pscb->p_pkt->len, payload_size);
+  osi_free_and_reset((void**)&pscb->p_pkt);
+}
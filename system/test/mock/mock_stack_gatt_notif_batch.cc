@@ -0,0 +1,36 @@
+/*
+ * Copyright 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "stack/gatt/gatt_notif_batch.h"
+#include "test/common/mock_functions.h"
+
+void GattNotificationBatch::Add(uint16_t /* handle */,
+                                const uint8_t* /* p_val */,
+                                uint16_t /* len */) {
+  inc_func_call_count(__func__);
+}
+void GattNotificationBatch::Clear() { inc_func_call_count(__func__); }
+std::vector<std::vector<tGATT_PENDING_NOTIF>> GattNotificationBatch::TakePdus(
+    uint16_t /* payload_size */, bool /* multi_notif_supported */) {
+  inc_func_call_count(__func__);
+  return {};
+}
+void gatt_notif_batch_init(void) { inc_func_call_count(__func__); }
+uint64_t gatt_notif_batch_get_window_ms(void) {
+  inc_func_call_count(__func__);
+  return 0;
+}
+void gatt_notif_batch_dump(int /* fd */) { inc_func_call_count(__func__); }